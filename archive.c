@@ -0,0 +1,1094 @@
+/***************************************************************************
+ * Routines to write and read miniSEED records in an SDS archive.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2026 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libmseed.h"
+
+#if defined(LMP_WIN)
+#include <direct.h>
+#define lm_mkdir(P) _mkdir (P)
+#else
+#include <dirent.h>
+#define lm_mkdir(P) mkdir (P, 0777)
+#endif
+
+/* Default maximum number of files kept open by an MS3ArchiveWriter */
+#define LM_ARCHIVEMAXOPEN 256
+
+/* Default size of the output buffer of each open archive file */
+#define LM_ARCHIVEBUFSIZE 65536
+
+/* Bytes read at the start and end of a day file for its first and last records */
+#define LM_ARCHIVEPROBESIZE 65536
+
+/* Length of an SDS day file, leap seconds are not counted by nstime_t */
+#define LM_SDSDAY ((nstime_t)86400 * NSTMODULUS)
+
+/* FNV-1a hash */
+#define LM_FNV_OFFSET 2166136261u
+#define LM_FNV_PRIME 16777619u
+
+/* Open day file of an archive, in a hash table by path and in a list
+ * ordered by most recent use */
+typedef struct LMArchiveFile
+{
+  char path[512];              /* Path of the day file */
+  uint32_t hash;               /* Hash of path */
+  MS3FileWriter *writer;       /* Writer appending to the file */
+  struct LMArchiveFile *hashnext; /* Next file in the same hash bucket */
+  struct LMArchiveFile *prev;  /* More recently used file */
+  struct LMArchiveFile *next;  /* Less recently used file */
+} LMArchiveFile;
+
+/* Directory listing */
+typedef struct LMDir
+{
+#if defined(LMP_WIN)
+  intptr_t handle;             /* Search handle, -1 if not open */
+  struct _finddata_t data;     /* Current entry */
+  int8_t pending;              /* Set if data holds an entry not yet returned */
+#else
+  DIR *dir;                    /* Directory stream */
+#endif
+} LMDir;
+
+/* SDS archive writer (opaque in public header) */
+struct MS3ArchiveWriter
+{
+  char basedir[256];           /* Base directory of the archive */
+  uint64_t buffersize;         /* Output buffer size of each file */
+  int maxopen;                 /* Maximum number of open files */
+  int openfiles;               /* Number of open files */
+  LMArchiveFile **table;       /* Hash table of open files */
+  uint32_t tablesize;          /* Size of table, a power of 2 */
+  LMArchiveFile *mru;          /* Most recently used file */
+  LMArchiveFile *lru;          /* Least recently used file, closed first */
+  int64_t recordcount;         /* Records written to the archive */
+  MS3SourceID sourceid;        /* Codes of the last source identifier written */
+  int8_t verbose;              /* Logging level */
+};
+
+/***************************************************************************
+ * Remove a file from the hash table and use list of an archive.
+ ***************************************************************************/
+static void
+lm_archive_unlink (MS3ArchiveWriter *archive, LMArchiveFile *file)
+{
+  LMArchiveFile **bucket = &archive->table[file->hash & (archive->tablesize - 1)];
+
+  while (*bucket != file)
+    bucket = &(*bucket)->hashnext;
+  *bucket = file->hashnext;
+
+  if (file->prev)
+    file->prev->next = file->next;
+  else
+    archive->mru = file->next;
+
+  if (file->next)
+    file->next->prev = file->prev;
+  else
+    archive->lru = file->prev;
+
+  archive->openfiles--;
+} /* End of lm_archive_unlink() */
+
+/***************************************************************************
+ * Close a file of an archive and release it.
+ *
+ * Returns 0 on success and -1 if writing the file failed.
+ ***************************************************************************/
+static int
+lm_archive_closefile (MS3ArchiveWriter *archive, LMArchiveFile *file)
+{
+  int rv;
+
+  lm_archive_unlink (archive, file);
+
+  rv = ms3_filewriter_close (&file->writer);
+  libmseed_memory.free (file);
+
+  return rv;
+} /* End of lm_archive_closefile() */
+
+/***************************************************************************
+ * Create the directory of the first dirlength bytes of path, creating
+ * missing parent directories as needed.  In the common case of existing
+ * parents this costs a single mkdir().
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_archive_mkdir (char *path, size_t dirlength)
+{
+  char saved = path[dirlength];
+  size_t idx;
+  int rv = 0;
+
+  path[dirlength] = '\0';
+
+  if ((rv = lm_mkdir (path)) != 0 && errno == ENOENT)
+  {
+    /* Create each parent directory from the top, existing or not, failures
+     * are reported by the final attempt to create the leaf */
+    for (idx = 1; idx < dirlength; idx++)
+    {
+      if (path[idx] != '/')
+        continue;
+
+      path[idx] = '\0';
+      lm_mkdir (path);
+      path[idx] = '/';
+    }
+
+    rv = lm_mkdir (path);
+  }
+
+  if (rv != 0 && errno == EEXIST)
+    rv = 0;
+
+  if (rv != 0)
+  {
+    ms_log (2, "Cannot create directory %s: %s\n", path, strerror (errno));
+    rv = -1;
+  }
+
+  path[dirlength] = saved;
+
+  return rv;
+} /* End of lm_archive_mkdir() */
+
+/***************************************************************************
+ * Find the open day file of an archive for a source identifier and
+ * time, opening it if needed and closing the least recently used file
+ * when the limit of open files is reached.
+ *
+ * Returns the file on success and NULL on error.
+ ***************************************************************************/
+static LMArchiveFile *
+lm_archive_file (MS3ArchiveWriter *archive, const char *sid, nstime_t time)
+{
+  LMArchiveFile *file;
+  LMArchiveFile **bucket;
+  MS3SourceID *codes = &archive->sourceid;
+  char path[512];
+  uint16_t year;
+  uint16_t yday;
+  uint32_t hash;
+  size_t dirlength;
+  int length;
+  int idx;
+
+  if (ms_sid2sourceid (sid, codes))
+  {
+    ms_log (2, "Cannot determine archive file for source identifier %s\n", sid);
+    return NULL;
+  }
+
+  if (ms_nstime2time (time, &year, &yday, NULL, NULL, NULL, NULL))
+  {
+    ms_log (2, "Cannot determine archive file for time of %s\n", sid);
+    return NULL;
+  }
+
+  /* SDS path: BASE/YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DOY */
+  idx = snprintf (path, sizeof (path), "%s/%04d/%s/%s/%s.D", archive->basedir, year, codes->net,
+                  codes->sta, codes->chan);
+  length = (idx < 0 || (size_t)idx >= sizeof (path))
+               ? -1
+               : idx + snprintf (path + idx, sizeof (path) - idx, "/%s.%s.%s.%s.D.%04d.%03d",
+                                 codes->net, codes->sta, codes->loc, codes->chan, year, yday);
+
+  if (length < 0 || (size_t)length >= sizeof (path))
+  {
+    ms_log (2, "Archive file name for %s is too long\n", sid);
+    return NULL;
+  }
+
+  dirlength = (size_t)idx;
+
+  hash = LM_FNV_OFFSET;
+  for (idx = 0; idx < length; idx++)
+    hash = (hash ^ (uint8_t)path[idx]) * LM_FNV_PRIME;
+
+  bucket = &archive->table[hash & (archive->tablesize - 1)];
+
+  for (file = *bucket; file; file = file->hashnext)
+  {
+    if (file->hash == hash && !strcmp (file->path, path))
+      break;
+  }
+
+  if (file)
+  {
+    /* Move to the front of the use list */
+    if (file != archive->mru)
+    {
+      file->prev->next = file->next;
+      if (file->next)
+        file->next->prev = file->prev;
+      else
+        archive->lru = file->prev;
+
+      file->prev = NULL;
+      file->next = archive->mru;
+      archive->mru->prev = file;
+      archive->mru = file;
+    }
+
+    return file;
+  }
+
+  /* Close the least recently used file when the limit is reached */
+  if (archive->openfiles >= archive->maxopen)
+  {
+    if (archive->verbose > 1)
+      ms_log (0, "Closing archive file %s\n", archive->lru->path);
+
+    if (lm_archive_closefile (archive, archive->lru))
+      return NULL;
+  }
+
+  if ((file = (LMArchiveFile *)libmseed_memory.malloc (sizeof (LMArchiveFile))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for archive file\n");
+    return NULL;
+  }
+
+  memcpy (file->path, path, (size_t)length + 1);
+  file->hash = hash;
+
+  if (lm_archive_mkdir (file->path, dirlength) ||
+      (file->writer = ms3_filewriter_open (file->path, 0, archive->buffersize,
+                                           archive->verbose)) == NULL)
+  {
+    libmseed_memory.free (file);
+    return NULL;
+  }
+
+  file->hashnext = *bucket;
+  *bucket = file;
+
+  file->prev = NULL;
+  file->next = archive->mru;
+  if (archive->mru)
+    archive->mru->prev = file;
+  else
+    archive->lru = file;
+  archive->mru = file;
+
+  archive->openfiles++;
+
+  return file;
+} /* End of lm_archive_file() */
+
+/** ************************************************************************
+ * @brief Open a writer of miniSEED records to an SDS archive
+ *
+ * Create an opaque ::MS3ArchiveWriter that routes records to day files
+ * of a SeisComP Data Structure (SDS) archive under @p basedir, in the
+ * layout:
+ *
+ * `YEAR/NET/STA/CHAN.D/NET.STA.LOC.CHAN.D.YEAR.DOY`
+ *
+ * where the codes are derived from the record source identifier with
+ * ms_sid2nslc_n() and the year and day from the record time.
+ * Directories are created as needed and records are appended to
+ * existing files.
+ *
+ * Day files are kept open for further records, up to @p maxopen files,
+ * each written through an ::MS3FileWriter with a buffer of @p
+ * buffersize bytes.  When the limit is reached the least recently used
+ * file is closed, which avoids opening a file for each record when
+ * writing many channels.
+ *
+ * @param[in] basedir Base directory of the archive
+ * @param[in] maxopen Maximum number of open files, 0 for a default of 256
+ * @param[in] buffersize Size of the output buffer of each file, 0 for a default of 64 KiB
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns a pointer to an ::MS3ArchiveWriter on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_archive_write_msr()
+ * @see ms3_archive_write_record()
+ * @see ms3_archive_flush()
+ * @see ms3_archive_close()
+ ***************************************************************************/
+MS3ArchiveWriter *
+ms3_archive_open (const char *basedir, int maxopen, uint64_t buffersize, int8_t verbose)
+{
+  MS3ArchiveWriter *archive = NULL;
+
+  if (!basedir)
+  {
+    ms_log (2, "%s(): Required input not defined: 'basedir'\n", __func__);
+    return NULL;
+  }
+
+  if (maxopen < 0)
+  {
+    ms_log (2, "%s(): Maximum number of open files cannot be negative: %d\n", __func__, maxopen);
+    return NULL;
+  }
+
+  if (strlen (basedir) >= sizeof (archive->basedir))
+  {
+    ms_log (2, "Archive directory name is too long: %s\n", basedir);
+    return NULL;
+  }
+
+  archive = (MS3ArchiveWriter *)libmseed_memory.malloc (sizeof (MS3ArchiveWriter));
+  if (!archive)
+  {
+    ms_log (2, "Cannot allocate memory for archive writer\n");
+    return NULL;
+  }
+
+  memset (archive, 0, sizeof (MS3ArchiveWriter));
+  strcpy (archive->basedir, basedir);
+  archive->buffersize = (buffersize > 0) ? buffersize : LM_ARCHIVEBUFSIZE;
+  archive->maxopen = (maxopen > 0) ? maxopen : LM_ARCHIVEMAXOPEN;
+  archive->verbose = verbose;
+
+  /* Hash table of at least twice the open file limit */
+  archive->tablesize = 16;
+  while (archive->tablesize < (uint32_t)archive->maxopen * 2 && archive->tablesize < (1u << 24))
+    archive->tablesize <<= 1;
+
+  archive->table =
+      (LMArchiveFile **)libmseed_memory.malloc (sizeof (LMArchiveFile *) * archive->tablesize);
+  if (!archive->table)
+  {
+    ms_log (2, "Cannot allocate memory for archive writer\n");
+    libmseed_memory.free (archive);
+    return NULL;
+  }
+
+  memset (archive->table, 0, sizeof (LMArchiveFile *) * archive->tablesize);
+
+  return archive;
+} /* End of ms3_archive_open() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3Record into day files of an SDS archive
+ *
+ * Pack the data samples of @p msr into records appended to the archive
+ * day files of its source identifier.  The samples are split at day
+ * boundaries, so that each day file only contains records starting and
+ * ending in its day.  A day is 86400 seconds as leap seconds are not
+ * represented by ::nstime_t.  Records without samples or a sample rate
+ * are written to the file of their start time.
+ *
+ * All samples are packed, as if ::MSF_FLUSHDATA was set in @p flags.
+ * The record is not modified.
+ *
+ * @param[in] archive ::MS3ArchiveWriter context
+ * @param[in] msr ::MS3Record containing data to pack
+ * @param[in] flags Flags controlling packing, as for msr3_pack()
+ * @param[in] verbose Controls verbosity of packing, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+ms3_archive_write_msr (MS3ArchiveWriter *archive, const MS3Record *msr, uint32_t flags,
+                       int8_t verbose)
+{
+  LMArchiveFile *file;
+  MS3Record piece;
+  nstime_t daystart;
+  nstime_t nextday;
+  int64_t remaining;
+  int64_t count;
+  int64_t records = 0;
+  int64_t rv;
+  double sampratehz;
+  uint8_t samplesize;
+
+  if (!archive || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  piece = *msr;
+  remaining = msr->numsamples;
+  samplesize = ms_samplesize (msr->sampletype);
+
+  /* Rates below 1 Hz may be stored as a negative sample period */
+  sampratehz = msr3_sampratehz (msr);
+
+  do
+  {
+    /* Limit the piece to the samples before the next day */
+    count = remaining;
+
+    if (remaining > 1 && sampratehz > 0.0 && msr->datasamples && samplesize)
+    {
+      daystart = piece.starttime / LM_SDSDAY * LM_SDSDAY;
+      if (daystart > piece.starttime)
+        daystart -= LM_SDSDAY;
+      nextday = daystart + LM_SDSDAY;
+
+      if (ms_sampletime (piece.starttime, remaining - 1, sampratehz) >= nextday)
+      {
+        count = (int64_t)((double)(nextday - piece.starttime) / NSTMODULUS * sampratehz);
+
+        while (count < remaining && ms_sampletime (piece.starttime, count, sampratehz) < nextday)
+          count++;
+        while (count > 1 && ms_sampletime (piece.starttime, count - 1, sampratehz) >= nextday)
+          count--;
+      }
+    }
+
+    piece.numsamples = count;
+    piece.samplecnt = count;
+    if (samplesize && msr->datasamples)
+      piece.datasize = (uint64_t)count * samplesize;
+
+    if ((file = lm_archive_file (archive, msr->sid, piece.starttime)) == NULL)
+      return -1;
+
+    if ((rv = ms3_filewriter_write_msr (file->writer, &piece, flags | MSF_FLUSHDATA, verbose)) < 0)
+      return -1;
+
+    records += rv;
+    remaining -= count;
+
+    if (remaining > 0)
+    {
+      piece.datasamples = (char *)piece.datasamples + (size_t)count * samplesize;
+      piece.starttime = ms_sampletime (piece.starttime, count, sampratehz);
+    }
+  } while (remaining > 0);
+
+  archive->recordcount += records;
+
+  return records;
+} /* End of ms3_archive_write_msr() */
+
+/** ************************************************************************
+ * @brief Write the raw record of an ::MS3Record to an SDS archive
+ *
+ * Append the record at ::MS3Record.record, of ::MS3Record.reclen
+ * bytes, as returned by the reading and parsing routines, to the
+ * archive day file of its source identifier and start time.  The
+ * record is written unchanged and is not split at day boundaries.
+ *
+ * @param[in] archive ::MS3ArchiveWriter context
+ * @param[in] msr ::MS3Record with the record to write
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_write_record (MS3ArchiveWriter *archive, const MS3Record *msr)
+{
+  LMArchiveFile *file;
+
+  if (!archive || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  if (!msr->record || msr->reclen <= 0)
+  {
+    ms_log (2, "%s(): Record of %s is not available\n", __func__, msr->sid);
+    return -1;
+  }
+
+  if ((file = lm_archive_file (archive, msr->sid, msr->starttime)) == NULL)
+    return -1;
+
+  if (ms3_filewriter_write (file->writer, msr->record, (uint64_t)msr->reclen))
+    return -1;
+
+  archive->recordcount++;
+
+  return 0;
+} /* End of ms3_archive_write_record() */
+
+/** ************************************************************************
+ * @brief Flush the open files of an SDS archive
+ *
+ * Write the buffered records of all open day files, as done by
+ * ms3_filewriter_flush().  The files remain open.
+ *
+ * @param[in] archive ::MS3ArchiveWriter context
+ * @param[in] sync If non-zero, also commit the files to storage
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_flush (MS3ArchiveWriter *archive, int8_t sync)
+{
+  LMArchiveFile *file;
+  int rv = 0;
+
+  if (!archive)
+  {
+    ms_log (2, "%s(): Required input not defined: 'archive'\n", __func__);
+    return -1;
+  }
+
+  for (file = archive->mru; file; file = file->next)
+  {
+    if (ms3_filewriter_flush (file->writer, sync))
+      rv = -1;
+  }
+
+  return rv;
+} /* End of ms3_archive_flush() */
+
+/** ************************************************************************
+ * @brief Close an SDS archive writer
+ *
+ * Write buffered records, close all open day files and free the
+ * ::MS3ArchiveWriter.  The pointer is set to NULL.
+ *
+ * @param[in,out] archive Pointer to ::MS3ArchiveWriter to close
+ *
+ * @returns 0 on success and -1 if writing any file failed.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_archive_close (MS3ArchiveWriter **archive)
+{
+  int rv = 0;
+
+  if (!archive || !*archive)
+    return 0;
+
+  while ((*archive)->lru)
+  {
+    if (lm_archive_closefile (*archive, (*archive)->lru))
+      rv = -1;
+  }
+
+  if ((*archive)->verbose)
+    ms_log (0, "Wrote %" PRId64 " records to archive %s\n", (*archive)->recordcount,
+            (*archive)->basedir);
+
+  libmseed_memory.free ((*archive)->table);
+  libmseed_memory.free (*archive);
+  *archive = NULL;
+
+  return rv;
+} /* End of ms3_archive_close() */
+
+/***************************************************************************
+ * Open a directory for listing with lm_dir_next().
+ *
+ * Returns 0 on success and -1 if the directory cannot be read.
+ ***************************************************************************/
+static int
+lm_dir_open (LMDir *dir, const char *path)
+{
+#if defined(LMP_WIN)
+  char pattern[520];
+
+  if ((size_t)snprintf (pattern, sizeof (pattern), "%s/*", path) >= sizeof (pattern))
+    return -1;
+
+  dir->handle = _findfirst (pattern, &dir->data);
+  dir->pending = 1;
+
+  return (dir->handle == -1) ? -1 : 0;
+#else
+  dir->dir = opendir (path);
+
+  return (dir->dir == NULL) ? -1 : 0;
+#endif
+} /* End of lm_dir_open() */
+
+/***************************************************************************
+ * Return the name of the next entry of a directory, other than "." and
+ * "..", or NULL when there are no more entries.
+ ***************************************************************************/
+static const char *
+lm_dir_next (LMDir *dir)
+{
+  const char *name;
+
+  for (;;)
+  {
+#if defined(LMP_WIN)
+    if (!dir->pending && _findnext (dir->handle, &dir->data) != 0)
+      return NULL;
+
+    dir->pending = 0;
+    name = dir->data.name;
+#else
+    struct dirent *entry = readdir (dir->dir);
+
+    if (entry == NULL)
+      return NULL;
+
+    name = entry->d_name;
+#endif
+
+    if (strcmp (name, ".") && strcmp (name, ".."))
+      return name;
+  }
+} /* End of lm_dir_next() */
+
+/***************************************************************************
+ * Close a directory opened with lm_dir_open().
+ ***************************************************************************/
+static void
+lm_dir_close (LMDir *dir)
+{
+#if defined(LMP_WIN)
+  _findclose (dir->handle);
+#else
+  closedir (dir->dir);
+#endif
+} /* End of lm_dir_close() */
+
+/***************************************************************************
+ * Test whether any selection could match data in a time range, for
+ * source identifiers starting with prefix, or exactly matching sid if
+ * prefix is NULL.  Publication versions are not considered, as they are
+ * not part of archive paths.  No selections match everything.
+ *
+ * Returns 1 for a possible match and 0 otherwise.
+ ***************************************************************************/
+static int
+lm_archive_match (const MS3Selections *selections, const char *prefix, const char *sid,
+                  nstime_t starttime, nstime_t endtime)
+{
+  const MS3Selections *select;
+  MS3Selections single;
+  size_t length;
+
+  if (!selections)
+    return 1;
+
+  for (select = selections; select; select = select->next)
+  {
+    single = *select;
+    single.next = NULL;
+    single.pubversion = 0;
+
+    if (prefix)
+    {
+      /* Compare the literal leading part of the pattern with the prefix */
+      length = strcspn (select->sidpattern, "*?[");
+      if (strlen (prefix) < length)
+        length = strlen (prefix);
+
+      if (strncmp (select->sidpattern, prefix, length))
+        continue;
+
+      strcpy (single.sidpattern, "*");
+      sid = prefix;
+    }
+
+    if (ms3_matchselect (&single, sid, starttime, endtime, 0, NULL))
+      return 1;
+  }
+
+  return 0;
+} /* End of lm_archive_match() */
+
+/***************************************************************************
+ * Parse the record of a buffer that ends at the end of the buffer,
+ * searching backwards from the end for the last record.
+ *
+ * Returns the end time of the record, or NSTUNSET if not found.
+ ***************************************************************************/
+static nstime_t
+lm_archive_lastrecord (const char *buffer, int64_t length)
+{
+  MS3Record *msr = NULL;
+  nstime_t endtime = NSTUNSET;
+  uint8_t formatversion;
+  int64_t offset;
+
+  for (offset = length - MINRECLEN; offset >= 0; offset--)
+  {
+    if (ms3_detect (buffer + offset, (uint64_t)(length - offset), &formatversion) ==
+            length - offset &&
+        msr3_parse (buffer + offset, (uint64_t)(length - offset), &msr, 0, 0) == MS_NOERROR)
+    {
+      endtime = msr3_endtime (msr);
+      break;
+    }
+  }
+
+  msr3_free (&msr);
+
+  return endtime;
+} /* End of lm_archive_lastrecord() */
+
+/***************************************************************************
+ * Test whether any selection could match the data of a day file, from
+ * the start of its first record and the end of its last record, found
+ * within LM_ARCHIVEPROBESIZE bytes of the start and end of the file.
+ * The records of a day file are expected to be in time order, as
+ * written by ms3_archive_open().  Files whose first and last records
+ * cannot be read this way are not excluded.
+ *
+ * Returns 1 for a possible match and 0 otherwise.
+ ***************************************************************************/
+static int
+lm_archive_probefile (const MS3Selections *selections, const char *path, const char *sid)
+{
+  MS3Record *msr = NULL;
+  nstime_t starttime = NSTUNSET;
+  nstime_t endtime = NSTUNSET;
+  int64_t filesize = -1;
+  int64_t length = 0;
+  char *buffer;
+  FILE *fp;
+
+  if (!selections)
+    return 1;
+
+  if ((buffer = (char *)libmseed_memory.malloc (LM_ARCHIVEPROBESIZE)) == NULL)
+    return 1;
+
+  if ((fp = fopen (path, "rb")) != NULL)
+  {
+    if (lmp_fseek64 (fp, 0, SEEK_END) == 0)
+      filesize = lmp_ftell64 (fp);
+
+    /* First record from the start of the file */
+    if (filesize > 0 && lmp_fseek64 (fp, 0, SEEK_SET) == 0)
+    {
+      length = (int64_t)fread (buffer, 1, LM_ARCHIVEPROBESIZE, fp);
+
+      if (msr3_parse (buffer, (uint64_t)length, &msr, 0, 0) == MS_NOERROR)
+        starttime = msr->starttime;
+    }
+
+    /* Last record from the end of the file */
+    if (starttime != NSTUNSET && filesize > length &&
+        lmp_fseek64 (fp, filesize - LM_ARCHIVEPROBESIZE, SEEK_SET) == 0)
+      length = (int64_t)fread (buffer, 1, LM_ARCHIVEPROBESIZE, fp);
+
+    if (starttime != NSTUNSET && length > 0)
+      endtime = lm_archive_lastrecord (buffer, length);
+
+    fclose (fp);
+  }
+
+  msr3_free (&msr);
+  libmseed_memory.free (buffer);
+
+  if (starttime == NSTUNSET || endtime == NSTUNSET || endtime == NSTERROR || endtime < starttime)
+    return 1;
+
+  return lm_archive_match (selections, NULL, sid, starttime, endtime);
+} /* End of lm_archive_probefile() */
+
+/***************************************************************************
+ * Add a path to a list of paths, growing the list as needed.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_archive_addpath (char ***paths, size_t *count, size_t *size, const char *path)
+{
+  char **newpaths;
+  size_t length = strlen (path) + 1;
+
+  if (*count == *size)
+  {
+    *size = (*size) ? *size * 2 : 64;
+    if ((newpaths = (char **)libmseed_memory.realloc (*paths, sizeof (char *) * *size)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory for archive file list\n");
+      return -1;
+    }
+    *paths = newpaths;
+  }
+
+  if (((*paths)[*count] = (char *)libmseed_memory.malloc (length)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for archive file list\n");
+    return -1;
+  }
+
+  memcpy ((*paths)[*count], path, length);
+  (*count)++;
+
+  return 0;
+} /* End of lm_archive_addpath() */
+
+static int
+lm_cmppath (const void *a, const void *b)
+{
+  return strcmp (*(char *const *)a, *(char *const *)b);
+}
+
+/***************************************************************************
+ * Find the day files of an SDS archive that may contain data matching
+ * the selections, only descending into the year, network and station
+ * directories that may match.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_archive_findfiles (const char *basedir, const MS3Selections *selections, char ***paths,
+                      size_t *count, int8_t verbose)
+{
+  LMDir dirs[5];
+  const char *name;
+  char path[512];
+  char prefix[LM_SIDLEN];
+  char sid[LM_SIDLEN];
+  char net[16], sta[16], loc[16], chan[16];
+  char netdir[16] = {0};
+  size_t offsets[5];
+  size_t size = 0;
+  nstime_t yearstart = 0;
+  nstime_t yearend = 0;
+  nstime_t daystart;
+  int year;
+  int yday;
+  int level = 0;
+  int length;
+  int prefixlength;
+  int rv = 0;
+
+  *count = 0;
+
+  if (lm_dir_open (&dirs[0], basedir))
+  {
+    ms_log (2, "Cannot read archive directory %s: %s\n", basedir, strerror (errno));
+    return -1;
+  }
+
+  offsets[0] = strlen (basedir);
+  if (offsets[0] >= sizeof (path))
+    offsets[0] = sizeof (path) - 1;
+  memcpy (path, basedir, offsets[0]);
+
+  /* Depth-first walk of BASE/YEAR/NET/STA/CHAN.D with a stack of open
+   * directories, the path holds the names of the levels above */
+  while (level >= 0)
+  {
+    if ((name = lm_dir_next (&dirs[level])) == NULL)
+    {
+      lm_dir_close (&dirs[level]);
+      level--;
+      continue;
+    }
+
+    length = snprintf (path + offsets[level], sizeof (path) - offsets[level], "/%s", name);
+    if (length < 0 || (size_t)length >= sizeof (path) - offsets[level])
+      continue;
+
+    if (level == 0)
+    {
+      /* Year directory, files of the last day may hold data of the next year */
+      if (strlen (name) != 4 || sscanf (name, "%4d", &year) != 1)
+        continue;
+
+      yearstart = ms_time2nstime (year, 1, 0, 0, 0, 0);
+      yearend = ms_time2nstime (year + 1, 1, 0, 0, 0, 0) + LM_SDSDAY - 1;
+
+      if (!lm_archive_match (selections, "", NULL, yearstart, yearend))
+        continue;
+    }
+    else if (level == 1)
+    {
+      /* Network directory */
+      if (strlen (name) >= sizeof (netdir))
+        continue;
+
+      strcpy (netdir, name);
+      snprintf (prefix, sizeof (prefix), "FDSN:%s_", netdir);
+
+      if (!lm_archive_match (selections, prefix, NULL, yearstart, yearend))
+        continue;
+    }
+    else if (level == 2)
+    {
+      /* Station directory, skipped if the identifier prefix cannot fit */
+      prefixlength = snprintf (prefix, sizeof (prefix), "FDSN:%s_%s_", netdir, name);
+      if (prefixlength < 0 || (size_t)prefixlength >= sizeof (prefix))
+        continue;
+
+      if (!lm_archive_match (selections, prefix, NULL, yearstart, yearend))
+        continue;
+    }
+    else if (level == 3)
+    {
+      /* Channel directory, CHAN.D */
+      if (length < 4 || strcmp (name + length - 3, ".D"))
+        continue;
+    }
+    else
+    {
+      /* Day file NET.STA.LOC.CHAN.D.YEAR.DOY in a channel directory, where
+       * records starting in the day may extend into the next day */
+      loc[0] = '\0';
+      if (sscanf (name, "%15[^.].%15[^.].%15[^.].%15[^.].D.%4d.%3d", net, sta, loc, chan, &year,
+                  &yday) != 6 &&
+          sscanf (name, "%15[^.].%15[^.]..%15[^.].D.%4d.%3d", net, sta, chan, &year, &yday) != 5)
+        continue;
+
+      if (ms_nslc2sid (sid, sizeof (sid), 0, net, sta, loc, chan) < 0)
+        continue;
+
+      daystart = ms_time2nstime (year, yday, 0, 0, 0, 0);
+
+      if (lm_archive_match (selections, NULL, sid, daystart, daystart + 2 * LM_SDSDAY - 1) &&
+          lm_archive_probefile (selections, path, sid))
+      {
+        if (verbose > 1)
+          ms_log (0, "Selected archive file %s\n", path);
+
+        if (lm_archive_addpath (paths, count, &size, path))
+        {
+          rv = -1;
+          break;
+        }
+      }
+
+      continue;
+    }
+
+    /* Descend, entries that are not directories cannot be opened */
+    if (lm_dir_open (&dirs[level + 1], path) == 0)
+    {
+      offsets[level + 1] = offsets[level] + (size_t)length;
+      level++;
+    }
+  }
+
+  /* Close directories left open after an error */
+  for (; level >= 0; level--)
+    lm_dir_close (&dirs[level]);
+
+  if (*count > 1)
+    qsort (*paths, *count, sizeof (char *), lm_cmppath);
+
+  return rv;
+} /* End of lm_archive_findfiles() */
+
+/** ************************************************************************
+ * @brief Read data matching selections from an SDS archive into a
+ * trace list
+ *
+ * Find the day files of a SeisComP Data Structure (SDS) archive under
+ * @p basedir, in the layout written by ms3_archive_open(), that may
+ * contain data matching @p selections and read them into a
+ * ::MS3TraceList with ms3_readtracelist_selection().
+ *
+ * Only the directories and day files whose codes and dates can match
+ * a selection are listed and read, the source identifier pattern and
+ * time windows of each selection prune the year, network and station
+ * directories and the day files.  A day file is read for selections
+ * including its day or the day after, as records starting late in a
+ * day may extend past midnight.  The first and last records of each
+ * such file are read and the file is skipped if no selection includes
+ * the time between them, as the records of a day file are expected to
+ * be in time order.  Within the files, records are tested
+ * against the selections from their headers, as with
+ * ms3_readtracelist_selection().  Selections may be built from codes
+ * with ms3_addselect_comp().  If @p selections is NULL all files are
+ * read.
+ *
+ * Files are read in path order.  The ::MSF_RECORDLIST flag is not
+ * supported, as the record list would refer to file names that do not
+ * persist beyond this call.
+ *
+ * @param[out] ppmstl Pointer-to-pointer to a ::MS3TraceList to populate
+ * @param[in] basedir Base directory of the archive
+ * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
+ * @param[in] selections Pointer to ::MS3Selections for limiting data
+ * @param[in] splitversion Flag to control splitting of version/quality
+ * @param[in] flags Flags as for ms3_readtracelist_selection()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns ::MS_NOERROR and populates an ::MS3TraceList struct at *ppmstl
+ * on success, otherwise returns a (negative) libmseed error code.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_readtracelist_selection()
+ * @see @ref data-selections
+ ***************************************************************************/
+int
+ms3_archive_readtracelist (MS3TraceList **ppmstl, const char *basedir,
+                           const MS3Tolerance *tolerance, const MS3Selections *selections,
+                           int8_t splitversion, uint32_t flags, int8_t verbose)
+{
+  char **paths = NULL;
+  size_t count = 0;
+  size_t idx;
+  int retcode = MS_NOERROR;
+
+  if (!ppmstl || !basedir)
+  {
+    ms_log (2, "%s(): Required input not defined: 'ppmstl' or 'basedir'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (flags & MSF_RECORDLIST)
+  {
+    ms_log (2, "%s(): Record lists are not supported for archive reading\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (lm_archive_findfiles (basedir, selections, &paths, &count, verbose))
+    retcode = MS_GENERROR;
+
+  /* Initialize MS3TraceList if needed, even if no files match */
+  if (retcode == MS_NOERROR && !*ppmstl && (*ppmstl = mstl3_init (NULL)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    retcode = MS_GENERROR;
+  }
+
+  if (verbose && retcode == MS_NOERROR)
+    ms_log (0, "Reading %" PRIsize_t " files from archive %s\n", count, basedir);
+
+  for (idx = 0; idx < count && retcode == MS_NOERROR; idx++)
+  {
+    retcode = ms3_readtracelist_selection (ppmstl, paths[idx], tolerance, selections,
+                                           splitversion, flags, verbose);
+  }
+
+  for (idx = 0; idx < count; idx++)
+    libmseed_memory.free (paths[idx]);
+
+  if (paths)
+    libmseed_memory.free (paths);
+
+  return retcode;
+} /* End of ms3_archive_readtracelist() */
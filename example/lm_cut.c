@@ -0,0 +1,95 @@
+/***************************************************************************
+ * A program for cutting miniSEED to a time window.
+ *
+ * Records entirely within the window are copied byte-for-byte, only
+ * records crossing the window boundaries are decoded, trimmed and
+ * packed again.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2026 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <libmseed.h>
+
+/* Write each record to the output file */
+static void
+record_handler (char *record, int reclen, void *handlerdata)
+{
+  ms3_filewriter_write ((MS3FileWriter *)handlerdata, record, (uint64_t)reclen);
+}
+
+int
+main (int argc, char **argv)
+{
+  MS3Selections *selections = NULL;
+  MS3FileWriter *writer = NULL;
+  const char *sidpattern = "*";
+  nstime_t starttime;
+  nstime_t endtime;
+  int64_t records;
+  int8_t verbose = 0;
+
+  if (argc < 5 || argc > 6)
+  {
+    ms_log (2, "Usage: %s <infile> <outfile> <starttime> <endtime> [sidpattern]\n", argv[0]);
+    ms_log (2, "  Times are ISO format or '-' for open, outfile may be '-' for stdout\n");
+    return 1;
+  }
+
+  starttime = (strcmp (argv[3], "-")) ? ms_timestr2nstime (argv[3]) : NSTUNSET;
+  endtime = (strcmp (argv[4], "-")) ? ms_timestr2nstime (argv[4]) : NSTUNSET;
+
+  if (starttime == NSTERROR || endtime == NSTERROR)
+  {
+    ms_log (2, "Cannot parse time window: %s to %s\n", argv[3], argv[4]);
+    return 1;
+  }
+
+  if (argc == 6)
+    sidpattern = argv[5];
+
+  if (ms3_addselect (&selections, sidpattern, starttime, endtime, 0))
+  {
+    ms_log (2, "Cannot create data selection\n");
+    return 1;
+  }
+
+  if ((writer = ms3_filewriter_open (argv[2], 1, 0, verbose)) == NULL)
+  {
+    ms3_freeselections (selections);
+    return 1;
+  }
+
+  /* Cut records matching the selection, only decoding those crossing the window */
+  records = ms3_cut_selection (argv[1], selections, record_handler, writer, 0, verbose);
+
+  if (ms3_filewriter_close (&writer) || records < 0)
+  {
+    if (records < 0)
+      ms_log (2, "Cannot cut miniSEED from file: %s\n", ms_errorstr ((int)records));
+    ms3_freeselections (selections);
+    return 1;
+  }
+
+  ms_log (1, "Wrote %" PRId64 " records\n", records);
+
+  ms3_freeselections (selections);
+
+  return 0;
+}
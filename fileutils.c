@@ -18,6 +18,7 @@
  * limitations under the License.
  ***************************************************************************/
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,10 +27,18 @@
 #include <sys/types.h>
 #include <time.h>
 
+#include "internalstate.h"
 #include "libmseed.h"
 #include "msio.h"
+#include "simdutils.h"
+#include "unpack.h"
 
-/* Skip length in bytes when skipping non-data */
+/* LMP_WIN is defined by libmseed.h */
+#if !defined(LMP_WIN)
+#include <pthread.h>
+#endif
+
+/* Minimum skip length in bytes when skipping non-data */
 #define SKIPLEN 1
 
 /* Initialize the global file reading parameters */
@@ -217,6 +226,40 @@ ms3_shift_msfp (MS3FileParam *msfp, int shift)
   return;
 } /* End of ms3_shift_msfp() */
 
+/***************************************************************************
+ *
+ * Determine the number of bytes of non-data to skip at the start of a
+ * buffer, advancing at least SKIPLEN bytes to the next position that
+ * could start a record.
+ *
+ * Candidate positions are located with a vectorized signature search
+ * and confirmed with the fixed header tests used by ms3_detect(), all
+ * positions skipped would fail detection.  When no position can be
+ * confirmed the skip ends where fewer than MINRECLEN bytes remain,
+ * the remainder is tested when more data has been read.
+ ***************************************************************************/
+static int
+ms3_skip_notdata (const char *buffer, int length)
+{
+  int offset = SKIPLEN;
+  int limit = length - MINRECLEN;
+
+  while (offset <= limit)
+  {
+    offset += (int)lm_find_signature (buffer + offset, limit - offset + LM_SIGNATURE_SPAN);
+
+    if (offset > limit)
+      break;
+
+    if (MS3_ISVALIDHEADER (buffer + offset) || MS2_ISVALIDHEADER (buffer + offset))
+      return offset;
+
+    offset++;
+  }
+
+  return (offset > SKIPLEN) ? offset : SKIPLEN;
+} /* End of ms3_skip_notdata() */
+
 /* Macro to calculate length of unprocessed buffer */
 #define MSFPBUFLEN(MSFP) (MSFP->readlength - MSFP->readoffset)
 
@@ -237,7 +280,9 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
   MS3FileParam *msfp;
   uint32_t pflags = flags;
   char *pathname_range = NULL;
+  char sid[LM_SIDLEN];
 
+  int64_t preskip = 0;
   int parseval = 0;
   int readsize = 0;
   int readcount = 0;
@@ -460,6 +505,27 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
       if (msio_feof (&msfp->input) || atrangeend)
         pflags |= MSF_ATENDOFFILE;
 
+      /* Skip records not matching selections using only the fixed header */
+      if (selections &&
+          (preskip = lm_preselect_skip (selections, MSFPREADPTR (msfp), MSFPBUFLEN (msfp), sid)) > 0)
+      {
+        msfp->flags |= MSFP_PARSEDRECORD;
+
+        if (verbose > 1)
+        {
+          ms_log (0,
+                  "Skipping (selection) record for %s (%" PRId64
+                  " bytes) starting at offset %" PRId64 "\n",
+                  sid, preskip, msfp->streampos);
+        }
+
+        /* Skip record length bytes, update reading offset and file position */
+        msfp->readoffset += preskip;
+        msfp->streampos += preskip;
+        parseval = 0;
+        continue;
+      }
+
       parseval = msr3_parse (MSFPREADPTR (msfp), MSFPBUFLEN (msfp), ppmsr, pflags, verbose);
 
       /* Record detected and parsed */
@@ -514,15 +580,17 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
         /* Skip non-data if requested */
         if (flags & MSF_SKIPNOTDATA)
         {
+          int skiplen = ms3_skip_notdata (MSFPREADPTR (msfp), MSFPBUFLEN (msfp));
+
           if (verbose > 1)
           {
-            ms_log (0, "Skipped %d bytes of non-data record at byte offset %" PRId64 "\n", SKIPLEN,
+            ms_log (0, "Skipped %d bytes of non-data record at byte offset %" PRId64 "\n", skiplen,
                     msfp->streampos);
           }
 
-          /* Skip SKIPLEN bytes, update reading offset and file position */
-          msfp->readoffset += SKIPLEN;
-          msfp->streampos += SKIPLEN;
+          /* Skip to next possible record, update reading offset and file position */
+          msfp->readoffset += skiplen;
+          msfp->streampos += skiplen;
         }
         /* Parsing errors */
         else if (parseval == MS_NOTSEED)
@@ -556,9 +624,11 @@ _ms3_readmsr_impl (MS3FileParam **ppmsfp, MS3Record **ppmsr, const char *mspath,
         {
           if (flags & MSF_SKIPNOTDATA)
           {
-            /* Skip SKIPLEN bytes, update reading offset and file position */
-            msfp->readoffset += SKIPLEN;
-            msfp->streampos += SKIPLEN;
+            int skiplen = ms3_skip_notdata (MSFPREADPTR (msfp), MSFPBUFLEN (msfp));
+
+            /* Skip to next possible record, update reading offset and file position */
+            msfp->readoffset += skiplen;
+            msfp->streampos += skiplen;
           }
           else
           {
@@ -806,6 +876,7 @@ ms3_readtracelist_timewin (MS3TraceList **ppmstl, const char *mspath, const MS3T
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
  *  - @c ::MSF_RECORDLIST_NOEXTRAS : Do not copy extra headers into record list entries
  *  - @c ::MSF_SKIPADJACENTDUPLICATES : Skip adjacent duplicate records
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records already added to the trace list, before unpacking
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -831,6 +902,8 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
   uint32_t dataoffset;
   uint32_t datasize;
   uint32_t previous_crc = 0;
+  uint32_t rflags = flags;
+  int duplicate;
   int retcode;
 
   if (!ppmstl)
@@ -851,8 +924,12 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
     }
   }
 
+  /* Defer data unpacking until duplicates are skipped by unsetting MSF_UNPACKDATA */
+  if (flags & MSF_SKIPDUPLICATES)
+    rflags &= ~(MSF_UNPACKDATA);
+
   /* Loop over the input file and add each record to trace list */
-  while ((retcode = ms3_readmsr_selection (&msfp, &msr, mspath, flags, selections, verbose)) ==
+  while ((retcode = ms3_readmsr_selection (&msfp, &msr, mspath, rflags, selections, verbose)) ==
          MS_NOERROR)
   {
     if (flags & MSF_SKIPADJACENTDUPLICATES)
@@ -867,8 +944,28 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
       previous_crc = crc;
     }
 
+    if (flags & MSF_SKIPDUPLICATES)
+    {
+      if ((duplicate = lm_tracelist_seen (*ppmstl, msr)) < 0)
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+
+      if (duplicate)
+        continue;
+
+      /* Unpack data samples deferred until the record is known to be new */
+      if ((flags & MSF_UNPACKDATA) && msr->samplecnt > 0 &&
+          msr3_unpack_data (msr, verbose) != msr->samplecnt)
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+    }
+
     seg = mstl3_addmsr_recordptr (*ppmstl, msr, (flags & MSF_RECORDLIST) ? &recordptr : NULL,
-                                  splitversion, 1, flags, tolerance);
+                                  splitversion, 1, flags & ~MSF_SKIPDUPLICATES, tolerance);
 
     if (seg == NULL)
     {
@@ -907,98 +1004,622 @@ ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspath,
 } /* End of ms3_readtracelist_selection() */
 
 /** ************************************************************************
- * @brief Set User-Agent header for URL-based requests.
+ * @brief Cut miniSEED records of a file to selections
  *
- * Configure global User-Agent header for URL-based requests
- * generated by the library.  The @p program and @p version values
- * will be combined into the form "program/version" along with
- * declarations of the library and URL-supporting dependency versions.
+ * Read the records of @p mspath matching @p selections and deliver the
+ * parts within the time windows of the matching selection to @p
+ * record_handler using msr3_cut().  Records entirely within a time
+ * window are delivered byte-for-byte without decoding, only the records
+ * crossing a window boundary are decoded, trimmed and packed again.
  *
- * An error will be returned when the library was not compiled with
- * URL support.
+ * A record intersecting several time windows of the matching selection
+ * is cut to each of them.  If @p selections is NULL all records are
+ * delivered unchanged.
  *
- * @param[in] program Name of calling program
- * @param[in] version Version of calling program
+ * @param[in] mspath File to read
+ * @param[in] selections Pointer to ::MS3Selections with source IDs and time windows
+ * @param[in] record_handler Callback function to receive records
+ * @param[in] handlerdata Pointer passed to @p record_handler
+ * @param[in] flags Flags supported by msr3_parse() and msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
  *
- * @returns 0 on succes and a negative library error code on error.
+ * @returns the number of records delivered on success, otherwise a
+ * (negative) libmseed error code.
  *
  * @ref MessageOnError - this function logs a message on error
+ *
+ * @see msr3_cut()
+ * @see @ref data-selections
  ***************************************************************************/
-int
-ms3_url_useragent (const char *program, const char *version)
+int64_t
+ms3_cut_selection (const char *mspath, const MS3Selections *selections,
+                   void (*record_handler) (char *, int, void *), void *handlerdata, uint32_t flags,
+                   int8_t verbose)
 {
-#if !defined(LIBMSEED_URL)
-  (void)program; /* Unused */
-  (void)version; /* Unused */
-  ms_log (2, "URL support not included in library\n");
-  return -1;
-#else
-  return msio_url_useragent (program, version);
-#endif
-} /* End of ms3_url_useragent() */
+  MS3Record *msr = NULL;
+  MS3FileParam *msfp = NULL;
+  const MS3Selections *match;
+  const MS3SelectTime *window;
+  int64_t records = 0;
+  int64_t rv;
+  int retcode;
 
-/** ************************************************************************
- * @brief Set connection and stall timeouts for URL-based requests.
+  if (!mspath || !record_handler)
+  {
+    ms_log (2, "%s(): Required input not defined: 'mspath' or 'record_handler'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  /* Records are only decoded when cut */
+  flags &= ~MSF_UNPACKDATA;
+
+  while ((retcode = ms3_readmsr_selection (&msfp, &msr, mspath, flags, selections, verbose)) ==
+         MS_NOERROR)
+  {
+    match = (selections) ? msr3_matchselect (selections, msr, NULL) : NULL;
+    window = (match) ? match->timewindows : NULL;
+
+    /* Cut to each time window, or pass through if there are none */
+    do
+    {
+      if ((rv = msr3_cut (msr, (window) ? window->starttime : NSTUNSET,
+                          (window) ? window->endtime : NSTUNSET, record_handler, handlerdata,
+                          flags, verbose)) < 0)
+      {
+        retcode = MS_GENERROR;
+        break;
+      }
+
+      records += rv;
+    } while (window && (window = window->next));
+
+    if (retcode != MS_NOERROR)
+      break;
+  }
+
+  ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+  if (retcode != MS_NOERROR && retcode != MS_ENDOFFILE)
+    return retcode;
+
+  return records;
+} /* End of ms3_cut_selection() */
+
+/* Maximum number of merge inputs open at once, idle file inputs are closed */
+#define LM_MERGEMAXOPEN 128
+
+/* Input of an MS3MergeReader with its current record */
+typedef struct LMMergeInput
+{
+  char *path;                  /* Path of the input, owned */
+  MS3FileParam *msfp;          /* Reading state, NULL while closed */
+  MS3Record *msr;              /* Current record, the next to be merged */
+  char *record;                /* Copy of the current raw record while closed */
+  uint32_t recordsize;         /* Allocated size of record copy */
+  int64_t resumeoffset;        /* Stream position to reopen a closed input at */
+  int64_t endoffset;           /* End offset of the input, 0 if unknown */
+  int prev;                    /* Next more recently read open input, -1 if none */
+  int next;                    /* Next less recently read open input, -1 if none */
+  int8_t open;                 /* Input is a file in the list of open inputs */
+  int8_t closed;               /* Input was closed while idle */
+} LMMergeInput;
+
+/* Time-ordered merge of records from several inputs (opaque in public header) */
+struct MS3MergeReader
+{
+  LMMergeInput *inputs;        /* Inputs, in order given */
+  int count;                   /* Number of inputs */
+  int *heap;                   /* Binary min-heap of indices of inputs with a current record */
+  int heapsize;                /* Number of inputs in the heap */
+  int yielded;                 /* Input of the last returned record, advanced on the next call */
+  int openhead;                /* Most recently read open file input, -1 if none */
+  int opentail;                /* Least recently read open file input, -1 if none */
+  int opencount;               /* Number of open file inputs */
+  uint32_t flags;              /* Reading flags */
+  int8_t bysid;                /* Order by source identifier before start time */
+  int8_t verbose;              /* Logging level */
+};
+
+/***************************************************************************
+ * Compare the current records of two merge inputs, by start time and
+ * source identifier in the order of the reader, then by input position
+ * so records with equal keys are returned in input order.
  *
- * Set global timeouts, in seconds, for URL-based requests generated
- * by the library.  The @p connecttimeout limits the time allowed to
- * establish a connection and the @p stalltimeout limits the time a
- * transfer is allowed to proceed at less than 1 byte/second, guarding
- * against a stalled connection that would otherwise hang indefinitely.
+ * Returns a negative value if input a is ordered first and a positive
+ * value otherwise.
+ ***************************************************************************/
+static int
+lm_merge_compare (const MS3MergeReader *merge, int a, int b)
+{
+  const MS3Record *msra = merge->inputs[a].msr;
+  const MS3Record *msrb = merge->inputs[b].msr;
+  int cmp;
+
+  if (merge->bysid && (cmp = strcmp (msra->sid, msrb->sid)) != 0)
+    return cmp;
+
+  if (msra->starttime != msrb->starttime)
+    return (msra->starttime < msrb->starttime) ? -1 : 1;
+
+  if (!merge->bysid && (cmp = strcmp (msra->sid, msrb->sid)) != 0)
+    return cmp;
+
+  return a - b;
+} /* End of lm_merge_compare() */
+
+/***************************************************************************
+ * Move the heap entry at position down to restore the heap order.
+ ***************************************************************************/
+static void
+lm_merge_siftdown (MS3MergeReader *merge, int position)
+{
+  int child;
+  int entry = merge->heap[position];
+
+  while ((child = 2 * position + 1) < merge->heapsize)
+  {
+    if (child + 1 < merge->heapsize &&
+        lm_merge_compare (merge, merge->heap[child + 1], merge->heap[child]) < 0)
+      child++;
+
+    if (lm_merge_compare (merge, entry, merge->heap[child]) <= 0)
+      break;
+
+    merge->heap[position] = merge->heap[child];
+    position = child;
+  }
+
+  merge->heap[position] = entry;
+} /* End of lm_merge_siftdown() */
+
+/***************************************************************************
+ * Remove a merge input from the list of open file inputs.
+ ***************************************************************************/
+static void
+lm_merge_unlink (MS3MergeReader *merge, int index)
+{
+  LMMergeInput *input = &merge->inputs[index];
+
+  if (!input->open)
+    return;
+
+  if (input->prev >= 0)
+    merge->inputs[input->prev].next = input->next;
+  else
+    merge->openhead = input->next;
+
+  if (input->next >= 0)
+    merge->inputs[input->next].prev = input->prev;
+  else
+    merge->opentail = input->prev;
+
+  input->open = 0;
+  merge->opencount--;
+} /* End of lm_merge_unlink() */
+
+/***************************************************************************
+ * Close an idle merge input, keeping a copy of its current raw record
+ * and the stream position to reopen it at.
  *
- * A value of 0 disables the respective timeout and a negative value
- * leaves it unchanged.  If not set, a connect timeout of 60 seconds
- * and a stall timeout of 300 seconds are used by default.  The stall
- * timeout can also be set with the \b LIBMSEED_URL_TIMEOUT
- * environment variable, overridden by a call to this function.
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_merge_suspend (MS3MergeReader *merge, int index)
+{
+  LMMergeInput *input = &merge->inputs[index];
+  MS3Record *msr = input->msr;
+  char *record;
+
+  if (input->recordsize < (uint32_t)msr->reclen)
+  {
+    if ((record = (char *)libmseed_memory.realloc (input->record, msr->reclen)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory for merge reader\n");
+      return -1;
+    }
+
+    input->record = record;
+    input->recordsize = (uint32_t)msr->reclen;
+  }
+
+  memcpy (input->record, msr->record, msr->reclen);
+  msr->record = input->record;
+
+  /* Reopen without any byte range suffix, which is replaced by the offsets */
+  input->resumeoffset = input->msfp->streampos;
+  input->endoffset = input->msfp->endoffset;
+  strcpy (input->path, input->msfp->path);
+
+  /* Release the reading state, keeping the current record */
+  input->msr = NULL;
+  ms3_readmsr_r (&input->msfp, &input->msr, NULL, 0, 0);
+  input->msr = msr;
+
+  lm_merge_unlink (merge, index);
+  input->closed = 1;
+
+  return 0;
+} /* End of lm_merge_suspend() */
+
+/***************************************************************************
+ * Read the next record of a merge input.
  *
- * An error will be returned when the library was not compiled with
- * URL support.
+ * An input closed while idle is reopened at its saved stream position.
+ * Only LM_MERGEMAXOPEN file inputs are kept open, the least recently
+ * read are closed.
  *
- * @param[in] connecttimeout Connection timeout in seconds, negative to leave unchanged
- * @param[in] stalltimeout Stall (low-speed) timeout in seconds, negative to leave unchanged
+ * Returns MS_NOERROR when a record is available, MS_ENDOFFILE at the
+ * end of the input, and a (negative) libmseed error code on error.
+ ***************************************************************************/
+static int
+lm_merge_read (MS3MergeReader *merge, int index)
+{
+  LMMergeInput *input = &merge->inputs[index];
+  uint32_t flags = merge->flags;
+  int retcode;
+
+  if (input->closed)
+  {
+    if ((input->msfp = ms3_msfp_init (input->resumeoffset, input->endoffset, -1)) == NULL)
+      return MS_GENERROR;
+
+    /* Records were read before, reaching the end of the input is not an error */
+    input->msfp->flags |= MSFP_PARSEDRECORD;
+    flags &= ~MSF_PNAMERANGE;
+    input->closed = 0;
+  }
+
+  retcode = ms3_readmsr_r (&input->msfp, &input->msr, input->path, flags, merge->verbose);
+
+  if (retcode != MS_NOERROR)
+  {
+    if (retcode != MS_ENDOFFILE)
+      ms_log (2, "Cannot read %s: %s\n", input->path, ms_errorstr (retcode));
+
+    /* Release the reading state and record of the finished input */
+    ms3_readmsr_r (&input->msfp, &input->msr, NULL, 0, 0);
+    lm_merge_unlink (merge, index);
+
+    return retcode;
+  }
+
+  /* Move file inputs to the head of the list of open inputs */
+  if (input->msfp->input.type == LMIO_FILE)
+  {
+    lm_merge_unlink (merge, index);
+
+    input->prev = -1;
+    input->next = merge->openhead;
+    if (merge->openhead >= 0)
+      merge->inputs[merge->openhead].prev = index;
+    else
+      merge->opentail = index;
+    merge->openhead = index;
+    input->open = 1;
+    merge->opencount++;
+  }
+
+  while (merge->opencount > LM_MERGEMAXOPEN)
+  {
+    if (lm_merge_suspend (merge, merge->opentail))
+      return MS_GENERROR;
+  }
+
+  return retcode;
+} /* End of lm_merge_read() */
+
+/** ************************************************************************
+ * @brief Open a time-ordered merge of miniSEED records from several
+ * inputs
+ *
+ * Create an opaque ::MS3MergeReader returning the records of the @p
+ * count inputs at @p paths in a single order through
+ * ms3_mergereader_next().  Records are merged through a heap holding the
+ * current record of each input, so memory use is bounded by the number
+ * of inputs rather than the amount of data, and records are not decoded
+ * unless ::MSF_UNPACKDATA is set in @p flags.
+ *
+ * If @p bysid is non-zero records are ordered by source identifier and
+ * then start time, otherwise by start time and then source identifier.
+ * Records with equal keys are returned in the order of the inputs.  The
+ * merge is only fully ordered if each input is in that order itself,
+ * the records of an input are always returned in input order.
+ *
+ * Each input is read with ms3_readmsr_r(), a path may be any input
+ * supported by ms3_readmsr().  At most 128 file inputs are kept open,
+ * the least recently read are closed while idle and reopened at the
+ * same position when their next record is needed, so the number of
+ * inputs is not limited by the number of open files.  Other inputs,
+ * such as URLs, are kept open until they are exhausted.
+ *
+ * @param[in] paths Array of @p count paths to read
+ * @param[in] count Number of inputs
+ * @param[in] bysid Flag to order by source identifier before start time
+ * @param[in] flags Flags supported by msr3_parse()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
  *
- * @returns 0 on succes and a negative library error code on error.
+ * @returns a pointer to an ::MS3MergeReader on success and NULL on error.
  *
  * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_mergereader_next()
+ * @see ms3_mergereader_close()
  ***************************************************************************/
-int
-ms3_url_timeout (long connecttimeout, long stalltimeout)
+MS3MergeReader *
+ms3_mergereader_open (const char *const *paths, int count, int8_t bysid, uint32_t flags,
+                      int8_t verbose)
 {
-#if !defined(LIBMSEED_URL)
-  (void)connecttimeout; /* Unused */
-  (void)stalltimeout;   /* Unused */
-  ms_log (2, "URL support not included in library\n");
-  return -1;
-#else
-  return msio_url_timeout (connecttimeout, stalltimeout);
-#endif
-} /* End of ms3_url_timeout() */
+  MS3MergeReader *merge = NULL;
+  size_t length;
+  int idx;
+
+  if (!paths || count < 0)
+  {
+    ms_log (2, "%s(): Required input not defined: 'paths'\n", __func__);
+    return NULL;
+  }
+
+  if ((merge = (MS3MergeReader *)libmseed_memory.malloc (sizeof (MS3MergeReader))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for merge reader\n");
+    return NULL;
+  }
+
+  memset (merge, 0, sizeof (MS3MergeReader));
+  merge->count = count;
+  merge->yielded = -1;
+  merge->openhead = -1;
+  merge->opentail = -1;
+  merge->bysid = bysid;
+  merge->flags = flags;
+  merge->verbose = verbose;
+
+  merge->inputs = (LMMergeInput *)libmseed_memory.malloc (sizeof (LMMergeInput) * (count + 1));
+  merge->heap = (int *)libmseed_memory.malloc (sizeof (int) * (count + 1));
+
+  if (!merge->inputs || !merge->heap)
+  {
+    ms_log (2, "Cannot allocate memory for merge reader\n");
+    merge->count = 0;
+    ms3_mergereader_close (&merge);
+    return NULL;
+  }
+
+  memset (merge->inputs, 0, sizeof (LMMergeInput) * (count + 1));
+
+  for (idx = 0; idx < count; idx++)
+  {
+    if (!paths[idx])
+    {
+      ms_log (2, "%s(): Required input not defined: 'paths[%d]'\n", __func__, idx);
+      ms3_mergereader_close (&merge);
+      return NULL;
+    }
+
+    length = strlen (paths[idx]) + 1;
+    if ((merge->inputs[idx].path = (char *)libmseed_memory.malloc (length)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory for merge reader\n");
+      ms3_mergereader_close (&merge);
+      return NULL;
+    }
+    memcpy (merge->inputs[idx].path, paths[idx], length);
+  }
+
+  /* Read the first record of each input and build the heap */
+  for (idx = 0; idx < count; idx++)
+  {
+    switch (lm_merge_read (merge, idx))
+    {
+    case MS_NOERROR:
+      merge->heap[merge->heapsize++] = idx;
+      break;
+    case MS_ENDOFFILE:
+      break;
+    default:
+      ms3_mergereader_close (&merge);
+      return NULL;
+    }
+  }
+
+  for (idx = merge->heapsize / 2 - 1; idx >= 0; idx--)
+    lm_merge_siftdown (merge, idx);
+
+  return merge;
+} /* End of ms3_mergereader_open() */
 
 /** ************************************************************************
- * @brief Set authentication credentials for URL-based requests.
- *
- * Sets global user and password for authentication for URL-based
- * requests generated by the library.  The expected format of the
- * credentials is: "[user name]:[password]" (without the square
- * brackets).
+ * @brief Return the next record of a time-ordered merge
  *
- * An error will be returned when the library was not compiled with
- * URL support.
+ * Set @p *ppmsr to the next record in the order of the ::MS3MergeReader.
+ * The record, including the raw record at ::MS3Record.record, is owned
+ * by the reader and valid until the next call, it may be written out
+ * unchanged or modified and unpacked.
  *
- * @param[in] userpassword User and password as user:password
+ * @param[in] merge ::MS3MergeReader context
+ * @param[out] ppmsr Pointer-to-pointer set to the next record
  *
- * @returns 0 on succes and a negative library error code on error.
+ * @returns ::MS_NOERROR when a record is returned, ::MS_ENDOFFILE when
+ * all inputs are exhausted, and a (negative) libmseed error code on
+ * error.
  *
  * @ref MessageOnError - this function logs a message on error
  ***************************************************************************/
 int
-ms3_url_userpassword (const char *userpassword)
+ms3_mergereader_next (MS3MergeReader *merge, MS3Record **ppmsr)
 {
-#if !defined(LIBMSEED_URL)
-  (void)userpassword; /* Unused */
-  ms_log (2, "URL support not included in library\n");
-  return -1;
+  int retcode;
+
+  if (!merge || !ppmsr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'merge' or 'ppmsr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  *ppmsr = NULL;
+
+  /* Advance the input of the last returned record, at the top of the heap */
+  if (merge->yielded >= 0)
+  {
+    retcode = lm_merge_read (merge, merge->yielded);
+    merge->yielded = -1;
+
+    if (retcode == MS_ENDOFFILE)
+    {
+      merge->heap[0] = merge->heap[--merge->heapsize];
+    }
+    else if (retcode != MS_NOERROR)
+    {
+      merge->heap[0] = merge->heap[--merge->heapsize];
+      return retcode;
+    }
+
+    if (merge->heapsize > 1)
+      lm_merge_siftdown (merge, 0);
+  }
+
+  if (merge->heapsize == 0)
+    return MS_ENDOFFILE;
+
+  merge->yielded = merge->heap[0];
+  *ppmsr = merge->inputs[merge->yielded].msr;
+
+  return MS_NOERROR;
+} /* End of ms3_mergereader_next() */
+
+/** ************************************************************************
+ * @brief Close a time-ordered merge
+ *
+ * Close all inputs and free the ::MS3MergeReader.  The pointer is set
+ * to NULL.
+ *
+ * @param[in,out] merge Pointer to ::MS3MergeReader to close
+ ***************************************************************************/
+void
+ms3_mergereader_close (MS3MergeReader **merge)
+{
+  int idx;
+
+  if (!merge || !*merge)
+    return;
+
+  if ((*merge)->inputs)
+  {
+    for (idx = 0; idx < (*merge)->count; idx++)
+    {
+      if ((*merge)->inputs[idx].msfp || (*merge)->inputs[idx].msr)
+        ms3_readmsr_r (&(*merge)->inputs[idx].msfp, &(*merge)->inputs[idx].msr, NULL, 0, 0);
+
+      if ((*merge)->inputs[idx].path)
+        libmseed_memory.free ((*merge)->inputs[idx].path);
+
+      if ((*merge)->inputs[idx].record)
+        libmseed_memory.free ((*merge)->inputs[idx].record);
+    }
+
+    libmseed_memory.free ((*merge)->inputs);
+  }
+
+  if ((*merge)->heap)
+    libmseed_memory.free ((*merge)->heap);
+
+  libmseed_memory.free (*merge);
+  *merge = NULL;
+} /* End of ms3_mergereader_close() */
+
+/** ************************************************************************
+ * @brief Set User-Agent header for URL-based requests.
+ *
+ * Configure global User-Agent header for URL-based requests
+ * generated by the library.  The @p program and @p version values
+ * will be combined into the form "program/version" along with
+ * declarations of the library and URL-supporting dependency versions.
+ *
+ * An error will be returned when the library was not compiled with
+ * URL support.
+ *
+ * @param[in] program Name of calling program
+ * @param[in] version Version of calling program
+ *
+ * @returns 0 on succes and a negative library error code on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_url_useragent (const char *program, const char *version)
+{
+#if !defined(LIBMSEED_URL)
+  (void)program; /* Unused */
+  (void)version; /* Unused */
+  ms_log (2, "URL support not included in library\n");
+  return -1;
+#else
+  return msio_url_useragent (program, version);
+#endif
+} /* End of ms3_url_useragent() */
+
+/** ************************************************************************
+ * @brief Set connection and stall timeouts for URL-based requests.
+ *
+ * Set global timeouts, in seconds, for URL-based requests generated
+ * by the library.  The @p connecttimeout limits the time allowed to
+ * establish a connection and the @p stalltimeout limits the time a
+ * transfer is allowed to proceed at less than 1 byte/second, guarding
+ * against a stalled connection that would otherwise hang indefinitely.
+ *
+ * A value of 0 disables the respective timeout and a negative value
+ * leaves it unchanged.  If not set, a connect timeout of 60 seconds
+ * and a stall timeout of 300 seconds are used by default.  The stall
+ * timeout can also be set with the \b LIBMSEED_URL_TIMEOUT
+ * environment variable, overridden by a call to this function.
+ *
+ * An error will be returned when the library was not compiled with
+ * URL support.
+ *
+ * @param[in] connecttimeout Connection timeout in seconds, negative to leave unchanged
+ * @param[in] stalltimeout Stall (low-speed) timeout in seconds, negative to leave unchanged
+ *
+ * @returns 0 on succes and a negative library error code on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_url_timeout (long connecttimeout, long stalltimeout)
+{
+#if !defined(LIBMSEED_URL)
+  (void)connecttimeout; /* Unused */
+  (void)stalltimeout;   /* Unused */
+  ms_log (2, "URL support not included in library\n");
+  return -1;
+#else
+  return msio_url_timeout (connecttimeout, stalltimeout);
+#endif
+} /* End of ms3_url_timeout() */
+
+/** ************************************************************************
+ * @brief Set authentication credentials for URL-based requests.
+ *
+ * Sets global user and password for authentication for URL-based
+ * requests generated by the library.  The expected format of the
+ * credentials is: "[user name]:[password]" (without the square
+ * brackets).
+ *
+ * An error will be returned when the library was not compiled with
+ * URL support.
+ *
+ * @param[in] userpassword User and password as user:password
+ *
+ * @returns 0 on succes and a negative library error code on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_url_userpassword (const char *userpassword)
+{
+#if !defined(LIBMSEED_URL)
+  (void)userpassword; /* Unused */
+  ms_log (2, "URL support not included in library\n");
+  return -1;
 #else
   return msio_url_userpassword (userpassword);
 #endif
@@ -1052,6 +1673,23 @@ ms3_url_freeheaders (void)
 #endif
 } /* End of ms3_url_freeheaders() */
 
+/***************************************************************************
+ *
+ * Internal batch handler.  The handler data should be a pointer to
+ * an open file descriptor to which batches of records will be written.
+ *
+ ***************************************************************************/
+static void
+ms_batch_handler_int (char *records, uint64_t length, int reccount, void *ofp)
+{
+  (void)reccount;
+
+  if (fwrite (records, (size_t)length, 1, (FILE *)ofp) != 1)
+  {
+    ms_log (2, "Error writing to output file\n");
+  }
+} /* End of ms_batch_handler_int() */
+
 /** ************************************************************************
  * @brief Write miniSEED from an ::MS3Record container to a file
  *
@@ -1088,11 +1726,6 @@ msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overwrite, uint32_t
   const char *perms = (overwrite) ? "wb" : "ab";
   int64_t packedrecords = 0;
 
-  MS3RecordPacker *packer;
-  char *record = NULL;
-  int32_t reclen = 0;
-  int result;
-
   if (!msr || !mspath)
   {
     ms_log (2, "%s(): Required input not defined: 'msr' or 'mspath'\n", __func__);
@@ -1109,58 +1742,34 @@ msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overwrite, uint32_t
     ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
     return -1;
   }
+  else
+  {
+    /* Records are written in batches, stream buffering would only copy them */
+    setvbuf (ofp, NULL, _IONBF, 0);
+  }
 
-  /* Initialize packer */
-  packer = msr3_pack_init (msr, flags, verbose);
-  if (!packer)
+  packedrecords = msr3_pack_batch (msr, &ms_batch_handler_int, ofp, 0, NULL, flags, verbose);
+
+  /* The batch handler cannot signal a write failure, check the stream directly */
+  if (packedrecords >= 0 && (fflush (ofp) != 0 || ferror (ofp)))
   {
-    if (ofp != stdout)
-      fclose (ofp);
-    return -1;
+    ms_log (2, "Error writing to output file %s\n", mspath);
+    packedrecords = -1;
   }
 
-  /* Pack the MS3Record */
-  while ((result = msr3_pack_next (packer, &record, &reclen)) == 1)
+  /* Close file and return record count */
+  if (ofp != stdout)
   {
-    if (fwrite (record, reclen, 1, (FILE *)ofp) != 1)
+    if (fclose (ofp) != 0 && packedrecords >= 0)
     {
-      ms_log (2, "Error writing to output file\n");
+      ms_log (2, "Error closing output file %s: %s\n", mspath, strerror (errno));
       packedrecords = -1;
-      break;
     }
-
-    packedrecords++;
   }
 
-  /* A negative result indicates a packing error */
-  if (result < 0 && packedrecords >= 0)
-    packedrecords = -1;
-
-  /* Free packer and get total packed samples */
-  msr3_pack_free (&packer, NULL);
-
-  /* Close file and return record count */
-  if (ofp != stdout)
-    fclose (ofp);
-
   return packedrecords;
 } /* End of msr3_writemseed() */
 
-/***************************************************************************
- *
- * Internal record handler.  The handler data should be a pointer to
- * an open file descriptor to which records will be written.
- *
- ***************************************************************************/
-static void
-ms_record_handler_int (char *record, int reclen, void *ofp)
-{
-  if (fwrite (record, reclen, 1, (FILE *)ofp) != 1)
-  {
-    ms_log (2, "Error writing to output file\n");
-  }
-} /* End of ms_record_handler_int() */
-
 /** ************************************************************************
  * @brief Write miniSEED from an ::MS3TraceList container to a file
  *
@@ -1212,6 +1821,11 @@ mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite, int
     ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
     return -1;
   }
+  else
+  {
+    /* Records are written in batches, stream buffering would only copy them */
+    setvbuf (ofp, NULL, _IONBF, 0);
+  }
 
   /* Do not modify the trace list during packing */
   flags |= MSF_MAINTAINMSTL;
@@ -1219,10 +1833,10 @@ mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite, int
   /* Pack all data */
   flags |= MSF_FLUSHDATA;
 
-  packedrecords = mstl3_pack (mstl, &ms_record_handler_int, ofp, maxreclen, encoding, NULL, flags,
-                              verbose, NULL);
+  packedrecords = mstl3_pack_batch (mstl, &ms_batch_handler_int, ofp, 0, maxreclen, encoding, NULL,
+                                    flags, verbose, NULL);
 
-  /* The record handler cannot signal a write failure, so flush and check
+  /* The batch handler cannot signal a write failure, so flush and check
    * the stream directly.  A full or read-only filesystem may not surface
    * an error until buffered data is flushed. */
   if (packedrecords >= 0 && (fflush (ofp) != 0 || ferror (ofp)))
@@ -1244,6 +1858,852 @@ mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite, int
   return packedrecords;
 } /* End of mstl3_writemseed() */
 
+/* Portable mutex, condition variable and thread primitives for the
+ * I/O thread of an asynchronous file writer */
+#if defined(LMP_WIN)
+typedef CRITICAL_SECTION lm_mutex_t;
+typedef CONDITION_VARIABLE lm_cond_t;
+typedef HANDLE lm_thread_t;
+#define lm_mutex_init(M) (InitializeCriticalSection (M), 0)
+#define lm_mutex_destroy(M) DeleteCriticalSection (M)
+#define lm_mutex_lock(M) EnterCriticalSection (M)
+#define lm_mutex_unlock(M) LeaveCriticalSection (M)
+#define lm_cond_init(C) (InitializeConditionVariable (C), 0)
+#define lm_cond_destroy(C)
+#define lm_cond_wait(C, M) SleepConditionVariableCS (C, M, INFINITE)
+#define lm_cond_signal(C) WakeConditionVariable (C)
+#else
+typedef pthread_mutex_t lm_mutex_t;
+typedef pthread_cond_t lm_cond_t;
+typedef pthread_t lm_thread_t;
+#define lm_mutex_init(M) pthread_mutex_init (M, NULL)
+#define lm_mutex_destroy(M) pthread_mutex_destroy (M)
+#define lm_mutex_lock(M) pthread_mutex_lock (M)
+#define lm_mutex_unlock(M) pthread_mutex_unlock (M)
+#define lm_cond_init(C) pthread_cond_init (C, NULL)
+#define lm_cond_destroy(C) pthread_cond_destroy (C)
+#define lm_cond_wait(C, M) pthread_cond_wait (C, M)
+#define lm_cond_signal(C) pthread_cond_signal (C)
+#endif
+
+/* Default number of buffers of an asynchronous file writer */
+#define LM_WRITERBUFFERS 4
+
+/* Asynchronous output of an MS3FileWriter.  The buffers form a ring, the
+ * caller fills one while the others are queued for, or being written by,
+ * the I/O thread in order.  The lock is only taken to hand over a full
+ * buffer, and the caller waits when all other buffers are queued. */
+struct LMAsyncWriter
+{
+  lm_mutex_t lock;
+  lm_cond_t queuedcond;        /* Signaled when a buffer is queued or a stop is requested */
+  lm_cond_t writtencond;       /* Signaled when a queued buffer has been written */
+  lm_thread_t thread;          /* I/O thread */
+  FILE *ofp;                   /* Output stream, only used by the I/O thread while it runs */
+  char **buffers;              /* Ring of buffers */
+  uint64_t *lengths;           /* Length of the records in each queued buffer */
+  int count;                   /* Number of buffers */
+  int head;                    /* First queued buffer, written next */
+  int queued;                  /* Number of queued buffers, including one being written */
+  int fill;                    /* Buffer being filled by the caller */
+  int8_t stop;                 /* Set to stop the I/O thread once the queue is empty */
+  int8_t error;                /* Set after a write error, later buffers are discarded */
+  int errnum;                  /* Value of errno for the write error */
+};
+
+/***************************************************************************
+ * Main loop of the I/O thread of an asynchronous file writer, writing
+ * queued buffers in order until a stop is requested.
+ ***************************************************************************/
+static void
+lm_async_run (struct LMAsyncWriter *async)
+{
+  char *buffer;
+  uint64_t length;
+  int8_t error;
+
+  lm_mutex_lock (&async->lock);
+
+  for (;;)
+  {
+    while (async->queued == 0 && !async->stop)
+      lm_cond_wait (&async->queuedcond, &async->lock);
+
+    if (async->queued == 0)
+      break;
+
+    buffer = async->buffers[async->head];
+    length = async->lengths[async->head];
+    error = async->error;
+
+    lm_mutex_unlock (&async->lock);
+
+    /* Write outside of the lock, discarding buffers after an error */
+    if (!error && fwrite (buffer, (size_t)length, 1, async->ofp) != 1)
+    {
+      error = 1;
+      async->errnum = errno;
+    }
+
+    lm_mutex_lock (&async->lock);
+
+    async->error = error;
+    async->head = (async->head + 1) % async->count;
+    async->queued--;
+    lm_cond_signal (&async->writtencond);
+  }
+
+  lm_mutex_unlock (&async->lock);
+} /* End of lm_async_run() */
+
+#if defined(LMP_WIN)
+static DWORD WINAPI
+lm_async_thread (LPVOID arg)
+{
+  lm_async_run ((struct LMAsyncWriter *)arg);
+  return 0;
+}
+#else
+static void *
+lm_async_thread (void *arg)
+{
+  lm_async_run ((struct LMAsyncWriter *)arg);
+  return NULL;
+}
+#endif
+
+/***************************************************************************
+ * Wait until all buffers queued by an asynchronous file writer have been
+ * written.
+ *
+ * Returns 0 on success and -1 if a write failed.
+ ***************************************************************************/
+static int
+lm_async_barrier (MS3FileWriter *writer)
+{
+  struct LMAsyncWriter *async = writer->async;
+  int8_t error;
+
+  lm_mutex_lock (&async->lock);
+  while (async->queued > 0)
+    lm_cond_wait (&async->writtencond, &async->lock);
+  error = async->error;
+  lm_mutex_unlock (&async->lock);
+
+  if (error && !writer->error)
+  {
+    ms_log (2, "Error writing to output file %s: %s\n", writer->path, strerror (async->errnum));
+    writer->error = 1;
+  }
+
+  return (error) ? -1 : 0;
+} /* End of lm_async_barrier() */
+
+/***************************************************************************
+ * Queue the filled buffer of an asynchronous file writer for writing and
+ * continue with the next buffer of the ring, waiting for it to be written
+ * if all other buffers are queued.
+ *
+ * Returns 0 on success and -1 if a write failed.
+ ***************************************************************************/
+static int
+lm_async_submit (MS3FileWriter *writer)
+{
+  struct LMAsyncWriter *async = writer->async;
+  int8_t error;
+
+  lm_mutex_lock (&async->lock);
+
+  async->lengths[async->fill] = writer->length;
+  async->queued++;
+  lm_cond_signal (&async->queuedcond);
+
+  /* Back-pressure: wait while the I/O thread holds every other buffer */
+  while (async->queued == async->count)
+    lm_cond_wait (&async->writtencond, &async->lock);
+
+  async->fill = (async->fill + 1) % async->count;
+  error = async->error;
+
+  lm_mutex_unlock (&async->lock);
+
+  writer->buffer = async->buffers[async->fill];
+  writer->length = 0;
+
+  if (error && !writer->error)
+  {
+    ms_log (2, "Error writing to output file %s: %s\n", writer->path, strerror (async->errnum));
+    writer->error = 1;
+  }
+
+  return (error) ? -1 : 0;
+} /* End of lm_async_submit() */
+
+/***************************************************************************
+ * Set up the buffer ring of a file writer, reusing its buffer as the
+ * first, and start its I/O thread.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_async_start (MS3FileWriter *writer, int buffercount)
+{
+  struct LMAsyncWriter *async;
+  int idx;
+
+  if ((async = (struct LMAsyncWriter *)libmseed_memory.malloc (sizeof (*async))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for asynchronous writer\n");
+    return -1;
+  }
+
+  memset (async, 0, sizeof (*async));
+  async->ofp = writer->ofp;
+  async->count = buffercount;
+  async->buffers = (char **)libmseed_memory.malloc (sizeof (char *) * buffercount);
+  async->lengths = (uint64_t *)libmseed_memory.malloc (sizeof (uint64_t) * buffercount);
+
+  if (!async->buffers || !async->lengths)
+  {
+    ms_log (2, "Cannot allocate memory for asynchronous writer\n");
+    goto failed;
+  }
+
+  memset (async->buffers, 0, sizeof (char *) * buffercount);
+  async->buffers[0] = writer->buffer;
+
+  for (idx = 1; idx < buffercount; idx++)
+  {
+    if ((async->buffers[idx] = (char *)libmseed_memory.malloc (writer->size)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory for file writer buffer\n");
+      goto failed;
+    }
+  }
+
+  if (lm_mutex_init (&async->lock) != 0)
+  {
+    ms_log (2, "Cannot initialize asynchronous writer lock\n");
+    goto failed;
+  }
+
+  if (lm_cond_init (&async->queuedcond) != 0 || lm_cond_init (&async->writtencond) != 0)
+  {
+    ms_log (2, "Cannot initialize asynchronous writer conditions\n");
+    lm_mutex_destroy (&async->lock);
+    goto failed;
+  }
+
+#if defined(LMP_WIN)
+  async->thread = CreateThread (NULL, 0, lm_async_thread, async, 0, NULL);
+  if (async->thread == NULL)
+#else
+  if (pthread_create (&async->thread, NULL, lm_async_thread, async) != 0)
+#endif
+  {
+    ms_log (2, "Cannot start asynchronous writer thread\n");
+    lm_cond_destroy (&async->queuedcond);
+    lm_cond_destroy (&async->writtencond);
+    lm_mutex_destroy (&async->lock);
+    goto failed;
+  }
+
+  writer->async = async;
+
+  return 0;
+
+failed:
+  if (async->buffers)
+  {
+    for (idx = 1; idx < buffercount; idx++)
+      if (async->buffers[idx])
+        libmseed_memory.free (async->buffers[idx]);
+
+    libmseed_memory.free (async->buffers);
+  }
+  if (async->lengths)
+    libmseed_memory.free (async->lengths);
+  libmseed_memory.free (async);
+
+  return -1;
+} /* End of lm_async_start() */
+
+/***************************************************************************
+ * Stop the I/O thread of a file writer once all queued buffers are
+ * written, and release the buffer ring including the writer's buffer.
+ ***************************************************************************/
+static void
+lm_async_stop (MS3FileWriter *writer)
+{
+  struct LMAsyncWriter *async = writer->async;
+  int idx;
+
+  lm_mutex_lock (&async->lock);
+  async->stop = 1;
+  lm_cond_signal (&async->queuedcond);
+  lm_mutex_unlock (&async->lock);
+
+#if defined(LMP_WIN)
+  WaitForSingleObject (async->thread, INFINITE);
+  CloseHandle (async->thread);
+#else
+  pthread_join (async->thread, NULL);
+#endif
+
+  lm_cond_destroy (&async->queuedcond);
+  lm_cond_destroy (&async->writtencond);
+  lm_mutex_destroy (&async->lock);
+
+  for (idx = 0; idx < async->count; idx++)
+    libmseed_memory.free (async->buffers[idx]);
+
+  libmseed_memory.free (async->buffers);
+  libmseed_memory.free (async->lengths);
+  libmseed_memory.free (async);
+
+  writer->async = NULL;
+  writer->buffer = NULL;
+} /* End of lm_async_stop() */
+
+/***************************************************************************
+ * Write the records buffered by a writer to its output stream, or queue
+ * them for the I/O thread of an asynchronous writer.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_filewriter_drain (MS3FileWriter *writer)
+{
+  if (writer->length == 0)
+    return 0;
+
+  if (writer->async)
+    return lm_async_submit (writer);
+
+  if (fwrite (writer->buffer, (size_t)writer->length, 1, writer->ofp) != 1)
+  {
+    ms_log (2, "Error writing to output file %s: %s\n", writer->path, strerror (errno));
+    writer->error = 1;
+    return -1;
+  }
+
+  writer->length = 0;
+
+  return 0;
+} /* End of lm_filewriter_drain() */
+
+/***************************************************************************
+ * Return the free space in the buffer of a writer, limited to the range
+ * of a record buffer length.
+ ***************************************************************************/
+static inline uint32_t
+lm_filewriter_space (const MS3FileWriter *writer)
+{
+  uint64_t space = writer->size - writer->length;
+
+  return (space > UINT32_MAX) ? UINT32_MAX : (uint32_t)space;
+} /* End of lm_filewriter_space() */
+
+/***************************************************************************
+ * Commit the data written to a stream to storage, without forcing
+ * metadata that is not needed to read the data back where supported.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_fdatasync (FILE *stream)
+{
+#if defined(LMP_WIN)
+  return (_commit (_fileno (stream)) == 0) ? 0 : -1;
+#elif defined(__APPLE__)
+  return (fsync (fileno (stream)) == 0) ? 0 : -1;
+#else
+  return (fdatasync (fileno (stream)) == 0) ? 0 : -1;
+#endif
+} /* End of lm_fdatasync() */
+
+/** ************************************************************************
+ * @brief Open a persistent writer of miniSEED records to a file
+ *
+ * Create an opaque ::MS3FileWriter that keeps @p mspath open, collecting
+ * records in a buffer of @p buffersize bytes and writing them to the
+ * file as the buffer fills.  This avoids the opening and closing of the
+ * file by each call to msr3_writemseed() when records are written to a
+ * long-lived file over time.
+ *
+ * The @p overwrite flag controls whether a existing file is
+ * overwritten or not.  If true (non-zero) any existing file will be
+ * replaced.  If false (zero) the file is opened in append mode, and all
+ * writes go to the end of the file even if it is written by others.  In
+ * either case, new files will be created if they do not yet exist.  If
+ * @p mspath is "-" records are written to standard output.
+ *
+ * Data is only committed to storage by the system when requested with
+ * ms3_filewriter_flush().
+ *
+ * @param[in] mspath File for output records
+ * @param[in] overwrite Flag to control overwriting versus appending
+ * @param[in] buffersize Size of the output buffer in bytes, 0 for a default of 1 MiB
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns a pointer to an ::MS3FileWriter on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_filewriter_write_msr()
+ * @see ms3_filewriter_write_mstl()
+ * @see ms3_filewriter_write()
+ * @see ms3_filewriter_flush()
+ * @see ms3_filewriter_close()
+ ***************************************************************************/
+MS3FileWriter *
+ms3_filewriter_open (const char *mspath, int8_t overwrite, uint64_t buffersize, int8_t verbose)
+{
+  MS3FileWriter *writer = NULL;
+  const char *perms = (overwrite) ? "wb" : "ab";
+
+  if (!mspath)
+  {
+    ms_log (2, "%s(): Required input not defined: 'mspath'\n", __func__);
+    return NULL;
+  }
+
+  if (strlen (mspath) >= sizeof (writer->path))
+  {
+    ms_log (2, "Output file name is too long: %s\n", mspath);
+    return NULL;
+  }
+
+  writer = (MS3FileWriter *)libmseed_memory.malloc (sizeof (MS3FileWriter));
+  if (!writer)
+  {
+    ms_log (2, "Cannot allocate memory for file writer\n");
+    return NULL;
+  }
+
+  memset (writer, 0, sizeof (MS3FileWriter));
+  strcpy (writer->path, mspath);
+  writer->size = (buffersize > 0) ? buffersize : LM_WRITERBUFSIZE;
+  writer->verbose = verbose;
+
+  if ((writer->buffer = (char *)libmseed_memory.malloc (writer->size)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for file writer buffer\n");
+    libmseed_memory.free (writer);
+    return NULL;
+  }
+
+  /* Open output file or use stdout */
+  if (strcmp (mspath, "-") == 0)
+  {
+    writer->ofp = stdout;
+  }
+  else if ((writer->ofp = fopen (mspath, perms)) == NULL)
+  {
+    ms_log (2, "Cannot open output file %s: %s\n", mspath, strerror (errno));
+    libmseed_memory.free (writer->buffer);
+    libmseed_memory.free (writer);
+    return NULL;
+  }
+  else
+  {
+    /* Records are written from the writer's buffer, stream buffering would only copy them */
+    setvbuf (writer->ofp, NULL, _IONBF, 0);
+  }
+
+  if (verbose > 1)
+    ms_log (0, "Opened %s for writing\n", mspath);
+
+  return writer;
+} /* End of ms3_filewriter_open() */
+
+/** ************************************************************************
+ * @brief Open a persistent writer of miniSEED records to a file with
+ * asynchronous output
+ *
+ * Like ms3_filewriter_open(), except that the output buffer is one of a
+ * ring of @p buffercount buffers of @p buffersize bytes, and full buffers
+ * are written to the file by a dedicated I/O thread.  Packing continues
+ * into the next buffer while earlier buffers are written, the caller
+ * only waits when all other buffers are still queued for writing.
+ *
+ * The writer is otherwise used like a synchronous writer.
+ * ms3_filewriter_flush() waits for all queued records to be written
+ * before flushing, and ms3_filewriter_close() waits for them and stops
+ * the I/O thread.  A write error in the I/O thread is reported by the
+ * next call on the writer, and records queued after the error are
+ * discarded.
+ *
+ * The writer must not be used by more than one thread at a time.
+ *
+ * @param[in] mspath File for output records
+ * @param[in] overwrite Flag to control overwriting versus appending
+ * @param[in] buffersize Size of each output buffer in bytes, 0 for a default of 1 MiB
+ * @param[in] buffercount Number of output buffers, at least 2, 0 for a default of 4
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns a pointer to an ::MS3FileWriter on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_filewriter_open()
+ * @see ms3_filewriter_flush()
+ * @see ms3_filewriter_close()
+ ***************************************************************************/
+MS3FileWriter *
+ms3_filewriter_open_async (const char *mspath, int8_t overwrite, uint64_t buffersize,
+                           int buffercount, int8_t verbose)
+{
+  MS3FileWriter *writer = NULL;
+
+  if (buffercount == 0)
+    buffercount = LM_WRITERBUFFERS;
+
+  if (buffercount < 2)
+  {
+    ms_log (2, "%s(): Buffer count must be at least 2, not %d\n", __func__, buffercount);
+    return NULL;
+  }
+
+  if ((writer = ms3_filewriter_open (mspath, overwrite, buffersize, verbose)) == NULL)
+    return NULL;
+
+  if (lm_async_start (writer, buffercount))
+  {
+    ms3_filewriter_close (&writer);
+    return NULL;
+  }
+
+  return writer;
+} /* End of ms3_filewriter_open_async() */
+
+/** ************************************************************************
+ * @brief Write miniSEED records to a file writer
+ *
+ * Add @p length bytes of complete miniSEED records at @p record to the
+ * buffer of @p writer, writing the buffer to the file first if the
+ * records do not fit.  Records larger than the buffer are written
+ * directly.
+ *
+ * @param[in] writer ::MS3FileWriter context
+ * @param[in] record Buffer of one or more records
+ * @param[in] length Length of @p record in bytes
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_filewriter_write (MS3FileWriter *writer, const char *record, uint64_t length)
+{
+  if (!writer || !record)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'record'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+  {
+    ms_log (2, "Cannot write to %s after a previous error\n", writer->path);
+    return -1;
+  }
+
+  if (length > writer->size - writer->length && lm_filewriter_drain (writer))
+    return -1;
+
+  if (length > writer->size)
+  {
+    /* The I/O thread must be idle before writing directly */
+    if (writer->async && lm_async_barrier (writer))
+      return -1;
+
+    if (fwrite (record, (size_t)length, 1, writer->ofp) != 1)
+    {
+      ms_log (2, "Error writing to output file %s: %s\n", writer->path, strerror (errno));
+      writer->error = 1;
+      return -1;
+    }
+
+    return 0;
+  }
+
+  memcpy (writer->buffer + writer->length, record, (size_t)length);
+  writer->length += length;
+
+  return 0;
+} /* End of ms3_filewriter_write() */
+
+/** ************************************************************************
+ * @brief Pack an ::MS3Record and write the records to a file writer
+ *
+ * Pack ::MS3Record data into miniSEED record(s) like msr3_writemseed()
+ * and add them to the buffer of @p writer.  Records are packed directly
+ * into the buffer when it has space for a record of the maximum length.
+ *
+ * @param[in] writer ::MS3FileWriter context
+ * @param[in] msr ::MS3Record containing data to write
+ * @param[in] flags Flags controlling data packing, see msr3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see msr3_pack_next_into()
+ ***************************************************************************/
+int64_t
+ms3_filewriter_write_msr (MS3FileWriter *writer, const MS3Record *msr, uint32_t flags,
+                          int8_t verbose)
+{
+  MS3RecordPacker *packer;
+  char *record = NULL;
+  int32_t reclen = 0;
+  int64_t packedrecords = 0;
+  int result;
+
+  if (!writer || !msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'msr'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+  {
+    ms_log (2, "Cannot write to %s after a previous error\n", writer->path);
+    return -1;
+  }
+
+  if ((packer = msr3_pack_init (msr, flags, verbose)) == NULL)
+    return -1;
+
+  do
+  {
+    /* Make room for a record of the maximum length, if the buffer can hold one */
+    if (writer->size - writer->length < packer->maxreclen && lm_filewriter_drain (writer))
+    {
+      result = -1;
+      break;
+    }
+
+    if (writer->size >= packer->maxreclen)
+    {
+      result = msr3_pack_next_into (packer, writer->buffer + writer->length,
+                                    lm_filewriter_space (writer), &reclen);
+
+      if (result == 1)
+        writer->length += reclen;
+    }
+    else if ((result = msr3_pack_next (packer, &record, &reclen)) == 1 &&
+             ms3_filewriter_write (writer, record, reclen))
+    {
+      result = -1;
+    }
+
+    if (result == 1)
+      packedrecords++;
+  } while (result == 1);
+
+  msr3_pack_free (&packer, NULL);
+
+  writer->recordcount += packedrecords;
+
+  return (result == 0) ? packedrecords : -1;
+} /* End of ms3_filewriter_write_msr() */
+
+/** ************************************************************************
+ * @brief Pack ::MS3TraceList data and write the records to a file writer
+ *
+ * Pack ::MS3TraceList data into miniSEED record(s) like mstl3_pack()
+ * and add them to the buffer of @p writer.  Records are packed directly
+ * into the buffer when it has space for a record of the maximum length.
+ *
+ * Unlike mstl3_writemseed(), the ::MSF_FLUSHDATA and ::MSF_MAINTAINMSTL
+ * flags are not implied, so the trace list may be used as a rolling
+ * buffer of data that are written as complete records are available.
+ *
+ * @param[in] writer ::MS3FileWriter context
+ * @param[in,out] mstl ::MS3TraceList containing data to write
+ * @param[in] maxreclen The maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[in] flags Flags controlling data packing, see mstl3_pack()
+ * @param[in] verbose Controls verbosity, 0 means no diagnostic output
+ *
+ * @returns the number of records written on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mstl3_pack_next_into()
+ ***************************************************************************/
+int64_t
+ms3_filewriter_write_mstl (MS3FileWriter *writer, MS3TraceList *mstl, int maxreclen,
+                           int8_t encoding, uint32_t flags, int8_t verbose)
+{
+  MS3TraceListPacker *packer;
+  char *record = NULL;
+  int32_t reclen = 0;
+  uint32_t recordsize = (maxreclen < 0) ? MS_PACK_DEFAULT_RECLEN : (uint32_t)maxreclen;
+  int64_t packedrecords = 0;
+  int result;
+
+  if (!writer || !mstl)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer' or 'mstl'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+  {
+    ms_log (2, "Cannot write to %s after a previous error\n", writer->path);
+    return -1;
+  }
+
+  if ((packer = mstl3_pack_init (mstl, maxreclen, encoding, flags, verbose, NULL, 0)) == NULL)
+    return -1;
+
+  do
+  {
+    /* Make room for a record of the maximum length, if the buffer can hold one */
+    if (writer->size - writer->length < recordsize && lm_filewriter_drain (writer))
+    {
+      result = -1;
+      break;
+    }
+
+    if (writer->size >= recordsize)
+    {
+      result = mstl3_pack_next_into (packer, flags, writer->buffer + writer->length,
+                                     lm_filewriter_space (writer), &reclen);
+
+      if (result == 1)
+        writer->length += reclen;
+    }
+    else if ((result = mstl3_pack_next (packer, flags, &record, &reclen)) == 1 &&
+             ms3_filewriter_write (writer, record, reclen))
+    {
+      result = -1;
+    }
+
+    if (result == 1)
+      packedrecords++;
+  } while (result == 1);
+
+  mstl3_pack_free (&packer, NULL);
+
+  writer->recordcount += packedrecords;
+
+  return (result == 0) ? packedrecords : -1;
+} /* End of ms3_filewriter_write_mstl() */
+
+/** ************************************************************************
+ * @brief Write buffered records of a file writer to the file
+ *
+ * Write all records in the buffer of @p writer to its file and, if @p
+ * sync is true (non-zero), commit the file data to storage with
+ * fdatasync() or the closest equivalent of the system.
+ *
+ * @param[in] writer ::MS3FileWriter context
+ * @param[in] sync Flag to control committing data to storage
+ *
+ * @returns 0 on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_filewriter_flush (MS3FileWriter *writer, int8_t sync)
+{
+  if (!writer)
+  {
+    ms_log (2, "%s(): Required input not defined: 'writer'\n", __func__);
+    return -1;
+  }
+
+  if (writer->error)
+  {
+    ms_log (2, "Cannot write to %s after a previous error\n", writer->path);
+    return -1;
+  }
+
+  if (lm_filewriter_drain (writer))
+    return -1;
+
+  if (writer->async && lm_async_barrier (writer))
+    return -1;
+
+  if (fflush (writer->ofp) != 0 || ferror (writer->ofp))
+  {
+    ms_log (2, "Error writing to output file %s\n", writer->path);
+    writer->error = 1;
+    return -1;
+  }
+
+  if (sync && writer->ofp != stdout && lm_fdatasync (writer->ofp))
+  {
+    ms_log (2, "Error committing output file %s: %s\n", writer->path, strerror (errno));
+    writer->error = 1;
+    return -1;
+  }
+
+  return 0;
+} /* End of ms3_filewriter_flush() */
+
+/** ************************************************************************
+ * @brief Write buffered records, close the file and free a file writer
+ *
+ * Write all records in the buffer of the writer, close the file and free
+ * all memory associated with the ::MS3FileWriter, setting the pointer to
+ * NULL.  Data is not committed to storage, call ms3_filewriter_flush()
+ * first to do so.
+ *
+ * @param[in] writer Pointer to ::MS3FileWriter pointer
+ *
+ * @returns 0 on success and -1 if a write or earlier write failed.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int
+ms3_filewriter_close (MS3FileWriter **writer)
+{
+  int rv = 0;
+
+  if (!writer || !*writer)
+    return 0;
+
+  if ((*writer)->error || lm_filewriter_drain (*writer))
+    rv = -1;
+
+  /* Wait for queued records to be written and stop the I/O thread */
+  if ((*writer)->async)
+  {
+    if (lm_async_barrier (*writer))
+      rv = -1;
+
+    lm_async_stop (*writer);
+  }
+
+  if (rv == 0 && (fflush ((*writer)->ofp) != 0 || ferror ((*writer)->ofp)))
+  {
+    ms_log (2, "Error writing to output file %s\n", (*writer)->path);
+    rv = -1;
+  }
+
+  if ((*writer)->ofp != stdout && fclose ((*writer)->ofp) != 0 && rv == 0)
+  {
+    ms_log (2, "Error closing output file %s: %s\n", (*writer)->path, strerror (errno));
+    rv = -1;
+  }
+
+  if ((*writer)->verbose > 1)
+    ms_log (0, "Closed %s, %" PRId64 " records packed\n", (*writer)->path,
+            (*writer)->recordcount);
+
+  if ((*writer)->buffer)
+    libmseed_memory.free ((*writer)->buffer);
+  libmseed_memory.free (*writer);
+  *writer = NULL;
+
+  return rv;
+} /* End of ms3_filewriter_close() */
+
 /** ************************************************************************
  * Parse a range from the end of a string.
  *
@@ -170,10 +170,42 @@ static LeapSecond embedded_leapsecondlist[] = {
 /* Global variable to hold a leap second list */
 LeapSecond *leapsecondlist = &embedded_leapsecondlist[0];
 
+/* Immutable snapshot of a leap second list in a sorted array, used to find
+ * the leap seconds within a time span with a binary search.  A reload
+ * replaces the snapshot as a whole, replaced snapshots are retained as
+ * other threads may still be using them. */
+typedef struct LMLeapSecondTable
+{
+  const LeapSecond *entries;   /* Leap seconds in time order, also linked as a list */
+  int count;                   /* Number of entries */
+  struct LMLeapSecondTable *retired; /* Previously replaced snapshot, never freed */
+} LMLeapSecondTable;
+
+static LMLeapSecondTable embedded_leapsecondtable = {
+    .entries = embedded_leapsecondlist,
+    .count = sizeof (embedded_leapsecondlist) / sizeof (embedded_leapsecondlist[0]),
+    .retired = NULL};
+
+/* Current leap second snapshot */
+static LMLeapSecondTable *leapsecondtable = &embedded_leapsecondtable;
+
+/* Atomic pointer load and store, a snapshot swap is visible as a whole */
+#if defined(LMP_WIN)
+#define LM_LOAD_POINTER(ptr) \
+  InterlockedCompareExchangePointer ((PVOID volatile *)&(ptr), NULL, NULL)
+#define LM_STORE_POINTER(ptr, value) InterlockedExchangePointer ((PVOID volatile *)&(ptr), (value))
+#else
+#define LM_LOAD_POINTER(ptr) __atomic_load_n (&(ptr), __ATOMIC_ACQUIRE)
+#define LM_STORE_POINTER(ptr, value) __atomic_store_n (&(ptr), (value), __ATOMIC_RELEASE)
+#endif
+
 /* Days in each month, for non-leap and leap years */
 static const int monthdays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 static const int monthdays_leap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
 
+/* Days in the year before each month, for non-leap years */
+static const int monthstartdays[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
 /* Determine if year is a leap year */
 #define LEAPYEAR(year) (((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0))
 
@@ -204,6 +236,23 @@ static const int monthdays_leap[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30,
 
 /** @endcond */
 
+/***************************************************************************
+ * Copy a code of length bytes to dest of destsize bytes, truncating it
+ * to fit and terminating it.  Nothing is copied if dest is NULL.
+ ***************************************************************************/
+static void
+lm_copycode (char *dest, size_t destsize, const char *code, size_t length)
+{
+  if (!dest || destsize == 0)
+    return;
+
+  if (length > destsize - 1)
+    length = destsize - 1;
+
+  memcpy (dest, code, length);
+  dest[length] = '\0';
+} /* End of lm_copycode() */
+
 /** ************************************************************************
  * @brief Parse network, station, location and channel codes from an FDSN Source ID
  *
@@ -250,10 +299,8 @@ int
 ms_sid2nslc_n (const char *sid, char *net, size_t netsize, char *sta, size_t stasize, char *loc,
                size_t locsize, char *chan, size_t chansize)
 {
-  size_t idlen;
+  const char *code[4];
   const char *cid;
-  char *id;
-  char *ptr, *top, *next;
   int sepcnt = 0;
 
   if (!sid)
@@ -263,98 +310,98 @@ ms_sid2nslc_n (const char *sid, char *net, size_t netsize, char *sta, size_t sta
   }
 
   /* Handle the FDSN: namespace identifier */
-  if (!strncmp (sid, "FDSN:", 5))
+  if (strncmp (sid, "FDSN:", 5))
   {
-    /* Advance sid pointer to last ':', skipping all namespace identifiers */
-    sid = strrchr (sid, ':') + 1;
+    ms_log (2, "Unrecognized identifier: %s\n", sid);
+    return -1;
+  }
 
-    /* Verify 5 delimiters */
-    cid = sid;
-    while ((cid = strchr (cid, '_')))
-    {
-      cid++;
-      sepcnt++;
-    }
-    if (sepcnt != 5)
-    {
-      ms_log (2, "Incorrect number of identifier delimiters (%d): %s\n", sepcnt, sid);
-      return -1;
-    }
+  /* Advance sid pointer to last ':', skipping all namespace identifiers */
+  sid = strrchr (sid, ':') + 1;
 
-    idlen = strlen (sid) + 1;
-    if (!(id = libmseed_memory.malloc (idlen)))
-    {
-      ms_log (2, "Error duplicating identifier\n");
-      return -1;
-    }
-    memcpy (id, sid, idlen);
+  /* Find the start of the network, station, location and channel codes,
+   * the channel containing the last 2 of 5 delimiters */
+  code[0] = sid;
+  for (cid = sid; (cid = strchr (cid, '_')); cid++)
+  {
+    if (++sepcnt <= 3)
+      code[sepcnt] = cid + 1;
+  }
+  if (sepcnt != 5)
+  {
+    ms_log (2, "Incorrect number of identifier delimiters (%d): %s\n", sepcnt, sid);
+    return -1;
+  }
 
-    /* Network */
-    top = id;
-    if ((ptr = strchr (top, '_')))
-    {
-      next = ptr + 1;
-      *ptr = '\0';
+  /* Network, station and location, potentially empty */
+  lm_copycode (net, netsize, code[0], (size_t)(code[1] - code[0] - 1));
+  lm_copycode (sta, stasize, code[1], (size_t)(code[2] - code[1] - 1));
+  lm_copycode (loc, locsize, code[2], (size_t)(code[3] - code[2] - 1));
 
-      if (net && netsize > 0)
-      {
-        strncpy (net, top, netsize - 1);
-        net[netsize - 1] = '\0';
-      }
+  /* Channel */
+  if (*code[3] && chan && chansize > 0)
+  {
+    /* Map extended channel to SEED channel if possible, otherwise direct copy */
+    if (chansize < 4 || ms_xchan2seedchan (chan, code[3]))
+      lm_copycode (chan, chansize, code[3], strlen (code[3]));
+  }
 
-      top = next;
-    }
-    /* Station */
-    if ((ptr = strchr (top, '_')))
-    {
-      next = ptr + 1;
-      *ptr = '\0';
+  return 0;
+} /* End of ms_sid2nslc_n() */
 
-      if (sta && stasize > 0)
-      {
-        strncpy (sta, top, stasize - 1);
-        sta[stasize - 1] = '\0';
-      }
+/** ************************************************************************
+ * @brief Parse a source identifier into an ::MS3SourceID
+ *
+ * Set the codes of @p sourceid from an FDSN Source Identifier as
+ * ms_sid2nslc_n() does, mapping an extended channel to a SEED channel
+ * if possible.
+ *
+ * The identifier is kept in @p sourceid and a following call with the
+ * same identifier returns without parsing, so an ::MS3SourceID kept
+ * with a stream acts as a cache of its codes.  The structure must be
+ * initialized to zeros before its first use.
+ *
+ * @param[in] sid Source identifier
+ * @param[in,out] sourceid ::MS3SourceID for the codes
+ *
+ * @retval 0 on success
+ * @retval -1 on error
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms_sid2nslc_n()
+ ***************************************************************************/
+int
+ms_sid2sourceid (const char *sid, MS3SourceID *sourceid)
+{
+  size_t length;
 
-      top = next;
-    }
-    /* Location, potentially empty */
-    if ((ptr = strchr (top, '_')))
-    {
-      next = ptr + 1;
-      *ptr = '\0';
+  if (!sid || !sourceid)
+  {
+    ms_log (2, "%s(): Required input not defined: 'sid' or 'sourceid'\n", __func__);
+    return -1;
+  }
 
-      if (loc && locsize > 0)
-      {
-        strncpy (loc, top, locsize - 1);
-        loc[locsize - 1] = '\0';
-      }
+  if (sourceid->sid[0] && !strcmp (sourceid->sid, sid))
+    return 0;
 
-      top = next;
-    }
-    /* Channel */
-    if (*top && chan && chansize > 0)
-    {
-      /* Map extended channel to SEED channel if possible, otherwise direct copy */
-      if (chansize < 4 || ms_xchan2seedchan (chan, top))
-      {
-        strncpy (chan, top, chansize - 1);
-        chan[chansize - 1] = '\0';
-      }
-    }
+  sourceid->sid[0] = '\0';
+  sourceid->net[0] = '\0';
+  sourceid->sta[0] = '\0';
+  sourceid->loc[0] = '\0';
+  sourceid->chan[0] = '\0';
 
-    /* Free duplicated ID */
-    if (id)
-      libmseed_memory.free (id);
-  }
-  else
-  {
-    ms_log (2, "Unrecognized identifier: %s\n", sid);
+  if (ms_sid2nslc_n (sid, sourceid->net, sizeof (sourceid->net), sourceid->sta,
+                     sizeof (sourceid->sta), sourceid->loc, sizeof (sourceid->loc), sourceid->chan,
+                     sizeof (sourceid->chan)))
     return -1;
-  }
+
+  /* Identifiers too long to keep are parsed on every call */
+  if ((length = strlen (sid)) < sizeof (sourceid->sid))
+    memcpy (sourceid->sid, sid, length + 1);
 
   return 0;
-} /* End of ms_sid2nslc_n() */
+} /* End of ms_sid2sourceid() */
 
 /** ************************************************************************
  * @deprecated Use ms_sid2nslc_n() instead
@@ -1299,6 +1346,243 @@ ms_nstime2timestrz (nstime_t nstime, char *timestr, ms_timeformat_t timeformat,
   return ms_nstime2timestr_n (nstime, timestr, 37, timeformat, subseconds);
 } /* End of ms_nstime2timestrz() */
 
+/***************************************************************************
+ * Write value as width decimal digits, zero padded, to dest.
+ ***************************************************************************/
+static inline void
+lm_putdigits (char *dest, uint32_t value, int width)
+{
+  while (width-- > 0)
+  {
+    dest[width] = (char)('0' + value % 10);
+    value /= 10;
+  }
+} /* End of lm_putdigits() */
+
+/***************************************************************************
+ * Determine the number of subsecond digits printed by
+ * ms_nstime2timestr_n() for the subseconds flag and nanosec value.
+ *
+ * Returns 0, 6 or 9 digits and -1 for an unhandled subseconds value.
+ ***************************************************************************/
+static int
+lm_subsecond_digits (ms_subseconds_t subseconds, int nanosec)
+{
+  int submicro = nanosec % 1000;
+
+  switch (subseconds)
+  {
+  case NONE:
+    return 0;
+  case MICRO:
+    return 6;
+  case NANO:
+    return 9;
+  case MICRO_NONE:
+    return (nanosec / 1000) ? 6 : 0;
+  case NANO_NONE:
+    return (nanosec) ? 9 : 0;
+  case NANO_MICRO:
+    return (submicro) ? 9 : 6;
+  case NANO_MICRO_NONE:
+    return (nanosec == 0) ? 0 : (submicro) ? 9 : 6;
+  }
+
+  return -1;
+} /* End of lm_subsecond_digits() */
+
+/** ************************************************************************
+ * @brief Convert an array of ::nstime_t to time strings
+ *
+ * Create the time strings of @p count times at @p nstimes, identical to
+ * those of ms_nstime2timestr_n(), in consecutive slots of @p timestrsize
+ * bytes at @p timestrs, the string for time @c i starting at
+ * <tt>timestrs + i * timestrsize</tt>.
+ *
+ * For the ISO 8601 and SEED ordinal formats the date portion of the
+ * string is only determined when the day changes from the previous
+ * time, and times of day and subseconds are written directly, making
+ * this much faster than individual conversions for runs of times within
+ * a day, such as record, segment or gap times.  Other formats and
+ * special values are converted with ms_nstime2timestr_n().
+ *
+ * @param[in] nstimes Array of @p count time values to convert
+ * @param[in] count Number of time values
+ * @param[out] timestrs Buffer for @p count time strings of @p timestrsize bytes each
+ * @param[in] timestrsize Size of each time string slot in bytes
+ * @param timeformat Time string format, one of @ref ms_timeformat_t
+ * @param subseconds Inclusion of subseconds, one of @ref ms_subseconds_t
+ *
+ * @returns the number of time strings created on success, otherwise
+ * ::MS_GENERROR.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms_nstime2timestr_n()
+ ***************************************************************************/
+int64_t
+ms_nstime2timestr_batch (const nstime_t *nstimes, int64_t count, char *timestrs,
+                         size_t timestrsize, ms_timeformat_t timeformat,
+                         ms_subseconds_t subseconds)
+{
+  struct tm tms;
+  char prefix[16];
+  char suffix[8];
+  size_t prefixlength = 0;
+  size_t suffixlength = 0;
+  size_t length;
+  int64_t cachedday = 0;
+  int8_t cached = 0;
+  int8_t zulu;
+  char *timestr;
+  int64_t idx;
+  int64_t isec;
+  int64_t day;
+  int64_t daysec;
+  int secofday;
+  int nanosec;
+  int digits;
+  int year;
+
+  if (!nstimes || !timestrs || count < 0)
+  {
+    ms_log (2, "%s(): Required argument not defined: 'nstimes' or 'timestrs'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  zulu = (timeformat == ISOMONTHDAY_Z || timeformat == ISOMONTHDAY_DOY_Z ||
+          timeformat == ISOMONTHDAY_SPACE_Z)
+             ? 1
+             : 0;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    timestr = timestrs + idx * timestrsize;
+
+    /* Reduce to Unix/POSIX epoch time and fractional nanoseconds */
+    isec = MS_NSTIME2EPOCH (nstimes[idx]);
+    nanosec = (int)(nstimes[idx] - (isec * NSTMODULUS));
+
+    /* Adjust for negative epoch times */
+    if (nanosec < 0)
+    {
+      isec -= 1;
+      nanosec += NSTMODULUS;
+    }
+
+    digits = lm_subsecond_digits (subseconds, nanosec);
+
+    day = isec / 86400;
+    secofday = (int)(isec - day * 86400);
+    if (secofday < 0)
+    {
+      day -= 1;
+      secofday += 86400;
+    }
+
+    /* Determine the date prefix and suffix when the day changes */
+    if (!cached || day != cachedday)
+    {
+      cached = 0;
+
+      if (timeformat <= SEEDORDINAL && nstimes[idx] != NSTERROR && nstimes[idx] != NSTUNSET)
+      {
+        daysec = day * 86400;
+
+        if (!(ms_gmtime64_r (&daysec, &tms)))
+        {
+          ms_log (2, "Error converting epoch-time of (%" PRId64 ") to date-time components\n",
+                  daysec);
+          return MS_GENERROR;
+        }
+
+        year = tms.tm_year + 1900;
+
+        /* Four digit years only, others are printed by ms_nstime2timestr_n() */
+        if (year >= 1000 && year <= 9999)
+        {
+          lm_putdigits (prefix, (uint32_t)year, 4);
+
+          if (timeformat == SEEDORDINAL)
+          {
+            prefix[4] = ',';
+            lm_putdigits (prefix + 5, (uint32_t)tms.tm_yday + 1, 3);
+            prefix[8] = ',';
+            prefixlength = 9;
+            suffixlength = 0;
+          }
+          else
+          {
+            prefix[4] = '-';
+            lm_putdigits (prefix + 5, (uint32_t)tms.tm_mon + 1, 2);
+            prefix[7] = '-';
+            lm_putdigits (prefix + 8, (uint32_t)tms.tm_mday, 2);
+            prefix[10] = (timeformat == ISOMONTHDAY_SPACE || timeformat == ISOMONTHDAY_SPACE_Z)
+                             ? ' '
+                             : 'T';
+            prefixlength = 11;
+            suffixlength = 0;
+
+            if (timeformat == ISOMONTHDAY_DOY || timeformat == ISOMONTHDAY_DOY_Z)
+            {
+              memcpy (suffix, " (", 2);
+              lm_putdigits (suffix + 2, (uint32_t)tms.tm_yday + 1, 3);
+              suffix[5] = ')';
+              suffixlength = 6;
+            }
+          }
+
+          cachedday = day;
+          cached = 1;
+        }
+      }
+    }
+
+    /* Other formats, special values and subsecond flags are converted individually */
+    if (!cached || digits < 0 || nstimes[idx] == NSTERROR || nstimes[idx] == NSTUNSET)
+    {
+      if (ms_nstime2timestr_n (nstimes[idx], timestr, timestrsize, timeformat, subseconds) == NULL)
+        return MS_GENERROR;
+
+      continue;
+    }
+
+    length = prefixlength + 8 + ((digits) ? digits + 1 : 0) + zulu + suffixlength;
+
+    if (length >= timestrsize)
+    {
+      ms_log (2, "Time string slot of %zu bytes too small for %zu characters\n", timestrsize,
+              length);
+      return MS_GENERROR;
+    }
+
+    memcpy (timestr, prefix, prefixlength);
+    timestr += prefixlength;
+
+    lm_putdigits (timestr, (uint32_t)(secofday / 3600), 2);
+    timestr[2] = ':';
+    lm_putdigits (timestr + 3, (uint32_t)(secofday / 60 % 60), 2);
+    timestr[5] = ':';
+    lm_putdigits (timestr + 6, (uint32_t)(secofday % 60), 2);
+    timestr += 8;
+
+    if (digits)
+    {
+      *timestr++ = '.';
+      lm_putdigits (timestr, (uint32_t)((digits == 6) ? nanosec / 1000 : nanosec), digits);
+      timestr += digits;
+    }
+
+    if (zulu)
+      *timestr++ = 'Z';
+
+    memcpy (timestr, suffix, suffixlength);
+    timestr[suffixlength] = '\0';
+  }
+
+  return count;
+} /* End of ms_nstime2timestr_batch() */
+
 /***************************************************************************
  * INTERNAL Convert specified date-time values to a high precision epoch time.
  *
@@ -1431,6 +1715,128 @@ ms_frac2nsec (const char *frac)
   return nsec;
 } /* End of ms_frac2nsec() */
 
+/***************************************************************************
+ * Parse count decimal digits at str into value.
+ *
+ * Returns 1 on success and 0 if any character is not a digit.
+ ***************************************************************************/
+static inline int
+lm_parsedigits (const char *str, int count, int *value)
+{
+  int idx;
+
+  *value = 0;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    if (str[idx] < '0' || str[idx] > '9')
+      return 0;
+
+    *value = *value * 10 + (str[idx] - '0');
+  }
+
+  return 1;
+} /* End of lm_parsedigits() */
+
+/***************************************************************************
+ * Convert a canonical, fixed layout time string to a high precision
+ * epoch time without the general parsers.
+ *
+ * Parsed layouts are ISO month-day "YYYY-MM-DD[Thh:mm:ss[.fffffffff]][Z]",
+ * with a 'T' or space separator, if monthday is set, and SEED ordinal
+ * "YYYY,DDD[,hh:mm:ss[.fffffffff]][Z]" if ordinal is set, with 1 to 9
+ * fractional digits.
+ *
+ * Any other string or out of range value is left to the general parsers,
+ * which report errors.
+ *
+ * Returns 1 and sets nstime if the string was converted, otherwise 0.
+ ***************************************************************************/
+static int
+lm_fasttimestr2nstime (const char *timestr, int8_t monthday, int8_t ordinal, nstime_t *nstime)
+{
+  const char *cp;
+  int year;
+  int mon;
+  int mday;
+  int yday;
+  int hour = 0;
+  int min = 0;
+  int sec = 0;
+  int nsec = 0;
+  int ndigits;
+
+  if (!lm_parsedigits (timestr, 4, &year) || !VALIDYEAR (year))
+    return 0;
+
+  /* Characters are tested in order so parsing stops at the end of a short string */
+  if (monthday && timestr[4] == '-')
+  {
+    if (!lm_parsedigits (timestr + 5, 2, &mon) || timestr[7] != '-' ||
+        !lm_parsedigits (timestr + 8, 2, &mday) || !VALIDMONTH (mon) ||
+        !VALIDMONTHDAY (year, mon, mday))
+      return 0;
+
+    yday = monthstartdays[mon - 1] + mday + ((mon > 2 && LEAPYEAR (year)) ? 1 : 0);
+    cp = timestr + 10;
+
+    if (*cp == 'T' || *cp == ' ')
+      cp++;
+    else if (*cp != '\0' && *cp != 'Z' && *cp != 'z')
+      return 0;
+  }
+  else if (ordinal && timestr[4] == ',')
+  {
+    if (!lm_parsedigits (timestr + 5, 3, &yday) || !VALIDYEARDAY (year, yday))
+      return 0;
+
+    cp = timestr + 8;
+
+    if (*cp == ',')
+      cp++;
+    else if (*cp != '\0' && *cp != 'Z' && *cp != 'z')
+      return 0;
+  }
+  else
+  {
+    return 0;
+  }
+
+  /* Time of day "hh:mm:ss[.fffffffff]" following a separator */
+  if (cp[-1] == 'T' || cp[-1] == ' ' || cp[-1] == ',')
+  {
+    if (!lm_parsedigits (cp, 2, &hour) || cp[2] != ':' || !lm_parsedigits (cp + 3, 2, &min) ||
+        cp[5] != ':' || !lm_parsedigits (cp + 6, 2, &sec) || !VALIDHOUR (hour) ||
+        !VALIDMIN (min) || !VALIDSEC (sec))
+      return 0;
+
+    cp += 8;
+
+    if (*cp == '.')
+    {
+      for (ndigits = 0, cp++; ndigits < 9 && *cp >= '0' && *cp <= '9'; ndigits++, cp++)
+        nsec = nsec * 10 + (*cp - '0');
+
+      /* Longer fractions are rounded by the general parsers */
+      if (ndigits == 0 || (*cp >= '0' && *cp <= '9'))
+        return 0;
+
+      for (; ndigits < 9; ndigits++)
+        nsec *= 10;
+    }
+  }
+
+  if (*cp == 'Z' || *cp == 'z')
+    cp++;
+
+  if (*cp != '\0')
+    return 0;
+
+  *nstime = ms_time2nstime_int (year, yday, hour, min, sec, (uint32_t)nsec);
+
+  return 1;
+} /* End of lm_fasttimestr2nstime() */
+
 /** ************************************************************************
  * @brief Convert a time string to a high precision epoch time.
  *
@@ -1452,6 +1858,10 @@ ms_frac2nsec (const char *frac)
  *
  * ISO month-day time strings conform to the RFC 3339 profile.
  *
+ * Canonical time strings with zero-padded fields, such as @c
+ * "YYYY-MM-DDThh:mm:ss.fffffffffZ" and @c "YYYY,DDD,hh:mm:ss.fffffffff",
+ * are converted directly without the general parsing.
+ *
  * Note that this routine does some sanity checking of the time string
  * contents, but does _not_ perform robust date-time validation.
  *
@@ -1485,6 +1895,10 @@ ms_timestr2nstime (const char *timestr)
     return NSTERROR;
   }
 
+  /* Convert canonical ISO month-day and SEED ordinal time strings directly */
+  if (lm_fasttimestr2nstime (timestr, 1, 1, &nstime))
+    return nstime;
+
   /* Determine first delimiter,
    * delimiter count before date-time separator,
    * number-like character count,
@@ -1657,6 +2071,7 @@ ms_mdtimestr2nstime (const char *timestr)
   int carry = 0;
   char fracstr[16] = "";
   uint32_t nsec = 0;
+  nstime_t nstime;
 
   if (!timestr)
   {
@@ -1664,6 +2079,10 @@ ms_mdtimestr2nstime (const char *timestr)
     return NSTERROR;
   }
 
+  /* Convert canonical time strings directly */
+  if (lm_fasttimestr2nstime (timestr, 1, 0, &nstime))
+    return nstime;
+
   fields = sscanf (timestr, "%d%*[-,/:.]%d%*[-,/:.]%d%*[-,/:.Tt ]%d%*[-,/:.]%d%*[-,/:.]%d%15[.0-9]",
                    &year, &mon, &mday, &hour, &min, &sec, fracstr);
 
@@ -1769,6 +2188,7 @@ ms_seedtimestr2nstime (const char *seedtimestr)
   int carry = 0;
   char fracstr[16] = "";
   uint32_t nsec = 0;
+  nstime_t nstime;
 
   if (!seedtimestr)
   {
@@ -1776,6 +2196,10 @@ ms_seedtimestr2nstime (const char *seedtimestr)
     return NSTERROR;
   }
 
+  /* Convert canonical time strings directly */
+  if (lm_fasttimestr2nstime (seedtimestr, 0, 1, &nstime))
+    return nstime;
+
   fields = sscanf (seedtimestr, "%d%*[-,:.]%d%*[-,:.Tt ]%d%*[-,:.]%d%*[-,:.]%d%15[.0-9]", &year,
                    &yday, &hour, &min, &sec, fracstr);
 
@@ -1866,8 +2290,12 @@ nstime_t
 ms_sampletime (nstime_t time, int64_t offset, double samprate)
 {
   nstime_t span = 0;
-  LeapSecond *lslist = leapsecondlist;
+  LMLeapSecondTable *table;
+  LeapSecond *lslist;
   double spandouble = 0.0;
+  int low;
+  int high;
+  int mid;
 
   if (offset < 0)
   {
@@ -1904,20 +2332,168 @@ ms_sampletime (nstime_t time, int64_t offset, double samprate)
     return NSTERROR;
   }
 
-  /* Adjust for each leap second contained in the time range, if list is available.
+  /* Only spans longer than a second can contain a leap second */
+  if (span <= NSTMODULUS)
+    return (time + span);
+
+  table = LM_LOAD_POINTER (leapsecondtable);
+  lslist = LM_LOAD_POINTER (leapsecondlist);
+
+  /* Adjust for each leap second contained in the time range using the sorted
+   * snapshot, unless the caller replaced the global list.
    * The contained test (leapsecond <= time + span - NSTMODULUS) is written in
    * addition form to avoid overflow of the intermediate expression. */
-  for (; lslist; lslist = lslist->next)
+  if (lslist == table->entries)
   {
-    if (lslist->leapsecond > time && lslist->leapsecond + NSTMODULUS <= time + span)
+    /* Early out when the span is entirely before or after all leap seconds */
+    if (table->count == 0 || time >= table->entries[table->count - 1].leapsecond ||
+        table->entries[0].leapsecond + NSTMODULUS > time + span)
+      return (time + span);
+
+    /* Find the first leap second after the start time */
+    low = 0;
+    high = table->count;
+    while (low < high)
+    {
+      mid = low + (high - low) / 2;
+
+      if (table->entries[mid].leapsecond > time)
+        high = mid;
+      else
+        low = mid + 1;
+    }
+
+    for (; low < table->count && table->entries[low].leapsecond + NSTMODULUS <= time + span; low++)
     {
       span -= NSTMODULUS;
     }
   }
+  else
+  {
+    for (; lslist; lslist = lslist->next)
+    {
+      if (lslist->leapsecond > time && lslist->leapsecond + NSTMODULUS <= time + span)
+      {
+        span -= NSTMODULUS;
+      }
+    }
+  }
 
   return (time + span);
 } /* End of ms_sampletime() */
 
+/***************************************************************************
+ * Return the leap second adjustment of ms_sampletime() for a sample at
+ * offset whose unadjusted time is rawtime, or -1 on error.
+ ***************************************************************************/
+static nstime_t
+lm_leapadjustment (nstime_t time, int64_t offset, double samprate, nstime_t rawtime)
+{
+  nstime_t sampletime = ms_sampletime (time, offset, samprate);
+
+  return (sampletime == NSTERROR) ? -1 : rawtime - sampletime;
+} /* End of lm_leapadjustment() */
+
+/** ************************************************************************
+ * @brief Calculate the times of a run of samples in an array
+ *
+ * Set @p times to the times of the @p count samples starting at offset
+ * @p start in an array of samples starting at @p time, each identical to
+ * the result of ms_sampletime() for that offset, including rounding
+ * and adjustment for leap seconds.
+ *
+ * The times are calculated in a single loop without per-sample
+ * branches, only the samples following a leap second contained in the
+ * run are adjusted, in runs with the same adjustment.
+ *
+ * @param[in] time Time value for first sample in array
+ * @param[in] start Offset of first sample to calculate time of, must be non-negative
+ * @param[in] count Number of sample times to calculate
+ * @param[in] samprate Sample rate (when positive) or period (when negative)
+ * @param[out] times Array of at least @p count values for the sample times
+ *
+ * @returns 0 on success and ::MS_GENERROR if @p start or @p count is
+ * negative or a sample time is not representable.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms_sampletime()
+ ***************************************************************************/
+int
+ms_sampletimes (nstime_t time, int64_t start, int64_t count, double samprate, nstime_t *times)
+{
+  nstime_t adjustment;
+  nstime_t lastadjustment;
+  double factor;
+  int64_t idx;
+  int64_t low;
+  int64_t high;
+  int64_t mid;
+
+  if (!times || start < 0 || count < 0 || start > INT64_MAX - count)
+  {
+    ms_log (2, "%s(): Invalid output, start (%" PRId64 ") or count (%" PRId64 ")\n", __func__,
+            start, count);
+    return MS_GENERROR;
+  }
+
+  if (count == 0)
+    return 0;
+
+  /* The last sample time is the largest, validating it validates all */
+  if (ms_sampletime (time, start + count - 1, samprate) == NSTERROR)
+    return MS_GENERROR;
+
+  /* Unadjusted times, the same calculation as ms_sampletime() */
+  if (samprate > 0.0)
+  {
+    for (idx = 0; idx < count; idx++)
+      times[idx] = time + (nstime_t)((double)(start + idx) / samprate * NSTMODULUS + 0.5);
+  }
+  else if (samprate < 0.0)
+  {
+    factor = -samprate;
+    for (idx = 0; idx < count; idx++)
+      times[idx] = time + (nstime_t)((double)(start + idx) * factor * NSTMODULUS + 0.5);
+  }
+  else
+  {
+    for (idx = 0; idx < count; idx++)
+      times[idx] = time;
+  }
+
+  /* The leap second adjustment never decreases with offset, apply each
+   * level of adjustment to the run of samples sharing it */
+  lastadjustment = lm_leapadjustment (time, start + count - 1, samprate, times[count - 1]);
+
+  for (idx = 0; idx < count && lastadjustment > 0; idx = low)
+  {
+    if ((adjustment = lm_leapadjustment (time, start + idx, samprate, times[idx])) < 0)
+      return MS_GENERROR;
+
+    /* Find the end of the run with this adjustment */
+    low = idx + 1;
+    high = count;
+    while (low < high)
+    {
+      mid = low + (high - low) / 2;
+
+      if (lm_leapadjustment (time, start + mid, samprate, times[mid]) == adjustment)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    if (adjustment)
+    {
+      for (mid = idx; mid < low; mid++)
+        times[mid] -= adjustment;
+    }
+  }
+
+  return 0;
+} /* End of ms_sampletimes() */
+
 /** ************************************************************************
  * @brief Runtime test for host endianess
  * @returns 1 if the host is big endian, 0 otherwise.
@@ -1959,11 +2535,32 @@ ms_readleapseconds (const char *envvarname)
   return -2;
 } /* End of ms_readleapseconds() */
 
+/***************************************************************************
+ * Compare two LeapSecond entries by time, for qsort().
+ ***************************************************************************/
+static int
+lm_cmpleapsecond (const void *a, const void *b)
+{
+  const LeapSecond *lsa = (const LeapSecond *)a;
+  const LeapSecond *lsb = (const LeapSecond *)b;
+
+  if (lsa->leapsecond < lsb->leapsecond)
+    return -1;
+
+  return (lsa->leapsecond > lsb->leapsecond) ? 1 : 0;
+} /* End of lm_cmpleapsecond() */
+
 /** ************************************************************************
  * @brief Read leap second from the specified file
  *
  * Leap seconds are loaded into the library's global leapsecond list.
  *
+ * The list, and the sorted snapshot of it used by ms_sampletime(), are
+ * replaced as a whole after the file is read, so leap seconds may be
+ * reloaded while other threads are calculating sample times.  Reloads
+ * themselves must not run concurrently.  Replaced lists are not freed,
+ * as they may still be in use.  On error the current list is retained.
+ *
  * The file is expected to be in NTP leap second list format. Some locations
  * where this file can be obtained are indicated in RFC 8633 section 3.7:
  * https://www.rfc-editor.org/rfc/rfc8633.html#section-3.7
@@ -1979,8 +2576,9 @@ int
 ms_readleapsecondfile (const char *filename)
 {
   FILE *fp = NULL;
-  LeapSecond *ls = NULL;
-  LeapSecond *lastls = NULL;
+  LMLeapSecondTable *table = NULL;
+  LeapSecond *entries = NULL;
+  LeapSecond *newentries = NULL;
   int64_t expires;
   char readline[200];
   char *cp;
@@ -1988,6 +2586,8 @@ ms_readleapsecondfile (const char *filename)
   int TAIdelta;
   int fields;
   int count = 0;
+  int size = 0;
+  int idx;
 
   if (!filename)
   {
@@ -2001,20 +2601,6 @@ ms_readleapsecondfile (const char *filename)
     return -1;
   }
 
-  /* Detatch embedded leap second list */
-  if (leapsecondlist == &embedded_leapsecondlist[0])
-  {
-    leapsecondlist = NULL;
-  }
-
-  /* Free existing leapsecondlist */
-  while (leapsecondlist != NULL)
-  {
-    LeapSecond *next = leapsecondlist->next;
-    libmseed_memory.free (leapsecondlist);
-    leapsecondlist = next;
-  }
-
   while (fgets (readline, sizeof (readline) - 1, fp))
   {
     /* Guarantee termination */
@@ -2065,33 +2651,33 @@ ms_readleapsecondfile (const char *filename)
       if (leapsecond > INT64_MAX / NSTMODULUS || leapsecond < INT64_MIN / NSTMODULUS)
       {
         ms_log (2, "Leap second epoch is beyond the representable nstime range\n");
+        if (entries)
+          libmseed_memory.free (entries);
         fclose (fp);
         return -1;
       }
 
-      if ((ls = (LeapSecond *)libmseed_memory.malloc (sizeof (LeapSecond))) == NULL)
+      /* Grow array of leap seconds as needed */
+      if (count == size)
       {
-        ms_log (2, "Cannot allocate LeapSecond entry, out of memory?\n");
-        fclose (fp);
-        return -1;
-      }
+        size = (size) ? size * 2 : 64;
 
-      ls->leapsecond = MS_EPOCH2NSTIME (leapsecond);
-      ls->TAIdelta = TAIdelta;
-      ls->next = NULL;
-      count++;
+        if ((newentries = (LeapSecond *)libmseed_memory.realloc (
+                 entries, sizeof (LeapSecond) * size)) == NULL)
+        {
+          ms_log (2, "Cannot allocate LeapSecond entry, out of memory?\n");
+          if (entries)
+            libmseed_memory.free (entries);
+          fclose (fp);
+          return -1;
+        }
 
-      /* Add leap second to global list */
-      if (!leapsecondlist)
-      {
-        leapsecondlist = ls;
-        lastls = ls;
-      }
-      else
-      {
-        lastls->next = ls;
-        lastls = ls;
+        entries = newentries;
       }
+
+      entries[count].leapsecond = MS_EPOCH2NSTIME (leapsecond);
+      entries[count].TAIdelta = TAIdelta;
+      count++;
     }
     else
     {
@@ -2102,12 +2688,38 @@ ms_readleapsecondfile (const char *filename)
   if (ferror (fp))
   {
     ms_log (2, "Error reading leap second file (%s): %s\n", filename, strerror (errno));
+    if (entries)
+      libmseed_memory.free (entries);
     fclose (fp);
     return -1;
   }
 
   fclose (fp);
 
+  if ((table = (LMLeapSecondTable *)libmseed_memory.malloc (sizeof (LMLeapSecondTable))) == NULL)
+  {
+    ms_log (2, "Cannot allocate leap second table, out of memory?\n");
+    if (entries)
+      libmseed_memory.free (entries);
+    return -1;
+  }
+
+  /* Sort leap seconds and link them as a list */
+  if (count > 1)
+    qsort (entries, (size_t)count, sizeof (LeapSecond), lm_cmpleapsecond);
+
+  for (idx = 0; idx < count; idx++)
+    entries[idx].next = (idx + 1 < count) ? &entries[idx + 1] : NULL;
+
+  table->entries = entries;
+  table->count = count;
+  table->retired = leapsecondtable;
+
+  /* Replace the list and snapshot, ms_sampletime() uses the snapshot only
+   * while both match, the list or snapshot it finds remain valid */
+  LM_STORE_POINTER (leapsecondlist, (count) ? entries : NULL);
+  LM_STORE_POINTER (leapsecondtable, table);
+
   return count;
 } /* End of ms_readleapsecondfile() */
 
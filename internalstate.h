@@ -26,6 +26,44 @@ extern "C" {
 #endif
 
 #include "libmseed.h"
+#include "packdata.h"
+
+/* Storage class of per-thread state, unless disabled by a defined
+ * LIBMSEED_NO_THREADING.
+ *
+ * Windows has its own designation for TLS.
+ * Otherwise, C11 defines the standardized _Thread_local storage-class.
+ * Otherwise fallback to the commonly supported __thread keyword. */
+#if defined(LIBMSEED_NO_THREADING)
+#define lm_thread_local
+#elif defined(LMP_WIN)
+#define lm_thread_local __declspec (thread)
+#elif __STDC_VERSION__ >= 201112L
+#define lm_thread_local _Thread_local
+#else
+#define lm_thread_local __thread
+#endif
+
+/* Stream parameters of the header left in an MS3RecordPacker's rawrec by
+ * a packing session, the header is reused by a following session with
+ * the same parameters and only its start time is updated */
+typedef struct LMPackTemplate
+{
+  char sid[LM_SIDLEN];         /* Source identifier */
+  char *extra;                 /* Copy of extra headers, owned */
+  uint16_t extralength;        /* Length of extra headers */
+  uint16_t extrasize;          /* Allocated size of extra */
+  double samprate;             /* Sample rate */
+  uint32_t maxreclen;          /* Record length */
+  uint8_t encoding;            /* Data encoding */
+  uint8_t pubversion;          /* Publication version */
+  uint8_t flags;               /* Record-level bit flags */
+  int8_t formatversion;        /* 2 or 3, 0 if no header is available */
+  int8_t b1001;                /* miniSEED 2 B1001: 0 = none, 1 = always, 2 = for usec offsets */
+  int dataoffset;              /* Offset to data payload */
+  uint16_t blockette_1000_offset; /* Offset to B1000 (miniSEED 2) */
+  uint16_t blockette_1001_offset; /* Offset to B1001 (miniSEED 2) */
+} LMPackTemplate;
 
 /* Generator-style packing context for MS3Record (opaque in public header) */
 struct MS3RecordPacker
@@ -52,6 +90,75 @@ struct MS3RecordPacker
   uint16_t blockette_1000_offset; /* Offset to B1000 (miniSEED 2) */
   uint16_t blockette_1001_offset; /* Offset to B1001 (miniSEED 2) */
   uint8_t finished;            /* Packing complete flag */
+
+  LMPackTemplate template;     /* Parameters of the header in rawrec, retained across sessions */
+  nstime_t daystart;           /* Start of the day of the last converted start time */
+  uint16_t dayyear;            /* Year of daystart, 0 if not set */
+  uint16_t dayyday;            /* Day of year of daystart */
+};
+
+/* Streaming packing context for a single stream (opaque in public header) */
+struct MS3StreamPacker
+{
+  MS3Record msr;               /* Stream template, start time is that of the current run */
+  MS3RecordPacker packer;      /* Header template and buffers of the current run */
+  void (*record_handler) (char *, int, void *); /* Callback for each record */
+  void *handlerdata;           /* Caller data for record_handler */
+  uint32_t flags;              /* Packing flags */
+  int8_t verbose;              /* Logging level */
+  int8_t active;               /* Set while a run of contiguous samples is in progress */
+  LMSteimEncoder steim;        /* Incremental encoder of the current record (Steim) */
+  uint32_t maxsamples;         /* Max samples per record */
+  uint32_t count;              /* Samples added to the current record */
+  int64_t packedsamples;       /* Total samples packed into records */
+};
+
+/* Default size of the buffer collecting records for a batch handler */
+#define LM_BATCHSIZE 65536
+
+/* Collector of consecutive records delivered to a batch handler in one
+ * contiguous buffer, lm_batch_record_handler() is a record handler for
+ * the packing routines with a pointer to an LMRecordBatch as handler data */
+typedef struct LMRecordBatch
+{
+  void (*batch_handler) (char *, uint64_t, int, void *); /* Callback for each batch */
+  void *handlerdata;           /* Caller data for batch_handler */
+  char *buffer;                /* Allocated batch buffer */
+  uint64_t size;               /* Allocated size of buffer */
+  uint64_t length;             /* Length of records in buffer */
+  int count;                   /* Number of records in buffer */
+} LMRecordBatch;
+
+/* Allocate the buffer of a batch of batchsize bytes, or LM_BATCHSIZE if 0;
+ * returns 0 on success and -1 on error */
+extern int lm_batch_init (LMRecordBatch *batch,
+                          void (*batch_handler) (char *, uint64_t, int, void *), void *handlerdata,
+                          uint64_t batchsize);
+
+/* Add a record to a batch, delivering the batch first if the record does not fit */
+extern void lm_batch_record_handler (char *record, int reclen, void *batch);
+
+/* Deliver any records collected in a batch */
+extern void lm_batch_flush (LMRecordBatch *batch);
+
+/* Release the buffer of a batch */
+extern void lm_batch_free (LMRecordBatch *batch);
+
+/* Default size of the output buffer of an MS3FileWriter */
+#define LM_WRITERBUFSIZE 1048576
+
+/* Persistent output file writer (opaque in public header) */
+struct MS3FileWriter
+{
+  char path[512];              /* Output file, "-" for stdout */
+  FILE *ofp;                   /* Output stream, unbuffered except for stdout */
+  char *buffer;                /* Allocated output buffer */
+  uint64_t size;               /* Allocated size of buffer */
+  uint64_t length;             /* Length of records in buffer */
+  int64_t recordcount;         /* Records packed by the writer */
+  int8_t error;                /* Set after a write error, further writes fail */
+  int8_t verbose;              /* Logging level */
+  struct LMAsyncWriter *async; /* I/O thread and buffer ring, NULL unless asynchronous */
 };
 
 /* Generator-style packing context for MS3TraceList (opaque in public header) */
@@ -82,12 +189,13 @@ struct MS3TraceListPacker
 };
 
 /* Test whether a record with the given geometry cannot hold numsamples,
- * without allocating or writing anything; always returns 0 (not
- * determined) for miniSEED 2, whose data offset depends on the blockette
- * layout built by msr3_pack_header2_offsets() */
+ * without allocating or writing anything, planning the capacity of Steim
+ * encoded records from datasamples; always returns 0 (not determined)
+ * for miniSEED 2, whose data offset depends on the blockette layout built
+ * by msr3_pack_header2_offsets() */
 extern int lm_pack_short_of_record (int8_t formatversion, uint32_t maxreclen, size_t sidlength,
-                                    uint16_t extralength, uint8_t encoding, uint8_t samplesize,
-                                    int64_t numsamples);
+                                    uint16_t extralength, uint8_t encoding, char sampletype,
+                                    const void *datasamples, int64_t numsamples);
 
 /* Start (or restart) a packing session in a caller-allocated ::MS3RecordPacker,
  * reusing its rawrec/encoded buffers when already large enough; returns 0 on
@@ -95,6 +203,11 @@ extern int lm_pack_short_of_record (int8_t formatversion, uint32_t maxreclen, si
 extern int lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flags,
                                int8_t verbose);
 
+/* Pack the next record of a session into dest, packer->rawrec or a buffer
+ * of at least packer->maxreclen bytes; returns 1 when a record is
+ * available, 0 when finished, and -1 on error */
+extern int lm_pack_next (MS3RecordPacker *packer, char *dest, int32_t *reclen);
+
 /* Report the total samples packed by a session and end it, retaining the
  * packer's buffers for reuse by a later lm_pack_state_init() */
 extern void lm_pack_state_finish (MS3RecordPacker *packer, int64_t *packedsamples);
@@ -111,6 +224,26 @@ extern void lm_pack_state_free (MS3RecordPacker *packer);
  * refused in favor of a full scan */
 #define LM_RECENTSEGS_MAXWALK 8
 
+/* Key of a record added to a trace list with MSF_SKIPDUPLICATES, the hash
+ * covers the source identifier and the data payload, a zero hash marks an
+ * unused entry */
+typedef struct LMRecordKey
+{
+  uint64_t hash;               /* CRC-32C of SID (high) and data payload (low) */
+  nstime_t starttime;          /* Record start time */
+  int64_t samplecnt;           /* Record sample count */
+} LMRecordKey;
+
+/* Entry mapping a SID to the trace ID of a trace list with that SID, a
+ * zero hash marks an unused entry */
+typedef struct LMSIDEntry
+{
+  uint32_t hash;               /* CRC-32C of the SID, never zero */
+  int8_t shared;               /* Set if several trace IDs have the SID, id is not used */
+  MS3TraceID *id;              /* Trace ID with the SID, NULL if removed or shared */
+  char sid[LM_SIDLEN];         /* SID of the entry */
+} LMSIDEntry;
+
 /* Private extension of MS3TraceList (opaque in public header).
  *
  * The public struct is the first member so public pointers, sizeof, and
@@ -119,8 +252,21 @@ typedef struct
 {
   MS3TraceList mstl;
   int8_t foreignid; /* Set if an MS3TraceID not allocated by this library may be present */
+  LMRecordKey *recordkeys;     /* Open addressing table of added record keys, NULL if unused */
+  uint64_t recordkeysize;      /* Number of entries in recordkeys, a power of 2 */
+  uint64_t recordkeycount;     /* Number of used entries in recordkeys */
+  LMSIDEntry *sidentries;      /* Open addressing table of trace IDs by SID, or NULL */
+  uint32_t sidentrysize;       /* Number of entries in sidentries, a power of 2 */
+  uint32_t sidentrycount;      /* Number of used entries in sidentries */
 } LMTraceListNode;
 
+/* Test whether a record was already added to a trace list, from a hash of
+ * its SID and data payload, its start time and sample count, without
+ * decoding; records not seen before are remembered.  Returns 1 for a
+ * duplicate, 0 otherwise including for records without a raw record, and
+ * -1 on error */
+extern int lm_tracelist_seen (MS3TraceList *mstl, const MS3Record *msr);
+
 /* Private extension of MS3TraceID (opaque in public header).
  *
  * Tracks the most-recently-active segments of a trace ID (the "recent set")
@@ -29,8 +29,8 @@ extern "C"
 {
 #endif
 
-#define LIBMSEED_VERSION "3.5.4"    //!< Library version
-#define LIBMSEED_RELEASE "2026.217" //!< Library release date
+#define LIBMSEED_VERSION "3.6.0"    //!< Library version
+#define LIBMSEED_RELEASE "2026.292" //!< Library release date
 
 /** @defgroup io-functions File and URL I/O */
 /** @defgroup miniseed-record Record Handling */
@@ -329,6 +329,9 @@ extern int ms_nstime2time (nstime_t nstime, uint16_t *year, uint16_t *yday, uint
                            uint8_t *min, uint8_t *sec, uint32_t *nsec);
 extern char *ms_nstime2timestr_n (nstime_t nstime, char *timestr, size_t timestrsize,
                                   ms_timeformat_t timeformat, ms_subseconds_t subsecond);
+extern int64_t ms_nstime2timestr_batch (const nstime_t *nstimes, int64_t count, char *timestrs,
+                                        size_t timestrsize, ms_timeformat_t timeformat,
+                                        ms_subseconds_t subseconds);
 DEPRECATED extern char *ms_nstime2timestr (nstime_t nstime, char *timestr,
                                            ms_timeformat_t timeformat, ms_subseconds_t subsecond);
 DEPRECATED extern char *ms_nstime2timestrz (nstime_t nstime, char *timestr,
@@ -423,14 +426,34 @@ extern int msr3_parse (const char *record, uint64_t recbuflen, MS3Record **ppmsr
 
 extern int msr3_pack (const MS3Record *msr, void (*record_handler) (char *, int, void *),
                       void *handlerdata, int64_t *packedsamples, uint32_t flags, int8_t verbose);
+extern int msr3_pack_batch (const MS3Record *msr,
+                            void (*batch_handler) (char *, uint64_t, int, void *),
+                            void *handlerdata, uint64_t batchsize, int64_t *packedsamples,
+                            uint32_t flags, int8_t verbose);
 
 /** @brief Opaque packing context for MS3Record generator-style interface */
 typedef struct MS3RecordPacker MS3RecordPacker;
 
 extern MS3RecordPacker *msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose);
 extern int msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen);
+extern int msr3_pack_next_into (MS3RecordPacker *packer, char *record, uint32_t recbuflen,
+                                int32_t *reclen);
 extern void msr3_pack_free (MS3RecordPacker **packer, int64_t *packedsamples);
 
+/** @brief Opaque streaming packing context for a single stream */
+typedef struct MS3StreamPacker MS3StreamPacker;
+
+extern MS3StreamPacker *msr3_streampack_init (const MS3Record *msr,
+                                              void (*record_handler) (char *, int, void *),
+                                              void *handlerdata, uint32_t flags, int8_t verbose);
+extern int64_t msr3_streampack_append (MS3StreamPacker *stream, const int32_t *samples,
+                                       uint64_t count, nstime_t starttime);
+extern int64_t msr3_streampack_flush (MS3StreamPacker *stream);
+extern void msr3_streampack_free (MS3StreamPacker **stream, int64_t *packedsamples);
+
+extern int64_t msr3_cut (const MS3Record *msr, nstime_t starttime, nstime_t endtime,
+                         void (*record_handler) (char *, int, void *), void *handlerdata,
+                         uint32_t flags, int8_t verbose);
 extern int msr3_repack_mseed3 (const MS3Record *msr, char *record, uint32_t recbuflen,
                                int8_t verbose);
 
@@ -456,6 +479,7 @@ extern void msr3_free (MS3Record **ppmsr);
 extern MS3Record *msr3_duplicate (const MS3Record *msr, int8_t datadup);
 extern MS3Record *msr3_duplicate_extra (const MS3Record *msr, int8_t datadup, int8_t extradup);
 extern nstime_t msr3_endtime (const MS3Record *msr);
+extern int msr3_sampletimes (const MS3Record *msr, nstime_t *times, int64_t start, int64_t count);
 extern void msr3_print (const MS3Record *msr, int8_t details);
 extern int msr3_resize_buffer (MS3Record *msr);
 extern double msr3_sampratehz (const MS3Record *msr);
@@ -513,6 +537,22 @@ extern int ms3_addselect_comp (MS3Selections **ppselections, char *network, char
 extern int ms3_readselectionsfile (MS3Selections **ppselections, const char *filename);
 extern void ms3_freeselections (MS3Selections *selections);
 extern void ms3_printselections (const MS3Selections *selections);
+
+/** @brief Compiled data selections, see ms3_compileselections()
+ *
+ * An opaque structure built from ::MS3Selections for efficient
+ * repeated matching. */
+typedef struct MS3CompiledSelections MS3CompiledSelections;
+
+extern MS3CompiledSelections *ms3_compileselections (const MS3Selections *selections);
+extern const MS3Selections *ms3_matchselect_compiled (MS3CompiledSelections *compiled,
+                                                      const char *sid, nstime_t starttime,
+                                                      nstime_t endtime, int pubversion,
+                                                      const MS3SelectTime **ppselecttime);
+extern const MS3Selections *msr3_matchselect_compiled (MS3CompiledSelections *compiled,
+                                                       const MS3Record *msr,
+                                                       const MS3SelectTime **ppselecttime);
+extern void ms3_freecompiledselections (MS3CompiledSelections *compiled);
 /** @} */
 
 /** @addtogroup record-list
@@ -709,10 +749,17 @@ extern int64_t mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *bu
 extern int64_t mstl3_unpack_recordlist (MS3TraceID *id, MS3TraceSeg *seg, void *output,
                                         uint64_t outputsize, int8_t verbose);
 extern int mstl3_convertsamples (MS3TraceSeg *seg, char type, int8_t truncate);
+extern int mstl3_sampletimes (const MS3TraceSeg *seg, nstime_t *times, int64_t start,
+                              int64_t count);
 extern int mstl3_resize_buffers (MS3TraceList *mstl);
 extern int64_t mstl3_pack (MS3TraceList *mstl, void (*record_handler) (char *, int, void *),
                            void *handlerdata, int reclen, int8_t encoding, int64_t *packedsamples,
                            uint32_t flags, int8_t verbose, char *extra);
+extern int64_t mstl3_pack_batch (MS3TraceList *mstl,
+                                 void (*batch_handler) (char *, uint64_t, int, void *),
+                                 void *handlerdata, uint64_t batchsize, int reclen,
+                                 int8_t encoding, int64_t *packedsamples, uint32_t flags,
+                                 int8_t verbose, char *extra);
 
 /** @brief Opaque packing context for MS3TraceList generator-style interface */
 typedef struct MS3TraceListPacker MS3TraceListPacker;
@@ -721,6 +768,8 @@ extern MS3TraceListPacker *mstl3_pack_init (MS3TraceList *mstl, int reclen, int8
                                             uint32_t flags, int8_t verbose, char *extra,
                                             uint32_t flush_idle_seconds);
 extern int mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int32_t *reclen);
+extern int mstl3_pack_next_into (MS3TraceListPacker *packer, uint32_t flags, char *record,
+                                 uint32_t recbuflen, int32_t *reclen);
 extern void mstl3_pack_free (MS3TraceListPacker **packer, int64_t *packedsamples);
 
 extern int64_t mstl3_pack_ppupdate_flushidle (MS3TraceList *mstl,
@@ -778,6 +827,8 @@ extern void mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timefo
     \sa ms3_readtracelist_selection()
     \sa msr3_writemseed()
     \sa mstl3_writemseed()
+    \sa ms3_filewriter_open()
+    \sa ms3_archive_open()
     @{ */
 
 /** @brief Type definition for data source I/O: file-system versus URL
@@ -859,6 +910,17 @@ extern int ms3_readtracelist_selection (MS3TraceList **ppmstl, const char *mspat
                                         const MS3Tolerance *tolerance,
                                         const MS3Selections *selections, int8_t splitversion,
                                         uint32_t flags, int8_t verbose);
+extern int64_t ms3_cut_selection (const char *mspath, const MS3Selections *selections,
+                                  void (*record_handler) (char *, int, void *), void *handlerdata,
+                                  uint32_t flags, int8_t verbose);
+
+/** @brief Opaque time-ordered merge of records from several inputs */
+typedef struct MS3MergeReader MS3MergeReader;
+
+extern MS3MergeReader *ms3_mergereader_open (const char *const *paths, int count, int8_t bysid,
+                                             uint32_t flags, int8_t verbose);
+extern int ms3_mergereader_next (MS3MergeReader *merge, MS3Record **ppmsr);
+extern void ms3_mergereader_close (MS3MergeReader **merge);
 extern int ms3_url_useragent (const char *program, const char *version);
 extern int ms3_url_timeout (long connecttimeout, long stalltimeout);
 extern int ms3_url_userpassword (const char *userpassword);
@@ -868,6 +930,39 @@ extern int64_t msr3_writemseed (MS3Record *msr, const char *mspath, int8_t overw
                                 uint32_t flags, int8_t verbose);
 extern int64_t mstl3_writemseed (MS3TraceList *mstl, const char *mspath, int8_t overwrite,
                                  int maxreclen, int8_t encoding, uint32_t flags, int8_t verbose);
+
+/** @brief Opaque persistent output file writer */
+typedef struct MS3FileWriter MS3FileWriter;
+
+extern MS3FileWriter *ms3_filewriter_open (const char *mspath, int8_t overwrite,
+                                           uint64_t buffersize, int8_t verbose);
+extern MS3FileWriter *ms3_filewriter_open_async (const char *mspath, int8_t overwrite,
+                                                 uint64_t buffersize, int buffercount,
+                                                 int8_t verbose);
+extern int ms3_filewriter_write (MS3FileWriter *writer, const char *record, uint64_t length);
+extern int64_t ms3_filewriter_write_msr (MS3FileWriter *writer, const MS3Record *msr,
+                                         uint32_t flags, int8_t verbose);
+extern int64_t ms3_filewriter_write_mstl (MS3FileWriter *writer, MS3TraceList *mstl,
+                                          int maxreclen, int8_t encoding, uint32_t flags,
+                                          int8_t verbose);
+extern int ms3_filewriter_flush (MS3FileWriter *writer, int8_t sync);
+extern int ms3_filewriter_close (MS3FileWriter **writer);
+
+/** @brief Opaque writer of records to an SDS archive */
+typedef struct MS3ArchiveWriter MS3ArchiveWriter;
+
+extern MS3ArchiveWriter *ms3_archive_open (const char *basedir, int maxopen, uint64_t buffersize,
+                                           int8_t verbose);
+extern int64_t ms3_archive_write_msr (MS3ArchiveWriter *archive, const MS3Record *msr,
+                                      uint32_t flags, int8_t verbose);
+extern int ms3_archive_write_record (MS3ArchiveWriter *archive, const MS3Record *msr);
+extern int ms3_archive_flush (MS3ArchiveWriter *archive, int8_t sync);
+extern int ms3_archive_close (MS3ArchiveWriter **archive);
+extern int ms3_archive_readtracelist (MS3TraceList **ppmstl, const char *basedir,
+                                      const MS3Tolerance *tolerance,
+                                      const MS3Selections *selections, int8_t splitversion,
+                                      uint32_t flags, int8_t verbose);
+
 extern int libmseed_url_support (void);
 extern MS3FileParam *ms3_msfp_init (int64_t startoffset, int64_t endoffset, int fd);
 extern MS3FileParam *ms3_msfp_init_fd (int fd);
@@ -884,11 +979,24 @@ extern MS3FileParam *ms3_msfp_init_fd (int fd);
     combination of the codes.
 
     @{ */
+
+/** @brief FDSN Source Identifier parsed into network, station, location
+ * and channel codes by ms_sid2sourceid(), initialize to zeros before use */
+typedef struct MS3SourceID
+{
+  char sid[LM_SIDLEN];  //!< Source identifier of the codes, empty if not parsed
+  char net[LM_SIDLEN];  //!< Network code
+  char sta[LM_SIDLEN];  //!< Station code
+  char loc[LM_SIDLEN];  //!< Location code, potentially empty
+  char chan[LM_SIDLEN]; //!< Channel code, SEED channel if the extended channel maps to one
+} MS3SourceID;
+
 extern int ms_sid2nslc_n (const char *sid, char *net, size_t netsize, char *sta, size_t stasize,
                           char *loc, size_t locsize, char *chan, size_t chansize);
 DEPRECATED extern int ms_sid2nslc (const char *sid, char *net, char *sta, char *loc, char *chan);
 extern int ms_nslc2sid (char *sid, int sidlen, uint16_t flags, const char *net, const char *sta,
                         const char *loc, const char *chan);
+extern int ms_sid2sourceid (const char *sid, MS3SourceID *sourceid);
 extern int ms_seedchan2xchan (char *xchan, const char *seedchan);
 extern int ms_xchan2seedchan (char *seedchan, const char *xchan);
 extern int ms_strncpclean (char *dest, const char *source, int length);
@@ -1351,6 +1459,11 @@ extern int ms_rlog_free (MSLogParam *logp);
     Normally, calling programs do not need to do any particular
     handling of leap seconds after loading the leap second list.
 
+    The leap second list is searched through a sorted snapshot that
+    ms_readleapsecondfile() replaces as a whole, so the global list
+    should be treated as read-only.  A list assigned by the caller is
+    still used, by walking it for every calculation.
+
     @note The library's internal, epoch-based time representation
     cannot distinguish a leap second.  On the epoch time scale a leap
     second appears as repeat of the second that follows it, an
@@ -1384,6 +1497,8 @@ extern const char *ms_encodingstr (uint8_t encoding);
 extern const char *ms_errorstr (int errorcode);
 
 extern nstime_t ms_sampletime (nstime_t time, int64_t offset, double samprate);
+extern int ms_sampletimes (nstime_t time, int64_t start, int64_t count, double samprate,
+                           nstime_t *times);
 extern int ms_bigendianhost (void);
 
 /** DEPRECATED legacy implementation of fabs(), now a macro */
@@ -1639,6 +1754,7 @@ extern void *libmseed_memory_prealloc (void *ptr, size_t size, size_t *currentsi
 #define MSF_SPLITISVERSION 0x0800 //!< [TraceList] Use the splitversion value as version instead of record version
 #define MSF_SKIPADJACENTDUPLICATES 0x1000 //!< [TraceList] Skip adjacent duplicate records
 #define MSF_RECORDLIST_NOEXTRAS 0x2000 //!< [TraceList] Do not copy extra headers to the record list
+#define MSF_SKIPDUPLICATES 0x4000 //!< [TraceList] Skip duplicate records, adjacent or not
 /** @} */
 
 #ifdef __cplusplus
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "internalstate.h"
 #include "libmseed.h"
 
 void rloginit_int (MSLogParam *logp, void (*log_print) (const char *), const char *logprefix,
@@ -36,23 +37,11 @@ void print_message_int (MSLogParam *logp, int level, const char *message, char *
 
 /* Initialize the global logging parameters
  *
- * If not disabled by a defined LIBMSEED_NO_THREADING, use options for
- * thread-local storage.  In this default case each thread will have
- * it's own "global" logging parameters initialized to the library
- * default settings.
- *
- * Windows has its own designation for TLS.
- * Otherwise, C11 defines the standardized _Thread_local storage-class.
- * Otherwise fallback to the commonly supported __thread keyword.
+ * If not disabled by a defined LIBMSEED_NO_THREADING, use thread-local
+ * storage.  In this default case each thread will have it's own "global"
+ * logging parameters initialized to the library default settings.
  */
 #if !defined(LIBMSEED_NO_THREADING)
-#if defined(LMP_WIN)
-#define lm_thread_local __declspec (thread)
-#elif __STDC_VERSION__ >= 201112L
-#define lm_thread_local _Thread_local
-#else
-#define lm_thread_local __thread
-#endif
 lm_thread_local MSLogParam gMSLogParam = MSLogParam_INITIALIZER;
 #else
 MSLogParam gMSLogParam = MSLogParam_INITIALIZER;
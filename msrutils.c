@@ -233,6 +233,44 @@ msr3_endtime (const MS3Record *msr)
   return ms_sampletime (msr->starttime, sampleoffset, msr->samprate);
 } /* End of msr3_endtime() */
 
+/** ************************************************************************
+ * @brief Calculate the times of samples in a record
+ *
+ * Set @p times to the times of the @p count samples of the record
+ * starting at sample @p start, identical to those calculated by
+ * ms_sampletime() including adjustment for leap seconds.
+ *
+ * @param[in] msr ::MS3Record to calculate sample times of
+ * @param[out] times Array of at least @p count values for the sample times
+ * @param[in] start First sample to calculate the time of
+ * @param[in] count Number of sample times to calculate
+ *
+ * @returns 0 on success and ::MS_GENERROR on error, including samples
+ * beyond ::MS3Record.samplecnt.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms_sampletimes()
+ ***************************************************************************/
+int
+msr3_sampletimes (const MS3Record *msr, nstime_t *times, int64_t start, int64_t count)
+{
+  if (!msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'msr'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (start < 0 || count < 0 || start > msr->samplecnt - count)
+  {
+    ms_log (2, "%s(): Samples %" PRId64 " to %" PRId64 " beyond %" PRId64 " in the record\n",
+            __func__, start, start + count, msr->samplecnt);
+    return MS_GENERROR;
+  }
+
+  return ms_sampletimes (msr->starttime, start, count, msr->samprate, times);
+} /* End of msr3_sampletimes() */
+
 /** ************************************************************************
  * @brief Print header values of an MS3Record
  *
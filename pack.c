@@ -50,6 +50,11 @@ static nstime_t ms_timestr2btime (const char *timestr, uint8_t *btime, int8_t *u
 
 static nstime_t nstime2fsec_usec_offset (nstime_t nstime, uint16_t *fsec, int8_t *usec_offset);
 
+static int lm_pack_settime (MS3RecordPacker *packer, char *record, nstime_t starttime);
+
+static int lm_pack_finish_record (MS3RecordPacker *packer, char *record, uint32_t numsamples,
+                                  uint32_t datalength, nstime_t starttime, uint32_t *reclen);
+
 /** ************************************************************************
  * @brief Pack data into miniSEED records using a callback function to handle
  * the records.
@@ -150,6 +155,143 @@ msr3_pack (const MS3Record *msr, void (*record_handler) (char *, int, void *), v
   return (result == 0) ? recordcount : -1;
 } /* End of msr3_pack() */
 
+/***************************************************************************
+ * Allocate the buffer of a record batch, see internalstate.h.
+ ***************************************************************************/
+int
+lm_batch_init (LMRecordBatch *batch, void (*batch_handler) (char *, uint64_t, int, void *),
+               void *handlerdata, uint64_t batchsize)
+{
+  if (!batch_handler)
+  {
+    ms_log (2, "callback batch_handler() function pointer not set!\n");
+    return -1;
+  }
+
+  batch->batch_handler = batch_handler;
+  batch->handlerdata = handlerdata;
+  batch->size = (batchsize > 0) ? batchsize : LM_BATCHSIZE;
+  batch->length = 0;
+  batch->count = 0;
+
+  if ((batch->buffer = (char *)libmseed_memory.malloc (batch->size)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory for record batch\n");
+    return -1;
+  }
+
+  return 0;
+} /* End of lm_batch_init() */
+
+/***************************************************************************
+ * Record handler adding each record to the LMRecordBatch at ptr.
+ *
+ * A record that does not fit in the remaining space delivers the batch
+ * first, and a record larger than the batch buffer is delivered alone
+ * without being copied.
+ ***************************************************************************/
+void
+lm_batch_record_handler (char *record, int reclen, void *ptr)
+{
+  LMRecordBatch *batch = (LMRecordBatch *)ptr;
+
+  if ((uint64_t)reclen > batch->size - batch->length)
+    lm_batch_flush (batch);
+
+  if ((uint64_t)reclen > batch->size)
+  {
+    batch->batch_handler (record, (uint64_t)reclen, 1, batch->handlerdata);
+    return;
+  }
+
+  memcpy (batch->buffer + batch->length, record, reclen);
+  batch->length += reclen;
+  batch->count++;
+} /* End of lm_batch_record_handler() */
+
+/***************************************************************************
+ * Deliver the records collected in a batch, if any.
+ ***************************************************************************/
+void
+lm_batch_flush (LMRecordBatch *batch)
+{
+  if (batch->count > 0)
+    batch->batch_handler (batch->buffer, batch->length, batch->count, batch->handlerdata);
+
+  batch->length = 0;
+  batch->count = 0;
+} /* End of lm_batch_flush() */
+
+/***************************************************************************
+ * Release the buffer of a record batch.
+ ***************************************************************************/
+void
+lm_batch_free (LMRecordBatch *batch)
+{
+  if (batch->buffer)
+    libmseed_memory.free (batch->buffer);
+
+  batch->buffer = NULL;
+  batch->size = 0;
+} /* End of lm_batch_free() */
+
+/** ************************************************************************
+ * @brief Pack data into miniSEED records delivered in batches
+ *
+ * This function is identical to msr3_pack() except that records are
+ * collected in a buffer of @p batchsize bytes and passed to @p
+ * batch_handler() many at a time instead of one record per callback.
+ *
+ * The @p batch_handler() callback should expect 1) a @c char* to
+ * consecutive records, 2) the total length of the records, 3) the
+ * number of records and 4) a pointer supplied by the original caller
+ * containing optional private data (@p handlerdata).  A batch may be
+ * written to a file or socket with a single call.  The memory will be
+ * re-used or freed when @p batch_handler() returns.
+ *
+ * A record longer than @p batchsize is delivered alone.
+ *
+ * @param[in] msr ::MS3Record containing data to pack
+ * @param[in] batch_handler() Callback function called for each batch of records
+ * @param[in] handlerdata A pointer that will be provided to the @p batch_handler()
+ * @param[in] batchsize Size of the batch buffer in bytes, 0 for a default of 65536
+ * @param[out] packedsamples The number of samples packed, returned to caller
+ * @param[in] flags Bit flags used to control the packing process, see msr3_pack()
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see msr3_pack()
+ * @see mstl3_pack_batch()
+ ***************************************************************************/
+int
+msr3_pack_batch (const MS3Record *msr, void (*batch_handler) (char *, uint64_t, int, void *),
+                 void *handlerdata, uint64_t batchsize, int64_t *packedsamples, uint32_t flags,
+                 int8_t verbose)
+{
+  LMRecordBatch batch;
+  int recordcount;
+
+  if (!msr)
+  {
+    ms_log (2, "%s(): Required input not defined: 'msr'\n", __func__);
+    return -1;
+  }
+
+  if (lm_batch_init (&batch, batch_handler, handlerdata, batchsize))
+    return -1;
+
+  recordcount = msr3_pack (msr, lm_batch_record_handler, &batch, packedsamples, flags, verbose);
+
+  /* Records packed before an error are delivered */
+  lm_batch_flush (&batch);
+  lm_batch_free (&batch);
+
+  return recordcount;
+} /* End of msr3_pack_batch() */
+
 /***************************************************************************
  * Maximum samples that fit in maxdatabytes for a given encoding, the same
  * formula used by lm_pack_state_init() to set packer->maxsamples.
@@ -165,6 +307,36 @@ lm_pack_maxsamples (uint32_t maxdatabytes, uint8_t encoding, uint8_t samplesize)
     return (samplesize) ? maxdatabytes / samplesize : 0;
 } /* End of lm_pack_maxsamples() */
 
+/***************************************************************************
+ * Test whether numsamples integer samples, Steim encoded, cannot fill a
+ * record with maxdatabytes of data space.
+ *
+ * The capacity of a record is determined exactly from the bit widths of
+ * the differences.  The packing of the last words of a record depends on
+ * up to 6 (Steim2) or 3 (Steim1) differences following them, so a record
+ * is only complete, and identical to one packed with more samples
+ * available, when those samples are also present.
+ *
+ * Returns non-zero if the samples are short of a full record, otherwise 0.
+ ***************************************************************************/
+static int
+lm_pack_steim_short (const int32_t *samples, uint64_t numsamples, uint32_t maxdatabytes,
+                     uint8_t encoding)
+{
+  uint64_t lookahead = (encoding == DE_STEIM1) ? 3 : 6;
+  uint64_t words = (maxdatabytes / 64) * 15;
+
+  if (words < 2)
+    return 0;
+
+  /* Every word holds at least one difference */
+  if (numsamples < words - 2 + lookahead)
+    return 1;
+
+  return numsamples <
+         lm_steim_capacity (samples, numsamples, maxdatabytes, (int8_t)encoding) + lookahead;
+} /* End of lm_pack_steim_short() */
+
 /***************************************************************************
  * Test whether a record with the given geometry cannot hold numsamples,
  * i.e. whether msr3_pack_next() would return 0 on a fresh packer with this
@@ -180,9 +352,10 @@ lm_pack_maxsamples (uint32_t maxdatabytes, uint8_t encoding, uint8_t samplesize)
  ***************************************************************************/
 int
 lm_pack_short_of_record (int8_t formatversion, uint32_t maxreclen, size_t sidlength,
-                         uint16_t extralength, uint8_t encoding, uint8_t samplesize,
-                         int64_t numsamples)
+                         uint16_t extralength, uint8_t encoding, char sampletype,
+                         const void *datasamples, int64_t numsamples)
 {
+  uint8_t samplesize = ms_samplesize (sampletype);
   uint32_t offset;
   uint32_t maxdatabytes;
   uint32_t maxsamples;
@@ -199,7 +372,15 @@ lm_pack_short_of_record (int8_t formatversion, uint32_t maxreclen, size_t sidlen
   maxdatabytes = maxreclen - offset;
   maxsamples = lm_pack_maxsamples (maxdatabytes, encoding, samplesize);
 
-  return (uint64_t)numsamples < maxsamples;
+  if ((uint64_t)numsamples >= maxsamples)
+    return 0;
+
+  /* The sample limit is only an upper bound for Steim encodings */
+  if ((encoding == DE_STEIM1 || encoding == DE_STEIM2) && sampletype == 'i' && datasamples)
+    return lm_pack_steim_short ((const int32_t *)datasamples, (uint64_t)numsamples, maxdatabytes,
+                                encoding);
+
+  return 1;
 } /* End of lm_pack_short_of_record() */
 
 /** ************************************************************************
@@ -259,6 +440,93 @@ msr3_pack_init (const MS3Record *msr, uint32_t flags, int8_t verbose)
   return packer;
 } /* End of msr3_pack_init() */
 
+/***************************************************************************
+ * Test whether the header template of a packer, left in its rawrec by
+ * the previous session, was packed for the stream parameters of msr and
+ * differs only in start time from a header packed for msr.
+ *
+ * Returns non-zero if the template can be reused, otherwise 0.
+ ***************************************************************************/
+static int
+lm_pack_template_match (const MS3RecordPacker *packer, const MS3Record *msr)
+{
+  const LMPackTemplate *template = &packer->template;
+  uint16_t extralength = (msr->extra) ? msr->extralength : 0;
+  uint16_t fsec;
+  int8_t usec_offset;
+
+  if (template->formatversion != packer->formatversion ||
+      template->maxreclen != packer->maxreclen || template->encoding != packer->encoding ||
+      template->pubversion != msr->pubversion || template->flags != msr->flags ||
+      template->samprate != msr->samprate || template->extralength != extralength ||
+      strcmp (template->sid, msr->sid) ||
+      (extralength > 0 && memcmp (template->extra, msr->extra, extralength)))
+    return 0;
+
+  /* A miniSEED 2 header includes B1001 for a microsecond offset of the start
+   * time when it is not included for other reasons */
+  if (template->formatversion == 2 && template->b1001 != 1)
+  {
+    if (nstime2fsec_usec_offset (msr->starttime, &fsec, &usec_offset) == NSTERROR)
+      return 0;
+
+    if ((usec_offset != 0) != (template->b1001 == 2))
+      return 0;
+  }
+
+  return 1;
+} /* End of lm_pack_template_match() */
+
+/***************************************************************************
+ * Record the stream parameters of msr for the header just packed into
+ * the packer's rawrec, for reuse by a following session.  If the extra
+ * headers cannot be copied no template is recorded.
+ ***************************************************************************/
+static void
+lm_pack_template_save (MS3RecordPacker *packer, const MS3Record *msr)
+{
+  LMPackTemplate *template = &packer->template;
+  uint16_t extralength = (msr->extra) ? msr->extralength : 0;
+  uint16_t fsec;
+  int8_t usec_offset = 0;
+
+  template->formatversion = 0;
+
+  if (extralength > template->extrasize)
+  {
+    char *extra = (char *)libmseed_memory.realloc (template->extra, extralength);
+
+    if (!extra)
+      return;
+
+    template->extra = extra;
+    template->extrasize = extralength;
+  }
+
+  if (extralength > 0)
+    memcpy (template->extra, msr->extra, extralength);
+
+  memcpy (template->sid, msr->sid, sizeof (template->sid));
+  template->extralength = extralength;
+  template->samprate = msr->samprate;
+  template->maxreclen = packer->maxreclen;
+  template->encoding = packer->encoding;
+  template->pubversion = msr->pubversion;
+  template->flags = msr->flags;
+  template->dataoffset = packer->dataoffset;
+  template->blockette_1000_offset = packer->blockette_1000_offset;
+  template->blockette_1001_offset = packer->blockette_1001_offset;
+  template->b1001 = 0;
+
+  if (packer->formatversion == 2 && packer->blockette_1001_offset)
+  {
+    nstime2fsec_usec_offset (msr->starttime, &fsec, &usec_offset);
+    template->b1001 = (usec_offset) ? 2 : 1;
+  }
+
+  template->formatversion = packer->formatversion;
+} /* End of lm_pack_template_save() */
+
 /***************************************************************************
  * Start (or restart) a packing session in a caller-allocated packer,
  * reusing its rawrec/encoded buffers when they are already large enough.
@@ -292,12 +560,17 @@ lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flag
   }
 
   /* Reset per-session state, retaining rawrec/encoded and their allocated
-   * sizes for reuse regardless of what else this struct grows to hold */
+   * sizes, the header template and the start of day cache for reuse
+   * regardless of what else this struct grows to hold */
   {
     char *rawrec = packer->rawrec;
     uint32_t rawrec_size = packer->rawrec_size;
     char *encoded = packer->encoded;
     uint32_t encoded_size = packer->encoded_size;
+    LMPackTemplate template = packer->template;
+    nstime_t daystart = packer->daystart;
+    uint16_t dayyear = packer->dayyear;
+    uint16_t dayyday = packer->dayyday;
 
     memset (packer, 0, sizeof (*packer));
 
@@ -305,6 +578,10 @@ lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flag
     packer->rawrec_size = rawrec_size;
     packer->encoded = encoded;
     packer->encoded_size = encoded_size;
+    packer->template = template;
+    packer->daystart = daystart;
+    packer->dayyear = dayyear;
+    packer->dayyday = dayyday;
   }
 
   packer->msr = msr;
@@ -358,8 +635,6 @@ lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flag
     packer->rawrec_size = packer->maxreclen;
   }
 
-  memset (packer->rawrec, 0, packer->maxreclen);
-
   /* For records with samples, validate sample type before packing */
   if (msr->numsamples > 0)
   {
@@ -371,43 +646,66 @@ lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flag
     }
   }
 
-  /* Pack header (required for header-only and data-containing records) */
-  if (packer->formatversion == 3)
+  /* Reuse the header left in rawrec by the previous session when packed for
+   * the same stream parameters, updating only the start time */
+  if (msr->numsamples > 0 && lm_pack_template_match (packer, msr))
   {
-    packer->dataoffset = msr3_pack_header3 (msr, packer->rawrec, packer->maxreclen, verbose);
+    packer->dataoffset = packer->template.dataoffset;
+    packer->blockette_1000_offset = packer->template.blockette_1000_offset;
+    packer->blockette_1001_offset = packer->template.blockette_1001_offset;
+
+    memset (packer->rawrec + packer->dataoffset, 0, packer->maxreclen - packer->dataoffset);
+
+    if (lm_pack_settime (packer, packer->rawrec, msr->starttime))
+      return -1;
   }
   else
   {
-    packer->dataoffset = msr3_pack_header2_offsets (msr, packer->rawrec, packer->maxreclen,
-                                                    &packer->blockette_1000_offset,
-                                                    &packer->blockette_1001_offset, verbose);
+    packer->template.formatversion = 0;
 
-    if (packer->dataoffset > 0 && msr->numsamples > 0)
+    memset (packer->rawrec, 0, packer->maxreclen);
+
+    /* Pack header (required for header-only and data-containing records) */
+    if (packer->formatversion == 3)
     {
-      /* For Steim encodings, align data offset to 64-byte boundary */
-      if (packer->encoding == DE_STEIM1 || packer->encoding == DE_STEIM2)
-      {
-        packer->dataoffset = ((packer->dataoffset + 63) / 64) * 64;
-      }
+      packer->dataoffset = msr3_pack_header3 (msr, packer->rawrec, packer->maxreclen, verbose);
+    }
+    else
+    {
+      packer->dataoffset = msr3_pack_header2_offsets (msr, packer->rawrec, packer->maxreclen,
+                                                      &packer->blockette_1000_offset,
+                                                      &packer->blockette_1001_offset, verbose);
 
-      /* The (possibly aligned) data offset must still leave room for data
-       * within the record and fit the 16-bit v2 data-offset field. */
-      if ((uint32_t)packer->dataoffset >= packer->maxreclen || packer->dataoffset > UINT16_MAX)
+      if (packer->dataoffset > 0 && msr->numsamples > 0)
       {
-        ms_log (2, "%s: Data offset (%d) does not fit within record length (%u)\n", msr->sid,
-                packer->dataoffset, packer->maxreclen);
-        return -1;
+        /* For Steim encodings, align data offset to 64-byte boundary */
+        if (packer->encoding == DE_STEIM1 || packer->encoding == DE_STEIM2)
+        {
+          packer->dataoffset = ((packer->dataoffset + 63) / 64) * 64;
+        }
+
+        /* The (possibly aligned) data offset must still leave room for data
+         * within the record and fit the 16-bit v2 data-offset field. */
+        if ((uint32_t)packer->dataoffset >= packer->maxreclen || packer->dataoffset > UINT16_MAX)
+        {
+          ms_log (2, "%s: Data offset (%d) does not fit within record length (%u)\n", msr->sid,
+                  packer->dataoffset, packer->maxreclen);
+          return -1;
+        }
+
+        /* Set data offset in header */
+        *pMS2FSDH_DATAOFFSET (packer->rawrec) = HO2u (packer->dataoffset, packer->swapflag);
       }
+    }
 
-      /* Set data offset in header */
-      *pMS2FSDH_DATAOFFSET (packer->rawrec) = HO2u (packer->dataoffset, packer->swapflag);
+    if (packer->dataoffset < 0)
+    {
+      ms_log (2, "%s: Cannot pack miniSEED header\n", msr->sid);
+      return -1;
     }
-  }
 
-  if (packer->dataoffset < 0)
-  {
-    ms_log (2, "%s: Cannot pack miniSEED header\n", msr->sid);
-    return -1;
+    if (packer->dataoffset > 0 && msr->numsamples > 0)
+      lm_pack_template_save (packer, msr);
   }
 
   /* For records with samples, set up encoding buffers and parameters */
@@ -471,35 +769,112 @@ lm_pack_state_init (MS3RecordPacker *packer, const MS3Record *msr, uint32_t flag
  * @ref MessageOnError - this function logs a message on error
  *
  * @see msr3_pack_init()
+ * @see msr3_pack_next_into()
  * @see msr3_pack_free()
  ***************************************************************************/
 int
 msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
 {
-  int64_t samples_packed;
-  int64_t packoffset_bytes;
-  uint64_t remaining_samples;
-  uint32_t datalength;
-  uint32_t reclen_generated;
-  uint32_t crc;
-  uint16_t year;
-  uint16_t day;
-  uint8_t hour;
-  uint8_t min;
-  uint8_t sec;
-  uint32_t nsec;
-  uint16_t fsec;
-  int8_t usec_offset;
+  int result;
+
+  if (!packer || !record || !reclen)
+  {
+    ms_log (2, "%s(): Required input not defined\n", __func__);
+    return -1;
+  }
 
+  if ((result = lm_pack_next (packer, packer->rawrec, reclen)) == 1)
+    *record = packer->rawrec;
+
+  return result;
+} /* End of msr3_pack_next() */
+
+/** ************************************************************************
+ * @brief Generate next miniSEED record into a caller-supplied buffer.
+ *
+ * This function is identical to msr3_pack_next() except that the record
+ * is written to @p record, memory owned by the caller such as a slot of
+ * a shared memory ring or a mapped output file, instead of a buffer
+ * owned by the @p packer that the caller would copy from.
+ *
+ * The record is assembled in place when @p record is aligned to at
+ * least 4 bytes, and the data samples are encoded directly into it when
+ * the data payload is aligned to 8 bytes, as with a buffer from malloc()
+ * and miniSEED 2 records.  Otherwise a copy is made.
+ *
+ * The buffer must be at least as large as the maximum record length of
+ * the packer, i.e. @ref MS3Record.reclen or 4096 when that is -1, as
+ * that space may be used while encoding.  Bytes beyond the returned
+ * record length are not specified.
+ *
+ * @param[in] packer ::MS3RecordPacker context
+ * @param[out] record Buffer for the record
+ * @param[in] recbuflen Length of @p record buffer in bytes
+ * @param[out] reclen Length of record in bytes
+ *
+ * @return 1 when a record is available, 0 when finished, and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see msr3_pack_next()
+ ***************************************************************************/
+int
+msr3_pack_next_into (MS3RecordPacker *packer, char *record, uint32_t recbuflen, int32_t *reclen)
+{
   if (!packer || !record || !reclen)
   {
     ms_log (2, "%s(): Required input not defined\n", __func__);
     return -1;
   }
 
+  if (recbuflen < packer->maxreclen)
+  {
+    ms_log (2, "%s: Record buffer length (%u) is smaller than the record length (%u)\n",
+            packer->msr->sid, recbuflen, packer->maxreclen);
+    return -1;
+  }
+
+  return lm_pack_next (packer, record, reclen);
+} /* End of msr3_pack_next_into() */
+
+/***************************************************************************
+ * Pack the next record of a packing session into dest, which is either
+ * packer->rawrec or a caller buffer of at least packer->maxreclen bytes.
+ *
+ * The header is maintained in packer->rawrec and copied to a caller
+ * buffer.  Samples are encoded in place when the data payload in dest is
+ * aligned for any sample size, otherwise via packer->encoded.  A caller
+ * buffer that is not aligned for the header fields receives a copy of
+ * the record assembled in packer->rawrec.
+ *
+ * Returns 1 when a record is available, 0 when finished, and -1 on error.
+ ***************************************************************************/
+int
+lm_pack_next (MS3RecordPacker *packer, char *dest, int32_t *reclen)
+{
+  int64_t samples_packed;
+  int64_t packoffset_bytes;
+  uint64_t remaining_samples;
+  uint32_t datalength;
+  uint32_t reclen_generated;
+  uint32_t crc;
+  char *data;
+  int inplace;
+  int result;
+
   if (packer->finished)
     return 0;
 
+  /* Header fields are not written to an unaligned buffer, the record is
+   * assembled in rawrec and copied instead */
+  if (dest != packer->rawrec && (uintptr_t)dest % sizeof (uint32_t) != 0)
+  {
+    if ((result = lm_pack_next (packer, packer->rawrec, reclen)) == 1)
+      memcpy (dest, packer->rawrec, *reclen);
+
+    return result;
+  }
+
   /* Handle header-only records (no data samples) */
   if (packer->msr->numsamples <= 0)
   {
@@ -520,7 +895,6 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
         ms_log (0, "%s: Packed %d byte record with no payload\n", packer->msr->sid,
                 packer->dataoffset);
 
-      *record = packer->rawrec;
       *reclen = packer->dataoffset;
     }
     else /* version 2 */
@@ -540,10 +914,12 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
         ms_log (0, "%s: Packed %u byte record with no payload\n", packer->msr->sid,
                 packer->maxreclen);
 
-      *record = packer->rawrec;
       *reclen = packer->maxreclen;
     }
 
+    if (dest != packer->rawrec)
+      memcpy (dest, packer->rawrec, *reclen);
+
     packer->recordcount++;
     packer->finished = 1;
     return 1;
@@ -552,9 +928,15 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   /* Calculate remaining samples */
   remaining_samples = packer->msr->numsamples - packer->packed_samples;
 
-  /* Finished packing if all samples have been packed or less than max samples and not flushing */
+  /* Finished packing if all samples have been packed or, when not flushing, the
+   * remaining samples cannot fill a record.  The sample limit is exact except for
+   * Steim encodings, for which the capacity is determined from the samples. */
   if ((remaining_samples == 0) ||
-      (remaining_samples < packer->maxsamples && !(packer->flags & MSF_FLUSHDATA)))
+      (remaining_samples < packer->maxsamples && !(packer->flags & MSF_FLUSHDATA) &&
+       ((packer->encoding != DE_STEIM1 && packer->encoding != DE_STEIM2) ||
+        packer->msr->sampletype != 'i' ||
+        lm_pack_steim_short ((int32_t *)packer->msr->datasamples + packer->packed_samples,
+                             remaining_samples, packer->maxdatabytes, packer->encoding))))
   {
     packer->finished = 1;
     return 0;
@@ -568,10 +950,14 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   if (packer->formatversion == 2 && samples_to_pack > UINT16_MAX)
     samples_to_pack = UINT16_MAX;
 
+  /* Encode directly into the record when the payload is aligned */
+  data = dest + packer->dataoffset;
+  inplace = ((uintptr_t)data % sizeof (double) == 0);
+
   samples_packed = msr_pack_data (
-      packer->encoded, (uint8_t *)packer->msr->datasamples + packoffset_bytes, samples_to_pack,
-      packer->maxdatabytes, packer->msr->sampletype, packer->encoding, packer->swapflag,
-      &datalength, packer->msr->sid, packer->verbose);
+      (inplace) ? data : packer->encoded, (uint8_t *)packer->msr->datasamples + packoffset_bytes,
+      samples_to_pack, packer->maxdatabytes, packer->msr->sampletype, packer->encoding,
+      packer->swapflag, &datalength, packer->msr->sid, packer->verbose);
 
   if (samples_packed < 0)
   {
@@ -586,89 +972,23 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   }
 
   /* Copy encoded data into record */
-  memcpy (packer->rawrec + packer->dataoffset, packer->encoded, datalength);
-
-  /* Version 3 record */
-  if (packer->formatversion == 3)
-  {
-    /* Calculate record length */
-    reclen_generated = packer->dataoffset + datalength;
-
-    /* Update number of samples and data length */
-    *pMS3FSDH_NUMSAMPLES (packer->rawrec) = HO4u ((uint32_t)samples_packed, packer->swapflag);
-    *pMS3FSDH_DATALENGTH (packer->rawrec) = HO4u (datalength, packer->swapflag);
+  if (!inplace)
+    memcpy (data, packer->encoded, datalength);
 
-    /* Update start time if not first record */
-    if (packer->recordcount > 0)
-    {
-      if (ms_nstime2time (packer->nextstarttime, &year, &day, &hour, &min, &sec, &nsec))
-      {
-        ms_log (2, "%s: Cannot convert record starttime: %" PRId64 "\n", packer->msr->sid,
-                packer->nextstarttime);
-        return -1;
-      }
-
-      *pMS3FSDH_NSEC (packer->rawrec) = HO4u (nsec, packer->swapflag);
-      *pMS3FSDH_YEAR (packer->rawrec) = HO2u (year, packer->swapflag);
-      *pMS3FSDH_DAY (packer->rawrec) = HO2u (day, packer->swapflag);
-      *pMS3FSDH_HOUR (packer->rawrec) = hour;
-      *pMS3FSDH_MIN (packer->rawrec) = min;
-      *pMS3FSDH_SEC (packer->rawrec) = sec;
-    }
-
-    /* Calculate CRC and set */
-    memset (pMS3FSDH_CRC (packer->rawrec), 0, sizeof (uint32_t));
-    crc = ms_crc32c ((const uint8_t *)packer->rawrec, reclen_generated, 0);
-    *pMS3FSDH_CRC (packer->rawrec) = HO4u (crc, packer->swapflag);
-  }
-  /* Version 2 record */
-  else
-  {
-    /* V2 records are always full length */
-    reclen_generated = packer->maxreclen;
-
-    /* Update number of samples */
-    *pMS2FSDH_NUMSAMPLES (packer->rawrec) = HO2u ((uint16_t)samples_packed, packer->swapflag);
-
-    /* Zero any space between encoded data and end of record */
-    uint32_t content = packer->dataoffset + datalength;
-    if (content < packer->maxreclen)
-      memset (packer->rawrec + content, 0, packer->maxreclen - content);
-
-    /* Update start time if not first record */
-    if (packer->recordcount > 0)
-    {
-      nstime_t second_nstime = nstime2fsec_usec_offset (packer->nextstarttime, &fsec, &usec_offset);
-
-      /* Use the (possibly carried) second-resolution time so Y/D/H/M/S stay
-       * consistent with fsec/usec_offset when rounding carries into the next second */
-      if (second_nstime == NSTERROR ||
-          ms_nstime2time (second_nstime, &year, &day, &hour, &min, &sec, NULL))
-      {
-        ms_log (2, "%s: Cannot convert record starttime: %" PRId64 "\n", packer->msr->sid,
-                packer->nextstarttime);
-        return -1;
-      }
-
-      *pMS2FSDH_YEAR (packer->rawrec) = HO2u (year, packer->swapflag);
-      *pMS2FSDH_DAY (packer->rawrec) = HO2u (day, packer->swapflag);
-      *pMS2FSDH_HOUR (packer->rawrec) = hour;
-      *pMS2FSDH_MIN (packer->rawrec) = min;
-      *pMS2FSDH_SEC (packer->rawrec) = sec;
-      *pMS2FSDH_FSEC (packer->rawrec) = HO2u (fsec, packer->swapflag);
+  /* Copy header into a caller buffer */
+  if (dest != packer->rawrec)
+    memcpy (dest, packer->rawrec, packer->dataoffset);
 
-      if (packer->blockette_1001_offset)
-      {
-        *pMS2B1001_MICROSECOND (packer->rawrec + packer->blockette_1001_offset) = usec_offset;
-      }
-    }
-  }
+  /* Finish header, updating start time if not first record */
+  if (lm_pack_finish_record (packer, dest, (uint32_t)samples_packed, datalength,
+                             (packer->recordcount > 0) ? packer->nextstarttime : NSTUNSET,
+                             &reclen_generated))
+    return -1;
 
   if (packer->verbose >= 1)
     ms_log (0, "%s: Packed %" PRId64 " samples into %u byte record\n", packer->msr->sid,
             samples_packed, reclen_generated);
 
-  *record = packer->rawrec;
   *reclen = reclen_generated;
 
   packer->packed_samples += samples_packed;
@@ -686,7 +1006,167 @@ msr3_pack_next (MS3RecordPacker *packer, char **record, int32_t *reclen)
   }
 
   return 1;
-} /* End of msr3_pack_next() */
+} /* End of lm_pack_next() */
+
+/***************************************************************************
+ * Break down a start time into date-time components like ms_nstime2time(),
+ * converting only the first time of each day in full and deriving later
+ * times of the same day from the packer's cached start of day.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_pack_splittime (MS3RecordPacker *packer, nstime_t nstime, uint16_t *year, uint16_t *day,
+                   uint8_t *hour, uint8_t *min, uint8_t *sec, uint32_t *nsec)
+{
+  nstime_t offset = nstime - packer->daystart;
+  int64_t isec;
+  uint32_t ifract;
+
+  if (packer->dayyear == 0 || offset < 0 || offset >= (nstime_t)86400 * NSTMODULUS)
+  {
+    if (ms_nstime2time (nstime, year, day, hour, min, sec, &ifract))
+      return -1;
+
+    packer->daystart =
+        nstime - ((int64_t)*hour * 3600 + *min * 60 + *sec) * NSTMODULUS - ifract;
+    packer->dayyear = *year;
+    packer->dayyday = *day;
+  }
+  else
+  {
+    isec = offset / NSTMODULUS;
+    ifract = (uint32_t)(offset - isec * NSTMODULUS);
+
+    *year = packer->dayyear;
+    *day = packer->dayyday;
+    *hour = (uint8_t)(isec / 3600);
+    *min = (uint8_t)(isec / 60 % 60);
+    *sec = (uint8_t)(isec % 60);
+  }
+
+  if (nsec)
+    *nsec = ifract;
+
+  return 0;
+} /* End of lm_pack_splittime() */
+
+/***************************************************************************
+ * Set the start time in the header of record, packer->rawrec or a copy
+ * of its header.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_pack_settime (MS3RecordPacker *packer, char *record, nstime_t starttime)
+{
+  uint16_t year;
+  uint16_t day;
+  uint8_t hour;
+  uint8_t min;
+  uint8_t sec;
+  uint32_t nsec;
+  uint16_t fsec;
+  int8_t usec_offset;
+
+  if (packer->formatversion == 3)
+  {
+    if (lm_pack_splittime (packer, starttime, &year, &day, &hour, &min, &sec, &nsec))
+    {
+      ms_log (2, "%s: Cannot convert record starttime: %" PRId64 "\n", packer->msr->sid,
+              starttime);
+      return -1;
+    }
+
+    *pMS3FSDH_NSEC (record) = HO4u (nsec, packer->swapflag);
+    *pMS3FSDH_YEAR (record) = HO2u (year, packer->swapflag);
+    *pMS3FSDH_DAY (record) = HO2u (day, packer->swapflag);
+    *pMS3FSDH_HOUR (record) = hour;
+    *pMS3FSDH_MIN (record) = min;
+    *pMS3FSDH_SEC (record) = sec;
+  }
+  else
+  {
+    nstime_t second_nstime = nstime2fsec_usec_offset (starttime, &fsec, &usec_offset);
+
+    /* Use the (possibly carried) second-resolution time so Y/D/H/M/S stay
+     * consistent with fsec/usec_offset when rounding carries into the next second */
+    if (second_nstime == NSTERROR ||
+        lm_pack_splittime (packer, second_nstime, &year, &day, &hour, &min, &sec, NULL))
+    {
+      ms_log (2, "%s: Cannot convert record starttime: %" PRId64 "\n", packer->msr->sid,
+              starttime);
+      return -1;
+    }
+
+    *pMS2FSDH_YEAR (record) = HO2u (year, packer->swapflag);
+    *pMS2FSDH_DAY (record) = HO2u (day, packer->swapflag);
+    *pMS2FSDH_HOUR (record) = hour;
+    *pMS2FSDH_MIN (record) = min;
+    *pMS2FSDH_SEC (record) = sec;
+    *pMS2FSDH_FSEC (record) = HO2u (fsec, packer->swapflag);
+
+    if (packer->blockette_1001_offset)
+    {
+      *pMS2B1001_MICROSECOND (record + packer->blockette_1001_offset) = usec_offset;
+    }
+  }
+
+  return 0;
+} /* End of lm_pack_settime() */
+
+/***************************************************************************
+ * Finish the header of record, packer->rawrec or a copy of its header,
+ * whose encoded data has been placed at the data offset: set the sample
+ * count and data length, the start time unless it is NSTUNSET, and the
+ * CRC (miniSEED 3) or zero the unused data space (miniSEED 2).
+ *
+ * The generated record length is returned via reclen.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_pack_finish_record (MS3RecordPacker *packer, char *record, uint32_t numsamples,
+                       uint32_t datalength, nstime_t starttime, uint32_t *reclen)
+{
+  uint32_t crc;
+
+  /* Update start time if requested */
+  if (starttime != NSTUNSET && lm_pack_settime (packer, record, starttime))
+    return -1;
+
+  /* Version 3 record */
+  if (packer->formatversion == 3)
+  {
+    /* Calculate record length */
+    *reclen = packer->dataoffset + datalength;
+
+    /* Update number of samples and data length */
+    *pMS3FSDH_NUMSAMPLES (record) = HO4u (numsamples, packer->swapflag);
+    *pMS3FSDH_DATALENGTH (record) = HO4u (datalength, packer->swapflag);
+
+    /* Calculate CRC and set */
+    memset (pMS3FSDH_CRC (record), 0, sizeof (uint32_t));
+    crc = ms_crc32c ((const uint8_t *)record, *reclen, 0);
+    *pMS3FSDH_CRC (record) = HO4u (crc, packer->swapflag);
+  }
+  /* Version 2 record */
+  else
+  {
+    /* V2 records are always full length */
+    *reclen = packer->maxreclen;
+
+    /* Update number of samples */
+    *pMS2FSDH_NUMSAMPLES (record) = HO2u ((uint16_t)numsamples, packer->swapflag);
+
+    /* Zero any space between encoded data and end of record */
+    uint32_t content = packer->dataoffset + datalength;
+    if (content < packer->maxreclen)
+      memset (record + content, 0, packer->maxreclen - content);
+  }
+
+  return 0;
+} /* End of lm_pack_finish_record() */
 
 /** ************************************************************************
  * @brief Free packer and resources
@@ -746,12 +1226,633 @@ lm_pack_state_free (MS3RecordPacker *packer)
   if (packer->encoded)
     libmseed_memory.free (packer->encoded);
 
+  if (packer->template.extra)
+    libmseed_memory.free (packer->template.extra);
+
   packer->rawrec = NULL;
   packer->rawrec_size = 0;
   packer->encoded = NULL;
   packer->encoded_size = 0;
+  memset (&packer->template, 0, sizeof (packer->template));
 } /* End of lm_pack_state_free() */
 
+/***************************************************************************
+ * Start a record of a stream packer, preparing the incremental Steim
+ * encoder for Steim encodings.
+ ***************************************************************************/
+static void
+lm_streampack_startrecord (MS3StreamPacker *stream)
+{
+  MS3RecordPacker *packer = &stream->packer;
+
+  stream->count = 0;
+
+  /* Steim frames are always big endian */
+  if (packer->encoding == DE_STEIM1 || packer->encoding == DE_STEIM2)
+    lm_steim_start (&stream->steim, (int32_t *)packer->encoded, packer->maxdatabytes,
+                    packer->maxsamples, packer->encoding, (ms_bigendianhost ()) ? 0 : 1);
+} /* End of lm_streampack_startrecord() */
+
+/***************************************************************************
+ * Start a run of contiguous samples of a stream packer at starttime,
+ * packing the header template used by all records of the run.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_streampack_startrun (MS3StreamPacker *stream, nstime_t starttime)
+{
+  stream->msr.starttime = starttime;
+
+  if (lm_pack_state_init (&stream->packer, &stream->msr, stream->flags, stream->verbose))
+    return -1;
+
+  /* The packer's limit is based on the 32-bit sample size, INT16 encoded samples are smaller */
+  stream->maxsamples = stream->packer.maxsamples;
+
+  if (stream->packer.encoding == DE_INT16)
+  {
+    stream->maxsamples = stream->packer.maxdatabytes / sizeof (int16_t);
+
+    if (stream->packer.formatversion == 2 && stream->maxsamples > UINT16_MAX)
+      stream->maxsamples = UINT16_MAX;
+  }
+
+  lm_streampack_startrecord (stream);
+  stream->active = 1;
+
+  return 0;
+} /* End of lm_streampack_startrun() */
+
+/***************************************************************************
+ * Complete the current record of a stream packer and pass it to the
+ * record handler.  For Steim encodings, samples added but not packed
+ * when the record filled are carried into the next record.
+ *
+ * Returns 1 when a record was produced, 0 when the record is empty and
+ * -1 on error.
+ ***************************************************************************/
+static int
+lm_streampack_emit (MS3StreamPacker *stream)
+{
+  MS3RecordPacker *packer = &stream->packer;
+  int32_t carry[7];
+  int carrycount = 0;
+  int idx;
+  uint32_t numsamples;
+  uint32_t datalength;
+  uint32_t reclen;
+
+  if (stream->count == 0)
+    return 0;
+
+  if (packer->encoding == DE_STEIM1 || packer->encoding == DE_STEIM2)
+  {
+    if (lm_steim_finish (&stream->steim, &datalength, stream->msr.sid) < 0)
+      return -1;
+
+    numsamples = (uint32_t)stream->steim.samplecount;
+    carrycount = stream->steim.pending;
+    memcpy (carry, stream->steim.values, carrycount * sizeof (int32_t));
+  }
+  else
+  {
+    numsamples = stream->count;
+    datalength = numsamples * ((packer->encoding == DE_INT16) ? 2 : 4);
+  }
+
+  /* Copy encoded data into record */
+  memcpy (packer->rawrec + packer->dataoffset, packer->encoded, datalength);
+
+  /* Finish header, updating start time if not first record of the run */
+  if (lm_pack_finish_record (packer, packer->rawrec, numsamples, datalength,
+                             (packer->recordcount > 0) ? packer->nextstarttime : NSTUNSET,
+                             &reclen))
+    return -1;
+
+  if (stream->verbose >= 1)
+    ms_log (0, "%s: Packed %u samples into %u byte record\n", stream->msr.sid, numsamples,
+            reclen);
+
+  stream->record_handler (packer->rawrec, (int)reclen, stream->handlerdata);
+
+  packer->packed_samples += numsamples;
+  packer->recordcount++;
+  packer->nextstarttime =
+      ms_sampletime (stream->msr.starttime, packer->packed_samples, stream->msr.samprate);
+
+  stream->packedsamples += numsamples;
+
+  /* Start next record with any samples carried over */
+  lm_streampack_startrecord (stream);
+
+  for (idx = 0; idx < carrycount; idx++)
+  {
+    if (lm_steim_add (&stream->steim, carry[idx], stream->msr.sid))
+      return -1;
+
+    stream->count++;
+  }
+
+  return 1;
+} /* End of lm_streampack_emit() */
+
+/***************************************************************************
+ * Complete all records of the current run of a stream packer.
+ *
+ * Returns the number of records produced on success and -1 on error.
+ ***************************************************************************/
+static int64_t
+lm_streampack_endrun (MS3StreamPacker *stream)
+{
+  int64_t recordcount = 0;
+  int rv;
+
+  while (stream->count > 0)
+  {
+    if ((rv = lm_streampack_emit (stream)) < 0)
+      return -1;
+
+    recordcount += rv;
+  }
+
+  stream->active = 0;
+
+  return recordcount;
+} /* End of lm_streampack_endrun() */
+
+/** ************************************************************************
+ * @brief Initialize a streaming packer for a single stream of integer samples
+ *
+ * A streaming packer produces records for a continuous stream of
+ * samples that arrive in blocks, such as from a digitizer or telemetry
+ * feed.  Blocks are added with msr3_streampack_append() and each record
+ * is passed to @p record_handler() as soon as it is full.  Steim frames
+ * are built as samples arrive, so each sample is encoded once
+ * regardless of the block sizes, and the records are identical to those
+ * created by msr3_pack() with ::MSF_FLUSHDATA for the same samples.
+ *
+ * The stream parameters are copied from the @p msr template: SID,
+ * sample rate, record length, encoding, publication version, flags,
+ * format version and extra headers.  The start time, sample type and
+ * any samples of the template are ignored.  Supported encodings are
+ * ::DE_INT16, ::DE_INT32, ::DE_STEIM1 and ::DE_STEIM2, the defaults
+ * for @ref MS3Record.reclen and @ref MS3Record.encoding of -1 are the
+ * same as for msr3_pack().
+ *
+ * The @p record_handler() is called as described for msr3_pack().
+ *
+ * @param[in] msr ::MS3Record template for the stream
+ * @param[in] record_handler() Callback function called for each record
+ * @param[in] handlerdata A pointer that will be provided to the @p record_handler()
+ * @param[in] flags Bit flags used to control the packing process:
+ * @parblock
+ *  - @c ::MSF_PACKVER2 : Pack miniSEED version 2 regardless of ::MS3Record.formatversion
+ * @endparblock
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ *
+ * @returns an allocated ::MS3StreamPacker on success and NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see msr3_streampack_append()
+ * @see msr3_streampack_flush()
+ * @see msr3_streampack_free()
+ ***************************************************************************/
+MS3StreamPacker *
+msr3_streampack_init (const MS3Record *msr, void (*record_handler) (char *, int, void *),
+                      void *handlerdata, uint32_t flags, int8_t verbose)
+{
+  MS3StreamPacker *stream = NULL;
+
+  if (!msr || !record_handler)
+  {
+    ms_log (2, "%s(): Required input not defined: 'msr' or 'record_handler'\n", __func__);
+    return NULL;
+  }
+
+  stream = (MS3StreamPacker *)libmseed_memory.malloc (sizeof (MS3StreamPacker));
+  if (!stream)
+  {
+    ms_log (2, "Cannot allocate memory for stream packer context\n");
+    return NULL;
+  }
+
+  memset (stream, 0, sizeof (MS3StreamPacker));
+
+  stream->msr = *msr;
+  stream->msr.record = NULL;
+  stream->msr.extra = NULL;
+  stream->msr.extralength = 0;
+  stream->msr.datasamples = NULL;
+  stream->msr.datasize = 0;
+  stream->msr.numsamples = 1;
+  stream->msr.sampletype = 'i';
+  stream->record_handler = record_handler;
+  stream->handlerdata = handlerdata;
+  stream->flags = flags;
+  stream->verbose = verbose;
+
+  if (msr->extralength > 0 && msr->extra)
+  {
+    stream->msr.extra = (char *)libmseed_memory.malloc (msr->extralength + 1);
+    if (!stream->msr.extra)
+    {
+      ms_log (2, "%s: Cannot allocate memory for extra headers\n", msr->sid);
+      msr3_streampack_free (&stream, NULL);
+      return NULL;
+    }
+
+    memcpy (stream->msr.extra, msr->extra, msr->extralength);
+    stream->msr.extra[msr->extralength] = '\0';
+    stream->msr.extralength = msr->extralength;
+  }
+
+  /* Validate the stream parameters with a header template for an arbitrary time */
+  if (lm_pack_state_init (&stream->packer, &stream->msr, flags, verbose))
+  {
+    msr3_streampack_free (&stream, NULL);
+    return NULL;
+  }
+
+  if (stream->packer.encoding != DE_INT16 && stream->packer.encoding != DE_INT32 &&
+      stream->packer.encoding != DE_STEIM1 && stream->packer.encoding != DE_STEIM2)
+  {
+    ms_log (2, "%s: Encoding %d is not supported for stream packing\n", msr->sid,
+            stream->packer.encoding);
+    msr3_streampack_free (&stream, NULL);
+    return NULL;
+  }
+
+  if (stream->packer.maxsamples == 0)
+  {
+    ms_log (2, "%s: Record length (%u) is not large enough for any samples\n", msr->sid,
+            stream->packer.maxreclen);
+    msr3_streampack_free (&stream, NULL);
+    return NULL;
+  }
+
+  return stream;
+} /* End of msr3_streampack_init() */
+
+/** ************************************************************************
+ * @brief Add a block of samples to a streaming packer
+ *
+ * Add @p count samples starting at @p starttime to the stream, passing
+ * each record to the record handler as soon as it is full.  Samples
+ * that do not complete a record are retained until more samples are
+ * added or msr3_streampack_flush() is called.
+ *
+ * When @p starttime is ::NSTUNSET the samples continue the stream.
+ * Otherwise, if the start time differs from the expected time of the
+ * next sample by more than half a sample period, the retained samples
+ * are flushed and a new run of records is started at @p starttime.  A
+ * start time is required for the first block and after a flush.
+ *
+ * @param[in] stream ::MS3StreamPacker context
+ * @param[in] samples Array of 32-bit integer samples
+ * @param[in] count Number of samples in @p samples
+ * @param[in] starttime Time of the first sample or ::NSTUNSET
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+msr3_streampack_append (MS3StreamPacker *stream, const int32_t *samples, uint64_t count,
+                        nstime_t starttime)
+{
+  MS3RecordPacker *packer;
+  int64_t recordcount = 0;
+  int64_t rv;
+  uint64_t idx = 0;
+  uint64_t chunk;
+
+  if (!stream || (!samples && count > 0))
+  {
+    ms_log (2, "%s(): Required input not defined: 'stream' or 'samples'\n", __func__);
+    return -1;
+  }
+
+  packer = &stream->packer;
+
+  if (count == 0)
+    return 0;
+
+  /* End the current run if the samples are not contiguous with it */
+  if (stream->active && starttime != NSTUNSET)
+  {
+    nstime_t expected = ms_sampletime (
+        stream->msr.starttime, packer->packed_samples + stream->count, stream->msr.samprate);
+    nstime_t halfperiod = (ms_sampletime (expected, 1, stream->msr.samprate) - expected) / 2;
+    nstime_t delta = (starttime > expected) ? starttime - expected : expected - starttime;
+
+    if (delta > halfperiod)
+    {
+      if ((rv = lm_streampack_endrun (stream)) < 0)
+        return -1;
+
+      recordcount += rv;
+    }
+  }
+
+  if (!stream->active)
+  {
+    if (starttime == NSTUNSET || starttime == NSTERROR)
+    {
+      ms_log (2, "%s: Start time required to start a stream\n", stream->msr.sid);
+      return -1;
+    }
+
+    if (lm_streampack_startrun (stream, starttime))
+      return -1;
+  }
+
+  if (packer->encoding == DE_STEIM1 || packer->encoding == DE_STEIM2)
+  {
+    for (idx = 0; idx < count; idx++)
+    {
+      if (lm_steim_add (&stream->steim, samples[idx], stream->msr.sid))
+        return -1;
+
+      stream->count++;
+
+      if (stream->steim.full)
+      {
+        if ((rv = lm_streampack_emit (stream)) < 0)
+          return -1;
+
+        recordcount += rv;
+      }
+    }
+  }
+  else
+  {
+    while (idx < count)
+    {
+      chunk = stream->maxsamples - stream->count;
+      if (chunk > count - idx)
+        chunk = count - idx;
+
+      if (packer->encoding == DE_INT16)
+        msr_encode_int16 ((int32_t *)samples + idx, chunk,
+                          (int16_t *)packer->encoded + stream->count, chunk * sizeof (int16_t),
+                          packer->swapflag);
+      else
+        msr_encode_int32 ((int32_t *)samples + idx, chunk,
+                          (int32_t *)packer->encoded + stream->count, chunk * sizeof (int32_t),
+                          packer->swapflag);
+
+      stream->count += (uint32_t)chunk;
+      idx += chunk;
+
+      if (stream->count == stream->maxsamples)
+      {
+        if ((rv = lm_streampack_emit (stream)) < 0)
+          return -1;
+
+        recordcount += rv;
+      }
+    }
+  }
+
+  return recordcount;
+} /* End of msr3_streampack_append() */
+
+/** ************************************************************************
+ * @brief Flush the samples retained by a streaming packer
+ *
+ * Pack all samples retained by the stream packer into records, the last
+ * of which will probably be smaller than requested or, in the case of
+ * miniSEED 2, unfilled.  The next block added must include a start time.
+ *
+ * @param[in] stream ::MS3StreamPacker context
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+msr3_streampack_flush (MS3StreamPacker *stream)
+{
+  if (!stream)
+  {
+    ms_log (2, "%s(): Required input not defined: 'stream'\n", __func__);
+    return -1;
+  }
+
+  return lm_streampack_endrun (stream);
+} /* End of msr3_streampack_flush() */
+
+/** ************************************************************************
+ * @brief Free a streaming packer and resources
+ *
+ * Free all memory associated with the ::MS3StreamPacker and set the
+ * pointer to NULL.  Samples not packed into records are discarded, call
+ * msr3_streampack_flush() first to pack them.
+ *
+ * @param[in] stream Pointer to ::MS3StreamPacker pointer
+ * @param[out] packedsamples Total number of samples packed, returned to caller
+ ***************************************************************************/
+void
+msr3_streampack_free (MS3StreamPacker **stream, int64_t *packedsamples)
+{
+  if (!stream || !*stream)
+    return;
+
+  if (packedsamples)
+    *packedsamples = (*stream)->packedsamples;
+
+  lm_pack_state_free (&(*stream)->packer);
+
+  if ((*stream)->msr.extra)
+    libmseed_memory.free ((*stream)->msr.extra);
+
+  libmseed_memory.free (*stream);
+  *stream = NULL;
+} /* End of msr3_streampack_free() */
+
+/** ************************************************************************
+ * @brief Cut a parsed miniSEED record to a time window
+ *
+ * Deliver the part of the record at ::MS3Record.record that lies within
+ * @p starttime and @p endtime, inclusive, to @p record_handler.  A
+ * record entirely within the window is passed to the handler
+ * unchanged, without decoding.  Only a record crossing a window
+ * boundary is decoded with msr3_unpack_data(), trimmed to the samples
+ * in the window and packed again with msr3_pack(), using the encoding,
+ * record length and format version of the original.  Samples of
+ * decode-only encodings (e.g. CDSN, SRO, GEOSCOPE) are packed as
+ * ::DE_INT32, ::DE_FLOAT32 or ::DE_FLOAT64 according to their decoded
+ * sample type.  Already unpacked samples of @p msr are used if available.
+ *
+ * A record without samples or sample rate, which cannot be trimmed, is
+ * passed unchanged if it intersects the window.  Either bound may be
+ * ::NSTUNSET for an open window.
+ *
+ * @param[in] msr ::MS3Record of the record to cut
+ * @param[in] starttime Start of the time window, ::NSTUNSET for open
+ * @param[in] endtime End of the time window, ::NSTUNSET for open
+ * @param[in] record_handler Callback function to receive records
+ * @param[in] handlerdata Pointer passed to @p record_handler
+ * @param[in] flags Flags as for msr3_pack(), ::MSF_FLUSHDATA is implied
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ *
+ * @returns the number of records delivered, 0 if the record is outside
+ * of the window, and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ***************************************************************************/
+int64_t
+msr3_cut (const MS3Record *msr, nstime_t starttime, nstime_t endtime,
+          void (*record_handler) (char *, int, void *), void *handlerdata, uint32_t flags,
+          int8_t verbose)
+{
+  MS3Record *unpacked = NULL;
+  MS3Record piece;
+  nstime_t recendtime;
+  double sampratehz;
+  int64_t first;
+  int64_t last;
+  int64_t records;
+  uint8_t samplesize;
+
+  if (!msr || !record_handler)
+  {
+    ms_log (2, "%s(): Required input not defined: 'msr' or 'record_handler'\n", __func__);
+    return -1;
+  }
+
+  if (!msr->record || msr->reclen <= 0)
+  {
+    ms_log (2, "%s(): Record of %s is not available\n", __func__, msr->sid);
+    return -1;
+  }
+
+  if (starttime == NSTERROR)
+    starttime = NSTUNSET;
+  if (endtime == NSTERROR)
+    endtime = NSTUNSET;
+
+  recendtime = msr3_endtime (msr);
+
+  if ((starttime != NSTUNSET && recendtime < starttime) ||
+      (endtime != NSTUNSET && msr->starttime > endtime))
+    return 0;
+
+  /* Pass through records within the window or that cannot be trimmed */
+  if ((starttime == NSTUNSET || msr->starttime >= starttime) &&
+      (endtime == NSTUNSET || recendtime <= endtime))
+  {
+    record_handler ((char *)msr->record, msr->reclen, handlerdata);
+    return 1;
+  }
+
+  /* Rates below 1 Hz may be stored as a negative sample period */
+  sampratehz = msr3_sampratehz (msr);
+
+  if (msr->samplecnt <= 0 || sampratehz <= 0.0)
+  {
+    record_handler ((char *)msr->record, msr->reclen, handlerdata);
+    return 1;
+  }
+
+  /* Decode the samples unless already available */
+  if (!msr->datasamples || msr->numsamples != msr->samplecnt)
+  {
+    if ((unpacked = msr3_duplicate (msr, 0)) == NULL)
+      return -1;
+
+    if (msr3_unpack_data (unpacked, verbose) != msr->samplecnt)
+    {
+      ms_log (2, "%s: Cannot unpack data samples to cut record\n", msr->sid);
+      msr3_free (&unpacked);
+      return -1;
+    }
+
+    piece = *unpacked;
+  }
+  else
+  {
+    piece = *msr;
+  }
+
+  samplesize = ms_samplesize (piece.sampletype);
+
+  /* First sample at or after the start, last sample at or before the end */
+  first = 0;
+  if (starttime != NSTUNSET && starttime > msr->starttime)
+  {
+    first = (int64_t)((double)(starttime - msr->starttime) / NSTMODULUS * sampratehz);
+    while (first > 0 && ms_sampletime (msr->starttime, first - 1, sampratehz) >= starttime)
+      first--;
+    while (first < msr->samplecnt &&
+           ms_sampletime (msr->starttime, first, sampratehz) < starttime)
+      first++;
+  }
+
+  last = msr->samplecnt - 1;
+  if (endtime != NSTUNSET && endtime < recendtime)
+  {
+    last = (int64_t)((double)(endtime - msr->starttime) / NSTMODULUS * sampratehz);
+    if (last > msr->samplecnt - 1)
+      last = msr->samplecnt - 1;
+    while (last + 1 < msr->samplecnt &&
+           ms_sampletime (msr->starttime, last + 1, sampratehz) <= endtime)
+      last++;
+    while (last >= 0 && ms_sampletime (msr->starttime, last, sampratehz) > endtime)
+      last--;
+  }
+
+  /* No samples within the window, between two samples */
+  if (first > last)
+  {
+    msr3_free (&unpacked);
+    return 0;
+  }
+
+  piece.starttime = ms_sampletime (msr->starttime, first, sampratehz);
+  piece.datasamples = (char *)piece.datasamples + (size_t)first * samplesize;
+  piece.numsamples = last - first + 1;
+  piece.samplecnt = piece.numsamples;
+  piece.datasize = (uint64_t)piece.numsamples * samplesize;
+
+  /* Decode-only encodings are packed with a generic encoding for the sample type */
+  switch (piece.encoding)
+  {
+  case DE_TEXT:
+  case DE_INT16:
+  case DE_INT32:
+  case DE_FLOAT32:
+  case DE_FLOAT64:
+  case DE_STEIM1:
+  case DE_STEIM2:
+    break;
+  default:
+    if (piece.sampletype == 'i')
+      piece.encoding = DE_INT32;
+    else if (piece.sampletype == 'f')
+      piece.encoding = DE_FLOAT32;
+    else if (piece.sampletype == 'd')
+      piece.encoding = DE_FLOAT64;
+    else
+      piece.encoding = DE_TEXT;
+
+    if (verbose > 1)
+      ms_log (0, "%s: Packing cut record from encoding %d with encoding %d\n", msr->sid,
+              msr->encoding, piece.encoding);
+  }
+
+  if (msr->formatversion == 2)
+    flags |= MSF_PACKVER2;
+
+  records = msr3_pack (&piece, record_handler, handlerdata, NULL, flags | MSF_FLUSHDATA, verbose);
+
+  msr3_free (&unpacked);
+
+  return (records < 0) ? -1 : records;
+} /* End of msr3_cut() */
+
 /** ************************************************************************
  * @brief Repack a parsed miniSEED record into a version 3 record.
  *
@@ -1142,10 +2243,8 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
   uint32_t reclen;
   uint8_t encoding;
 
-  char network[64];
-  char station[64];
-  char location[64];
-  char channel[64];
+  /* Codes of the last identifier packed by this thread */
+  static lm_thread_local MS3SourceID sourceid;
 
   uint16_t year;
   uint16_t day;
@@ -1226,19 +2325,18 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
   }
 
   /* Parse identifier codes from full identifier */
-  if (ms_sid2nslc_n (msr->sid, network, sizeof (network), station, sizeof (station), location,
-                     sizeof (location), channel, sizeof (channel)))
+  if (ms_sid2sourceid (msr->sid, &sourceid))
   {
     ms_log (2, "%s: Cannot parse SEED identifier codes from full identifier\n", msr->sid);
     return -1;
   }
 
   /* Verify that identifier codes will fit into and are appropriate for miniSEED 2 */
-  if (strlen (network) > 2 || strlen (station) > 5 || strlen (location) > 2 ||
-      strlen (channel) != 3)
+  if (strlen (sourceid.net) > 2 || strlen (sourceid.sta) > 5 || strlen (sourceid.loc) > 2 ||
+      strlen (sourceid.chan) != 3)
   {
     ms_log (2, "%s: Cannot create miniSEED 2 for N,S,L,C codes: %s, %s, %s, %s\n", msr->sid,
-            network, station, location, channel);
+            sourceid.net, sourceid.sta, sourceid.loc, sourceid.chan);
     return -1;
   }
 
@@ -1333,10 +2431,10 @@ msr3_pack_header2_offsets (const MS3Record *msr, char *record, uint32_t recbufle
   }
 
   *pMS2FSDH_RESERVED (record) = ' ';
-  ms_strncpopen (pMS2FSDH_STATION (record), station, 5);
-  ms_strncpopen (pMS2FSDH_LOCATION (record), location, 2);
-  ms_strncpopen (pMS2FSDH_CHANNEL (record), channel, 3);
-  ms_strncpopen (pMS2FSDH_NETWORK (record), network, 2);
+  ms_strncpopen (pMS2FSDH_STATION (record), sourceid.sta, 5);
+  ms_strncpopen (pMS2FSDH_LOCATION (record), sourceid.loc, 2);
+  ms_strncpopen (pMS2FSDH_CHANNEL (record), sourceid.chan, 3);
+  ms_strncpopen (pMS2FSDH_NETWORK (record), sourceid.net, 2);
 
   *pMS2FSDH_YEAR (record) = HO2u (year, swapflag);
   *pMS2FSDH_DAY (record) = HO2u (day, swapflag);
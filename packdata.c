@@ -25,6 +25,7 @@
 
 #include "libmseed.h"
 #include "packdata.h"
+#include "simdutils.h"
 
 /************************************************************************
  * msr_encode_text:
@@ -64,25 +65,18 @@ int64_t
 msr_encode_int16 (int32_t *input, uint64_t samplecount, int16_t *output, uint64_t outputlength,
                   int swapflag)
 {
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int16_t); idx++)
-  {
-    output[idx] = (int16_t)input[idx];
+  if (samplecount > outputlength / sizeof (int16_t))
+    samplecount = outputlength / sizeof (int16_t);
 
-    if (swapflag)
-      ms_gswap2 (&output[idx]);
-
-    outputlength -= sizeof (int16_t);
-  }
+  lm_int32_to_int16 (output, input, samplecount, swapflag);
 
-  return idx;
+  return samplecount;
 } /* End of msr_encode_int16() */
 
 /************************************************************************
@@ -97,25 +91,21 @@ int64_t
 msr_encode_int32 (int32_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                   int swapflag)
 {
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
-  {
-    output[idx] = input[idx];
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
 
-    if (swapflag)
-      ms_gswap4 (&output[idx]);
-
-    outputlength -= sizeof (int32_t);
-  }
+  if (swapflag)
+    lm_bswap4_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (int32_t));
 
-  return idx;
+  return samplecount;
 } /* End of msr_encode_int32() */
 
 /************************************************************************
@@ -130,25 +120,21 @@ int64_t
 msr_encode_float32 (float *input, uint64_t samplecount, float *output, uint64_t outputlength,
                     int swapflag)
 {
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (float); idx++)
-  {
-    output[idx] = input[idx];
+  if (samplecount > outputlength / sizeof (float))
+    samplecount = outputlength / sizeof (float);
 
-    if (swapflag)
-      ms_gswap4 (&output[idx]);
-
-    outputlength -= sizeof (float);
-  }
+  if (swapflag)
+    lm_bswap4_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (float));
 
-  return idx;
+  return samplecount;
 } /* End of msr_encode_float32() */
 
 /************************************************************************
@@ -163,48 +149,320 @@ int64_t
 msr_encode_float64 (double *input, uint64_t samplecount, double *output, uint64_t outputlength,
                     int swapflag)
 {
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (double); idx++)
+  if (samplecount > outputlength / sizeof (double))
+    samplecount = outputlength / sizeof (double);
+
+  if (swapflag)
+    lm_bswap8_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (double));
+
+  return samplecount;
+} /* End of msr_encode_float64() */
+
+/* Number of differences computed at a time by the Steim encoders */
+#define STEIM_DIFFBLOCK 256
+
+/* Maximum number of differences packed in a Steim2 word for each
+ * difference bit width class (LM_STEIM_*), 0 if not representable */
+static const int steim2_perword[9] = {7, 6, 5, 4, 3, 2, 1, 1, 0};
+
+/* Maximum number of differences packed in a Steim1 word for each
+ * difference bit width class (LM_STEIM_*) */
+static const int steim1_perword[9] = {4, 4, 4, 4, 2, 2, 2, 1, 1};
+
+/************************************************************************
+ * steim1_word:
+ *
+ * Pack the most differences (up to 4) that fit in a Steim1 word at
+ * frameptr[widx] and set the word's 2-bit nibble in frameptr[0].
+ * Swap if requested.
+ *
+ * Return the number of differences packed.
+ ************************************************************************/
+static inline int
+steim1_word (uint32_t *frameptr, int widx, const int32_t *diffs, const uint8_t *classes,
+             int diffcount, int swapflag)
+{
+  int packedsamples;
+  int limit;
+
+  union dword
+  {
+    int8_t d8[4];
+    int16_t d16[2];
+    int32_t d32;
+  } *word;
+
+  /* Determine optimal packing, the most differences (up to 4) for which
+   * every difference fits in the bit width used for that many:
+   * 4 x 8-bit differences
+   * 2 x 16-bit differences
+   * 1 x 32-bit difference */
+  packedsamples = 0;
+  for (limit = 4; packedsamples < diffcount && packedsamples < limit; packedsamples++)
+  {
+    if (steim1_perword[classes[packedsamples]] < limit)
+      limit = steim1_perword[classes[packedsamples]];
+
+    if (limit <= packedsamples)
+      break;
+  }
+
+  word = (union dword *)&frameptr[widx];
+
+  /* 4 x 8-bit differences */
+  if (packedsamples == 4)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 01=4x8b  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
+            diffs[3]);
+#endif
+
+    word->d8[0] = diffs[0];
+    word->d8[1] = diffs[1];
+    word->d8[2] = diffs[2];
+    word->d8[3] = diffs[3];
+
+    /* 2-bit nibble is 0b01 (0x1) */
+    frameptr[0] |= 0x1ul << (30 - 2 * widx);
+  }
+  /* 2 x 16-bit differences, also when 3 would fit */
+  else if (packedsamples >= 2)
   {
-    output[idx] = input[idx];
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 2=2x16b  %d  %d\n", widx, diffs[0], diffs[1]);
+#endif
+
+    word->d16[0] = diffs[0];
+    word->d16[1] = diffs[1];
 
     if (swapflag)
-      ms_gswap8 (&output[idx]);
+    {
+      ms_gswap2 (&word->d16[0]);
+      ms_gswap2 (&word->d16[1]);
+    }
 
-    outputlength -= sizeof (double);
+    /* 2-bit nibble is 0b10 (0x2) */
+    frameptr[0] |= 0x2ul << (30 - 2 * widx);
+
+    packedsamples = 2;
   }
+  /* 1 x 32-bit difference */
+  else
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 3=1x32b  %d\n", widx, diffs[0]);
+#endif
 
-  return idx;
-} /* End of msr_encode_float64() */
+    frameptr[widx] = diffs[0];
+
+    if (swapflag)
+      ms_gswap4 (&frameptr[widx]);
+
+    /* 2-bit nibble is 0b11 (0x3) */
+    frameptr[0] |= 0x3ul << (30 - 2 * widx);
+
+    packedsamples = 1;
+  }
+
+  return packedsamples;
+} /* End of steim1_word() */
+
+/************************************************************************
+ * steim2_word:
+ *
+ * Pack the most differences (up to 7) that fit in a Steim2 word at
+ * frameptr[widx] and set the word's 2-bit nibble in frameptr[0].
+ * Swap if requested.
+ *
+ * Return the number of differences packed, 0 if the first difference
+ * cannot be represented in 30 bits.
+ ************************************************************************/
+static inline int
+steim2_word (uint32_t *frameptr, int widx, const int32_t *diffs, const uint8_t *classes,
+             int diffcount, int swapflag)
+{
+  int packedsamples;
+  int limit;
+
+  union dword
+  {
+    int8_t d8[4];
+    int16_t d16[2];
+    int32_t d32;
+  } *word;
+
+  /* Determine optimal packing, the most differences (up to 7) for which
+   * every difference fits in the bit width used for that many:
+   * 7 x 4-bit differences
+   * 6 x 5-bit differences
+   * 5 x 6-bit differences
+   * 4 x 8-bit differences
+   * 3 x 10-bit differences
+   * 2 x 15-bit differences
+   * 1 x 30-bit difference */
+  packedsamples = 0;
+  for (limit = 7; packedsamples < diffcount && packedsamples < limit; packedsamples++)
+  {
+    if (steim2_perword[classes[packedsamples]] < limit)
+      limit = steim2_perword[classes[packedsamples]];
 
-/* Macro to determine number of bits needed to represent VALUE in
- * the following bit widths: 4,5,6,8,10,15,16,30,32 and set RESULT. */
-#define BITWIDTH(VALUE, RESULT)                       \
-  if (VALUE >= -8 && VALUE <= 7)                      \
-    RESULT = 4;                                       \
-  else if (VALUE >= -16 && VALUE <= 15)               \
-    RESULT = 5;                                       \
-  else if (VALUE >= -32 && VALUE <= 31)               \
-    RESULT = 6;                                       \
-  else if (VALUE >= -128 && VALUE <= 127)             \
-    RESULT = 8;                                       \
-  else if (VALUE >= -512 && VALUE <= 511)             \
-    RESULT = 10;                                      \
-  else if (VALUE >= -16384 && VALUE <= 16383)         \
-    RESULT = 15;                                      \
-  else if (VALUE >= -32768 && VALUE <= 32767)         \
-    RESULT = 16;                                      \
-  else if (VALUE >= -536870912 && VALUE <= 536870911) \
-    RESULT = 30;                                      \
-  else                                                \
-    RESULT = 32;
+    if (limit <= packedsamples)
+      break;
+  }
+
+  /* 7 x 4-bit differences */
+  if (packedsamples == 7)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 11,10=7x4b  %d  %d  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1],
+            diffs[2], diffs[3], diffs[4], diffs[5], diffs[6]);
+#endif
+
+    /* Mask the values, shift to proper location and set in word */
+    frameptr[widx] = ((uint32_t)diffs[6] & 0xFul);
+    frameptr[widx] |= ((uint32_t)diffs[5] & 0xFul) << 4;
+    frameptr[widx] |= ((uint32_t)diffs[4] & 0xFul) << 8;
+    frameptr[widx] |= ((uint32_t)diffs[3] & 0xFul) << 12;
+    frameptr[widx] |= ((uint32_t)diffs[2] & 0xFul) << 16;
+    frameptr[widx] |= ((uint32_t)diffs[1] & 0xFul) << 20;
+    frameptr[widx] |= ((uint32_t)diffs[0] & 0xFul) << 24;
+
+    /* 2-bit decode nibble is 0b10 (0x2) */
+    frameptr[widx] |= 0x2ul << 30;
+
+    /* 2-bit nibble is 0b11 (0x3) */
+    frameptr[0] |= 0x3ul << (30 - 2 * widx);
+  }
+  /* 6 x 5-bit differences */
+  else if (packedsamples == 6)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 11,01=6x5b  %d  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1],
+            diffs[2], diffs[3], diffs[4], diffs[5]);
+#endif
+
+    /* Mask the values, shift to proper location and set in word */
+    frameptr[widx] = ((uint32_t)diffs[5] & 0x1Ful);
+    frameptr[widx] |= ((uint32_t)diffs[4] & 0x1Ful) << 5;
+    frameptr[widx] |= ((uint32_t)diffs[3] & 0x1Ful) << 10;
+    frameptr[widx] |= ((uint32_t)diffs[2] & 0x1Ful) << 15;
+    frameptr[widx] |= ((uint32_t)diffs[1] & 0x1Ful) << 20;
+    frameptr[widx] |= ((uint32_t)diffs[0] & 0x1Ful) << 25;
+
+    /* 2-bit decode nibble is 0b01 (0x1) */
+    frameptr[widx] |= 0x1ul << 30;
+
+    /* 2-bit nibble is 0b11 (0x3) */
+    frameptr[0] |= 0x3ul << (30 - 2 * widx);
+  }
+  /* 5 x 6-bit differences */
+  else if (packedsamples == 5)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 11,00=5x6b  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
+            diffs[3], diffs[4]);
+#endif
+
+    /* Mask the values, shift to proper location and set in word */
+    frameptr[widx] = ((uint32_t)diffs[4] & 0x3Ful);
+    frameptr[widx] |= ((uint32_t)diffs[3] & 0x3Ful) << 6;
+    frameptr[widx] |= ((uint32_t)diffs[2] & 0x3Ful) << 12;
+    frameptr[widx] |= ((uint32_t)diffs[1] & 0x3Ful) << 18;
+    frameptr[widx] |= ((uint32_t)diffs[0] & 0x3Ful) << 24;
+
+    /* 2-bit decode nibble is 0b00, nothing to set */
+
+    /* 2-bit nibble is 0b11 (0x3) */
+    frameptr[0] |= 0x3ul << (30 - 2 * widx);
+  }
+  /* 4 x 8-bit differences */
+  else if (packedsamples == 4)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 01=4x8b  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
+            diffs[3]);
+#endif
+
+    word = (union dword *)&frameptr[widx];
+
+    word->d8[0] = diffs[0];
+    word->d8[1] = diffs[1];
+    word->d8[2] = diffs[2];
+    word->d8[3] = diffs[3];
+
+    /* 2-bit nibble is 0b01, only need to set 2nd bit */
+    frameptr[0] |= 0x1ul << (30 - 2 * widx);
+  }
+  /* 3 x 10-bit differences */
+  else if (packedsamples == 3)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 10,11=3x10b  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2]);
+#endif
+
+    /* Mask the values, shift to proper location and set in word */
+    frameptr[widx] = ((uint32_t)diffs[2] & 0x3FFul);
+    frameptr[widx] |= ((uint32_t)diffs[1] & 0x3FFul) << 10;
+    frameptr[widx] |= ((uint32_t)diffs[0] & 0x3FFul) << 20;
+
+    /* 2-bit decode nibble is 0b11 (0x3) */
+    frameptr[widx] |= 0x3ul << 30;
+
+    /* 2-bit nibble is 0b10 (0x2) */
+    frameptr[0] |= 0x2ul << (30 - 2 * widx);
+  }
+  /* 2 x 15-bit differences */
+  else if (packedsamples == 2)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 10,10=2x15b  %d  %d\n", widx, diffs[0], diffs[1]);
+#endif
+
+    /* Mask the values, shift to proper location and set in word */
+    frameptr[widx] = ((uint32_t)diffs[1] & 0x7FFFul);
+    frameptr[widx] |= ((uint32_t)diffs[0] & 0x7FFFul) << 15;
+
+    /* 2-bit decode nibble is 0b10 (0x2) */
+    frameptr[widx] |= 0x2ul << 30;
+
+    /* 2-bit nibble is 0b10 (0x2) */
+    frameptr[0] |= 0x2ul << (30 - 2 * widx);
+  }
+  /* 1 x 30-bit difference */
+  else if (packedsamples == 1)
+  {
+#if ENCODE_DEBUG
+    ms_log (0, "  W%02d: 10,01=1x30b  %d\n", widx, diffs[0]);
+#endif
+
+    /* Mask the value and set in word */
+    frameptr[widx] = ((uint32_t)diffs[0] & 0x3FFFFFFFul);
+
+    /* 2-bit decode nibble is 0b01 (0x1) */
+    frameptr[widx] |= 0x1ul << 30;
+
+    /* 2-bit nibble is 0b10 (0x2) */
+    frameptr[0] |= 0x2ul << (30 - 2 * widx);
+  }
+  else
+  {
+    return 0;
+  }
+
+  /* Swap encoded word except for 4x8-bit samples */
+  if (swapflag && packedsamples != 4)
+    ms_gswap4 (&frameptr[widx]);
+
+  return packedsamples;
+} /* End of steim2_word() */
 
 /************************************************************************
  * msr_encode_steim1:
@@ -226,24 +484,18 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 {
   int32_t *frameptr;   /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
-  int32_t diffs[4];
-  int32_t bitwidth[4];
+  int32_t diffbuffer[STEIM_DIFFBLOCK + 4];
+  uint8_t classbuffer[STEIM_DIFFBLOCK + 4];
   uint64_t inputidx = 0;
   uint64_t outputsamples = 0;
   uint64_t maxframes = outputlength / 64;
   uint64_t frameidx;
-  int diffcount = 0;
+  uint64_t blockcount;
+  int diffstart = 0;
+  int diffend = 0;
   int packedsamples = 0;
   int startnibble;
   int widx;
-  int idx;
-
-  union dword
-  {
-    int8_t d8[4];
-    int16_t d16[2];
-    int32_t d32;
-  } *word;
 
   if (samplecount == 0)
     return 0;
@@ -262,9 +514,9 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 #endif
 
   /* Add first difference to buffers */
-  diffs[0] = diff0;
-  BITWIDTH (diffs[0], bitwidth[0]);
-  diffcount = 1;
+  diffbuffer[0] = diff0;
+  classbuffer[0] = lm_steim_class (diff0);
+  diffend = 1;
 
   for (frameidx = 0; frameidx < maxframes && outputsamples < samplecount; frameidx++)
   {
@@ -300,92 +552,29 @@ msr_encode_steim1 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 
     for (widx = startnibble; widx < 16 && outputsamples < samplecount; widx++)
     {
-      if (diffcount < 4)
-      {
-        /* Shift diffs and related bit widths to beginning of buffers */
-        for (idx = 0; idx < diffcount; idx++)
-        {
-          diffs[idx] = diffs[packedsamples + idx];
-          bitwidth[idx] = bitwidth[packedsamples + idx];
-        }
-
-        /* Add new diffs and determine bit width needed to represent */
-        for (idx = diffcount; idx < 4 && inputidx < (samplecount - 1); idx++, inputidx++)
-        {
-          /* Difference in unsigned to avoid signed overflow UB */
-          diffs[idx] = (int32_t) ((uint32_t) *(input + inputidx + 1) - (uint32_t) *(input + inputidx));
-          BITWIDTH (diffs[idx], bitwidth[idx]);
-          diffcount++;
-        }
-      }
-
-      /* Determine optimal packing by checking, in-order:
-       * 4 x 8-bit differences
-       * 2 x 16-bit differences
-       * 1 x 32-bit difference */
-
-      word = (union dword *)&frameptr[widx];
-      packedsamples = 0;
-
-      /* 4 x 8-bit differences */
-      if (diffcount == 4 && bitwidth[0] <= 8 && bitwidth[1] <= 8 && bitwidth[2] <= 8 &&
-          bitwidth[3] <= 8)
+      /* Compute the next block of differences and bit width classes when
+       * fewer than a full word of differences remain */
+      if (diffend - diffstart < 4 && inputidx < (samplecount - 1))
       {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 01=4x8b  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
-                diffs[3]);
-#endif
-
-        word->d8[0] = diffs[0];
-        word->d8[1] = diffs[1];
-        word->d8[2] = diffs[2];
-        word->d8[3] = diffs[3];
-
-        /* 2-bit nibble is 0b01 (0x1) */
-        frameptr[0] |= 0x1ul << (30 - 2 * widx);
-
-        packedsamples = 4;
-      }
-      /* 2 x 16-bit differences */
-      else if (diffcount >= 2 && bitwidth[0] <= 16 && bitwidth[1] <= 16)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 2=2x16b  %d  %d\n", widx, diffs[0], diffs[1]);
-#endif
-
-        word->d16[0] = diffs[0];
-        word->d16[1] = diffs[1];
-
-        if (swapflag)
-        {
-          ms_gswap2 (&word->d16[0]);
-          ms_gswap2 (&word->d16[1]);
-        }
-
-        /* 2-bit nibble is 0b10 (0x2) */
-        frameptr[0] |= 0x2ul << (30 - 2 * widx);
-
-        packedsamples = 2;
+        /* Shift remaining diffs and classes to beginning of buffers */
+        diffend -= diffstart;
+        memmove (diffbuffer, diffbuffer + diffstart, diffend * sizeof (int32_t));
+        memmove (classbuffer, classbuffer + diffstart, diffend);
+        diffstart = 0;
+
+        blockcount = samplecount - 1 - inputidx;
+        if (blockcount > STEIM_DIFFBLOCK)
+          blockcount = STEIM_DIFFBLOCK;
+
+        lm_steim_diffs (diffbuffer + diffend, classbuffer + diffend, input + inputidx, blockcount);
+        diffend += (int)blockcount;
+        inputidx += blockcount;
       }
-      /* 1 x 32-bit difference */
-      else
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 3=1x32b  %d\n", widx, diffs[0]);
-#endif
-
-        frameptr[widx] = diffs[0];
-
-        if (swapflag)
-          ms_gswap4 (&frameptr[widx]);
 
-        /* 2-bit nibble is 0b11 (0x3) */
-        frameptr[0] |= 0x3ul << (30 - 2 * widx);
-
-        packedsamples = 1;
-      }
+      packedsamples = steim1_word ((uint32_t *)frameptr, widx, diffbuffer + diffstart,
+                                   classbuffer + diffstart, diffend - diffstart, swapflag);
 
-      diffcount -= packedsamples;
+      diffstart += packedsamples;
       outputsamples += packedsamples;
     } /* Done with words in frame */
 
@@ -428,24 +617,18 @@ msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 {
   uint32_t *frameptr;  /* Frame pointer in output */
   int32_t *Xnp = NULL; /* Reverse integration constant, aka last sample */
-  int32_t diffs[7];
-  int32_t bitwidth[7];
+  int32_t diffbuffer[STEIM_DIFFBLOCK + 7];
+  uint8_t classbuffer[STEIM_DIFFBLOCK + 7];
   uint64_t inputidx = 0;
   uint64_t outputsamples = 0;
   uint64_t maxframes = outputlength / 64;
   uint64_t frameidx;
-  int diffcount = 0;
+  uint64_t blockcount;
+  int diffstart = 0;
+  int diffend = 0;
   int packedsamples = 0;
   int startnibble;
   int widx;
-  int idx;
-
-  union dword
-  {
-    int8_t d8[4];
-    int16_t d16[2];
-    int32_t d32;
-  } *word;
 
   if (samplecount == 0)
     return 0;
@@ -464,9 +647,9 @@ msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 #endif
 
   /* Add first difference to buffers */
-  diffs[0] = diff0;
-  BITWIDTH (diffs[0], bitwidth[0]);
-  diffcount = 1;
+  diffbuffer[0] = diff0;
+  classbuffer[0] = lm_steim_class (diff0);
+  diffend = 1;
 
   for (frameidx = 0; frameidx < maxframes && outputsamples < samplecount; frameidx++)
   {
@@ -503,217 +686,330 @@ msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t *output, uint64
 
     for (widx = startnibble; widx < 16 && outputsamples < samplecount; widx++)
     {
-      if (diffcount < 7)
+      /* Compute the next block of differences and bit width classes when
+       * fewer than a full word of differences remain */
+      if (diffend - diffstart < 7 && inputidx < (samplecount - 1))
       {
-        /* Shift diffs and related bit widths to beginning of buffers */
-        for (idx = 0; idx < diffcount; idx++)
-        {
-          diffs[idx] = diffs[packedsamples + idx];
-          bitwidth[idx] = bitwidth[packedsamples + idx];
-        }
-
-        /* Add new diffs and determine bit width needed to represent */
-        for (idx = diffcount; idx < 7 && inputidx < (samplecount - 1); idx++, inputidx++)
-        {
-          /* Difference in unsigned to avoid signed overflow UB */
-          diffs[idx] = (int32_t) ((uint32_t) *(input + inputidx + 1) - (uint32_t) *(input + inputidx));
-          BITWIDTH (diffs[idx], bitwidth[idx]);
-          diffcount++;
-        }
+        /* Shift remaining diffs and classes to beginning of buffers */
+        diffend -= diffstart;
+        memmove (diffbuffer, diffbuffer + diffstart, diffend * sizeof (int32_t));
+        memmove (classbuffer, classbuffer + diffstart, diffend);
+        diffstart = 0;
+
+        blockcount = samplecount - 1 - inputidx;
+        if (blockcount > STEIM_DIFFBLOCK)
+          blockcount = STEIM_DIFFBLOCK;
+
+        lm_steim_diffs (diffbuffer + diffend, classbuffer + diffend, input + inputidx, blockcount);
+        diffend += (int)blockcount;
+        inputidx += blockcount;
       }
 
-      /* Determine optimal packing by checking, in-order:
-       * 7 x 4-bit differences
-       * 6 x 5-bit differences
-       * 5 x 6-bit differences
-       * 4 x 8-bit differences
-       * 3 x 10-bit differences
-       * 2 x 15-bit differences
-       * 1 x 30-bit difference */
-
-      packedsamples = 0;
+      packedsamples = steim2_word (frameptr, widx, diffbuffer + diffstart, classbuffer + diffstart,
+                                   diffend - diffstart, swapflag);
 
-      /* 7 x 4-bit differences */
-      if (diffcount == 7 && bitwidth[0] <= 4 && bitwidth[1] <= 4 && bitwidth[2] <= 4 &&
-          bitwidth[3] <= 4 && bitwidth[4] <= 4 && bitwidth[5] <= 4 && bitwidth[6] <= 4)
+      if (packedsamples == 0)
       {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 11,10=7x4b  %d  %d  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1],
-                diffs[2], diffs[3], diffs[4], diffs[5], diffs[6]);
-#endif
-
-        /* Mask the values, shift to proper location and set in word */
-        frameptr[widx] = ((uint32_t)diffs[6] & 0xFul);
-        frameptr[widx] |= ((uint32_t)diffs[5] & 0xFul) << 4;
-        frameptr[widx] |= ((uint32_t)diffs[4] & 0xFul) << 8;
-        frameptr[widx] |= ((uint32_t)diffs[3] & 0xFul) << 12;
-        frameptr[widx] |= ((uint32_t)diffs[2] & 0xFul) << 16;
-        frameptr[widx] |= ((uint32_t)diffs[1] & 0xFul) << 20;
-        frameptr[widx] |= ((uint32_t)diffs[0] & 0xFul) << 24;
+        ms_log (2, "%s: Unable to represent difference in <= 30 bits\n", sid);
+        return -1;
+      }
 
-        /* 2-bit decode nibble is 0b10 (0x2) */
-        frameptr[widx] |= 0x2ul << 30;
+      diffstart += packedsamples;
+      outputsamples += packedsamples;
+    } /* Done with words in frame */
 
-        /* 2-bit nibble is 0b11 (0x3) */
-        frameptr[0] |= 0x3ul << (30 - 2 * widx);
+    /* Swap word with nibbles */
+    if (swapflag)
+      ms_gswap4 (&frameptr[0]);
+  } /* Done with frames */
 
-        packedsamples = 7;
-      }
-      /* 6 x 5-bit differences */
-      else if (diffcount >= 6 && bitwidth[0] <= 5 && bitwidth[1] <= 5 && bitwidth[2] <= 5 &&
-               bitwidth[3] <= 5 && bitwidth[4] <= 5 && bitwidth[5] <= 5)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 11,01=6x5b  %d  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1],
-                diffs[2], diffs[3], diffs[4], diffs[5]);
-#endif
+  /* Set Xn (reverse integration constant) in first frame to last sample */
+  if (Xnp)
+  {
+    *Xnp = *(input + outputsamples - 1);
+    if (swapflag)
+      ms_gswap4 (Xnp);
+  }
 
-        /* Mask the values, shift to proper location and set in word */
-        frameptr[widx] = ((uint32_t)diffs[5] & 0x1Ful);
-        frameptr[widx] |= ((uint32_t)diffs[4] & 0x1Ful) << 5;
-        frameptr[widx] |= ((uint32_t)diffs[3] & 0x1Ful) << 10;
-        frameptr[widx] |= ((uint32_t)diffs[2] & 0x1Ful) << 15;
-        frameptr[widx] |= ((uint32_t)diffs[1] & 0x1Ful) << 20;
-        frameptr[widx] |= ((uint32_t)diffs[0] & 0x1Ful) << 25;
+  if (byteswritten)
+    *byteswritten = (uint32_t)(frameidx * 64);
 
-        /* 2-bit decode nibble is 0b01 (0x1) */
-        frameptr[widx] |= 0x1ul << 30;
+  return outputsamples;
+} /* End of msr_encode_steim2() */
 
-        /* 2-bit nibble is 0b11 (0x3) */
-        frameptr[0] |= 0x3ul << (30 - 2 * widx);
+/************************************************************************
+ * lm_steim_start:
+ *
+ * Start an incremental Steim1 or Steim2 encoding into the frames of
+ * output, limited to maxsamples samples when not 0.  Swap if requested.
+ ************************************************************************/
+void
+lm_steim_start (LMSteimEncoder *encoder, int32_t *output, uint64_t outputlength,
+                uint64_t maxsamples, int8_t encoding, int swapflag)
+{
+  encoder->output = (uint32_t *)output;
+  encoder->maxframes = (uint32_t)(outputlength / 64);
+  encoder->frameidx = 0;
+  encoder->widx = 3; /* First frame: skip nibbles, X0, and Xn */
+  encoder->encoding = encoding;
+  encoder->swapflag = (int8_t)swapflag;
+  encoder->full = (encoder->maxframes == 0);
+  encoder->maxsamples = maxsamples;
+  encoder->samplecount = 0;
+  encoder->lastsample = 0;
+  encoder->pending = 0;
+
+  if (encoder->maxframes > 0)
+    memset (encoder->output, 0, 64);
+} /* End of lm_steim_start() */
 
-        packedsamples = 6;
-      }
-      /* 5 x 6-bit differences */
-      else if (diffcount >= 5 && bitwidth[0] <= 6 && bitwidth[1] <= 6 && bitwidth[2] <= 6 &&
-               bitwidth[3] <= 6 && bitwidth[4] <= 6)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 11,00=5x6b  %d  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
-                diffs[3], diffs[4]);
-#endif
+/************************************************************************
+ * steim_pack_pending:
+ *
+ * Pack the next word of an incremental encoding from the pending
+ * differences, closing the frame when its last word is used.
+ *
+ * Return number of samples packed on success, -1 on failure.
+ ************************************************************************/
+static int
+steim_pack_pending (LMSteimEncoder *encoder, const char *sid)
+{
+  uint32_t *frameptr = encoder->output + (16 * encoder->frameidx);
+  int packedsamples;
 
-        /* Mask the values, shift to proper location and set in word */
-        frameptr[widx] = ((uint32_t)diffs[4] & 0x3Ful);
-        frameptr[widx] |= ((uint32_t)diffs[3] & 0x3Ful) << 6;
-        frameptr[widx] |= ((uint32_t)diffs[2] & 0x3Ful) << 12;
-        frameptr[widx] |= ((uint32_t)diffs[1] & 0x3Ful) << 18;
-        frameptr[widx] |= ((uint32_t)diffs[0] & 0x3Ful) << 24;
+  if (encoder->encoding == DE_STEIM1)
+    packedsamples = steim1_word (frameptr, encoder->widx, encoder->diffs, encoder->classes,
+                                 encoder->pending, encoder->swapflag);
+  else
+    packedsamples = steim2_word (frameptr, encoder->widx, encoder->diffs, encoder->classes,
+                                 encoder->pending, encoder->swapflag);
 
-        /* 2-bit decode nibble is 0b00, nothing to set */
+  if (packedsamples == 0)
+  {
+    ms_log (2, "%s: Unable to represent difference in <= 30 bits\n", sid);
+    return -1;
+  }
 
-        /* 2-bit nibble is 0b11 (0x3) */
-        frameptr[0] |= 0x3ul << (30 - 2 * widx);
+  encoder->samplecount += packedsamples;
+  encoder->lastsample = encoder->values[packedsamples - 1];
+  encoder->pending -= packedsamples;
 
-        packedsamples = 5;
-      }
-      /* 4 x 8-bit differences */
-      else if (diffcount >= 4 && bitwidth[0] <= 8 && bitwidth[1] <= 8 && bitwidth[2] <= 8 &&
-               bitwidth[3] <= 8)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 01=4x8b  %d  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2],
-                diffs[3]);
-#endif
+  if (encoder->pending > 0)
+  {
+    memmove (encoder->values, encoder->values + packedsamples, encoder->pending * sizeof (int32_t));
+    memmove (encoder->diffs, encoder->diffs + packedsamples, encoder->pending * sizeof (int32_t));
+    memmove (encoder->classes, encoder->classes + packedsamples, encoder->pending);
+  }
 
-        word = (union dword *)&frameptr[widx];
+  /* Swap word with nibbles and start the next frame when all words are used */
+  if (++encoder->widx == 16)
+  {
+    if (encoder->swapflag)
+      ms_gswap4 (&frameptr[0]);
 
-        word->d8[0] = diffs[0];
-        word->d8[1] = diffs[1];
-        word->d8[2] = diffs[2];
-        word->d8[3] = diffs[3];
+    encoder->widx = 1; /* Subsequent frames: skip nibbles */
 
-        /* 2-bit nibble is 0b01, only need to set 2nd bit */
-        frameptr[0] |= 0x1ul << (30 - 2 * widx);
+    if (++encoder->frameidx >= encoder->maxframes)
+      encoder->full = 1;
+    else
+      memset (frameptr + 16, 0, 64);
+  }
 
-        packedsamples = 4;
-      }
-      /* 3 x 10-bit differences */
-      else if (diffcount >= 3 && bitwidth[0] <= 10 && bitwidth[1] <= 10 && bitwidth[2] <= 10)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 10,11=3x10b  %d  %d  %d\n", widx, diffs[0], diffs[1], diffs[2]);
-#endif
+  return packedsamples;
+} /* End of steim_pack_pending() */
 
-        /* Mask the values, shift to proper location and set in word */
-        frameptr[widx] = ((uint32_t)diffs[2] & 0x3FFul);
-        frameptr[widx] |= ((uint32_t)diffs[1] & 0x3FFul) << 10;
-        frameptr[widx] |= ((uint32_t)diffs[0] & 0x3FFul) << 20;
+/************************************************************************
+ * lm_steim_add:
+ *
+ * Add a sample to an incremental Steim encoding, packing a word as soon
+ * as enough differences are available to decide its packing.  The
+ * encoding is full when the frames or sample limit are exhausted,
+ * samples added but not packed by then remain in encoder->values and
+ * belong to a following encoding.
+ *
+ * Return 0 when the sample was added, 1 when the encoding was already
+ * full and -1 on failure.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ************************************************************************/
+int
+lm_steim_add (LMSteimEncoder *encoder, int32_t sample, const char *sid)
+{
+  int32_t diff;
+  int window = (encoder->encoding == DE_STEIM1) ? 4 : 7;
 
-        /* 2-bit decode nibble is 0b11 (0x3) */
-        frameptr[widx] |= 0x3ul << 30;
+  if (encoder->full)
+    return 1;
 
-        /* 2-bit nibble is 0b10 (0x2) */
-        frameptr[0] |= 0x2ul << (30 - 2 * widx);
+  /* First sample: save forward integration constant (X0), difference is 0 */
+  if (encoder->samplecount == 0 && encoder->pending == 0)
+  {
+    encoder->output[1] = (uint32_t)sample;
 
-        packedsamples = 3;
-      }
-      /* 2 x 15-bit differences */
-      else if (diffcount >= 2 && bitwidth[0] <= 15 && bitwidth[1] <= 15)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 10,10=2x15b  %d  %d\n", widx, diffs[0], diffs[1]);
-#endif
+    if (encoder->swapflag)
+      ms_gswap4 (&encoder->output[1]);
 
-        /* Mask the values, shift to proper location and set in word */
-        frameptr[widx] = ((uint32_t)diffs[1] & 0x7FFFul);
-        frameptr[widx] |= ((uint32_t)diffs[0] & 0x7FFFul) << 15;
+    diff = 0;
+  }
+  else
+  {
+    int32_t previous = (encoder->pending > 0) ? encoder->values[encoder->pending - 1]
+                                              : encoder->lastsample;
 
-        /* 2-bit decode nibble is 0b10 (0x2) */
-        frameptr[widx] |= 0x2ul << 30;
+    diff = (int32_t)((uint32_t)sample - (uint32_t)previous);
+  }
 
-        /* 2-bit nibble is 0b10 (0x2) */
-        frameptr[0] |= 0x2ul << (30 - 2 * widx);
+  encoder->values[encoder->pending] = sample;
+  encoder->diffs[encoder->pending] = diff;
+  encoder->classes[encoder->pending] = lm_steim_class (diff);
+  encoder->pending++;
 
-        packedsamples = 2;
-      }
-      /* 1 x 30-bit difference */
-      else if (diffcount >= 1 && bitwidth[0] <= 30)
-      {
-#if ENCODE_DEBUG
-        ms_log (0, "  W%02d: 10,01=1x30b  %d\n", widx, diffs[0]);
-#endif
+  /* At the sample limit pack all pending differences, as the batch
+   * encoders do at the end of their input */
+  if (encoder->maxsamples && encoder->samplecount + encoder->pending >= encoder->maxsamples)
+  {
+    while (encoder->pending > 0 && !encoder->full)
+    {
+      if (steim_pack_pending (encoder, sid) < 0)
+        return -1;
+    }
 
-        /* Mask the value and set in word */
-        frameptr[widx] = ((uint32_t)diffs[0] & 0x3FFFFFFFul);
+    encoder->full = 1;
+  }
+  else if (encoder->pending == window)
+  {
+    if (steim_pack_pending (encoder, sid) < 0)
+      return -1;
+  }
 
-        /* 2-bit decode nibble is 0b01 (0x1) */
-        frameptr[widx] |= 0x1ul << 30;
+  return 0;
+} /* End of lm_steim_add() */
 
-        /* 2-bit nibble is 0b10 (0x2) */
-        frameptr[0] |= 0x2ul << (30 - 2 * widx);
+/************************************************************************
+ * lm_steim_finish:
+ *
+ * Complete an incremental Steim encoding: pack pending differences while
+ * frames are available, then set the nibbles of the last frame and the
+ * reverse integration constant (Xn).  Must be called once per encoding.
+ *
+ * Return number of samples in output on success, -1 on failure.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ ************************************************************************/
+int
+lm_steim_finish (LMSteimEncoder *encoder, uint32_t *byteswritten, const char *sid)
+{
+  uint32_t frames;
 
-        packedsamples = 1;
-      }
-      else
-      {
-        ms_log (2, "%s: Unable to represent difference in <= 30 bits\n", sid);
-        return -1;
-      }
+  while (encoder->pending > 0 && !encoder->full)
+  {
+    if (steim_pack_pending (encoder, sid) < 0)
+      return -1;
+  }
 
-      /* Swap encoded word except for 4x8-bit samples */
-      if (swapflag && packedsamples != 4)
-        ms_gswap4 (&frameptr[widx]);
+  encoder->full = 1;
+  frames = encoder->frameidx;
 
-      diffcount -= packedsamples;
-      outputsamples += packedsamples;
-    } /* Done with words in frame */
+  /* Swap word with nibbles of a partially used frame */
+  if (frames < encoder->maxframes && encoder->widx > ((frames == 0) ? 3 : 1))
+  {
+    if (encoder->swapflag)
+      ms_gswap4 (&encoder->output[16 * frames]);
 
-    /* Swap word with nibbles */
-    if (swapflag)
-      ms_gswap4 (&frameptr[0]);
-  } /* Done with frames */
+    frames++;
+  }
 
   /* Set Xn (reverse integration constant) in first frame to last sample */
-  if (Xnp)
+  if (encoder->samplecount > 0)
   {
-    *Xnp = *(input + outputsamples - 1);
-    if (swapflag)
-      ms_gswap4 (Xnp);
+    encoder->output[2] = (uint32_t)encoder->lastsample;
+
+    if (encoder->swapflag)
+      ms_gswap4 (&encoder->output[2]);
   }
 
   if (byteswritten)
-    *byteswritten = (uint32_t)(frameidx * 64);
+    *byteswritten = frames * 64;
+
+  return (int)encoder->samplecount;
+} /* End of lm_steim_finish() */
+
+/************************************************************************
+ * lm_steim_capacity:
+ *
+ * Determine the number of samples of input that msr_encode_steim1() or
+ * msr_encode_steim2(), with a diff0 of 0, pack into outputlength bytes of
+ * frames, without encoding.  A difference that cannot be represented is
+ * counted as one per word, encoding will report the error.
+ *
+ * Return number of samples that fit in output.
+ ************************************************************************/
+uint64_t
+lm_steim_capacity (const int32_t *input, uint64_t samplecount, uint64_t outputlength,
+                   int8_t encoding)
+{
+  const int *perword = (encoding == DE_STEIM1) ? steim1_perword : steim2_perword;
+  int window = (encoding == DE_STEIM1) ? 4 : 7;
+  int32_t diffbuffer[STEIM_DIFFBLOCK + 7];
+  uint8_t classbuffer[STEIM_DIFFBLOCK + 7];
+  uint64_t words = (outputlength / 64) * 15;
+  uint64_t inputidx = 0;
+  uint64_t outputsamples = 0;
+  uint64_t blockcount;
+  int diffstart = 0;
+  int diffend = 1;
+  int packedsamples;
+  int limit;
+
+  if (samplecount == 0 || words == 0)
+    return 0;
+
+  /* First frame: X0 and Xn occupy two words */
+  words -= 2;
+
+  diffbuffer[0] = 0;
+  classbuffer[0] = LM_STEIM_4BIT;
+
+  for (; words > 0 && outputsamples < samplecount; words--)
+  {
+    /* Compute the next block of bit width classes when fewer than a full
+     * word of differences remain */
+    if (diffend - diffstart < window && inputidx < (samplecount - 1))
+    {
+      diffend -= diffstart;
+      memmove (classbuffer, classbuffer + diffstart, diffend);
+      diffstart = 0;
+
+      blockcount = samplecount - 1 - inputidx;
+      if (blockcount > STEIM_DIFFBLOCK)
+        blockcount = STEIM_DIFFBLOCK;
+
+      lm_steim_diffs (diffbuffer + diffend, classbuffer + diffend, input + inputidx, blockcount);
+      diffend += (int)blockcount;
+      inputidx += blockcount;
+    }
+
+    /* Same packing selection as the encoders */
+    packedsamples = 0;
+    for (limit = window; packedsamples < diffend - diffstart && packedsamples < limit;
+         packedsamples++)
+    {
+      if (perword[classbuffer[diffstart + packedsamples]] < limit)
+        limit = perword[classbuffer[diffstart + packedsamples]];
+
+      if (limit <= packedsamples)
+        break;
+    }
+
+    /* Steim1 packs 2 x 16-bit differences when 3 would fit */
+    if (encoding == DE_STEIM1 && packedsamples == 3)
+      packedsamples = 2;
+    else if (packedsamples == 0)
+      packedsamples = 1;
+
+    diffstart += packedsamples;
+    outputsamples += packedsamples;
+  }
 
   return outputsamples;
-} /* End of msr_encode_steim2() */
+} /* End of lm_steim_capacity() */
@@ -48,6 +48,38 @@ extern int64_t msr_encode_steim2 (int32_t *input, uint64_t samplecount, int32_t
                                   uint64_t outputlength, int32_t diff0, uint32_t *byteswritten,
                                   const char *sid, int swapflag);
 
+/* Number of samples msr_encode_steim1/2() with a diff0 of 0 would pack
+ * into outputlength bytes of frames, determined without encoding */
+extern uint64_t lm_steim_capacity (const int32_t *input, uint64_t samplecount,
+                                   uint64_t outputlength, int8_t encoding);
+
+/* Incremental Steim1/Steim2 encoder, packing samples into frames as they
+ * are added with results identical to msr_encode_steim1/2() with a diff0
+ * of 0.  Differences are held until enough are available to decide the
+ * packing of a word, at most 7 for Steim2 and 4 for Steim1. */
+typedef struct LMSteimEncoder
+{
+  uint32_t *output;     /* Output frames */
+  uint32_t maxframes;   /* Number of frames available in output */
+  uint32_t frameidx;    /* Index of the current frame */
+  int widx;             /* Index of the next word in the current frame */
+  int8_t encoding;      /* DE_STEIM1 or DE_STEIM2 */
+  int8_t swapflag;      /* Swap frames to big endian byte order */
+  int8_t full;          /* No more samples can be added */
+  uint64_t maxsamples;  /* Maximum number of samples, 0 for no limit */
+  uint64_t samplecount; /* Number of samples packed into frames */
+  int32_t lastsample;   /* Last sample packed into frames */
+  int pending;          /* Number of samples added but not packed */
+  int32_t values[7];    /* Samples added but not packed */
+  int32_t diffs[7];     /* Differences of samples not packed */
+  uint8_t classes[7];   /* Bit width classes of differences not packed */
+} LMSteimEncoder;
+
+extern void lm_steim_start (LMSteimEncoder *encoder, int32_t *output, uint64_t outputlength,
+                            uint64_t maxsamples, int8_t encoding, int swapflag);
+extern int lm_steim_add (LMSteimEncoder *encoder, int32_t sample, const char *sid);
+extern int lm_steim_finish (LMSteimEncoder *encoder, uint32_t *byteswritten, const char *sid);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -301,6 +302,139 @@ ms3_detect (const char *record, uint64_t recbuflen, uint8_t *formatversion)
     return reclen;
 } /* End of ms3_detect() */
 
+/***************************************************************************
+ * lm_preselect_skip:
+ *
+ * Test the fixed header of a record in a buffer against selections
+ * without unpacking the record.  The source identifier, publication
+ * version and time coverage are derived directly from the fixed
+ * header fields.
+ *
+ * For miniSEED 2.x the start time may be adjusted by up to 128
+ * microseconds by a 1001 blockette and the sample rate may be
+ * replaced by a 100 blockette, so only the start time is tested,
+ * with a margin, to never reject a record that would match after a
+ * full parse.
+ *
+ * If @p sid is not NULL the source identifier is copied to it, the
+ * buffer must be at least LM_SIDLEN bytes.
+ *
+ * Returns the record length when the complete record is in the
+ * buffer and definitely does not match the selections, otherwise 0,
+ * in which case the record should be parsed normally.
+ ***************************************************************************/
+int64_t
+lm_preselect_skip (const MS3Selections *selections, const char *record, uint64_t recbuflen,
+                   char *sid)
+{
+  char recordsid[LM_SIDLEN];
+  nstime_t starttime;
+  nstime_t endtime = NSTUNSET;
+  int64_t reclen;
+  uint8_t formatversion = 0;
+  uint8_t pubversion;
+  int8_t swapflag;
+
+  if (!selections || !record)
+    return 0;
+
+  reclen = ms3_detect (record, recbuflen, &formatversion);
+
+  if (reclen < MINRECLEN || reclen > MAXRECLEN || (uint64_t)reclen > recbuflen)
+    return 0;
+
+  if (formatversion == 3)
+  {
+    uint8_t sidlength = *pMS3FSDH_SIDLENGTH (record);
+    uint32_t nanoseconds;
+    uint32_t numsamples;
+    double samprate;
+
+    if (sidlength == 0 || sidlength >= LM_SIDLEN ||
+        (uint64_t)MS3FSDH_LENGTH + sidlength > (uint64_t)reclen)
+      return 0;
+
+    /* miniSEED 3 is little-endian */
+    swapflag = (ms_bigendianhost ()) ? 1 : 0;
+
+    memcpy (recordsid, pMS3FSDH_SID (record), sidlength);
+    recordsid[sidlength] = '\0';
+
+    memcpy (&nanoseconds, pMS3FSDH_NSEC (record), sizeof (uint32_t));
+    starttime = ms_time2nstime (HO2u (*pMS3FSDH_YEAR (record), swapflag),
+                                HO2u (*pMS3FSDH_DAY (record), swapflag), *pMS3FSDH_HOUR (record),
+                                *pMS3FSDH_MIN (record), *pMS3FSDH_SEC (record),
+                                HO4u (nanoseconds, swapflag));
+
+    memcpy (&samprate, pMS3FSDH_SAMPLERATE (record), sizeof (double));
+    samprate = HO8f (samprate, swapflag);
+
+    memcpy (&numsamples, pMS3FSDH_NUMSAMPLES (record), sizeof (uint32_t));
+    numsamples = HO4u (numsamples, swapflag);
+
+    if (starttime == NSTERROR || (samprate != 0.0 && !isnormal (samprate)))
+      return 0;
+
+    endtime = ms_sampletime (starttime, (numsamples > 0) ? numsamples - 1 : 0, samprate);
+
+    pubversion = *pMS3FSDH_PUBVERSION (record);
+  }
+  else if (formatversion == 2)
+  {
+    uint16_t year;
+    int32_t timecorrect;
+
+    /* Check to see if byte swapping is needed by checking for sane year and day */
+    swapflag = (MS_ISVALIDYEARDAY (*pMS2FSDH_YEAR (record), *pMS2FSDH_DAY (record))) ? 0 : 1;
+
+    if (!ms2_recordsid (record, recordsid, sizeof (recordsid)))
+      return 0;
+
+    year = HO2u (*pMS2FSDH_YEAR (record), swapflag);
+    if (year == 0)
+      return 0;
+
+    starttime = ms_time2nstime (year, HO2u (*pMS2FSDH_DAY (record), swapflag),
+                                *pMS2FSDH_HOUR (record), *pMS2FSDH_MIN (record),
+                                *pMS2FSDH_SEC (record),
+                                (uint32_t)HO2u (*pMS2FSDH_FSEC (record), swapflag) *
+                                    (NSTMODULUS / 10000));
+    if (starttime == NSTERROR)
+      return 0;
+
+    /* Apply time correction if not already applied, bit 1 of activity flags */
+    timecorrect = HO4d (*pMS2FSDH_TIMECORRECT (record), swapflag);
+    if (timecorrect != 0 && !(*pMS2FSDH_ACTFLAGS (record) & 0x02))
+      starttime += (nstime_t)timecorrect * (NSTMODULUS / 10000);
+
+    /* Allow for the largest 1001 blockette microsecond adjustment */
+    starttime -= (nstime_t)128 * (NSTMODULUS / 1000000);
+
+    if (*pMS2FSDH_DATAQUALITY (record) == 'M')
+      pubversion = 4;
+    else if (*pMS2FSDH_DATAQUALITY (record) == 'Q')
+      pubversion = 3;
+    else if (*pMS2FSDH_DATAQUALITY (record) == 'D')
+      pubversion = 2;
+    else if (*pMS2FSDH_DATAQUALITY (record) == 'R')
+      pubversion = 1;
+    else
+      pubversion = 0;
+  }
+  else
+  {
+    return 0;
+  }
+
+  if (sid)
+    memcpy (sid, recordsid, sizeof (recordsid));
+
+  if (ms3_matchselect (selections, recordsid, starttime, endtime, pubversion, NULL))
+    return 0;
+
+  return reclen;
+} /* End of lm_preselect_skip() */
+
 /** ************************************************************************
  * @brief Parse and verify a miniSEED 3.x record header
  *
@@ -29,6 +29,92 @@
 static int ms_isinteger (const char *string);
 static int ms_globmatch (const char *string, const char *pattern);
 
+/* Private types for compiled selections */
+
+/* Time window of a selection entry, sorted by start time */
+typedef struct LMSelectWindow
+{
+  nstime_t starttime;          /* Start time, INT64_MIN for open */
+  nstime_t endtime;            /* End time, INT64_MAX for open */
+  const MS3SelectTime *window; /* Original time window */
+  uint32_t order;              /* Position in original time window list */
+} LMSelectWindow;
+
+/* Selection entry with time windows sorted for searching */
+typedef struct LMSelectEntry
+{
+  const MS3Selections *selection; /* Original selection entry */
+  LMSelectWindow *windows;        /* Time windows sorted by start time */
+  nstime_t *maxendtime;           /* Latest end time of windows[0..N] */
+  uint32_t windowcount;           /* Number of time windows */
+  int8_t inorder;                 /* Flag: sorted order is the original list order */
+
+  /* Unless inorder, windows in blocks of a Fenwick tree over sorted
+   * positions, block i (1-based) holding the windows[i - (i & -i) .. i - 1]
+   * sorted by descending end time */
+  uint32_t *blockoffset;          /* Offset of each block, windowcount + 1 values */
+  nstime_t *blockendtime;         /* End times of block windows */
+  uint32_t *blockwindow;          /* Window with the lowest original order of block[0..N] */
+} LMSelectEntry;
+
+/* Window end time and position in windows[], for sorting blocks */
+typedef struct LMSelectBlockWindow
+{
+  nstime_t endtime;
+  uint32_t window;
+} LMSelectBlockWindow;
+
+/* Literal or prefix pattern and the entries that use it */
+typedef struct LMSelectKey
+{
+  char *key;         /* Literal pattern, or prefix without trailing '*' */
+  uint32_t hash;     /* Hash of key */
+  uint8_t prefix;    /* Flag: key is a prefix */
+  uint32_t *entries; /* Entry indices, ascending */
+  uint32_t count;    /* Number of entry indices */
+} LMSelectKey;
+
+/* Cached result of pattern matching for a source ID */
+typedef struct LMSelectCache
+{
+  char *sid;         /* Source ID, NULL for an empty slot */
+  uint32_t hash;     /* Hash of sid */
+  uint32_t *entries; /* Indices of entries with matching patterns, ascending */
+  uint32_t count;    /* Number of entry indices */
+} LMSelectCache;
+
+/* Maximum number of source IDs cached before the cache is reset */
+#define LM_SELECTCACHE_MAX 65536
+
+struct MS3CompiledSelections
+{
+  LMSelectEntry *entries; /* Selection entries in original order */
+  uint32_t entrycount;
+
+  LMSelectKey *keys; /* Open addressing table of literal and prefix patterns */
+  uint32_t keysize;  /* Size of key table, a power of 2 */
+
+  uint32_t *globs;    /* Indices of entries with general globbing patterns */
+  uint32_t globcount;
+
+  LMSelectCache *cache; /* Open addressing table of source ID results */
+  uint32_t cachesize;   /* Size of cache table, a power of 2 */
+  uint32_t cachecount;  /* Number of cached source IDs */
+};
+
+/* FNV-1a hash */
+#define LM_FNV_OFFSET 2166136261u
+#define LM_FNV_PRIME 16777619u
+
+static int lm_cmpwindow (const void *a, const void *b);
+static int lm_cmpblockwindow (const void *a, const void *b);
+static int lm_buildblocks (LMSelectEntry *entry);
+static int lm_cmpindex (const void *a, const void *b);
+static LMSelectKey *lm_findkey (const MS3CompiledSelections *compiled, const char *key,
+                                size_t keylength, uint32_t hash, uint8_t prefix);
+static LMSelectCache *lm_cachesid (MS3CompiledSelections *compiled, const char *sid);
+static int lm_appendindex (uint32_t **indices, uint32_t *count, uint32_t index);
+
 /** ************************************************************************
  * @brief Test the specified parameters for a matching selection entry
  *
@@ -799,6 +885,729 @@ ms3_printselections (const MS3Selections *selections)
   }
 } /* End of ms3_printselections() */
 
+/** ************************************************************************
+ * @brief Compile ::MS3Selections for repeated matching
+ *
+ * Build a matcher from @p selections that gives the same results as
+ * ms3_matchselect() but scales to large selection lists:
+ * @parblock
+ *  - Patterns without globbing characters, and patterns whose only
+ *    globbing is a trailing `*`, are looked up in a hash table by
+ *    source ID and source ID prefix instead of being matched one at
+ *    a time.
+ *  - The results of pattern matching are cached per distinct source
+ *    ID, so each source ID is matched against the patterns once.
+ *  - Time windows of each entry are sorted by start time and searched
+ *    with a binary search.  When the windows of an entry are not listed
+ *    in start time order, the window first in the original list is
+ *    found with a binary search in each of a logarithmic number of
+ *    blocks, using memory proportional to N log N for N windows.
+ * @endparblock
+ *
+ * The compiled selections reference @p selections, which must not be
+ * modified or freed while the compiled selections are in use.
+ *
+ * The compiled selections contain a cache that is updated when
+ * matching and must not be used concurrently by multiple threads.
+ *
+ * @param[in] selections ::MS3Selections to compile
+ *
+ * @returns Compiled selections on success, which must be freed with
+ * ms3_freecompiledselections(), or NULL on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms3_matchselect_compiled()
+ ***************************************************************************/
+MS3CompiledSelections *
+ms3_compileselections (const MS3Selections *selections)
+{
+  MS3CompiledSelections *compiled = NULL;
+  const MS3Selections *select;
+  const MS3SelectTime *selecttime;
+  LMSelectEntry *entry;
+  LMSelectKey *key;
+  const char *pattern;
+  size_t patternlength;
+  uint32_t index;
+  uint32_t hash;
+  uint32_t idx;
+  uint8_t prefix;
+
+  if (!selections)
+  {
+    ms_log (2, "%s(): Required input not defined: 'selections'\n", __func__);
+    return NULL;
+  }
+
+  if ((compiled = (MS3CompiledSelections *)libmseed_memory.malloc (sizeof (*compiled))) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+  memset (compiled, 0, sizeof (*compiled));
+
+  for (select = selections; select; select = select->next)
+    compiled->entrycount++;
+
+  /* Key table at no more than half full */
+  compiled->keysize = 16;
+  while (compiled->keysize < compiled->entrycount * 2)
+    compiled->keysize *= 2;
+
+  compiled->entries =
+      (LMSelectEntry *)libmseed_memory.malloc (sizeof (LMSelectEntry) * compiled->entrycount);
+  compiled->keys = (LMSelectKey *)libmseed_memory.malloc (sizeof (LMSelectKey) * compiled->keysize);
+
+  if (!compiled->entries || !compiled->keys)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    goto error_return;
+  }
+  memset (compiled->entries, 0, sizeof (LMSelectEntry) * compiled->entrycount);
+  memset (compiled->keys, 0, sizeof (LMSelectKey) * compiled->keysize);
+
+  for (index = 0, select = selections; select; index++, select = select->next)
+  {
+    entry = &compiled->entries[index];
+    entry->selection = select;
+
+    /* Sort time windows by start time, tracking the latest end time */
+    for (selecttime = select->timewindows; selecttime; selecttime = selecttime->next)
+      entry->windowcount++;
+
+    if (entry->windowcount)
+    {
+      entry->windows =
+          (LMSelectWindow *)libmseed_memory.malloc (sizeof (LMSelectWindow) * entry->windowcount);
+      entry->maxendtime = (nstime_t *)libmseed_memory.malloc (sizeof (nstime_t) * entry->windowcount);
+
+      if (!entry->windows || !entry->maxendtime)
+      {
+        ms_log (2, "Cannot allocate memory\n");
+        goto error_return;
+      }
+
+      for (idx = 0, selecttime = select->timewindows; selecttime;
+           idx++, selecttime = selecttime->next)
+      {
+        entry->windows[idx].starttime =
+            (selecttime->starttime == NSTERROR || selecttime->starttime == NSTUNSET)
+                ? INT64_MIN
+                : selecttime->starttime;
+        entry->windows[idx].endtime =
+            (selecttime->endtime == NSTERROR || selecttime->endtime == NSTUNSET)
+                ? INT64_MAX
+                : selecttime->endtime;
+        entry->windows[idx].window = selecttime;
+        entry->windows[idx].order = idx;
+      }
+
+      qsort (entry->windows, entry->windowcount, sizeof (LMSelectWindow), lm_cmpwindow);
+
+      entry->inorder = 1;
+      for (idx = 0; idx < entry->windowcount; idx++)
+      {
+        if (entry->windows[idx].order != idx)
+          entry->inorder = 0;
+
+        entry->maxendtime[idx] = entry->windows[idx].endtime;
+        if (idx > 0 && entry->maxendtime[idx - 1] > entry->maxendtime[idx])
+          entry->maxendtime[idx] = entry->maxendtime[idx - 1];
+      }
+
+      if (!entry->inorder && lm_buildblocks (entry))
+        goto error_return;
+    }
+
+    /* Classify pattern as literal, prefix (only a trailing '*') or glob */
+    pattern = select->sidpattern;
+    patternlength = strcspn (pattern, "*?[\\");
+    prefix = (pattern[patternlength] == '*');
+
+    if ((prefix && pattern[patternlength + strspn (pattern + patternlength, "*")] != '\0') ||
+        (!prefix && pattern[patternlength] != '\0'))
+    {
+      if (lm_appendindex (&compiled->globs, &compiled->globcount, index))
+        goto error_return;
+
+      continue;
+    }
+
+    hash = LM_FNV_OFFSET;
+    for (idx = 0; idx < patternlength; idx++)
+      hash = (hash ^ (uint8_t)pattern[idx]) * LM_FNV_PRIME;
+
+    key = lm_findkey (compiled, pattern, patternlength, hash, prefix);
+
+    /* Add new key in empty slot */
+    if (!key->key)
+    {
+      if ((key->key = (char *)libmseed_memory.malloc (patternlength + 1)) == NULL)
+      {
+        ms_log (2, "Cannot allocate memory\n");
+        goto error_return;
+      }
+
+      memcpy (key->key, pattern, patternlength);
+      key->key[patternlength] = '\0';
+      key->hash = hash;
+      key->prefix = prefix;
+    }
+
+    if (lm_appendindex (&key->entries, &key->count, index))
+      goto error_return;
+  }
+
+  return compiled;
+
+error_return:
+  ms3_freecompiledselections (compiled);
+
+  return NULL;
+} /* End of ms3_compileselections() */
+
+/** ************************************************************************
+ * @brief Test the specified parameters against compiled selections
+ *
+ * Equivalent to ms3_matchselect() with the ::MS3Selections used to
+ * create @p compiled, returning the same entries.
+ *
+ * @param[in] compiled Compiled selections from ms3_compileselections()
+ * @param[in] sid Source ID to match
+ * @param[in] starttime Start time to match
+ * @param[in] endtime End time to match
+ * @param[in] pubversion Publication version to match
+ * @param[out] ppselecttime Pointer-to-pointer to return the matching ::MS3SelectTime entry
+ *
+ * @returns A pointer to matching ::MS3Selections entry on success and NULL for
+ * no match or error.
+ *
+ * @see ms3_matchselect()
+ ***************************************************************************/
+const MS3Selections *
+ms3_matchselect_compiled (MS3CompiledSelections *compiled, const char *sid, nstime_t starttime,
+                          nstime_t endtime, int pubversion, const MS3SelectTime **ppselecttime)
+{
+  const LMSelectCache *cached;
+  const LMSelectEntry *entry;
+  const LMSelectWindow *matchwindow;
+  nstime_t qstart;
+  nstime_t qend;
+  uint32_t first;
+  uint32_t low;
+  uint32_t high;
+  uint32_t mid;
+  uint32_t idx;
+  uint32_t widx;
+
+  if (ppselecttime)
+    *ppselecttime = NULL;
+
+  if (!compiled || !sid)
+    return NULL;
+
+  if ((cached = lm_cachesid (compiled, sid)) == NULL)
+    return NULL;
+
+  qstart = (starttime == NSTERROR || starttime == NSTUNSET) ? INT64_MIN : starttime;
+  qend = (endtime == NSTERROR || endtime == NSTUNSET) ? INT64_MAX : endtime;
+
+  for (idx = 0; idx < cached->count; idx++)
+  {
+    entry = &compiled->entries[cached->entries[idx]];
+
+    if (entry->selection->pubversion > 0 && entry->selection->pubversion != pubversion)
+      continue;
+
+    /* If no time selection, this is a match */
+    if (!entry->windowcount)
+      return entry->selection;
+
+    /* Find count of windows starting at or before the query end */
+    low = 0;
+    high = entry->windowcount;
+    while (low < high)
+    {
+      mid = low + (high - low) / 2;
+      if (entry->windows[mid].starttime <= qend)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    /* No window intersects if none of those end at or after the query start */
+    if (low == 0 || entry->maxendtime[low - 1] < qstart)
+      continue;
+
+    /* Find the first window ending at or after the query start, where the
+     * latest end time first reaches it, all windows before it end earlier */
+    first = 0;
+    high = low - 1;
+    while (first < high)
+    {
+      mid = first + (high - first) / 2;
+      if (entry->maxendtime[mid] < qstart)
+        first = mid + 1;
+      else
+        high = mid;
+    }
+
+    /* Return the intersecting window first in the original list, which is
+     * the first found when the windows were listed by start time */
+    matchwindow = &entry->windows[first];
+
+    /* Otherwise take the lowest order of the windows ending at or after
+     * the query start in each block covering windows[0..low - 1] */
+    for (widx = low; !entry->inorder && widx > 0; widx -= widx & (~widx + 1))
+    {
+      first = entry->blockoffset[widx - 1];
+      high = entry->blockoffset[widx];
+      while (first < high)
+      {
+        mid = first + (high - first) / 2;
+        if (entry->blockendtime[mid] >= qstart)
+          first = mid + 1;
+        else
+          high = mid;
+      }
+
+      if (first > entry->blockoffset[widx - 1] &&
+          entry->windows[entry->blockwindow[first - 1]].order < matchwindow->order)
+        matchwindow = &entry->windows[entry->blockwindow[first - 1]];
+    }
+
+    if (ppselecttime)
+      *ppselecttime = matchwindow->window;
+
+    return entry->selection;
+  }
+
+  return NULL;
+} /* End of ms3_matchselect_compiled() */
+
+/** ************************************************************************
+ * @brief Test the ::MS3Record against compiled selections
+ *
+ * Equivalent to msr3_matchselect() with the ::MS3Selections used to
+ * create @p compiled.
+ *
+ * @param[in] compiled Compiled selections from ms3_compileselections()
+ * @param[in] msr ::MS3Record to match against selections
+ * @param[out] ppselecttime Pointer-to-pointer to return the matching ::MS3SelectTime entry
+ *
+ * @returns A pointer to matching ::MS3Selections entry successful
+ * match and NULL for no match or error.
+ ***************************************************************************/
+const MS3Selections *
+msr3_matchselect_compiled (MS3CompiledSelections *compiled, const MS3Record *msr,
+                           const MS3SelectTime **ppselecttime)
+{
+  if (!compiled || !msr)
+    return NULL;
+
+  return ms3_matchselect_compiled (compiled, msr->sid, msr->starttime, msr3_endtime (msr),
+                                   msr->pubversion, ppselecttime);
+} /* End of msr3_matchselect_compiled() */
+
+/** ************************************************************************
+ * @brief Free all memory associated with compiled selections
+ *
+ * The ::MS3Selections used to create @p compiled are not freed.
+ *
+ * @param[in] compiled Compiled selections from ms3_compileselections()
+ ***************************************************************************/
+void
+ms3_freecompiledselections (MS3CompiledSelections *compiled)
+{
+  uint32_t idx;
+
+  if (!compiled)
+    return;
+
+  if (compiled->entries)
+  {
+    for (idx = 0; idx < compiled->entrycount; idx++)
+    {
+      if (compiled->entries[idx].windows)
+        libmseed_memory.free (compiled->entries[idx].windows);
+      if (compiled->entries[idx].maxendtime)
+        libmseed_memory.free (compiled->entries[idx].maxendtime);
+      if (compiled->entries[idx].blockoffset)
+        libmseed_memory.free (compiled->entries[idx].blockoffset);
+      if (compiled->entries[idx].blockendtime)
+        libmseed_memory.free (compiled->entries[idx].blockendtime);
+      if (compiled->entries[idx].blockwindow)
+        libmseed_memory.free (compiled->entries[idx].blockwindow);
+    }
+
+    libmseed_memory.free (compiled->entries);
+  }
+
+  if (compiled->keys)
+  {
+    for (idx = 0; idx < compiled->keysize; idx++)
+    {
+      if (compiled->keys[idx].key)
+        libmseed_memory.free (compiled->keys[idx].key);
+      if (compiled->keys[idx].entries)
+        libmseed_memory.free (compiled->keys[idx].entries);
+    }
+
+    libmseed_memory.free (compiled->keys);
+  }
+
+  if (compiled->cache)
+  {
+    for (idx = 0; idx < compiled->cachesize; idx++)
+    {
+      if (compiled->cache[idx].sid)
+        libmseed_memory.free (compiled->cache[idx].sid);
+      if (compiled->cache[idx].entries)
+        libmseed_memory.free (compiled->cache[idx].entries);
+    }
+
+    libmseed_memory.free (compiled->cache);
+  }
+
+  if (compiled->globs)
+    libmseed_memory.free (compiled->globs);
+
+  libmseed_memory.free (compiled);
+} /* End of ms3_freecompiledselections() */
+
+/***************************************************************************
+ * lm_cmpwindow:
+ *
+ * qsort() comparison of LMSelectWindow by start time, then original order.
+ ***************************************************************************/
+static int
+lm_cmpwindow (const void *a, const void *b)
+{
+  const LMSelectWindow *wa = (const LMSelectWindow *)a;
+  const LMSelectWindow *wb = (const LMSelectWindow *)b;
+
+  if (wa->starttime != wb->starttime)
+    return (wa->starttime < wb->starttime) ? -1 : 1;
+
+  return (wa->order < wb->order) ? -1 : (wa->order > wb->order);
+}
+
+/***************************************************************************
+ * lm_cmpblockwindow:
+ *
+ * qsort() comparison of LMSelectBlockWindow by descending end time.
+ ***************************************************************************/
+static int
+lm_cmpblockwindow (const void *a, const void *b)
+{
+  const LMSelectBlockWindow *wa = (const LMSelectBlockWindow *)a;
+  const LMSelectBlockWindow *wb = (const LMSelectBlockWindow *)b;
+
+  if (wa->endtime != wb->endtime)
+    return (wa->endtime > wb->endtime) ? -1 : 1;
+
+  return (wa->window < wb->window) ? -1 : (wa->window > wb->window);
+}
+
+/***************************************************************************
+ * lm_buildblocks:
+ *
+ * Build the Fenwick tree blocks of an entry whose windows are not listed
+ * by start time, so the intersecting window first in the original list is
+ * found with a binary search in each of the blocks covering a prefix of
+ * the sorted windows.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_buildblocks (LMSelectEntry *entry)
+{
+  LMSelectBlockWindow *block;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t idx;
+  uint32_t bidx;
+
+  entry->blockoffset = (uint32_t *)libmseed_memory.malloc (sizeof (uint32_t) *
+                                                            (entry->windowcount + 1));
+  if (!entry->blockoffset)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return -1;
+  }
+
+  for (offset = 0, idx = 1; idx <= entry->windowcount; idx++)
+  {
+    entry->blockoffset[idx - 1] = offset;
+    offset += idx & (~idx + 1);
+  }
+  entry->blockoffset[entry->windowcount] = offset;
+
+  entry->blockendtime = (nstime_t *)libmseed_memory.malloc (sizeof (nstime_t) * offset);
+  entry->blockwindow = (uint32_t *)libmseed_memory.malloc (sizeof (uint32_t) * offset);
+  block = (LMSelectBlockWindow *)libmseed_memory.malloc (sizeof (LMSelectBlockWindow) *
+                                                         entry->windowcount);
+
+  if (!entry->blockendtime || !entry->blockwindow || !block)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    if (block)
+      libmseed_memory.free (block);
+    return -1;
+  }
+
+  for (idx = 1; idx <= entry->windowcount; idx++)
+  {
+    size = idx & (~idx + 1);
+    offset = entry->blockoffset[idx - 1];
+
+    for (bidx = 0; bidx < size; bidx++)
+    {
+      block[bidx].endtime = entry->windows[idx - size + bidx].endtime;
+      block[bidx].window = idx - size + bidx;
+    }
+
+    qsort (block, size, sizeof (LMSelectBlockWindow), lm_cmpblockwindow);
+
+    for (bidx = 0; bidx < size; bidx++)
+    {
+      entry->blockendtime[offset + bidx] = block[bidx].endtime;
+      entry->blockwindow[offset + bidx] = block[bidx].window;
+
+      if (bidx > 0 && entry->windows[entry->blockwindow[offset + bidx - 1]].order <
+                          entry->windows[block[bidx].window].order)
+        entry->blockwindow[offset + bidx] = entry->blockwindow[offset + bidx - 1];
+    }
+  }
+
+  libmseed_memory.free (block);
+
+  return 0;
+}
+
+/***************************************************************************
+ * lm_cmpindex:
+ *
+ * qsort() comparison of uint32_t values.
+ ***************************************************************************/
+static int
+lm_cmpindex (const void *a, const void *b)
+{
+  uint32_t ia = *(const uint32_t *)a;
+  uint32_t ib = *(const uint32_t *)b;
+
+  return (ia < ib) ? -1 : (ia > ib);
+}
+
+/***************************************************************************
+ * lm_findkey:
+ *
+ * Find the slot in the key table for a key of the specified length,
+ * hash and type.
+ *
+ * Returns the slot containing the key or the empty slot where it
+ * would be inserted.
+ ***************************************************************************/
+static LMSelectKey *
+lm_findkey (const MS3CompiledSelections *compiled, const char *key, size_t keylength,
+            uint32_t hash, uint8_t prefix)
+{
+  LMSelectKey *slot;
+  uint32_t mask = compiled->keysize - 1;
+  uint32_t idx = hash & mask;
+
+  for (;;)
+  {
+    slot = &compiled->keys[idx];
+
+    if (!slot->key ||
+        (slot->hash == hash && slot->prefix == prefix && strncmp (slot->key, key, keylength) == 0 &&
+         slot->key[keylength] == '\0'))
+      return slot;
+
+    idx = (idx + 1) & mask;
+  }
+}
+
+/***************************************************************************
+ * lm_cachesid:
+ *
+ * Find the cached pattern matching results for a source ID, matching
+ * the patterns and adding the results to the cache if not present.
+ *
+ * Returns the cache entry on success and NULL on error.
+ ***************************************************************************/
+static LMSelectCache *
+lm_cachesid (MS3CompiledSelections *compiled, const char *sid)
+{
+  LMSelectCache *slot;
+  LMSelectCache *newcache;
+  const LMSelectKey *key;
+  size_t sidlength = strlen (sid);
+  uint32_t prefixhash = LM_FNV_OFFSET;
+  uint32_t hash;
+  uint32_t mask;
+  uint32_t idx;
+  uint32_t kidx;
+  uint32_t gidx;
+
+  hash = LM_FNV_OFFSET;
+  for (idx = 0; idx < sidlength; idx++)
+    hash = (hash ^ (uint8_t)sid[idx]) * LM_FNV_PRIME;
+
+  /* Search cache */
+  if (compiled->cache)
+  {
+    mask = compiled->cachesize - 1;
+    for (idx = hash & mask; compiled->cache[idx].sid; idx = (idx + 1) & mask)
+    {
+      if (compiled->cache[idx].hash == hash && strcmp (compiled->cache[idx].sid, sid) == 0)
+        return &compiled->cache[idx];
+    }
+  }
+
+  /* Reset cache when full, or grow cache to keep it no more than half full */
+  if (compiled->cachecount >= LM_SELECTCACHE_MAX)
+  {
+    for (idx = 0; idx < compiled->cachesize; idx++)
+    {
+      if (compiled->cache[idx].sid)
+        libmseed_memory.free (compiled->cache[idx].sid);
+      if (compiled->cache[idx].entries)
+        libmseed_memory.free (compiled->cache[idx].entries);
+    }
+
+    memset (compiled->cache, 0, sizeof (LMSelectCache) * compiled->cachesize);
+    compiled->cachecount = 0;
+  }
+  else if ((compiled->cachecount + 1) * 2 > compiled->cachesize)
+  {
+    uint32_t newsize = (compiled->cachesize) ? compiled->cachesize * 2 : 64;
+
+    newcache = (LMSelectCache *)libmseed_memory.malloc (sizeof (LMSelectCache) * newsize);
+    if (!newcache)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return NULL;
+    }
+    memset (newcache, 0, sizeof (LMSelectCache) * newsize);
+
+    for (idx = 0; idx < compiled->cachesize; idx++)
+    {
+      if (!compiled->cache[idx].sid)
+        continue;
+
+      for (kidx = compiled->cache[idx].hash & (newsize - 1); newcache[kidx].sid;
+           kidx = (kidx + 1) & (newsize - 1))
+        ;
+
+      newcache[kidx] = compiled->cache[idx];
+    }
+
+    if (compiled->cache)
+      libmseed_memory.free (compiled->cache);
+
+    compiled->cache = newcache;
+    compiled->cachesize = newsize;
+  }
+
+  mask = compiled->cachesize - 1;
+  for (idx = hash & mask; compiled->cache[idx].sid; idx = (idx + 1) & mask)
+    ;
+
+  slot = &compiled->cache[idx];
+
+  if ((slot->sid = (char *)libmseed_memory.malloc (sidlength + 1)) == NULL)
+  {
+    ms_log (2, "Cannot allocate memory\n");
+    return NULL;
+  }
+
+  memcpy (slot->sid, sid, sidlength + 1);
+  slot->hash = hash;
+  slot->entries = NULL;
+  slot->count = 0;
+  compiled->cachecount++;
+
+  /* Collect entries with literal patterns equal to the source ID and
+   * with prefix patterns matching each leading portion of the source ID */
+  for (idx = 0; idx <= sidlength; idx++)
+  {
+    key = lm_findkey (compiled, sid, idx, prefixhash, 1);
+
+    for (kidx = 0; key->key && kidx < key->count; kidx++)
+      if (lm_appendindex (&slot->entries, &slot->count, key->entries[kidx]))
+        goto error_return;
+
+    if (idx < sidlength)
+      prefixhash = (prefixhash ^ (uint8_t)sid[idx]) * LM_FNV_PRIME;
+  }
+
+  key = lm_findkey (compiled, sid, sidlength, hash, 0);
+
+  for (kidx = 0; key->key && kidx < key->count; kidx++)
+    if (lm_appendindex (&slot->entries, &slot->count, key->entries[kidx]))
+      goto error_return;
+
+  /* Collect entries with general globbing patterns */
+  for (gidx = 0; gidx < compiled->globcount; gidx++)
+  {
+    if (ms_globmatch (sid, compiled->entries[compiled->globs[gidx]].selection->sidpattern))
+      if (lm_appendindex (&slot->entries, &slot->count, compiled->globs[gidx]))
+        goto error_return;
+  }
+
+  /* Sort entry indices into original selection order */
+  if (slot->count > 1)
+    qsort (slot->entries, slot->count, sizeof (uint32_t), lm_cmpindex);
+
+  return slot;
+
+error_return:
+  /* Remove the new slot, the last in its probe sequence */
+  libmseed_memory.free (slot->sid);
+  if (slot->entries)
+    libmseed_memory.free (slot->entries);
+  memset (slot, 0, sizeof (LMSelectCache));
+  compiled->cachecount--;
+
+  return NULL;
+}
+
+/***************************************************************************
+ * lm_appendindex:
+ *
+ * Append an index to a dynamically allocated array, growing the array
+ * in powers of 2.
+ *
+ * Returns 0 on success and -1 on error.
+ ***************************************************************************/
+static int
+lm_appendindex (uint32_t **indices, uint32_t *count, uint32_t index)
+{
+  uint32_t *newindices;
+
+  /* Grow when count is 0 or a power of 2 */
+  if ((*count & (*count - 1)) == 0)
+  {
+    newindices = (uint32_t *)libmseed_memory.realloc (
+        *indices, sizeof (uint32_t) * ((*count) ? *count * 2 : 1));
+
+    if (!newindices)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return -1;
+    }
+
+    *indices = newindices;
+  }
+
+  (*indices)[(*count)++] = index;
+
+  return 0;
+}
+
 /***************************************************************************
  * ms_isinteger:
  *
@@ -0,0 +1,624 @@
+/***************************************************************************
+ * Vectorized (SIMD) support routines with run time dispatch.
+ *
+ * The routines in this file select a vector implementation based on
+ * the capabilities of the host CPU, detected once, and complete any
+ * remainder with portable scalar code.  Builds without vector support
+ * use the scalar code for all quantities.
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2026 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#include <memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libmseed.h"
+#include "simdutils.h"
+
+#if LM_SIMD_X86
+#include <immintrin.h>
+
+#define LM_TARGET_SSSE3 __attribute__ ((target ("ssse3")))
+#define LM_TARGET_AVX2 __attribute__ ((target ("avx2")))
+#endif
+
+/* Relaxed atomic load and store of the detected level, which is the
+ * same for every thread so no ordering is needed */
+#if defined(LMP_WIN)
+#define LM_LOAD_LEVEL(var) InterlockedCompareExchange ((LONG volatile *)&(var), 0, 0)
+#define LM_STORE_LEVEL(var, value) InterlockedExchange ((LONG volatile *)&(var), (value))
+#else
+#define LM_LOAD_LEVEL(var) __atomic_load_n (&(var), __ATOMIC_RELAXED)
+#define LM_STORE_LEVEL(var, value) __atomic_store_n (&(var), (value), __ATOMIC_RELAXED)
+#endif
+
+/* Byte shuffle masks for 16-byte vectors.  An index with the high bit
+ * set produces a zero byte. */
+static const uint8_t identity_mask[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static const uint8_t bswap2_mask[16] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+static const uint8_t bswap4_mask[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+static const uint8_t bswap8_mask[16] = {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+
+/* Select the low 16 bits of each 32-bit quantity, in native or swapped order */
+static const uint8_t narrow_mask[16] = {0,    1,    4,    5,    8,    9,    12,   13,
+                                        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
+static const uint8_t narrow_swap_mask[16] = {1,    0,    5,    4,    9,    8,    13,   12,
+                                             0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80};
+
+/***************************************************************************
+ * lm_simd_level:
+ *
+ * Determine the SIMD capability level of the host CPU.  The detection
+ * is performed on the first call and the result retained atomically,
+ * concurrent first calls all detect and store the same value.
+ *
+ * Returns one of the LM_SIMD_* levels.
+ ***************************************************************************/
+int
+lm_simd_level (void)
+{
+#if defined(LMP_WIN)
+  static LONG level = -1;
+#else
+  static int level = -1;
+#endif
+  int detected;
+
+  if ((detected = (int)LM_LOAD_LEVEL (level)) >= 0)
+    return detected;
+
+  detected = LM_SIMD_NONE;
+
+#if LM_SIMD_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2"))
+    detected = LM_SIMD_AVX2;
+  else if (__builtin_cpu_supports ("ssse3"))
+    detected = LM_SIMD_SSSE3;
+#endif
+
+  LM_STORE_LEVEL (level, detected);
+
+  return detected;
+} /* End of lm_simd_level() */
+
+#if LM_SIMD_X86
+/* Shuffle the bytes of each 16-byte block of src into dst using mask,
+ * returning the number of bytes processed */
+LM_TARGET_SSSE3 static uint64_t
+shuffle_copy_ssse3 (uint8_t *dst, const uint8_t *src, uint64_t nbytes, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  uint64_t offset;
+
+  for (offset = 0; offset + 16 <= nbytes; offset += 16)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + offset));
+    _mm_storeu_si128 ((__m128i *)(dst + offset), _mm_shuffle_epi8 (v, vmask));
+  }
+
+  return offset;
+}
+
+LM_TARGET_AVX2 static uint64_t
+shuffle_copy_avx2 (uint8_t *dst, const uint8_t *src, uint64_t nbytes, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  __m256i vmask2 = _mm256_inserti128_si256 (_mm256_castsi128_si256 (vmask), vmask, 1);
+  uint64_t offset;
+
+  for (offset = 0; offset + 32 <= nbytes; offset += 32)
+  {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *)(src + offset));
+    _mm256_storeu_si256 ((__m256i *)(dst + offset), _mm256_shuffle_epi8 (v, vmask2));
+  }
+
+  if (offset + 16 <= nbytes)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i *)(src + offset));
+    _mm_storeu_si128 ((__m128i *)(dst + offset), _mm_shuffle_epi8 (v, vmask));
+    offset += 16;
+  }
+
+  return offset;
+}
+
+/* Widen 16-bit integers to 32-bit integers after shuffling the input
+ * bytes with mask, returning the number of samples processed */
+LM_TARGET_SSSE3 static uint64_t
+int16_to_int32_ssse3 (int32_t *dst, const uint8_t *src, uint64_t count, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  uint64_t idx;
+
+  for (idx = 0; idx + 8 <= count; idx += 8)
+  {
+    __m128i v = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)(src + idx * 2)), vmask);
+
+    /* Duplicate each 16-bit value into a 32-bit lane and sign extend with an arithmetic shift */
+    _mm_storeu_si128 ((__m128i *)(dst + idx), _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16));
+    _mm_storeu_si128 ((__m128i *)(dst + idx + 4), _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16));
+  }
+
+  return idx;
+}
+
+LM_TARGET_AVX2 static uint64_t
+int16_to_int32_avx2 (int32_t *dst, const uint8_t *src, uint64_t count, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  __m256i vmask2 = _mm256_inserti128_si256 (_mm256_castsi128_si256 (vmask), vmask, 1);
+  uint64_t idx;
+
+  for (idx = 0; idx + 16 <= count; idx += 16)
+  {
+    __m256i v = _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *)(src + idx * 2)), vmask2);
+
+    _mm256_storeu_si256 ((__m256i *)(dst + idx),
+                         _mm256_cvtepi16_epi32 (_mm256_castsi256_si128 (v)));
+    _mm256_storeu_si256 ((__m256i *)(dst + idx + 8),
+                         _mm256_cvtepi16_epi32 (_mm256_extracti128_si256 (v, 1)));
+  }
+
+  return idx;
+}
+
+/* Truncate 32-bit integers to 16-bit integers, selecting (and possibly
+ * swapping) the low order bytes with mask, returning the number of
+ * samples processed */
+LM_TARGET_SSSE3 static uint64_t
+int32_to_int16_ssse3 (uint8_t *dst, const int32_t *src, uint64_t count, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  uint64_t idx;
+
+  for (idx = 0; idx + 8 <= count; idx += 8)
+  {
+    __m128i a = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)(src + idx)), vmask);
+    __m128i b = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *)(src + idx + 4)), vmask);
+
+    _mm_storeu_si128 ((__m128i *)(dst + idx * 2), _mm_unpacklo_epi64 (a, b));
+  }
+
+  return idx;
+}
+
+LM_TARGET_AVX2 static uint64_t
+int32_to_int16_avx2 (uint8_t *dst, const int32_t *src, uint64_t count, const uint8_t *mask)
+{
+  __m128i vmask = _mm_loadu_si128 ((const __m128i *)mask);
+  __m256i vmask2 = _mm256_inserti128_si256 (_mm256_castsi128_si256 (vmask), vmask, 1);
+  uint64_t idx;
+
+  for (idx = 0; idx + 16 <= count; idx += 16)
+  {
+    __m256i a = _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *)(src + idx)), vmask2);
+    __m256i b = _mm256_shuffle_epi8 (_mm256_loadu_si256 ((const __m256i *)(src + idx + 8)), vmask2);
+
+    /* Each 128-bit lane holds 4 results in its low 64 bits, gather them in order */
+    __m256i v = _mm256_permute4x64_epi64 (_mm256_unpacklo_epi64 (a, b), _MM_SHUFFLE (3, 1, 2, 0));
+
+    _mm256_storeu_si256 ((__m256i *)(dst + idx * 2), v);
+  }
+
+  return idx;
+}
+
+/* Test 16 (SSSE3) or 32 (AVX2) positions at a time for a record header
+ * signature, returning the offset of the first match or of the first
+ * position not tested */
+LM_TARGET_SSSE3 static uint64_t
+find_signature_ssse3 (const uint8_t *buffer, uint64_t length)
+{
+  const __m128i ascii_m = _mm_set1_epi8 ('M');
+  const __m128i ascii_s = _mm_set1_epi8 ('S');
+  const __m128i three = _mm_set1_epi8 (3);
+  const __m128i ascii_d = _mm_set1_epi8 ('D');
+  const __m128i ascii_r = _mm_set1_epi8 ('R');
+  const __m128i ascii_q = _mm_set1_epi8 ('Q');
+  const __m128i space = _mm_set1_epi8 (' ');
+  const __m128i zero = _mm_setzero_si128 ();
+  uint64_t offset;
+  int match;
+
+  for (offset = 0; offset + 16 + LM_SIGNATURE_SPAN - 1 <= length; offset += 16)
+  {
+    __m128i v0 = _mm_loadu_si128 ((const __m128i *)(buffer + offset));
+    __m128i v1 = _mm_loadu_si128 ((const __m128i *)(buffer + offset + 1));
+    __m128i v2 = _mm_loadu_si128 ((const __m128i *)(buffer + offset + 2));
+    __m128i v6 = _mm_loadu_si128 ((const __m128i *)(buffer + offset + 6));
+    __m128i v7 = _mm_loadu_si128 ((const __m128i *)(buffer + offset + 7));
+
+    __m128i ms3 =
+        _mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8 (v0, ascii_m), _mm_cmpeq_epi8 (v1, ascii_s)),
+                       _mm_cmpeq_epi8 (v2, three));
+    __m128i indicator =
+        _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v6, ascii_d), _mm_cmpeq_epi8 (v6, ascii_r)),
+                      _mm_or_si128 (_mm_cmpeq_epi8 (v6, ascii_q), _mm_cmpeq_epi8 (v6, ascii_m)));
+    __m128i terminator = _mm_or_si128 (_mm_cmpeq_epi8 (v7, space), _mm_cmpeq_epi8 (v7, zero));
+
+    match = _mm_movemask_epi8 (_mm_or_si128 (ms3, _mm_and_si128 (indicator, terminator)));
+
+    if (match)
+      return offset + __builtin_ctz ((unsigned int)match);
+  }
+
+  return offset;
+}
+
+LM_TARGET_AVX2 static uint64_t
+find_signature_avx2 (const uint8_t *buffer, uint64_t length)
+{
+  const __m256i ascii_m = _mm256_set1_epi8 ('M');
+  const __m256i ascii_s = _mm256_set1_epi8 ('S');
+  const __m256i three = _mm256_set1_epi8 (3);
+  const __m256i ascii_d = _mm256_set1_epi8 ('D');
+  const __m256i ascii_r = _mm256_set1_epi8 ('R');
+  const __m256i ascii_q = _mm256_set1_epi8 ('Q');
+  const __m256i space = _mm256_set1_epi8 (' ');
+  const __m256i zero = _mm256_setzero_si256 ();
+  uint64_t offset;
+  int match;
+
+  for (offset = 0; offset + 32 + LM_SIGNATURE_SPAN - 1 <= length; offset += 32)
+  {
+    __m256i v0 = _mm256_loadu_si256 ((const __m256i *)(buffer + offset));
+    __m256i v1 = _mm256_loadu_si256 ((const __m256i *)(buffer + offset + 1));
+    __m256i v2 = _mm256_loadu_si256 ((const __m256i *)(buffer + offset + 2));
+    __m256i v6 = _mm256_loadu_si256 ((const __m256i *)(buffer + offset + 6));
+    __m256i v7 = _mm256_loadu_si256 ((const __m256i *)(buffer + offset + 7));
+
+    __m256i ms3 = _mm256_and_si256 (
+        _mm256_and_si256 (_mm256_cmpeq_epi8 (v0, ascii_m), _mm256_cmpeq_epi8 (v1, ascii_s)),
+        _mm256_cmpeq_epi8 (v2, three));
+    __m256i indicator = _mm256_or_si256 (
+        _mm256_or_si256 (_mm256_cmpeq_epi8 (v6, ascii_d), _mm256_cmpeq_epi8 (v6, ascii_r)),
+        _mm256_or_si256 (_mm256_cmpeq_epi8 (v6, ascii_q), _mm256_cmpeq_epi8 (v6, ascii_m)));
+    __m256i terminator =
+        _mm256_or_si256 (_mm256_cmpeq_epi8 (v7, space), _mm256_cmpeq_epi8 (v7, zero));
+
+    match = _mm256_movemask_epi8 (_mm256_or_si256 (ms3, _mm256_and_si256 (indicator, terminator)));
+
+    if (match)
+      return offset + __builtin_ctz ((unsigned int)match);
+  }
+
+  return offset;
+}
+/* Compute Steim differences and bit width classes 4 (SSSE3) or 8 (AVX2)
+ * at a time, returning the number of differences processed.  The class
+ * of a difference is the number of class thresholds its magnitude
+ * exceeds, from the count of true (all bits set) comparisons. */
+LM_TARGET_SSSE3 static uint64_t
+steim_diffs_ssse3 (int32_t *diffs, uint8_t *classes, const int32_t *input, uint64_t count)
+{
+  const __m128i thresholds[8] = {_mm_set1_epi32 (7),     _mm_set1_epi32 (15),
+                                 _mm_set1_epi32 (31),    _mm_set1_epi32 (127),
+                                 _mm_set1_epi32 (511),   _mm_set1_epi32 (16383),
+                                 _mm_set1_epi32 (32767), _mm_set1_epi32 (536870911)};
+  uint64_t idx;
+  int32_t packed;
+  int tidx;
+
+  for (idx = 0; idx + 4 <= count; idx += 4)
+  {
+    __m128i d = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *)(input + idx + 1)),
+                               _mm_loadu_si128 ((const __m128i *)(input + idx)));
+    __m128i magnitude = _mm_xor_si128 (d, _mm_srai_epi32 (d, 31));
+    __m128i class = _mm_setzero_si128 ();
+
+    for (tidx = 0; tidx < 8; tidx++)
+      class = _mm_sub_epi32 (class, _mm_cmpgt_epi32 (magnitude, thresholds[tidx]));
+
+    _mm_storeu_si128 ((__m128i *)(diffs + idx), d);
+
+    /* Narrow the 4 classes to bytes */
+    class = _mm_packs_epi16 (_mm_packs_epi32 (class, class), class);
+    packed = _mm_cvtsi128_si32 (class);
+    memcpy (classes + idx, &packed, sizeof (packed));
+  }
+
+  return idx;
+}
+
+LM_TARGET_AVX2 static uint64_t
+steim_diffs_avx2 (int32_t *diffs, uint8_t *classes, const int32_t *input, uint64_t count)
+{
+  const __m256i thresholds[8] = {
+      _mm256_set1_epi32 (7),     _mm256_set1_epi32 (15),    _mm256_set1_epi32 (31),
+      _mm256_set1_epi32 (127),   _mm256_set1_epi32 (511),   _mm256_set1_epi32 (16383),
+      _mm256_set1_epi32 (32767), _mm256_set1_epi32 (536870911)};
+  uint64_t idx;
+  int tidx;
+
+  for (idx = 0; idx + 8 <= count; idx += 8)
+  {
+    __m256i d = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *)(input + idx + 1)),
+                                  _mm256_loadu_si256 ((const __m256i *)(input + idx)));
+    __m256i magnitude = _mm256_xor_si256 (d, _mm256_srai_epi32 (d, 31));
+    __m256i class = _mm256_setzero_si256 ();
+
+    for (tidx = 0; tidx < 8; tidx++)
+      class = _mm256_sub_epi32 (class, _mm256_cmpgt_epi32 (magnitude, thresholds[tidx]));
+
+    _mm256_storeu_si256 ((__m256i *)(diffs + idx), d);
+
+    /* Narrow the 8 classes to bytes, the 128-bit halves are packed together */
+    __m128i narrow = _mm_packs_epi32 (_mm256_castsi256_si128 (class),
+                                      _mm256_extracti128_si256 (class, 1));
+    narrow = _mm_packs_epi16 (narrow, narrow);
+    _mm_storel_epi64 ((__m128i *)(classes + idx), narrow);
+  }
+
+  return idx;
+}
+#endif /* LM_SIMD_X86 */
+
+/* Shuffle whole 16-byte blocks with the best available vector code,
+ * returning the number of bytes processed */
+static uint64_t
+shuffle_copy (uint8_t *dst, const uint8_t *src, uint64_t nbytes, const uint8_t *mask)
+{
+#if LM_SIMD_X86
+  int level = lm_simd_level ();
+
+  if (level >= LM_SIMD_AVX2)
+    return shuffle_copy_avx2 (dst, src, nbytes, mask);
+  else if (level >= LM_SIMD_SSSE3)
+    return shuffle_copy_ssse3 (dst, src, nbytes, mask);
+#else
+  (void)dst;
+  (void)src;
+  (void)nbytes;
+  (void)mask;
+#endif
+
+  return 0;
+}
+
+/***************************************************************************
+ * lm_bswap2_copy:
+ *
+ * Copy 2-byte quantities from src to dst, swapping the byte order.
+ ***************************************************************************/
+void
+lm_bswap2_copy (void *dst, const void *src, uint64_t count)
+{
+  uint8_t *dptr = (uint8_t *)dst;
+  const uint8_t *sptr = (const uint8_t *)src;
+  uint16_t value;
+  uint64_t idx;
+
+  idx = shuffle_copy (dptr, sptr, count * 2, bswap2_mask) / 2;
+
+  for (; idx < count; idx++)
+  {
+    memcpy (&value, sptr + idx * 2, sizeof (value));
+    ms_gswap2 (&value);
+    memcpy (dptr + idx * 2, &value, sizeof (value));
+  }
+} /* End of lm_bswap2_copy() */
+
+/***************************************************************************
+ * lm_bswap4_copy:
+ *
+ * Copy 4-byte quantities from src to dst, swapping the byte order.
+ ***************************************************************************/
+void
+lm_bswap4_copy (void *dst, const void *src, uint64_t count)
+{
+  uint8_t *dptr = (uint8_t *)dst;
+  const uint8_t *sptr = (const uint8_t *)src;
+  uint32_t value;
+  uint64_t idx;
+
+  idx = shuffle_copy (dptr, sptr, count * 4, bswap4_mask) / 4;
+
+  for (; idx < count; idx++)
+  {
+    memcpy (&value, sptr + idx * 4, sizeof (value));
+    ms_gswap4 (&value);
+    memcpy (dptr + idx * 4, &value, sizeof (value));
+  }
+} /* End of lm_bswap4_copy() */
+
+/***************************************************************************
+ * lm_bswap8_copy:
+ *
+ * Copy 8-byte quantities from src to dst, swapping the byte order.
+ ***************************************************************************/
+void
+lm_bswap8_copy (void *dst, const void *src, uint64_t count)
+{
+  uint8_t *dptr = (uint8_t *)dst;
+  const uint8_t *sptr = (const uint8_t *)src;
+  uint64_t value;
+  uint64_t idx;
+
+  idx = shuffle_copy (dptr, sptr, count * 8, bswap8_mask) / 8;
+
+  for (; idx < count; idx++)
+  {
+    memcpy (&value, sptr + idx * 8, sizeof (value));
+    ms_gswap8 (&value);
+    memcpy (dptr + idx * 8, &value, sizeof (value));
+  }
+} /* End of lm_bswap8_copy() */
+
+/***************************************************************************
+ * lm_int16_to_int32:
+ *
+ * Widen 16-bit integers to 32-bit integers, swapping the byte order of
+ * the input if requested.  The input need not be aligned.
+ ***************************************************************************/
+void
+lm_int16_to_int32 (int32_t *dst, const void *src, uint64_t count, int swapflag)
+{
+  const uint8_t *sptr = (const uint8_t *)src;
+  int16_t value;
+  uint64_t idx = 0;
+
+#if LM_SIMD_X86
+  int level = lm_simd_level ();
+  const uint8_t *mask = (swapflag) ? bswap2_mask : identity_mask;
+
+  if (level >= LM_SIMD_AVX2)
+    idx = int16_to_int32_avx2 (dst, sptr, count, mask);
+  else if (level >= LM_SIMD_SSSE3)
+    idx = int16_to_int32_ssse3 (dst, sptr, count, mask);
+#endif
+
+  if (swapflag)
+  {
+    for (; idx < count; idx++)
+    {
+      memcpy (&value, sptr + idx * 2, sizeof (value));
+      ms_gswap2 (&value);
+      dst[idx] = (int32_t)value;
+    }
+  }
+  else
+  {
+    for (; idx < count; idx++)
+    {
+      memcpy (&value, sptr + idx * 2, sizeof (value));
+      dst[idx] = (int32_t)value;
+    }
+  }
+} /* End of lm_int16_to_int32() */
+
+/***************************************************************************
+ * lm_int32_to_int16:
+ *
+ * Truncate 32-bit integers to 16-bit integers, swapping the byte order
+ * of the output if requested.  The output need not be aligned.
+ ***************************************************************************/
+void
+lm_int32_to_int16 (void *dst, const int32_t *src, uint64_t count, int swapflag)
+{
+  uint8_t *dptr = (uint8_t *)dst;
+  int16_t value;
+  uint64_t idx = 0;
+
+#if LM_SIMD_X86
+  int level = lm_simd_level ();
+  const uint8_t *mask = (swapflag) ? narrow_swap_mask : narrow_mask;
+
+  if (level >= LM_SIMD_AVX2)
+    idx = int32_to_int16_avx2 (dptr, src, count, mask);
+  else if (level >= LM_SIMD_SSSE3)
+    idx = int32_to_int16_ssse3 (dptr, src, count, mask);
+#else
+  (void)narrow_mask;
+  (void)narrow_swap_mask;
+  (void)identity_mask;
+#endif
+
+  if (swapflag)
+  {
+    for (; idx < count; idx++)
+    {
+      value = (int16_t)src[idx];
+      ms_gswap2 (&value);
+      memcpy (dptr + idx * 2, &value, sizeof (value));
+    }
+  }
+  else
+  {
+    for (; idx < count; idx++)
+    {
+      value = (int16_t)src[idx];
+      memcpy (dptr + idx * 2, &value, sizeof (value));
+    }
+  }
+} /* End of lm_int32_to_int16() */
+
+/***************************************************************************
+ * lm_find_signature:
+ *
+ * Search a buffer for the signature of a miniSEED record header, the
+ * quick tests that must pass at the start of any record:
+ *  - miniSEED 3: 'M', 'S' and a format version of 3
+ *  - miniSEED 2: a data/quality indicator at offset 6 followed by a
+ *    space or NUL at offset 7
+ *
+ * Positions are tested only when LM_SIGNATURE_SPAN bytes are available.
+ * A matching position must be confirmed with the full header tests.
+ *
+ * Returns the offset of the first matching position, or of the first
+ * position too close to the end of the buffer to be tested.
+ ***************************************************************************/
+uint64_t
+lm_find_signature (const char *buffer, uint64_t length)
+{
+  const uint8_t *bptr = (const uint8_t *)buffer;
+  uint64_t offset = 0;
+
+#if LM_SIMD_X86
+  int level = lm_simd_level ();
+
+  if (level >= LM_SIMD_AVX2)
+    offset = find_signature_avx2 (bptr, length);
+  else if (level >= LM_SIMD_SSSE3)
+    offset = find_signature_ssse3 (bptr, length);
+#endif
+
+  for (; offset + LM_SIGNATURE_SPAN <= length; offset++)
+  {
+    if (bptr[offset] == 'M' && bptr[offset + 1] == 'S' && bptr[offset + 2] == 3)
+      return offset;
+
+    if (MS2_ISDATAINDICATOR (bptr[offset + 6]) &&
+        (bptr[offset + 7] == ' ' || bptr[offset + 7] == '\0'))
+      return offset;
+  }
+
+  return offset;
+} /* End of lm_find_signature() */
+
+/***************************************************************************
+ * lm_steim_diffs:
+ *
+ * Compute count differences between consecutive samples of input,
+ * which must contain count + 1 samples, and the bit width class of
+ * each difference as determined by lm_steim_class().
+ *
+ * Differences are calculated with wrap-around, matching the scalar
+ * difference of unsigned values.
+ ***************************************************************************/
+void
+lm_steim_diffs (int32_t *diffs, uint8_t *classes, const int32_t *input, uint64_t count)
+{
+  uint64_t idx = 0;
+
+#if LM_SIMD_X86
+  int level = lm_simd_level ();
+
+  if (level >= LM_SIMD_AVX2)
+    idx = steim_diffs_avx2 (diffs, classes, input, count);
+  else if (level >= LM_SIMD_SSSE3)
+    idx = steim_diffs_ssse3 (diffs, classes, input, count);
+#endif
+
+  for (; idx < count; idx++)
+  {
+    diffs[idx] = (int32_t)((uint32_t)input[idx + 1] - (uint32_t)input[idx]);
+    classes[idx] = lm_steim_class (diffs[idx]);
+  }
+} /* End of lm_steim_diffs() */
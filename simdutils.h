@@ -0,0 +1,104 @@
+/***************************************************************************
+ * Interface declarations for the vectorized (SIMD) support routines in
+ * simdutils.c
+ *
+ * This file is part of the miniSEED Library.
+ *
+ * Copyright (c) 2026 Chad Trabant, EarthScope Data Services
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ***************************************************************************/
+
+#ifndef SIMDUTILS_H
+#define SIMDUTILS_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libmseed.h"
+
+/* Vector code paths are compiled for x86 with GCC-compatible compilers,
+ * which support per-function target attributes and run time CPU feature
+ * detection.  All other builds use the portable scalar code. */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LM_SIMD_X86 1
+#else
+#define LM_SIMD_X86 0
+#endif
+
+/* Host SIMD capability levels, in increasing order */
+#define LM_SIMD_NONE 0  /* Scalar code only */
+#define LM_SIMD_SSSE3 1 /* x86 SSSE3, 128-bit byte shuffles */
+#define LM_SIMD_AVX2 2  /* x86 AVX2, 256-bit integer vectors */
+
+/* Return the SIMD capability level of the host, detected once */
+extern int lm_simd_level (void);
+
+/* Copy count 2, 4 or 8 byte quantities from src to dst, swapping the
+ * byte order of each.  The buffers must not overlap. */
+extern void lm_bswap2_copy (void *dst, const void *src, uint64_t count);
+extern void lm_bswap4_copy (void *dst, const void *src, uint64_t count);
+extern void lm_bswap8_copy (void *dst, const void *src, uint64_t count);
+
+/* Widen count 16-bit integers at src to 32-bit integers at dst,
+ * swapping the byte order of the input if swapflag is set */
+extern void lm_int16_to_int32 (int32_t *dst, const void *src, uint64_t count, int swapflag);
+
+/* Truncate count 32-bit integers at src to 16-bit integers at dst,
+ * swapping the byte order of the output if swapflag is set */
+extern void lm_int32_to_int16 (void *dst, const int32_t *src, uint64_t count, int swapflag);
+
+/* Number of bytes needed to test a position for a record header signature */
+#define LM_SIGNATURE_SPAN 8
+
+/* Return the offset of the first position in buffer that starts a
+ * miniSEED 3 ("MS" and version 3) or miniSEED 2 (data/quality indicator
+ * followed by a space or NUL at offset 6) header signature, or the first
+ * position too close to the end of the buffer to be tested */
+extern uint64_t lm_find_signature (const char *buffer, uint64_t length);
+
+/* Steim difference bit width classes, the smallest of the widths used
+ * by Steim1 and Steim2 encodings able to represent a difference */
+#define LM_STEIM_4BIT 0
+#define LM_STEIM_5BIT 1
+#define LM_STEIM_6BIT 2
+#define LM_STEIM_8BIT 3
+#define LM_STEIM_10BIT 4
+#define LM_STEIM_15BIT 5
+#define LM_STEIM_16BIT 6
+#define LM_STEIM_30BIT 7
+#define LM_STEIM_32BIT 8
+
+/* Return the bit width class of a Steim difference */
+static inline uint8_t
+lm_steim_class (int32_t diff)
+{
+  /* Magnitude, with negative values mapped to their one's complement */
+  int32_t magnitude = diff ^ (diff >> 31);
+
+  return (uint8_t)((magnitude > 7) + (magnitude > 15) + (magnitude > 31) + (magnitude > 127) +
+                   (magnitude > 511) + (magnitude > 16383) + (magnitude > 32767) +
+                   (magnitude > 536870911));
+}
+
+/* Compute count differences between consecutive samples of input,
+ * which must hold count + 1 samples, and the class of each difference */
+extern void lm_steim_diffs (int32_t *diffs, uint8_t *classes, const int32_t *input,
+                            uint64_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,350 @@
+#include <libmseed.h>
+#include <tau/tau.h>
+
+#include "testdata.h"
+
+/* Archive written by tests, removed by the test Makefile "clean" target */
+#define TESTARCHIVE "testdata-archive"
+#define TESTARCHIVE_DIR TESTARCHIVE "/2012/XX/TEST/"
+#define TESTARCHIVE_BHZ_133 TESTARCHIVE_DIR "BHZ.D/XX.TEST..BHZ.D.2012.133"
+#define TESTARCHIVE_BHZ_134 TESTARCHIVE_DIR "BHZ.D/XX.TEST..BHZ.D.2012.134"
+#define TESTARCHIVE_BHN_133 TESTARCHIVE_DIR "BHN.D/XX.TEST..BHN.D.2012.133"
+#define TESTARCHIVE_LHZ_133 TESTARCHIVE_DIR "LHZ.D/XX.TEST..LHZ.D.2012.133"
+#define TESTARCHIVE_LHZ_134 TESTARCHIVE_DIR "LHZ.D/XX.TEST..LHZ.D.2012.134"
+
+/* Count the samples and records of a file, and return the earliest and
+ * latest sample times */
+static int64_t
+count_samples (const char *path, int64_t *records, nstime_t *earliest, nstime_t *latest)
+{
+  MS3Record *msr = NULL;
+  int64_t samples = 0;
+
+  *records = 0;
+  *earliest = NSTUNSET;
+  *latest = NSTUNSET;
+
+  while (ms3_readmsr (&msr, path, 0, 0) == MS_NOERROR)
+  {
+    samples += msr->samplecnt;
+    (*records)++;
+
+    if (*earliest == NSTUNSET || msr->starttime < *earliest)
+      *earliest = msr->starttime;
+    if (*latest == NSTUNSET || msr3_endtime (msr) > *latest)
+      *latest = msr3_endtime (msr);
+  }
+
+  ms3_readmsr (&msr, NULL, 0, 0);
+
+  return samples;
+}
+
+static void
+init_record (MS3Record *msr, const char *sid, const char *starttime, int32_t *samples)
+{
+  int idx;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    samples[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  msr->reclen = 512;
+  msr->pubversion = 1;
+  msr->starttime = ms_timestr2nstime (starttime);
+  strcpy (msr->sid, sid);
+  msr->samprate = 40.0;
+  msr->encoding = DE_STEIM2;
+  msr->numsamples = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = samples;
+  msr->sampletype = 'i';
+}
+
+TEST (archive, split_days)
+{
+  MS3ArchiveWriter *archive = NULL;
+  MS3Record *msr = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  nstime_t midnight = ms_timestr2nstime ("2012-05-13T00:00:00");
+  nstime_t earliest;
+  nstime_t latest;
+  int64_t records;
+  int64_t samples;
+  int64_t rv;
+
+  remove (TESTARCHIVE_BHZ_133);
+  remove (TESTARCHIVE_BHZ_134);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  /* 499 samples at 40 Hz, 400 before midnight */
+  init_record (msr, "FDSN:XX_TEST__B_H_Z", "2012-05-12T23:59:50", isinedata);
+
+  archive = ms3_archive_open (TESTARCHIVE, 0, 0, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  rv = ms3_archive_write_msr (archive, msr, 0, 0);
+  CHECK (rv > 0, "ms3_archive_write_msr() returned unexpected value");
+  CHECK (msr->numsamples == SINE_DATA_SAMPLES - 1, "ms3_archive_write_msr() modified the record");
+
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+  CHECK (archive == NULL, "ms3_archive_close() did not set pointer to NULL");
+
+  samples = count_samples (TESTARCHIVE_BHZ_133, &records, &earliest, &latest);
+  CHECK (samples == 400, "Unexpected sample count in first day file");
+  CHECK (earliest == msr->starttime, "Unexpected start time in first day file");
+  CHECK (latest < midnight, "First day file extends into next day");
+
+  samples = count_samples (TESTARCHIVE_BHZ_134, &records, &earliest, &latest);
+  CHECK (samples == 99, "Unexpected sample count in second day file");
+  CHECK (earliest == midnight, "Second day file does not start at midnight");
+
+  remove (TESTARCHIVE_LHZ_133);
+  remove (TESTARCHIVE_LHZ_134);
+
+  /* 100 samples at 0.1 Hz stored as a sample period, 60 before midnight */
+  init_record (msr, "FDSN:XX_TEST__L_H_Z", "2012-05-12T23:50:00", isinedata);
+  msr->samprate = -10.0;
+  msr->numsamples = 100;
+  msr->samplecnt = 100;
+  msr->datasize = 100 * sizeof (int32_t);
+
+  archive = ms3_archive_open (TESTARCHIVE, 0, 0, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  rv = ms3_archive_write_msr (archive, msr, 0, 0);
+  CHECK (rv == 2, "ms3_archive_write_msr() did not split sub-Hz record at midnight");
+
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+
+  samples = count_samples (TESTARCHIVE_LHZ_133, &records, &earliest, &latest);
+  CHECK (samples == 60, "Unexpected sample count in first sub-Hz day file");
+  CHECK (latest < midnight, "First sub-Hz day file extends into next day");
+
+  samples = count_samples (TESTARCHIVE_LHZ_134, &records, &earliest, &latest);
+  CHECK (samples == 40, "Unexpected sample count in second sub-Hz day file");
+  CHECK (earliest == midnight, "Second sub-Hz day file does not start at midnight");
+
+  remove (TESTARCHIVE_LHZ_133);
+  remove (TESTARCHIVE_LHZ_134);
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
+TEST (archive, reopen_files)
+{
+  MS3ArchiveWriter *archive = NULL;
+  MS3Record *msr = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  nstime_t starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  nstime_t earliest;
+  nstime_t latest;
+  int64_t records;
+  int64_t samples;
+  int idx;
+
+  remove (TESTARCHIVE_BHZ_133);
+  remove (TESTARCHIVE_BHN_133);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  init_record (msr, "FDSN:XX_TEST__B_H_Z", "2012-05-12T00:00:00", isinedata);
+
+  /* Alternate channels with a single open file, closing and appending on each switch */
+  archive = ms3_archive_open (TESTARCHIVE, 1, 1024, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  for (idx = 0; idx < 4; idx++)
+  {
+    strcpy (msr->sid, (idx % 2) ? "FDSN:XX_TEST__B_H_N" : "FDSN:XX_TEST__B_H_Z");
+    msr->starttime = starttime + (nstime_t)(idx / 2) * 60 * NSTMODULUS;
+
+    CHECK (ms3_archive_write_msr (archive, msr, 0, 0) == 4,
+           "ms3_archive_write_msr() returned unexpected value");
+  }
+
+  CHECK (ms3_archive_flush (archive, 0) == 0, "ms3_archive_flush() returned unexpected error");
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+
+  samples = count_samples (TESTARCHIVE_BHZ_133, &records, &earliest, &latest);
+  CHECK (samples == 2 * (SINE_DATA_SAMPLES - 1), "Unexpected sample count in BHZ file");
+  CHECK (records == 8, "Unexpected record count in BHZ file");
+
+  samples = count_samples (TESTARCHIVE_BHN_133, &records, &earliest, &latest);
+  CHECK (samples == 2 * (SINE_DATA_SAMPLES - 1), "Unexpected sample count in BHN file");
+  CHECK (records == 8, "Unexpected record count in BHN file");
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
+TEST (archive, write_record)
+{
+  MS3ArchiveWriter *archive = NULL;
+  MS3Record *msr = NULL;
+  char reference[4096];
+  char archived[4096];
+  size_t referencelength;
+  size_t archivedlength;
+  FILE *fp;
+  int rv;
+
+  remove (TESTARCHIVE_BHZ_133);
+
+  archive = ms3_archive_open (TESTARCHIVE, 0, 0, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  while ((rv = ms3_readmsr (&msr, "data/reference-testdata-steim2.mseed3", 0, 0)) == MS_NOERROR)
+  {
+    CHECK (ms3_archive_write_record (archive, msr) == 0,
+           "ms3_archive_write_record() returned unexpected error");
+  }
+  CHECK (rv == MS_ENDOFFILE, "ms3_readmsr() did not reach end of file");
+  ms3_readmsr (&msr, NULL, 0, 0);
+
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+
+  fp = fopen ("data/reference-testdata-steim2.mseed3", "rb");
+  REQUIRE (fp != NULL, "Cannot open reference file");
+  referencelength = fread (reference, 1, sizeof (reference), fp);
+  fclose (fp);
+
+  fp = fopen (TESTARCHIVE_BHZ_133, "rb");
+  REQUIRE (fp != NULL, "Cannot open archive file");
+  archivedlength = fread (archived, 1, sizeof (archived), fp);
+  fclose (fp);
+
+  CHECK (archivedlength == referencelength, "Archived records differ in length from original");
+  CHECK (!memcmp (archived, reference, referencelength), "Archived records differ from original");
+}
+
+TEST (archive, readtracelist)
+{
+  MS3ArchiveWriter *archive = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3Selections *selections = NULL;
+  MS3Record *msr = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  nstime_t midnight = ms_timestr2nstime ("2012-05-13T00:00:00");
+  int rv;
+
+  remove (TESTARCHIVE_BHZ_133);
+  remove (TESTARCHIVE_BHZ_134);
+  remove (TESTARCHIVE_BHN_133);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  /* BHZ across midnight into day 134, BHN in day 133 */
+  archive = ms3_archive_open (TESTARCHIVE, 0, 0, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  init_record (msr, "FDSN:XX_TEST__B_H_Z", "2012-05-12T23:59:50", isinedata);
+  CHECK (ms3_archive_write_msr (archive, msr, 0, 0) > 0,
+         "ms3_archive_write_msr() returned unexpected value");
+  init_record (msr, "FDSN:XX_TEST__B_H_N", "2012-05-12T12:00:00", isinedata);
+  CHECK (ms3_archive_write_msr (archive, msr, 0, 0) > 0,
+         "ms3_archive_write_msr() returned unexpected value");
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+
+  /* All data */
+  rv = ms3_archive_readtracelist (&mstl, TESTARCHIVE, NULL, NULL, 0, 0, 0);
+  CHECK (rv == MS_NOERROR, "ms3_archive_readtracelist() returned unexpected error");
+  REQUIRE (mstl != NULL, "ms3_archive_readtracelist() did not create a trace list");
+  CHECK (mstl->numtraceids == 2, "Unexpected number of trace IDs");
+  mstl3_free (&mstl, 0);
+
+  /* Single channel after midnight, reading the day before midnight for
+   * records crossing it */
+  CHECK (ms3_addselect_comp (&selections, "XX", "TEST", "", "BHZ", midnight, NSTUNSET, 0) == 0,
+         "ms3_addselect_comp() returned unexpected error");
+  rv = ms3_archive_readtracelist (&mstl, TESTARCHIVE, NULL, selections, 0, MSF_UNPACKDATA, 0);
+  CHECK (rv == MS_NOERROR, "ms3_archive_readtracelist() returned unexpected error");
+  REQUIRE (mstl != NULL, "ms3_archive_readtracelist() did not create a trace list");
+  REQUIRE (mstl->numtraceids == 1, "Unexpected number of trace IDs");
+  CHECK_STREQ (mstl->traces.next[0]->sid, "FDSN:XX_TEST__B_H_Z");
+  CHECK (mstl->traces.next[0]->first->starttime == midnight,
+         "Unexpected start time of selected data");
+  CHECK (mstl->traces.next[0]->first->samplecnt == 99, "Unexpected sample count of selected data");
+  mstl3_free (&mstl, 0);
+  ms3_freeselections (selections);
+  selections = NULL;
+
+  /* No matching network */
+  CHECK (ms3_addselect (&selections, "FDSN:YY_*", NSTUNSET, NSTUNSET, 0) == 0,
+         "ms3_addselect() returned unexpected error");
+  rv = ms3_archive_readtracelist (&mstl, TESTARCHIVE, NULL, selections, 0, 0, 0);
+  CHECK (rv == MS_NOERROR, "ms3_archive_readtracelist() returned unexpected error");
+  REQUIRE (mstl != NULL, "ms3_archive_readtracelist() did not create a trace list");
+  CHECK (mstl->numtraceids == 0, "Unexpected data for unmatched selection");
+  mstl3_free (&mstl, 0);
+  ms3_freeselections (selections);
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
+TEST (archive, readtracelist_probe)
+{
+  MS3ArchiveWriter *archive = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3Selections *selections = NULL;
+  MS3Record *msr = NULL;
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  const char *starttimes[] = {"2012-05-12T01:00:00", "2012-05-12T10:00:00",
+                              "2012-05-12T02:00:00"};
+  int idx;
+  int rv;
+
+  remove (TESTARCHIVE_BHZ_133);
+  remove (TESTARCHIVE_BHZ_134);
+  remove (TESTARCHIVE_BHN_133);
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  /* A day file whose first and last records span 01:00 to 02:00, with a
+   * record out of time order between them */
+  archive = ms3_archive_open (TESTARCHIVE, 0, 0, 0);
+  REQUIRE (archive != NULL, "ms3_archive_open() returned unexpected NULL");
+
+  for (idx = 0; idx < 3; idx++)
+  {
+    init_record (msr, "FDSN:XX_TEST__B_H_Z", starttimes[idx], isinedata);
+    CHECK (ms3_archive_write_msr (archive, msr, 0, 0) > 0,
+           "ms3_archive_write_msr() returned unexpected value");
+  }
+  CHECK (ms3_archive_close (&archive) == 0, "ms3_archive_close() returned unexpected error");
+
+  /* Within the span of the first and last records */
+  CHECK (ms3_addselect (&selections, "FDSN:XX_TEST__B_H_Z",
+                        ms_timestr2nstime ("2012-05-12T01:30:00"),
+                        ms_timestr2nstime ("2012-05-12T02:00:05"), 0) == 0,
+         "ms3_addselect() returned unexpected error");
+  rv = ms3_archive_readtracelist (&mstl, TESTARCHIVE, NULL, selections, 0, 0, 0);
+  CHECK (rv == MS_NOERROR, "ms3_archive_readtracelist() returned unexpected error");
+  REQUIRE (mstl != NULL, "ms3_archive_readtracelist() did not create a trace list");
+  CHECK (mstl->numtraceids == 1, "Data within the file span was not read");
+  mstl3_free (&mstl, 0);
+  ms3_freeselections (selections);
+  selections = NULL;
+
+  /* Outside the span of the first and last records the file is not read */
+  CHECK (ms3_addselect (&selections, "FDSN:XX_TEST__B_H_Z",
+                        ms_timestr2nstime ("2012-05-12T10:00:00"),
+                        ms_timestr2nstime ("2012-05-12T10:00:05"), 0) == 0,
+         "ms3_addselect() returned unexpected error");
+  rv = ms3_archive_readtracelist (&mstl, TESTARCHIVE, NULL, selections, 0, 0, 0);
+  CHECK (rv == MS_NOERROR, "ms3_archive_readtracelist() returned unexpected error");
+  REQUIRE (mstl != NULL, "ms3_archive_readtracelist() did not create a trace list");
+  CHECK (mstl->numtraceids == 0, "File outside the selected time was read");
+  mstl3_free (&mstl, 0);
+  ms3_freeselections (selections);
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
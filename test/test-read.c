@@ -11,6 +11,7 @@
 #include <io.h>
 #define SET_BINARY_MODE(fd) _setmode (fd, _O_BINARY)
 #else
+#include <sys/resource.h>
 #define SET_BINARY_MODE(fd) ((void)0)
 #endif
 
@@ -641,6 +642,92 @@ TEST (read, selection_nomatch)
   ms3_freeselections (selections);
 }
 
+/* Count records matching selections by reading every record and testing
+ * it with msr3_matchselect() after a full parse */
+static int64_t
+count_matching_records (const char *path, const MS3Selections *selections)
+{
+  MS3Record *msr = NULL;
+  MS3FileParam *msfp = NULL;
+  int64_t count = 0;
+
+  while (ms3_readmsr_r (&msfp, &msr, path, 0, 0) == MS_NOERROR)
+  {
+    if (msr3_matchselect (selections, msr, NULL))
+      count++;
+  }
+
+  ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+
+  return count;
+}
+
+TEST (read, selection_prefilter)
+{
+  const char *paths[] = {"data/testdata-3channel-signal.mseed2",
+                         "data/testdata-3channel-signal.mseed3",
+                         "data/testdata-unapplied-timecorrection.mseed2"};
+  MS3Record *msr = NULL;
+  MS3FileParam *msfp = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3Selections *selections = NULL;
+  char buffer[65536];
+  size_t bufferlength;
+  int64_t expected;
+  int64_t count;
+  nstime_t starttime;
+  nstime_t endtime;
+  FILE *fp;
+  int idx;
+  int rv;
+
+  for (idx = 0; idx < (int)(sizeof (paths) / sizeof (paths[0])); idx++)
+  {
+    /* Window starting within, and ending after, the first record */
+    rv = ms3_readmsr (&msr, paths[idx], 0, 0);
+    REQUIRE (rv == MS_NOERROR, "ms3_readmsr() did not return expected MS_NOERROR");
+    starttime = msr->starttime + NSTMODULUS / 1000;
+    endtime = msr3_endtime (msr) + (nstime_t)60 * NSTMODULUS;
+    ms3_readmsr (&msr, NULL, 0, 0);
+
+    rv = ms3_addselect (&selections, "FDSN:*_*_*_*_H_Z", starttime, endtime, 0);
+    REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+    rv = ms3_addselect (&selections, "FDSN:*_*_*_*_H_E", NSTUNSET, NSTUNSET, 0);
+    REQUIRE (rv == 0, "ms3_addselect() returned an unexpected error");
+
+    expected = count_matching_records (paths[idx], selections);
+    REQUIRE (expected > 0, "Selections unexpectedly match no records");
+
+    /* Records skipped using the fixed header must match a full parse */
+    count = 0;
+    while ((rv = ms3_readmsr_selection (&msfp, &msr, paths[idx], MSF_UNPACKDATA, selections,
+                                        0)) == MS_NOERROR)
+    {
+      CHECK (msr3_matchselect (selections, msr, NULL) != NULL,
+             "ms3_readmsr_selection() returned a record not matching selections");
+      count++;
+    }
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_selection() did not return expected MS_ENDOFFILE");
+    CHECK (count == expected, "ms3_readmsr_selection() returned unexpected record count");
+    ms3_readmsr_selection (&msfp, &msr, NULL, 0, NULL, 0);
+
+    /* Same test for buffer reading */
+    fp = fopen (paths[idx], "rb");
+    REQUIRE (fp != NULL, "Cannot open test data file");
+    bufferlength = fread (buffer, 1, sizeof (buffer), fp);
+    fclose (fp);
+    REQUIRE (bufferlength > 0 && bufferlength < sizeof (buffer), "Unexpected test data length");
+
+    count = mstl3_readbuffer_selection (&mstl, buffer, bufferlength, 0, MSF_UNPACKDATA, NULL,
+                                        selections, 0);
+    CHECK (count == expected, "mstl3_readbuffer_selection() returned unexpected record count");
+    mstl3_free (&mstl, 0);
+
+    ms3_freeselections (selections);
+    selections = NULL;
+  }
+}
+
 TEST (read, oddball)
 {
   MS3Record *msr = NULL;
@@ -718,6 +805,98 @@ TEST (read, error)
   ms3_readmsr (&msr, NULL, flags, 0);
 }
 
+/* Write a copy of a miniSEED file with blocks of non-data before, between
+ * and after two copies of the records.  The non-data includes decoy
+ * signatures that fail the full header tests. */
+static int
+write_noisy_copy (const char *inpath, const char *outpath)
+{
+  const char decoy3[] = {'M', 'S', 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 99, 0, 0};
+  const char decoy2[] = "ABCDEFD ";
+  char buffer[20000];
+  char noise[3000];
+  size_t length;
+  FILE *ifp;
+  FILE *ofp;
+  int idx;
+
+  if (!(ifp = fopen (inpath, "rb")))
+    return -1;
+
+  length = fread (buffer, 1, sizeof (buffer), ifp);
+  fclose (ifp);
+
+  /* Noise pattern in which consecutive bytes never form a signature */
+  for (idx = 0; idx < (int)sizeof (noise); idx++)
+    noise[idx] = (char)((idx * 37 + 11) & 0xFF);
+
+  memcpy (noise + 100, decoy3, sizeof (decoy3));
+  memcpy (noise + 1500, decoy2, sizeof (decoy2) - 1);
+  memcpy (noise + 2001, decoy3, sizeof (decoy3));
+
+  if (!(ofp = fopen (outpath, "wb")))
+    return -1;
+
+  fwrite (noise, 1, sizeof (noise), ofp);
+  fwrite (buffer, 1, length, ofp);
+  fwrite (noise, 1, 777, ofp);
+  fwrite (buffer, 1, length, ofp);
+  fwrite (noise, 1, 1234, ofp);
+  fclose (ofp);
+
+  return 0;
+}
+
+/* Verify that records are found between blocks of non-data with MSF_SKIPNOTDATA */
+TEST (read, skipnotdata)
+{
+  MS3FileParam *msfp = NULL;
+  MS3Record *msr = NULL;
+  const char *inpaths[] = {"data/testdata-oneseries-mixedlengths-mixedorder.mseed2",
+                           "data/testdata-oneseries-mixedlengths-mixedorder.mseed3"};
+  const char *outpath = "testdata-skipnotdata.mseed";
+  int64_t cleanrecords;
+  int64_t cleansamples;
+  int64_t records;
+  int64_t samples;
+  int pidx;
+  int rv;
+
+  /* Suppress error and warning messages by accumulating them */
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+
+  for (pidx = 0; pidx < 2; pidx++)
+  {
+    cleanrecords = cleansamples = 0;
+    while ((rv = ms3_readmsr_r (&msfp, &msr, inpaths[pidx], 0, 0)) == MS_NOERROR)
+    {
+      cleanrecords++;
+      cleansamples += msr->samplecnt;
+    }
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_r() did not return expected MS_ENDOFFILE");
+    ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+
+    REQUIRE (write_noisy_copy (inpaths[pidx], outpath) == 0, "Cannot write test file");
+
+    records = samples = 0;
+    while ((rv = ms3_readmsr_r (&msfp, &msr, outpath, MSF_SKIPNOTDATA, 0)) == MS_NOERROR)
+    {
+      records++;
+      samples += msr->samplecnt;
+    }
+    CHECK (rv == MS_ENDOFFILE, "ms3_readmsr_r() did not return expected MS_ENDOFFILE");
+    ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+
+    CHECK (records == 2 * cleanrecords, "Record count mismatch when skipping non-data");
+    CHECK (samples == 2 * cleansamples, "Sample count mismatch when skipping non-data");
+
+    /* Without skipping the non-data is not miniSEED */
+    rv = ms3_readmsr_r (&msfp, &msr, outpath, 0, 0);
+    CHECK (rv == MS_NOTSEED, "ms3_readmsr_r() did not return expected MS_NOTSEED");
+    ms3_readmsr_r (&msfp, &msr, NULL, 0, 0);
+  }
+}
+
 static char packbuf[1024];
 static int packbuflen = 0;
 
@@ -818,3 +997,135 @@ TEST (read, v2_b100_invalid_samplerate)
   msr3_free (&msr);
   msr3_free (&parsed);
 }
+
+TEST (read, mergereader)
+{
+  /* The first two inputs are in time order, all three in source identifier order */
+  const char *paths[] = {"data/reference-testdata-steim2.mseed3",
+                         "data/reference-testdata-steim1.mseed3",
+                         "data/testdata-3channel-signal.mseed3"};
+  int64_t expected[3] = {0, 0, 0};
+  MS3MergeReader *merge = NULL;
+  MS3Record *msr = NULL;
+  char lastsid[LM_SIDLEN];
+  nstime_t lasttime;
+  int64_t records;
+  int ordered;
+  int count;
+  int bysid;
+  int rv;
+  int idx;
+
+  for (idx = 0; idx < 3; idx++)
+  {
+    while (ms3_readmsr (&msr, paths[idx], 0, 0) == MS_NOERROR)
+      expected[idx]++;
+    ms3_readmsr (&msr, NULL, 0, 0);
+  }
+
+  for (bysid = 0; bysid <= 1; bysid++)
+  {
+    count = (bysid) ? 3 : 2;
+    merge = ms3_mergereader_open (paths, count, (int8_t)bysid, 0, 0);
+    REQUIRE (merge != NULL, "ms3_mergereader_open() returned unexpected NULL");
+
+    records = 0;
+    ordered = 1;
+    lastsid[0] = '\0';
+    lasttime = NSTUNSET;
+
+    while ((rv = ms3_mergereader_next (merge, &msr)) == MS_NOERROR)
+    {
+      if (bysid)
+      {
+        if (strcmp (msr->sid, lastsid) < 0 ||
+            (!strcmp (msr->sid, lastsid) && msr->starttime < lasttime))
+          ordered = 0;
+      }
+      else if (lasttime != NSTUNSET && msr->starttime < lasttime)
+      {
+        ordered = 0;
+      }
+
+      strcpy (lastsid, msr->sid);
+      lasttime = msr->starttime;
+      records++;
+    }
+
+    CHECK (rv == MS_ENDOFFILE, "ms3_mergereader_next() did not reach end of inputs");
+    CHECK (msr == NULL, "ms3_mergereader_next() returned a record at end of inputs");
+    CHECK (records == expected[0] + expected[1] + ((bysid) ? expected[2] : 0),
+           "Unexpected number of merged records");
+    CHECK (ordered, "Merged records are out of order");
+
+    ms3_mergereader_close (&merge);
+    CHECK (merge == NULL, "ms3_mergereader_close() did not set pointer to NULL");
+  }
+
+  /* No inputs */
+  merge = ms3_mergereader_open (paths, 0, 0, 0, 0);
+  REQUIRE (merge != NULL, "ms3_mergereader_open() returned unexpected NULL");
+  CHECK (ms3_mergereader_next (merge, &msr) == MS_ENDOFFILE,
+         "ms3_mergereader_next() returned unexpected value for no inputs");
+  ms3_mergereader_close (&merge);
+}
+
+TEST (read, mergereader_manyinputs)
+{
+  const char *paths[300];
+  MS3MergeReader *merge = NULL;
+  MS3Record *msr = NULL;
+  nstime_t lasttime = NSTUNSET;
+  int64_t records = 0;
+  int ordered = 1;
+  int decoded = 1;
+  int rv;
+  int idx;
+#if !defined(LMP_WIN)
+  struct rlimit limit;
+  struct rlimit original;
+  int limited = 0;
+#endif
+
+  /* 4 records in each input, 3 records of the byte range inputs */
+  for (idx = 0; idx < 300; idx++)
+    paths[idx] = (idx % 2) ? "data/reference-testdata-steim2.mseed2@512"
+                           : "data/reference-testdata-steim2.mseed3";
+
+#if !defined(LMP_WIN)
+  /* Fewer open files allowed than inputs */
+  if (getrlimit (RLIMIT_NOFILE, &original) == 0 && original.rlim_cur > 200)
+  {
+    limit = original;
+    limit.rlim_cur = 200;
+    limited = (setrlimit (RLIMIT_NOFILE, &limit) == 0);
+  }
+#endif
+
+  merge = ms3_mergereader_open (paths, 300, 0, MSF_PNAMERANGE, 0);
+  REQUIRE (merge != NULL, "ms3_mergereader_open() returned unexpected NULL");
+
+  while ((rv = ms3_mergereader_next (merge, &msr)) == MS_NOERROR)
+  {
+    if (lasttime != NSTUNSET && msr->starttime < lasttime)
+      ordered = 0;
+
+    if (msr3_unpack_data (msr, 0) != msr->samplecnt)
+      decoded = 0;
+
+    lasttime = msr->starttime;
+    records++;
+  }
+
+  ms3_mergereader_close (&merge);
+
+#if !defined(LMP_WIN)
+  if (limited)
+    setrlimit (RLIMIT_NOFILE, &original);
+#endif
+
+  CHECK (rv == MS_ENDOFFILE, "ms3_mergereader_next() did not reach end of inputs");
+  CHECK (records == 150 * 4 + 150 * 3, "Unexpected number of merged records");
+  CHECK (ordered, "Merged records are out of order");
+  CHECK (decoded, "Merged records of reopened inputs could not be decoded");
+}
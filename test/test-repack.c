@@ -2,6 +2,8 @@
 #include <math.h>
 #include <tau/tau.h>
 
+#include "testdata.h"
+
 extern int cmpfiles (char *fileA, char *fileB);
 
 /* Write test output files.  Reference files are at "data/reference-<name>" */
@@ -168,3 +170,165 @@ TEST (repack, v2_negative_time_correction)
   msr3_free (&msr);
   msr3_free (&parsed);
 }
+
+static int passthrough = 0;
+
+/* Collect records in packbuf, counting records passed through unchanged */
+static void
+record_handler_cut (char *record, int reclen, void *handlerdata)
+{
+  if (record == (char *)handlerdata)
+    passthrough++;
+
+  record_handler_buf (record, reclen, NULL);
+}
+
+TEST (repack, cut)
+{
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  MS3TraceSeg *seg;
+  MS3Selections *selections = NULL;
+  nstime_t origin = ms_timestr2nstime ("2012-05-12T00:00:00");
+  nstime_t starttime = origin + NSTMODULUS;
+  nstime_t endtime = origin + 10 * (nstime_t)NSTMODULUS;
+  char subhz[4096];
+  int32_t subhzdata[100];
+  int64_t records = 0;
+  int64_t rv;
+  int retcode;
+  int idx;
+
+  /* 499 Steim2 samples at 40 Hz in 4 records, cut to samples 40 through 400 */
+  packbuflen = 0;
+  passthrough = 0;
+  while ((retcode = ms3_readmsr (&msr, "data/reference-testdata-steim2.mseed3", 0, 0)) ==
+         MS_NOERROR)
+  {
+    rv = msr3_cut (msr, starttime, endtime, record_handler_cut, (void *)msr->record, 0, 0);
+    REQUIRE (rv >= 0, "msr3_cut() returned an error");
+    records += rv;
+  }
+  CHECK (retcode == MS_ENDOFFILE, "ms3_readmsr() did not reach end of file");
+  ms3_readmsr (&msr, NULL, 0, 0);
+
+  CHECK (records == 3, "msr3_cut() returned unexpected record count");
+  CHECK (passthrough == 1, "Record within the window was not passed through");
+
+  rv = mstl3_readbuffer (&mstl, packbuf, packbuflen, 0, MSF_UNPACKDATA, NULL, 0);
+  CHECK (rv == records, "mstl3_readbuffer() returned unexpected record count");
+  REQUIRE (mstl != NULL && mstl->numtraceids == 1, "Unexpected trace list of cut records");
+
+  seg = mstl->traces.next[0]->first;
+  CHECK (seg->next == NULL, "Cut records are not contiguous");
+  CHECK (seg->starttime == starttime, "Cut data do not start at window start");
+  CHECK (seg->endtime == endtime, "Cut data do not end at window end");
+  REQUIRE (seg->numsamples == 361, "Cut data have unexpected sample count");
+  CHECK (((int32_t *)seg->datasamples)[0] == (int32_t)dsinedata[40],
+         "Cut data start with unexpected sample");
+  CHECK (((int32_t *)seg->datasamples)[360] == (int32_t)dsinedata[400],
+         "Cut data end with unexpected sample");
+  mstl3_free (&mstl, 0);
+
+  /* Same cut of the file by selection */
+  REQUIRE (ms3_addselect (&selections, "FDSN:XX_TEST__B_H_Z", starttime, endtime, 0) == 0,
+           "ms3_addselect() returned unexpected error");
+
+  packbuflen = 0;
+  rv = ms3_cut_selection ("data/reference-testdata-steim2.mseed3", selections,
+                          record_handler_buf, NULL, 0, 0);
+  CHECK (rv == records, "ms3_cut_selection() returned unexpected record count");
+
+  rv = mstl3_readbuffer (&mstl, packbuf, packbuflen, 0, 0, NULL, 0);
+  CHECK (rv == records, "mstl3_readbuffer() returned unexpected record count");
+  REQUIRE (mstl != NULL && mstl->numtraceids == 1, "Unexpected trace list of cut records");
+  CHECK (mstl->traces.next[0]->first->samplecnt == 361, "Cut file has unexpected sample count");
+  mstl3_free (&mstl, 0);
+
+  ms3_freeselections (selections);
+
+  /* 100 samples at 0.1 Hz stored as a sample period, cut to samples 50 through 70 */
+  for (idx = 0; idx < 100; idx++)
+    subhzdata[idx] = (int32_t)dsinedata[idx];
+
+  msr = msr3_init (NULL);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+  strcpy (msr->sid, "FDSN:XX_TEST__L_H_Z");
+  msr->starttime = origin;
+  msr->samprate = -10.0;
+  msr->encoding = DE_INT32;
+  msr->reclen = 1024;
+  msr->pubversion = 1;
+  msr->datasamples = subhzdata;
+  msr->numsamples = 100;
+  msr->sampletype = 'i';
+
+  packbuflen = 0;
+  rv = msr3_pack (msr, record_handler_buf, NULL, NULL, MSF_FLUSHDATA, 0);
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+  REQUIRE (rv == 1, "msr3_pack() returned unexpected value");
+
+  memcpy (subhz, packbuf, packbuflen);
+  REQUIRE (msr3_parse (subhz, (uint64_t)packbuflen, &msr, 0, 0) == MS_NOERROR,
+           "msr3_parse() could not parse sub-Hz record");
+  CHECK (msr->samprate == -10.0, "Sub-Hz record does not store a sample period");
+
+  starttime = origin + 500 * (nstime_t)NSTMODULUS;
+  endtime = origin + 700 * (nstime_t)NSTMODULUS;
+
+  packbuflen = 0;
+  rv = msr3_cut (msr, starttime, endtime, record_handler_buf, NULL, 0, 0);
+  CHECK (rv == 1, "msr3_cut() returned unexpected record count for sub-Hz record");
+  msr3_free (&msr);
+
+  REQUIRE (msr3_parse (packbuf, (uint64_t)packbuflen, &msr, MSF_UNPACKDATA, 0) == MS_NOERROR,
+           "msr3_parse() could not parse cut sub-Hz record");
+  CHECK (msr->starttime == starttime, "Cut sub-Hz record does not start at window start");
+  REQUIRE (msr->numsamples == 21, "Cut sub-Hz record has unexpected sample count");
+  CHECK (((int32_t *)msr->datasamples)[0] == subhzdata[50],
+         "Cut sub-Hz record starts with unexpected sample");
+  msr3_free (&msr);
+}
+
+TEST (repack, cut_decodeonly)
+{
+  MS3Record *msr = NULL;
+  MS3Record *cut = NULL;
+  const char *files[] = {"data/testdata-encoding-CDSN.mseed2",
+                         "data/testdata-encoding-GEOSCOPE-16bit-3exp-encoded.mseed2"};
+  const int8_t encodings[] = {DE_INT32, DE_FLOAT32};
+  nstime_t starttime;
+  nstime_t endtime;
+  int64_t rv;
+  int idx;
+
+  /* Records with decode-only encodings are cut to 100 samples of a generic encoding */
+  for (idx = 0; idx < 2; idx++)
+  {
+    rv = ms3_readmsr (&msr, files[idx], MSF_UNPACKDATA, 0);
+    REQUIRE (rv == MS_NOERROR, "ms3_readmsr() did not return expected MS_NOERROR");
+    REQUIRE (msr->numsamples > 200, "Unexpected sample count of input record");
+
+    starttime = ms_sampletime (msr->starttime, 100, msr->samprate);
+    endtime = ms_sampletime (msr->starttime, 199, msr->samprate);
+
+    packbuflen = 0;
+    rv = msr3_cut (msr, starttime, endtime, record_handler_buf, NULL, 0, 0);
+    CHECK (rv == 1, "msr3_cut() did not cut record with decode-only encoding");
+
+    REQUIRE (msr3_parse (packbuf, (uint64_t)packbuflen, &cut, MSF_UNPACKDATA, 0) == MS_NOERROR,
+             "msr3_parse() could not parse cut record");
+    CHECK (cut->encoding == encodings[idx], "Cut record has unexpected encoding");
+    CHECK (cut->starttime == starttime, "Cut record does not start at window start");
+    REQUIRE (cut->numsamples == 100, "Cut record has unexpected sample count");
+    CHECK (cut->sampletype == msr->sampletype, "Cut record has unexpected sample type");
+    CHECK (memcmp (cut->datasamples,
+                   (char *)msr->datasamples + 100 * ms_samplesize (msr->sampletype),
+                   100 * ms_samplesize (msr->sampletype)) == 0,
+           "Cut record has unexpected samples");
+
+    msr3_free (&cut);
+    ms3_readmsr (&msr, NULL, 0, 0);
+  }
+}
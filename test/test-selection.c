@@ -134,4 +134,141 @@ TEST (selection, error)
   REQUIRE (match == NULL, "ms3_matchselect() did not return expected NULL");
 
   ms3_freeselections (selections);
-}
\ No newline at end of file
+}
+TEST (selection, compiled)
+{
+  const char *patterns[] = {"FDSN:XX_STA1__B_H_Z",  "FDSN:XX_*",
+                            "FDSN:YY_STA?__L_H_Z",  "FDSN:XX_STA1_*",
+                            "FDSN:ZZ_*_*_B_H_[ZE]", "*",
+                            "FDSN:XX_STA1__B_H_Z",  "FDSN:YY_STA1__L_H_Z"};
+  const char *sids[] = {"FDSN:XX_STA1__B_H_Z",   "FDSN:XX_STA2__B_H_N",  "FDSN:YY_STA1__L_H_Z",
+                        "FDSN:YY_STA12__L_H_Z",  "FDSN:ZZ_S_00_B_H_E",   "FDSN:ZZ_S_00_B_H_N",
+                        "FDSN:XX_STA1_00_B_H_Z", "FDSN:AA_STA1__B_H_Z"};
+  MS3Selections *selections = NULL;
+  MS3CompiledSelections *compiled = NULL;
+  const MS3Selections *match;
+  const MS3Selections *compiledmatch;
+  const MS3SelectTime *timematch;
+  const MS3SelectTime *compiledtimematch;
+  nstime_t base = ms_timestr2nstime ("2010-02-27T00:00:00Z");
+  nstime_t hour = (nstime_t)3600 * NSTMODULUS;
+  nstime_t starttime;
+  nstime_t endtime;
+  int mismatches = 0;
+  int matches = 0;
+  int pidx;
+  int sidx;
+  int tidx;
+  int rv;
+
+  /* Entries with multiple, overlapping and open time windows, and
+   * publication versions, with patterns of every kind */
+  for (pidx = 0; pidx < (int)(sizeof (patterns) / sizeof (patterns[0])); pidx++)
+  {
+    if (pidx == 5)
+    {
+      rv = ms3_addselect (&selections, patterns[pidx], base + 20 * hour, NSTUNSET, 3);
+      REQUIRE (rv == 0, "ms3_addselect() did not return expected 0");
+      continue;
+    }
+
+    for (tidx = 0; tidx < 3; tidx++)
+    {
+      starttime = (tidx == 2) ? NSTUNSET : base + (pidx + tidx * 6) * hour;
+      endtime = base + (pidx + tidx * 6 + 2) * hour;
+
+      rv = ms3_addselect (&selections, patterns[pidx], starttime, endtime, (pidx == 7) ? 2 : 0);
+      REQUIRE (rv == 0, "ms3_addselect() did not return expected 0");
+    }
+  }
+
+  compiled = ms3_compileselections (selections);
+  REQUIRE (compiled != NULL, "ms3_compileselections() did not return expected compiled selections");
+
+  /* Compare with ms3_matchselect() for combinations of IDs, times and versions,
+   * twice to exercise the source ID cache */
+  for (tidx = 0; tidx < 2 * 30 * 4; tidx++)
+  {
+    for (sidx = 0; sidx < (int)(sizeof (sids) / sizeof (sids[0])); sidx++)
+    {
+      starttime = base + (tidx % 30) * hour - hour / 2;
+      endtime = starttime + ((tidx / 30) % 4) * hour / 3;
+
+      match = ms3_matchselect (selections, sids[sidx], starttime, endtime, (tidx % 4), &timematch);
+      compiledmatch = ms3_matchselect_compiled (compiled, sids[sidx], starttime, endtime,
+                                                (tidx % 4), &compiledtimematch);
+
+      if (match != compiledmatch || timematch != compiledtimematch)
+        mismatches++;
+      if (match)
+        matches++;
+    }
+  }
+
+  CHECK (mismatches == 0, "ms3_matchselect_compiled() results differ from ms3_matchselect()");
+  CHECK (matches > 0, "ms3_matchselect_compiled() test matched no entries");
+
+  match = ms3_matchselect_compiled (compiled, "FDSN:XX_STA1__B_H_Z", NSTUNSET, NSTUNSET, 0, NULL);
+  CHECK (match != NULL, "ms3_matchselect_compiled() did not return expected match");
+
+  match = ms3_matchselect_compiled (compiled, "FDSN:QQ_STA1__B_H_Z", base, base + hour, 0, NULL);
+  CHECK (match == NULL, "ms3_matchselect_compiled() returned unexpected match");
+
+  ms3_freecompiledselections (compiled);
+  ms3_freeselections (selections);
+}
+
+TEST (selection, compiled_windows)
+{
+  MS3Selections *selections = NULL;
+  MS3CompiledSelections *compiled = NULL;
+  const MS3Selections *match;
+  const MS3Selections *compiledmatch;
+  const MS3SelectTime *timematch;
+  const MS3SelectTime *compiledtimematch;
+  nstime_t base = ms_timestr2nstime ("2010-02-27T00:00:00Z");
+  nstime_t minute = (nstime_t)60 * NSTMODULUS;
+  nstime_t starttime;
+  uint32_t state = 12345;
+  int mismatches = 0;
+  int matches = 0;
+  int idx;
+  int rv;
+
+  /* Many overlapping windows of varied length in no particular order */
+  for (idx = 0; idx < 500; idx++)
+  {
+    state = state * 1103515245 + 12345;
+    starttime = base + (nstime_t)((state >> 8) % 10000) * minute;
+    rv = ms3_addselect (&selections, "FDSN:XX_STA1__B_H_Z", starttime,
+                        starttime + (nstime_t)(1 + (state >> 4) % 200) * minute, 0);
+    REQUIRE (rv == 0, "ms3_addselect() did not return expected 0");
+  }
+
+  compiled = ms3_compileselections (selections);
+  REQUIRE (compiled != NULL, "ms3_compileselections() did not return expected compiled selections");
+
+  for (idx = 0; idx < 5000; idx++)
+  {
+    state = state * 1103515245 + 12345;
+    starttime = base + (nstime_t)((state >> 8) % 10500) * minute - 100 * minute;
+
+    match = ms3_matchselect (selections, "FDSN:XX_STA1__B_H_Z", starttime,
+                             starttime + (nstime_t)(idx % 5) * minute, 0, &timematch);
+    compiledmatch = ms3_matchselect_compiled (compiled, "FDSN:XX_STA1__B_H_Z", starttime,
+                                              starttime + (nstime_t)(idx % 5) * minute, 0,
+                                              &compiledtimematch);
+
+    if (match != compiledmatch || timematch != compiledtimematch)
+      mismatches++;
+    if (match)
+      matches++;
+  }
+
+  CHECK (mismatches == 0, "ms3_matchselect_compiled() results differ from ms3_matchselect()");
+  CHECK (matches > 0 && matches < 5000,
+         "ms3_matchselect_compiled() test did not match some queries");
+
+  ms3_freecompiledselections (compiled);
+  ms3_freeselections (selections);
+}
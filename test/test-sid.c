@@ -52,6 +52,48 @@ TEST (SID, ms_sid2nslc_n)
   CHECK (rv == -1, "ms_sid2nslc did not return expected -1");
 }
 
+TEST (SID, ms_sid2sourceid)
+{
+  MS3SourceID sourceid = {0};
+  char net[2];
+  char chan[3];
+  int rv;
+
+  rv = ms_sid2sourceid ("FDSN:XX_TEST__L_H_Z", &sourceid);
+  CHECK (rv == 0, "ms_sid2sourceid returned unexpected error");
+  CHECK_STREQ (sourceid.sid, "FDSN:XX_TEST__L_H_Z");
+  CHECK_STREQ (sourceid.net, "XX");
+  CHECK_STREQ (sourceid.sta, "TEST");
+  CHECK_STREQ (sourceid.loc, "");
+  CHECK_STREQ (sourceid.chan, "LHZ");
+
+  /* The same identifier reuses the codes, a different one replaces them */
+  rv = ms_sid2sourceid ("FDSN:XX_TEST__L_H_Z", &sourceid);
+  CHECK (rv == 0, "ms_sid2sourceid returned unexpected error");
+  CHECK_STREQ (sourceid.chan, "LHZ");
+
+  rv = ms_sid2sourceid ("FDSN:YY_STA_00_BB_SS_ZZ", &sourceid);
+  CHECK (rv == 0, "ms_sid2sourceid returned unexpected error");
+  CHECK_STREQ (sourceid.net, "YY");
+  CHECK_STREQ (sourceid.sta, "STA");
+  CHECK_STREQ (sourceid.loc, "00");
+  CHECK_STREQ (sourceid.chan, "BB_SS_ZZ");
+
+  /* An error clears the codes */
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+  rv = ms_sid2sourceid ("FDSN:YY_STA", &sourceid);
+  CHECK (rv == -1, "ms_sid2sourceid did not return expected -1");
+  CHECK_STREQ (sourceid.sid, "");
+  CHECK_STREQ (sourceid.net, "");
+
+  /* Codes are truncated to the buffer sizes of ms_sid2nslc_n() */
+  rv = ms_sid2nslc_n ("FDSN:XX_TEST__BB_SS_ZZ", net, sizeof (net), NULL, 0, NULL, 0, chan,
+                      sizeof (chan));
+  CHECK (rv == 0, "ms_sid2nslc_n returned unexpected error");
+  CHECK_STREQ (net, "X");
+  CHECK_STREQ (chan, "BB");
+}
+
 TEST (SID, ms_nslc2sid)
 {
   uint16_t flags = 0;
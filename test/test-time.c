@@ -106,6 +106,50 @@ TEST (time, nstime2timestr)
   CHECK_STREQ (timestr, "ERROR");
 }
 
+TEST (time, nstime2timestr_batch)
+{
+  nstime_t nstimes[] = {1084345689123456788, 1084345689123456000, 1084345689000000000,
+                        1084345699500000000, 1084399199999999999, 1084399200000000000,
+                        -1,                  -86400000000001,     NSTUNSET,
+                        NSTERROR,            -9000000000000000000, 1084345689123456788};
+  char batch[sizeof (nstimes) / sizeof (nstimes[0])][40];
+  char single[40];
+  int count = sizeof (nstimes) / sizeof (nstimes[0]);
+  int timeformat;
+  int subseconds;
+  int mismatches = 0;
+  int idx;
+
+  for (timeformat = ISOMONTHDAY; timeformat <= NANOSECONDEPOCH; timeformat++)
+  {
+    for (subseconds = NONE; subseconds <= NANO_MICRO_NONE; subseconds++)
+    {
+      CHECK (ms_nstime2timestr_batch (nstimes, count, batch[0], sizeof (batch[0]),
+                                      (ms_timeformat_t)timeformat,
+                                      (ms_subseconds_t)subseconds) == count,
+             "ms_nstime2timestr_batch() returned unexpected value");
+
+      for (idx = 0; idx < count; idx++)
+      {
+        ms_nstime2timestr_n (nstimes[idx], single, sizeof (single), (ms_timeformat_t)timeformat,
+                             (ms_subseconds_t)subseconds);
+
+        if (strcmp (batch[idx], single))
+          mismatches++;
+      }
+    }
+  }
+
+  CHECK (mismatches == 0, "ms_nstime2timestr_batch() differs from ms_nstime2timestr_n()");
+
+  /* Suppress error and warning messages by accumulating them */
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+
+  /* Slots too small for the strings */
+  CHECK (ms_nstime2timestr_batch (nstimes, 2, batch[0], 20, ISOMONTHDAY, NANO) == MS_GENERROR,
+         "ms_nstime2timestr_batch() did not reject small slots");
+}
+
 TEST (time, timestr2nstime)
 {
   nstime_t nstime;
@@ -200,6 +244,52 @@ TEST (time, timestr2nstime)
 /* Verify ms_sampletime() adjusts by one second per leap second contained in
  * the span, not just the first, using the embedded leap second list (which
  * includes leaps at 2015-07-01 and 2017-01-01). */
+TEST (time, timestr2nstime_canonical)
+{
+  /* Canonical strings converted directly and equivalent forms for the general parsers */
+  const char *canonical[] = {"2004-05-12T07:08:09.123456788Z",
+                             "2004-05-12 07:08:09.1",
+                             "2004-05-12T07:08:09",
+                             "2004-05-12",
+                             "2016-12-31T23:59:60.999999999Z",
+                             "1969-12-31T23:59:59.5",
+                             "2004,133,07:08:09.123456788",
+                             "2004,133,07:08:09",
+                             "2004,133"};
+  const char *general[] = {"2004-5-12T7:8:9.123456788Z",
+                           "2004/05/12 7:8:9.100",
+                           "2004-05-12T07:08:09.000",
+                           "2004-05-12T00:00",
+                           "2016-12-31T23:59:60.9999999990Z",
+                           "1969-12-31T23:59:59.50",
+                           "2004,133,7,8,9.123456788",
+                           "2004,133,07,08,09",
+                           "2004,133,00"};
+  int count = sizeof (canonical) / sizeof (canonical[0]);
+  int idx;
+
+  for (idx = 0; idx < count; idx++)
+  {
+    CHECK (ms_timestr2nstime (canonical[idx]) == ms_timestr2nstime (general[idx]),
+           "Canonical time string converted differently than general form");
+    CHECK (ms_timestr2nstime (canonical[idx]) != NSTERROR,
+           "Canonical time string was not converted");
+  }
+
+  CHECK (ms_mdtimestr2nstime ("2004-05-12T07:08:09.123456788Z") == 1084345689123456788,
+         "ms_mdtimestr2nstime() did not convert canonical time string");
+  CHECK (ms_seedtimestr2nstime ("2004,133,07:08:09.123456788") == 1084345689123456788,
+         "ms_seedtimestr2nstime() did not convert canonical time string");
+
+  /* Suppress error and warning messages by accumulating them */
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+
+  /* Out of range values in canonical forms are still rejected */
+  CHECK (ms_timestr2nstime ("2004-02-30T00:00:00") == NSTERROR, "Invalid day was not rejected");
+  CHECK (ms_timestr2nstime ("2004,367,00:00:00") == NSTERROR, "Invalid day was not rejected");
+  CHECK (ms_timestr2nstime ("2004-05-12T24:00:00") == NSTERROR, "Invalid hour was not rejected");
+}
+
 TEST (time, sampletime_multileap)
 {
   nstime_t start;
@@ -257,6 +347,56 @@ TEST (time, sampletime_overflow)
          "ms_sampletime() did not calculate the expected time for a normal rate");
 }
 
+/* Verify ms_sampletimes() matches ms_sampletime() for each sample,
+ * including samples following contained leap seconds. */
+TEST (time, sampletimes)
+{
+  MS3Record msr = {0};
+  nstime_t times[2000];
+  nstime_t start;
+  int64_t idx;
+  int mismatches;
+
+  /* 0.3 Hz across the 2016-12-31 leap second */
+  start = ms_timestr2nstime ("2016-12-31T23:00:00.123456789Z");
+  REQUIRE (ms_sampletimes (start, 5, 2000, 0.3, times) == 0,
+           "ms_sampletimes() returned unexpected error");
+  for (mismatches = 0, idx = 0; idx < 2000; idx++)
+    mismatches += (times[idx] != ms_sampletime (start, 5 + idx, 0.3));
+  CHECK (mismatches == 0, "ms_sampletimes() differs from ms_sampletime() across a leap second");
+
+  /* Ten hour period across two leap seconds */
+  start = ms_timestr2nstime ("2015-06-01T00:00:00Z");
+  REQUIRE (ms_sampletimes (start, 0, 2000, -36000.0, times) == 0,
+           "ms_sampletimes() returned unexpected error");
+  for (mismatches = 0, idx = 0; idx < 2000; idx++)
+    mismatches += (times[idx] != ms_sampletime (start, idx, -36000.0));
+  CHECK (mismatches == 0, "ms_sampletimes() differs from ms_sampletime() across two leap seconds");
+
+  /* 40 Hz without leap seconds */
+  start = ms_timestr2nstime ("2012-05-12T00:00:00Z");
+  REQUIRE (ms_sampletimes (start, 0, 2000, 40.0, times) == 0,
+           "ms_sampletimes() returned unexpected error");
+  for (mismatches = 0, idx = 0; idx < 2000; idx++)
+    mismatches += (times[idx] != ms_sampletime (start, idx, 40.0));
+  CHECK (mismatches == 0, "ms_sampletimes() differs from ms_sampletime() at 40 Hz");
+
+  /* Record samples, bounded by the sample count */
+  msr.starttime = start;
+  msr.samprate = 40.0;
+  msr.samplecnt = 100;
+  CHECK (msr3_sampletimes (&msr, times, 90, 10) == 0,
+         "msr3_sampletimes() returned unexpected error");
+  CHECK (times[0] == ms_sampletime (start, 90, 40.0) && times[9] == ms_sampletime (start, 99, 40.0),
+         "msr3_sampletimes() returned unexpected times");
+
+  ms_rloginit (NULL, NULL, NULL, NULL, 10);
+  CHECK (msr3_sampletimes (&msr, times, 91, 10) == MS_GENERROR,
+         "msr3_sampletimes() did not reject samples beyond the record");
+  CHECK (ms_sampletimes (start, 2, 2, 5e-324, times) == MS_GENERROR,
+         "ms_sampletimes() did not reject an out-of-range span");
+}
+
 TEST (time, systemtime)
 {
   time_t timeval;
@@ -273,3 +413,48 @@ TEST (time, systemtime)
 
   CHECK (difference < 1 * NSTMODULUS, "lmp_systemtime() is not within 1 second of system time");
 }
+
+/* Loading a leap second file replaces the library list, this test is
+ * last so the embedded list is used by the tests above */
+TEST (time, readleapsecondfile)
+{
+  const char *path = "testdata-leapseconds";
+  nstime_t start;
+  nstime_t end;
+  int64_t offsetsec;
+  FILE *fp;
+
+  /* Leap seconds of 2015-07-01 and 2017-01-01, out of order */
+  fp = fopen (path, "wb");
+  REQUIRE (fp != NULL, "Cannot create leap second file");
+  fprintf (fp, "# Leap seconds\n3692217600 37\n3644697600 36\n");
+  fclose (fp);
+
+  CHECK (ms_readleapsecondfile (path) == 2, "ms_readleapsecondfile() returned unexpected value");
+  REQUIRE (leapsecondlist != NULL, "Leap second list not loaded");
+  CHECK (leapsecondlist->TAIdelta == 36, "Leap second list is not sorted");
+  REQUIRE (leapsecondlist->next != NULL, "Leap second list is not linked");
+  CHECK (leapsecondlist->next->TAIdelta == 37, "Leap second list is not sorted");
+  CHECK (leapsecondlist->next->next == NULL, "Leap second list is not terminated");
+
+  /* Both loaded leap seconds contained */
+  start = ms_timestr2nstime ("2015-01-01T00:00:00Z");
+  end = ms_timestr2nstime ("2017-06-01T00:00:00Z");
+  offsetsec = (end - start) / NSTMODULUS;
+  CHECK (ms_sampletime (start, offsetsec, -1.0) == end - 2 * NSTMODULUS,
+         "ms_sampletime() did not adjust for loaded leap seconds");
+
+  /* The embedded leap second of 2012-07-01 is no longer used */
+  start = ms_timestr2nstime ("2012-01-01T00:00:00Z");
+  end = ms_timestr2nstime ("2013-01-01T00:00:00Z");
+  offsetsec = (end - start) / NSTMODULUS;
+  CHECK (ms_sampletime (start, offsetsec, -1.0) == end,
+         "ms_sampletime() adjusted for a leap second not in the loaded list");
+
+  /* Spans of a second or less never contain a leap second */
+  start = ms_timestr2nstime ("2016-12-31T23:59:59.5Z");
+  CHECK (ms_sampletime (start, 1, 1.0) == start + NSTMODULUS,
+         "ms_sampletime() adjusted a span of a second");
+
+  remove (path);
+}
@@ -672,3 +672,130 @@ TEST (tracelist, mstl3_convertsamples_double)
   CHECK (((int32_t *)seg->datasamples)[1] == -2, "Double sample did not convert as expected");
   mstl3_free (&mstl, 0);
 }
+
+TEST (tracelist, skipduplicates)
+{
+  char buffer[2 * 1836];
+  FILE *fp = NULL;
+
+  MS3TraceList *mstl = NULL;
+  MS3TraceSeg *seg = NULL;
+  MS3Record *msr = NULL;
+  uint32_t flags = MSF_UNPACKDATA | MSF_SKIPDUPLICATES;
+  int64_t rv;
+  int pass;
+
+  char *path = "data/reference-testdata-steim2.mseed3";
+
+  /* Read test data into buffer twice, duplicating each record but none adjacent */
+  fp = fopen (path, "rb");
+  REQUIRE (fp != NULL, "File pointer is unexpected NULL");
+  REQUIRE (fread (buffer, 1836, 1, fp) == 1, "fread() did not read entire file");
+  fclose (fp);
+  memcpy (buffer + 1836, buffer, 1836);
+
+  rv = mstl3_readbuffer (&mstl, buffer, sizeof (buffer), 0, flags, NULL, 0);
+  CHECK (rv == 4, "mstl3_readbuffer() did not return expected 4");
+  REQUIRE (mstl != NULL, "mstl3_readbuffer() did not populate 'mstl'");
+  REQUIRE (mstl->numtraceids == 1, "Unexpected number of trace IDs");
+  seg = mstl->traces.next[0]->first;
+  CHECK (seg->next == NULL, "Duplicate records created additional segments");
+  CHECK (seg->samplecnt == 499, "Unexpected sample count with duplicates skipped");
+  CHECK (seg->numsamples == 499, "Unexpected number of unpacked samples");
+
+  /* Records read from a file are duplicates of those already in the trace list */
+  rv = ms3_readtracelist (&mstl, path, NULL, 0, flags, 0);
+  CHECK (rv == MS_NOERROR, "ms3_readtracelist() returned unexpected error");
+  CHECK (mstl->traces.next[0]->first->samplecnt == 499, "Duplicate records were added");
+  mstl3_free (&mstl, 0);
+
+  /* Adding the records twice with mstl3_addmsr() */
+  mstl = mstl3_init (NULL);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+
+  for (pass = 0; pass < 2; pass++)
+  {
+    while (ms3_readmsr (&msr, path, MSF_UNPACKDATA, 0) == MS_NOERROR)
+    {
+      CHECK (mstl3_addmsr (mstl, msr, 0, 1, MSF_SKIPDUPLICATES, NULL) != NULL,
+             "mstl3_addmsr() returned unexpected NULL");
+    }
+    ms3_readmsr (&msr, NULL, 0, 0);
+  }
+
+  seg = mstl->traces.next[0]->first;
+  CHECK (seg->next == NULL, "Duplicate records created additional segments");
+  CHECK (seg->samplecnt == 499, "Unexpected sample count with duplicates skipped");
+  mstl3_free (&mstl, 0);
+
+  /* Without skipping duplicates the repeated records are added */
+  rv = mstl3_readbuffer (&mstl, buffer, sizeof (buffer), 0, MSF_UNPACKDATA, NULL, 0);
+  CHECK (rv == 8, "mstl3_readbuffer() did not return expected 8");
+  REQUIRE (mstl != NULL, "mstl3_readbuffer() did not populate 'mstl'");
+  CHECK (mstl->traces.next[0]->first->next != NULL, "Repeated records were not added");
+  mstl3_free (&mstl, 0);
+}
+
+TEST (tracelist, sidlookup)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceID *id = NULL;
+  MS3Record *msr = NULL;
+  char sid[LM_SIDLEN];
+  int idx;
+
+  msr = msr3_init (NULL);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+  mstl = mstl3_init (NULL);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+
+  msr->samprate = 1.0;
+  msr->samplecnt = 10;
+  msr->pubversion = 1;
+
+  /* Contiguous records of many interleaved SIDs join one segment per SID */
+  for (idx = 0; idx < 2000; idx++)
+  {
+    snprintf (sid, sizeof (sid), "FDSN:XX_H%03d__B_H_Z", idx % 500);
+    strcpy (msr->sid, sid);
+    msr->starttime = (nstime_t)(idx / 500) * 10 * NSTMODULUS;
+
+    CHECK (mstl3_addmsr (mstl, msr, 0, 0, 0, NULL) != NULL,
+           "mstl3_addmsr() returned unexpected NULL");
+  }
+
+  CHECK (mstl->numtraceids == 500, "Unexpected number of trace IDs");
+  for (id = mstl->traces.next[0]; id; id = id->next[0])
+  {
+    if (id->numsegments != 1 || id->first->samplecnt != 40)
+      break;
+  }
+  CHECK (id == NULL, "Records were not joined to the trace ID of their SID");
+
+  /* Publication versions split a SID into several trace IDs */
+  strcpy (msr->sid, "FDSN:XX_H000__B_H_Z");
+  msr->starttime = (nstime_t)40 * NSTMODULUS;
+  msr->pubversion = 2;
+  CHECK (mstl3_addmsr (mstl, msr, 1, 0, 0, NULL) != NULL,
+         "mstl3_addmsr() returned unexpected NULL");
+  CHECK (mstl->numtraceids == 501, "Version 2 did not create a trace ID");
+
+  msr->pubversion = 1;
+  CHECK (mstl3_addmsr (mstl, msr, 1, 0, 0, NULL) != NULL,
+         "mstl3_addmsr() returned unexpected NULL");
+  msr->starttime = (nstime_t)50 * NSTMODULUS;
+  msr->pubversion = 2;
+  CHECK (mstl3_addmsr (mstl, msr, 1, 0, 0, NULL) != NULL,
+         "mstl3_addmsr() returned unexpected NULL");
+  CHECK (mstl->numtraceids == 501, "Unexpected number of trace IDs with versions");
+
+  id = mstl3_findID (mstl, "FDSN:XX_H000__B_H_Z", 1, NULL);
+  REQUIRE (id != NULL, "Version 1 trace ID not found");
+  CHECK (id->first->samplecnt == 50, "Version 1 record was not joined to its trace ID");
+  id = mstl3_findID (mstl, "FDSN:XX_H000__B_H_Z", 2, NULL);
+  REQUIRE (id != NULL, "Version 2 trace ID not found");
+  CHECK (id->first->samplecnt == 20, "Version 2 record was not joined to its trace ID");
+
+  mstl3_free (&mstl, 0);
+  msr3_free (&msr);
+}
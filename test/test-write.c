@@ -93,6 +93,7 @@ extern int cmpfiles (char *fileA, char *fileB);
 #define TESTFILE_B500FIELDS_V2 "testdata-b500fields.mseed2"
 #define TESTFILE_SAMPLECOUNT_V2 "testdata-samplecount.mseed2"
 #define TESTFILE_MSTLPACK_EXTRA_V2 "testdata-mstlpack-extra.mseed2"
+#define TESTFILE_FILEWRITER_V3 "testdata-filewriter.mseed3"
 
 /* Test writing miniSEED records to a file for each supported encoding and
  * verifies the output against reference files.
@@ -994,6 +995,175 @@ TEST (write, mstl3_writemseed)
   msr3_free (&msr);
 }
 
+TEST (write, ms3_filewriter)
+{
+  MS3FileWriter *writer = NULL;
+  MS3Record *msr = NULL;
+  MS3TraceList *mstl = NULL;
+  const uint64_t buffersizes[] = {0, 1000, 100};
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  char reference[4096];
+  size_t referencelength;
+  FILE *fp;
+  int idx;
+  int64_t rv;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  msr->reclen = 512;
+  msr->pubversion = 1;
+  msr->starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate = 40.0;
+  msr->encoding = DE_STEIM2;
+  msr->numsamples = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = isinedata;
+  msr->sampletype = 'i';
+
+  /* Records packed into buffers larger and smaller than a record */
+  for (idx = 0; idx < (int)(sizeof (buffersizes) / sizeof (buffersizes[0])); idx++)
+  {
+    writer = ms3_filewriter_open (TESTFILE_FILEWRITER_V3, 1, buffersizes[idx], 0);
+    REQUIRE (writer != NULL, "ms3_filewriter_open() returned unexpected NULL");
+
+    rv = ms3_filewriter_write_msr (writer, msr, MSF_FLUSHDATA, 0);
+    CHECK (rv == 4, "ms3_filewriter_write_msr() returned unexpected value");
+
+    rv = ms3_filewriter_close (&writer);
+    CHECK (rv == 0, "ms3_filewriter_close() returned unexpected error");
+    CHECK (writer == NULL, "ms3_filewriter_close() did not set pointer to NULL");
+    CHECK (!cmpfiles (TESTFILE_FILEWRITER_V3, "data/reference-" TESTFILE_STEIM2_V3),
+           "File writer record write mismatch");
+  }
+
+  /* Trace list records */
+  mstl = mstl3_init (mstl);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+  REQUIRE (mstl3_addmsr (mstl, msr, 0, 1, 0, NULL) != NULL,
+           "mstl3_addmsr() returned unexpected NULL");
+
+  writer = ms3_filewriter_open (TESTFILE_FILEWRITER_V3, 1, 0, 0);
+  REQUIRE (writer != NULL, "ms3_filewriter_open() returned unexpected NULL");
+  rv = ms3_filewriter_write_mstl (writer, mstl, 512, DE_STEIM2, MSF_FLUSHDATA, 0);
+  CHECK (rv == 4, "ms3_filewriter_write_mstl() returned unexpected value");
+  CHECK (mstl->numtraceids == 0, "Written trace list data were not removed");
+  rv = ms3_filewriter_close (&writer);
+  CHECK (rv == 0, "ms3_filewriter_close() returned unexpected error");
+  CHECK (!cmpfiles (TESTFILE_FILEWRITER_V3, "data/reference-" TESTFILE_STEIM2_V3),
+         "File writer trace list write mismatch");
+
+  mstl3_free (&mstl, 0);
+
+  /* Raw records written in two sessions, appending to the file */
+  fp = fopen ("data/reference-" TESTFILE_STEIM2_V3, "rb");
+  REQUIRE (fp != NULL, "Cannot open reference file");
+  referencelength = fread (reference, 1, sizeof (reference), fp);
+  fclose (fp);
+  REQUIRE (referencelength > 1024, "Cannot read reference file");
+
+  writer = ms3_filewriter_open (TESTFILE_FILEWRITER_V3, 1, 0, 0);
+  REQUIRE (writer != NULL, "ms3_filewriter_open() returned unexpected NULL");
+  CHECK (ms3_filewriter_write (writer, reference, 1024) == 0,
+         "ms3_filewriter_write() returned unexpected error");
+  CHECK (ms3_filewriter_close (&writer) == 0, "ms3_filewriter_close() returned unexpected error");
+
+  writer = ms3_filewriter_open (TESTFILE_FILEWRITER_V3, 0, 512, 0);
+  REQUIRE (writer != NULL, "ms3_filewriter_open() returned unexpected NULL");
+  CHECK (ms3_filewriter_write (writer, reference + 1024, referencelength - 1024) == 0,
+         "ms3_filewriter_write() returned unexpected error");
+  CHECK (ms3_filewriter_flush (writer, 1) == 0, "ms3_filewriter_flush() returned unexpected error");
+  CHECK (!cmpfiles (TESTFILE_FILEWRITER_V3, "data/reference-" TESTFILE_STEIM2_V3),
+         "File writer flushed append mismatch");
+  CHECK (ms3_filewriter_close (&writer) == 0, "ms3_filewriter_close() returned unexpected error");
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
+TEST (write, ms3_filewriter_async)
+{
+  MS3FileWriter *writer = NULL;
+  MS3Record *msr = NULL;
+  const uint64_t buffersizes[] = {512, 1000, 100, 0};
+  const int buffercounts[] = {2, 3, 2, 0};
+  int32_t isinedata[SINE_DATA_SAMPLES];
+  char reference[4096];
+  size_t referencelength;
+  FILE *fp;
+  int idx;
+  int64_t rv;
+
+  for (idx = 0; idx < SINE_DATA_SAMPLES; idx++)
+  {
+    isinedata[idx] = (int32_t)(dsinedata[idx]);
+  }
+
+  msr = msr3_init (msr);
+  REQUIRE (msr != NULL, "msr3_init() returned unexpected NULL");
+
+  msr->reclen = 512;
+  msr->pubversion = 1;
+  msr->starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  strcpy (msr->sid, "FDSN:XX_TEST__B_H_Z");
+  msr->samprate = 40.0;
+  msr->encoding = DE_STEIM2;
+  msr->numsamples = SINE_DATA_SAMPLES - 1;
+  msr->datasamples = isinedata;
+  msr->sampletype = 'i';
+
+  writer = ms3_filewriter_open_async (TESTFILE_FILEWRITER_V3, 1, 0, 1, 0);
+  CHECK (writer == NULL, "ms3_filewriter_open_async() accepted a single buffer");
+
+  /* Records queued in buffers holding one, several and no records */
+  for (idx = 0; idx < (int)(sizeof (buffersizes) / sizeof (buffersizes[0])); idx++)
+  {
+    writer = ms3_filewriter_open_async (TESTFILE_FILEWRITER_V3, 1, buffersizes[idx],
+                                        buffercounts[idx], 0);
+    REQUIRE (writer != NULL, "ms3_filewriter_open_async() returned unexpected NULL");
+
+    rv = ms3_filewriter_write_msr (writer, msr, MSF_FLUSHDATA, 0);
+    CHECK (rv == 4, "ms3_filewriter_write_msr() returned unexpected value");
+
+    CHECK (ms3_filewriter_flush (writer, 0) == 0,
+           "ms3_filewriter_flush() returned unexpected error");
+    CHECK (!cmpfiles (TESTFILE_FILEWRITER_V3, "data/reference-" TESTFILE_STEIM2_V3),
+           "Asynchronous file writer flushed write mismatch");
+
+    rv = ms3_filewriter_close (&writer);
+    CHECK (rv == 0, "ms3_filewriter_close() returned unexpected error");
+    CHECK (writer == NULL, "ms3_filewriter_close() did not set pointer to NULL");
+  }
+
+  /* Raw records queued one at a time, written in order on close */
+  fp = fopen ("data/reference-" TESTFILE_STEIM2_V3, "rb");
+  REQUIRE (fp != NULL, "Cannot open reference file");
+  referencelength = fread (reference, 1, sizeof (reference), fp);
+  fclose (fp);
+  REQUIRE (referencelength > 1024, "Cannot read reference file");
+
+  writer = ms3_filewriter_open_async (TESTFILE_FILEWRITER_V3, 1, 512, 2, 0);
+  REQUIRE (writer != NULL, "ms3_filewriter_open_async() returned unexpected NULL");
+  for (idx = 0; idx + 512 < (int)referencelength; idx += 512)
+  {
+    CHECK (ms3_filewriter_write (writer, reference + idx, 512) == 0,
+           "ms3_filewriter_write() returned unexpected error");
+  }
+  CHECK (ms3_filewriter_write (writer, reference + idx, referencelength - idx) == 0,
+         "ms3_filewriter_write() returned unexpected error");
+  CHECK (ms3_filewriter_close (&writer) == 0, "ms3_filewriter_close() returned unexpected error");
+  CHECK (!cmpfiles (TESTFILE_FILEWRITER_V3, "data/reference-" TESTFILE_STEIM2_V3),
+         "Asynchronous file writer raw write mismatch");
+
+  msr->datasamples = NULL;
+  msr3_free (&msr);
+}
+
 /***************************************************************************
  *
  * Internal record handler.  The handler data should be a pointer to
@@ -2614,3 +2784,609 @@ TEST (pack, msr3_pack_v2_calibration_abort)
                              "\"EndTime\":\"2024-01-02T03:04:09Z\"}]}}}") < 0,
          "An unrecognized calibration Type was not rejected");
 }
+
+/* Verify that the simple integer and float encodings round trip for sample
+ * counts that exercise both the vector code and the scalar remainder of
+ * the encoders and decoders, in both byte orders. */
+TEST (pack, msr3_pack_simple_encodings_lengths)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  MS3Record *rmsr = NULL;
+  int32_t idata[40];
+  float fdata[40];
+  double ddata[40];
+  const int8_t encodings[] = {DE_INT16, DE_INT32, DE_FLOAT32, DE_FLOAT64};
+  int eidx;
+  int count;
+  int version;
+  int idx;
+  int rv;
+
+  for (idx = 0; idx < 40; idx++)
+  {
+    idata[idx] = (idx % 2) ? -(idx * 811) : (idx * 757);
+    fdata[idx] = (float)idata[idx] / 7.0f;
+    ddata[idx] = (double)idata[idx] / 13.0;
+  }
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+
+  for (version = 2; version <= 3; version++)
+  {
+    for (eidx = 0; eidx < (int)(sizeof (encodings) / sizeof (encodings[0])); eidx++)
+    {
+      msr.encoding = encodings[eidx];
+
+      if (msr.encoding == DE_FLOAT32)
+      {
+        msr.datasamples = fdata;
+        msr.sampletype = 'f';
+      }
+      else if (msr.encoding == DE_FLOAT64)
+      {
+        msr.datasamples = ddata;
+        msr.sampletype = 'd';
+      }
+      else
+      {
+        msr.datasamples = idata;
+        msr.sampletype = 'i';
+      }
+
+      for (count = 1; count <= 40; count++)
+      {
+        msr.numsamples = count;
+        lastreclen = 0;
+
+        rv = (int)msr3_pack (&msr, record_keeper, NULL, NULL,
+                             MSF_FLUSHDATA | ((version == 2) ? MSF_PACKVER2 : 0), 0);
+        REQUIRE (rv == 1, "msr3_pack() did not create expected single record");
+        REQUIRE (lastreclen > 0, "No record was retained");
+
+        rv = msr3_parse (lastrecord, lastreclen, &rmsr, MSF_UNPACKDATA, 0);
+        REQUIRE (rv == MS_NOERROR, "msr3_parse() did not return expected MS_NOERROR");
+        REQUIRE (rmsr->numsamples == count, "Decoded sample count mismatch");
+        REQUIRE (rmsr->sampletype == msr.sampletype, "Decoded sample type mismatch");
+
+        CHECK (memcmp (rmsr->datasamples, msr.datasamples,
+                       count * ms_samplesize (msr.sampletype)) == 0,
+               "Decoded samples do not match original samples");
+      }
+    }
+  }
+
+  msr3_free (&rmsr);
+}
+
+/* Decode each record and append the samples to a buffer */
+static int32_t steimsamples[4000];
+static int64_t steimcount;
+
+static void
+steim_collector (char *record, int reclen, void *ptr)
+{
+  MS3Record *msr = NULL;
+
+  (void)ptr;
+  if (msr3_parse (record, reclen, &msr, MSF_UNPACKDATA, 0) == MS_NOERROR &&
+      steimcount + msr->numsamples <= (int64_t)(sizeof (steimsamples) / sizeof (int32_t)))
+  {
+    memcpy (steimsamples + steimcount, msr->datasamples, msr->numsamples * sizeof (int32_t));
+    steimcount += msr->numsamples;
+  }
+
+  msr3_free (&msr);
+}
+
+TEST (pack, msr3_pack_steim_bitwidths)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  /* Differences at the edges of each Steim bit width */
+  const int32_t edges[] = {7,      8,      -8,     -9,        15,        16,    -16,   -17,
+                           31,     32,     -32,    -33,       127,       128,   -128,  -129,
+                           511,    512,    -512,   -513,      16383,     16384, -16384, -16385,
+                           32767,  32768,  -32768, -32769,    536870911, -536870911};
+  int32_t data[3000];
+  int64_t count = 0;
+  int64_t rv;
+  int eidx;
+  int run;
+  int idx;
+  int version;
+
+  /* Runs of alternating edge values and constant runs of varying lengths */
+  for (eidx = 0; count < 2900; eidx = (eidx + 1) % (int)(sizeof (edges) / sizeof (edges[0])))
+  {
+    run = 1 + (eidx * 5 + (int)count) % 9;
+
+    for (idx = 0; idx < run; idx++)
+    {
+      data[count++] = 0;
+      data[count++] = edges[eidx];
+    }
+
+    for (idx = 0; idx < run % 4; idx++)
+      data[count++] = edges[eidx];
+  }
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  msr.datasamples = data;
+  msr.numsamples = count;
+  msr.sampletype = 'i';
+
+  for (version = 2; version <= 3; version++)
+  {
+    for (eidx = DE_STEIM1; eidx <= DE_STEIM2; eidx++)
+    {
+      msr.encoding = (int8_t)eidx;
+      steimcount = 0;
+
+      rv = msr3_pack (&msr, steim_collector, NULL, NULL,
+                      MSF_FLUSHDATA | ((version == 2) ? MSF_PACKVER2 : 0), 0);
+      REQUIRE (rv > 1, "msr3_pack() did not create expected multiple records");
+      REQUIRE (steimcount == count, "Decoded sample count mismatch");
+      CHECK (memcmp (steimsamples, data, count * sizeof (int32_t)) == 0,
+             "Decoded samples do not match original samples");
+    }
+  }
+}
+
+/* Append each record to one of two buffers selected by the handler data */
+static char streambuffers[2][200000];
+static int64_t streamlengths[2];
+
+static void
+stream_collector (char *record, int reclen, void *ptr)
+{
+  int which = *(int *)ptr;
+
+  if (streamlengths[which] + reclen <= (int64_t)sizeof (streambuffers[which]))
+    memcpy (streambuffers[which] + streamlengths[which], record, reclen);
+
+  streamlengths[which] += reclen;
+}
+
+TEST (pack, msr3_streampack)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  MS3StreamPacker *stream = NULL;
+  const int8_t encodings[] = {DE_STEIM2, DE_STEIM1, DE_INT32, DE_INT16};
+  int32_t data[6000];
+  int64_t records;
+  int64_t packedsamples;
+  int64_t rv;
+  uint64_t offset;
+  uint64_t block;
+  uint32_t seed = 12345;
+  int batch = 0;
+  int streamed = 1;
+  int eidx;
+  int idx;
+  int version;
+
+  /* Stretches of small and large differences */
+  for (idx = 0; idx < 6000; idx++)
+  {
+    seed = seed * 1103515245 + 12345;
+    data[idx] = (idx / 500 % 2) ? (int32_t)(seed >> 16) % 20000 - 10000
+                                : (int32_t)(seed >> 16) % 16 - 8 + ((idx) ? data[idx - 1] : 0);
+  }
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00.000025");
+  msr.datasamples = data;
+  msr.numsamples = 6000;
+  msr.sampletype = 'i';
+
+  /* Records match msr3_pack() of all samples for any block sizes */
+  for (version = 2; version <= 3; version++)
+  {
+    for (eidx = 0; eidx < (int)(sizeof (encodings) / sizeof (encodings[0])); eidx++)
+    {
+      msr.encoding = encodings[eidx];
+      streamlengths[0] = streamlengths[1] = 0;
+
+      rv = msr3_pack (&msr, stream_collector, &batch, NULL,
+                      MSF_FLUSHDATA | ((version == 2) ? MSF_PACKVER2 : 0), 0);
+      REQUIRE (rv > 1, "msr3_pack() did not create expected multiple records");
+
+      stream = msr3_streampack_init (&msr, stream_collector, &streamed,
+                                     (version == 2) ? MSF_PACKVER2 : 0, 0);
+      REQUIRE (stream != NULL, "msr3_streampack_init() returned unexpected NULL");
+
+      records = 0;
+      for (offset = 0, block = 1; offset < 6000; offset += block, block = block * 7 % 389 + 1)
+      {
+        if (block > 6000 - offset)
+          block = 6000 - offset;
+
+        rv = msr3_streampack_append (stream, data + offset, block,
+                                     (offset == 0) ? msr.starttime : NSTUNSET);
+        REQUIRE (rv >= 0, "msr3_streampack_append() returned unexpected error");
+        records += rv;
+      }
+
+      CHECK (streamlengths[1] < streamlengths[0], "Records not created as blocks were added");
+
+      rv = msr3_streampack_flush (stream);
+      REQUIRE (rv >= 1, "msr3_streampack_flush() did not create expected records");
+      records += rv;
+
+      msr3_streampack_free (&stream, &packedsamples);
+      CHECK (stream == NULL, "msr3_streampack_free() did not set pointer to NULL");
+      CHECK (packedsamples == 6000, "Packed sample count mismatch");
+
+      REQUIRE (streamlengths[1] == streamlengths[0], "Streamed record length total mismatch");
+      CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+             "Streamed records do not match msr3_pack() records");
+    }
+  }
+
+  /* A time gap starts a new run of records */
+  msr.encoding = DE_STEIM2;
+  msr.numsamples = 3000;
+  streamlengths[0] = streamlengths[1] = 0;
+
+  rv = msr3_pack (&msr, stream_collector, &batch, NULL, MSF_FLUSHDATA, 0);
+  REQUIRE (rv > 0, "msr3_pack() returned unexpected error");
+  msr.starttime += (nstime_t)NSTMODULUS * 3600;
+  msr.datasamples = data + 3000;
+  rv = msr3_pack (&msr, stream_collector, &batch, NULL, MSF_FLUSHDATA, 0);
+  REQUIRE (rv > 0, "msr3_pack() returned unexpected error");
+
+  stream = msr3_streampack_init (&msr, stream_collector, &streamed, 0, 0);
+  REQUIRE (stream != NULL, "msr3_streampack_init() returned unexpected NULL");
+
+  rv = msr3_streampack_append (stream, data, 2000, msr.starttime - (nstime_t)NSTMODULUS * 3600);
+  CHECK (rv >= 0, "msr3_streampack_append() returned unexpected error");
+  rv = msr3_streampack_append (stream, data + 2000, 1000, NSTUNSET);
+  CHECK (rv >= 0, "msr3_streampack_append() returned unexpected error");
+  rv = msr3_streampack_append (stream, data + 3000, 3000, msr.starttime);
+  CHECK (rv >= 0, "msr3_streampack_append() returned unexpected error");
+  rv = msr3_streampack_flush (stream);
+  CHECK (rv >= 1, "msr3_streampack_flush() did not create expected records");
+
+  msr3_streampack_free (&stream, NULL);
+
+  REQUIRE (streamlengths[1] == streamlengths[0], "Streamed record length total mismatch");
+  CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+         "Streamed records across a gap do not match msr3_pack() records");
+
+  /* A start time is required to start a stream */
+  stream = msr3_streampack_init (&msr, stream_collector, &streamed, 0, 0);
+  REQUIRE (stream != NULL, "msr3_streampack_init() returned unexpected NULL");
+  rv = msr3_streampack_append (stream, data, 10, NSTUNSET);
+  CHECK (rv == -1, "msr3_streampack_append() without start time did not return expected error");
+  msr3_streampack_free (&stream, NULL);
+}
+
+TEST (pack, msr3_pack_steim_capacity)
+{
+  MS3Record msr = MS3Record_INITIALIZER;
+  int32_t data[1000];
+  int64_t packedsamples;
+  int64_t flushedsamples;
+  int64_t rv;
+  uint32_t seed = 54321;
+  int batch = 0;
+  int unflushed = 1;
+  int idx;
+
+  /* Large differences, needing one 30-bit word per sample, fill 512-byte
+   * Steim2 records with far fewer samples than the frames could hold */
+  for (idx = 0; idx < 1000; idx++)
+  {
+    seed = seed * 1103515245 + 12345;
+    data[idx] = (int32_t)(seed >> 4) % 100000000;
+  }
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 100.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  msr.datasamples = data;
+  msr.numsamples = 1000;
+  msr.sampletype = 'i';
+  msr.encoding = DE_STEIM2;
+  streamlengths[0] = streamlengths[1] = 0;
+
+  rv = msr3_pack (&msr, stream_collector, &batch, &flushedsamples, MSF_FLUSHDATA, 0);
+  REQUIRE (rv > 1, "msr3_pack() did not create expected multiple records");
+
+  /* Without flushing all full records are packed, the same as when flushing */
+  rv = msr3_pack (&msr, stream_collector, &unflushed, &packedsamples, 0, 0);
+  CHECK (rv > 1, "msr3_pack() did not create records that are full");
+  CHECK (packedsamples > 1000 - 120 && packedsamples < flushedsamples,
+         "msr3_pack() did not pack expected samples");
+  CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[1]) == 0,
+         "Unflushed records do not match flushed records");
+}
+
+TEST (pack, mstl3_pack_next_template)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceListPacker *packer = NULL;
+  MS3Record msr = MS3Record_INITIALIZER;
+  const char *starttimes[] = {"2012-05-12T00:00:00", "2012-05-12T01:00:00.000025",
+                              "2012-05-12T02:00:00.000025", "2012-05-12T23:59:59.5"};
+  int32_t data[1000];
+  char *record = NULL;
+  int32_t reclen;
+  int64_t rv;
+  int batch = 0;
+  int generated = 1;
+  int segment;
+  int version;
+  int idx;
+
+  for (idx = 0; idx < 1000; idx++)
+    data[idx] = (idx % 50) * (idx % 7) - 100;
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.datasamples = data;
+  msr.numsamples = 1000;
+  msr.samplecnt = 1000;
+  msr.sampletype = 'i';
+  msr.encoding = DE_STEIM2;
+
+  /* Segments packed in sequence by the same packer, each reusing or rebuilding
+   * the header of the previous, match records packed from each segment alone */
+  for (version = 2; version <= 3; version++)
+  {
+    uint32_t flags = MSF_FLUSHDATA | ((version == 2) ? MSF_PACKVER2 : 0);
+
+    mstl = mstl3_init (NULL);
+    REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+    streamlengths[0] = streamlengths[1] = 0;
+
+    for (segment = 0; segment < 4; segment++)
+    {
+      msr.starttime = ms_timestr2nstime (starttimes[segment]);
+
+      rv = msr3_pack (&msr, stream_collector, &batch, NULL, flags, 0);
+      REQUIRE (rv > 0, "msr3_pack() returned unexpected error");
+
+      REQUIRE (mstl3_addmsr (mstl, &msr, 0, 1, 0, NULL) != NULL,
+               "mstl3_addmsr() returned unexpected NULL");
+    }
+
+    packer = mstl3_pack_init (mstl, 512, DE_STEIM2, flags, 0, NULL, 0);
+    REQUIRE (packer != NULL, "mstl3_pack_init() returned unexpected NULL");
+
+    while ((rv = mstl3_pack_next (packer, 0, &record, &reclen)) == 1)
+      stream_collector (record, reclen, &generated);
+
+    CHECK (rv == 0, "mstl3_pack_next() returned unexpected error");
+    mstl3_pack_free (&packer, NULL);
+    mstl3_free (&mstl, 0);
+
+    REQUIRE (streamlengths[1] == streamlengths[0], "Record length total mismatch");
+    CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+           "Records from reused headers do not match msr3_pack() records");
+  }
+}
+
+/* Append each batch of records to the second stream buffer */
+static int batchcalls;
+static int batchrecords;
+
+static void
+batch_collector (char *records, uint64_t length, int reccount, void *ptr)
+{
+  uint64_t batchsize = *(uint64_t *)ptr;
+
+  if (length > batchsize && reccount != 1)
+    return;
+
+  stream_collector (records, (int)length, &(int){1});
+  batchcalls++;
+  batchrecords += reccount;
+}
+
+TEST (pack, msr3_pack_batch)
+{
+  MS3TraceList *mstl = NULL;
+  MS3Record msr = MS3Record_INITIALIZER;
+  const uint64_t batchsizes[] = {0, 300, 512, 1500};
+  int32_t data[5000];
+  int64_t packedsamples;
+  int64_t rv;
+  uint64_t batchsize;
+  int records;
+  int perbatch;
+  int single = 0;
+  int sidx;
+  int idx;
+
+  for (idx = 0; idx < 5000; idx++)
+    data[idx] = (idx % 90) * (idx % 11) - 300;
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00");
+  msr.datasamples = data;
+  msr.numsamples = 5000;
+  msr.samplecnt = 5000;
+  msr.sampletype = 'i';
+  msr.encoding = DE_STEIM2;
+
+  /* Batches hold the same records as single record callbacks, in order */
+  for (sidx = 0; sidx < (int)(sizeof (batchsizes) / sizeof (batchsizes[0])); sidx++)
+  {
+    batchsize = (batchsizes[sidx]) ? batchsizes[sidx] : 65536;
+    streamlengths[0] = streamlengths[1] = 0;
+    batchcalls = batchrecords = 0;
+
+    records = msr3_pack (&msr, stream_collector, &single, NULL, MSF_FLUSHDATA, 0);
+    REQUIRE (records > 2, "msr3_pack() did not create expected multiple records");
+    perbatch = (batchsize < 512) ? 1 : (int)(batchsize / 512);
+
+    rv = msr3_pack_batch (&msr, batch_collector, &batchsize, batchsizes[sidx], &packedsamples,
+                          MSF_FLUSHDATA, 0);
+    CHECK (rv == batchrecords, "msr3_pack_batch() record count mismatch");
+    CHECK (packedsamples == 5000, "Packed sample count mismatch");
+    CHECK (batchcalls == (records + perbatch - 1) / perbatch, "Unexpected number of batches");
+
+    REQUIRE (streamlengths[1] == streamlengths[0], "Batch length total mismatch");
+    CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+           "Batched records do not match msr3_pack() records");
+  }
+
+  /* Trace list records of several IDs in batches */
+  mstl = mstl3_init (NULL);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+  REQUIRE (mstl3_addmsr (mstl, &msr, 0, 1, 0, NULL) != NULL, "mstl3_addmsr() returned NULL");
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_N");
+  REQUIRE (mstl3_addmsr (mstl, &msr, 0, 1, 0, NULL) != NULL, "mstl3_addmsr() returned NULL");
+
+  streamlengths[0] = streamlengths[1] = 0;
+  batchcalls = batchrecords = 0;
+  batchsize = 2048;
+
+  rv = mstl3_pack (mstl, stream_collector, &single, 512, DE_STEIM2, NULL,
+                   MSF_FLUSHDATA | MSF_MAINTAINMSTL, 0, NULL);
+  REQUIRE (rv > 4, "mstl3_pack() did not create expected multiple records");
+
+  rv = mstl3_pack_batch (mstl, batch_collector, &batchsize, batchsize, 512, DE_STEIM2,
+                         &packedsamples, MSF_FLUSHDATA, 0, NULL);
+  CHECK (rv == batchrecords, "mstl3_pack_batch() record count mismatch");
+  CHECK (packedsamples == 10000, "Packed sample count mismatch");
+  CHECK (batchcalls == (int)((streamlengths[0] + 2047) / 2048), "Unexpected number of batches");
+  CHECK (mstl->numtraceids == 0, "Packed trace IDs were not removed");
+
+  REQUIRE (streamlengths[1] == streamlengths[0], "Batch length total mismatch");
+  CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+         "Batched records do not match mstl3_pack() records");
+
+  mstl3_free (&mstl, 0);
+}
+
+TEST (pack, msr3_pack_next_into)
+{
+  MS3TraceList *mstl = NULL;
+  MS3TraceListPacker *mstlpacker = NULL;
+  MS3RecordPacker *packer = NULL;
+  MS3Record msr = MS3Record_INITIALIZER;
+  const int8_t encodings[] = {DE_STEIM2, DE_STEIM1, DE_INT32, DE_INT16};
+  static double slots[2][600 / sizeof (double)];
+  int32_t data[3000];
+  char *record = NULL;
+  char *slot;
+  int32_t reclen;
+  int64_t rv;
+  int single = 0;
+  int into = 1;
+  const int offsets[] = {0, 3, 5};
+  int oidx;
+  int eidx;
+  int offset;
+  int version;
+  int idx;
+
+  for (idx = 0; idx < 3000; idx++)
+    data[idx] = (idx % 70) * (idx % 13) - 400;
+
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_Z");
+  msr.reclen = 512;
+  msr.pubversion = 1;
+  msr.samprate = 40.0;
+  msr.starttime = ms_timestr2nstime ("2012-05-12T00:00:00.000025");
+  msr.datasamples = data;
+  msr.numsamples = 3000;
+  msr.samplecnt = 3000;
+  msr.sampletype = 'i';
+
+  /* Records packed into caller buffers, aligned or not for in place encoding,
+   * match records packed into the packer's buffer */
+  for (version = 2; version <= 3; version++)
+  {
+    uint32_t flags = MSF_FLUSHDATA | ((version == 2) ? MSF_PACKVER2 : 0);
+
+    for (eidx = 0; eidx < (int)(sizeof (encodings) / sizeof (encodings[0])); eidx++)
+    {
+      for (oidx = 0; oidx < 3; oidx++)
+      {
+        offset = offsets[oidx];
+        msr.encoding = encodings[eidx];
+        streamlengths[0] = streamlengths[1] = 0;
+
+        rv = msr3_pack (&msr, stream_collector, &single, NULL, flags, 0);
+        REQUIRE (rv > 1, "msr3_pack() did not create expected multiple records");
+
+        packer = msr3_pack_init (&msr, flags, 0);
+        REQUIRE (packer != NULL, "msr3_pack_init() returned unexpected NULL");
+
+        /* Alternate between two slots so no header is left in place */
+        slot = (char *)slots[0] + offset;
+        while ((rv = msr3_pack_next_into (packer, slot, 512, &reclen)) == 1)
+        {
+          stream_collector (slot, reclen, &into);
+          slot = (slot < (char *)slots[1]) ? (char *)slots[1] + offset : (char *)slots[0] + offset;
+        }
+
+        CHECK (rv == 0, "msr3_pack_next_into() returned unexpected error");
+        msr3_pack_free (&packer, NULL);
+
+        REQUIRE (streamlengths[1] == streamlengths[0], "Record length total mismatch");
+        CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+               "Records packed into caller buffers do not match msr3_pack() records");
+      }
+    }
+  }
+
+  /* A buffer smaller than the record length is refused */
+  packer = msr3_pack_init (&msr, MSF_FLUSHDATA, 0);
+  REQUIRE (packer != NULL, "msr3_pack_init() returned unexpected NULL");
+  rv = msr3_pack_next_into (packer, (char *)slots[0], 511, &reclen);
+  CHECK (rv == -1, "msr3_pack_next_into() with short buffer did not return expected error");
+  msr3_pack_free (&packer, NULL);
+
+  /* Trace list records packed into caller buffers */
+  msr.encoding = DE_STEIM2;
+  mstl = mstl3_init (NULL);
+  REQUIRE (mstl != NULL, "mstl3_init() returned unexpected NULL");
+  REQUIRE (mstl3_addmsr (mstl, &msr, 0, 1, 0, NULL) != NULL, "mstl3_addmsr() returned NULL");
+  strcpy (msr.sid, "FDSN:XX_TEST__B_H_N");
+  REQUIRE (mstl3_addmsr (mstl, &msr, 0, 1, 0, NULL) != NULL, "mstl3_addmsr() returned NULL");
+  streamlengths[0] = streamlengths[1] = 0;
+
+  mstlpacker = mstl3_pack_init (mstl, 512, DE_STEIM2, MSF_MAINTAINMSTL, 0, NULL, 0);
+  REQUIRE (mstlpacker != NULL, "mstl3_pack_init() returned unexpected NULL");
+  while ((rv = mstl3_pack_next (mstlpacker, MSF_FLUSHDATA, &record, &reclen)) == 1)
+    stream_collector (record, reclen, &single);
+  CHECK (rv == 0, "mstl3_pack_next() returned unexpected error");
+  mstl3_pack_free (&mstlpacker, NULL);
+
+  mstlpacker = mstl3_pack_init (mstl, 512, DE_STEIM2, MSF_MAINTAINMSTL, 0, NULL, 0);
+  REQUIRE (mstlpacker != NULL, "mstl3_pack_init() returned unexpected NULL");
+  rv = mstl3_pack_next_into (mstlpacker, MSF_FLUSHDATA, (char *)slots[0], 256, &reclen);
+  CHECK (rv == -1, "mstl3_pack_next_into() with short buffer did not return expected error");
+  while ((rv = mstl3_pack_next_into (mstlpacker, MSF_FLUSHDATA, (char *)slots[0] + 1, 512,
+                                     &reclen)) == 1)
+    stream_collector ((char *)slots[0] + 1, reclen, &into);
+  CHECK (rv == 0, "mstl3_pack_next_into() returned unexpected error");
+  mstl3_pack_free (&mstlpacker, NULL);
+  mstl3_free (&mstl, 0);
+
+  REQUIRE (streamlengths[0] > 512 * 4, "mstl3_pack_next() did not create expected records");
+  REQUIRE (streamlengths[1] == streamlengths[0], "Record length total mismatch");
+  CHECK (memcmp (streambuffers[0], streambuffers[1], streamlengths[0]) == 0,
+         "Trace list records packed into caller buffers do not match");
+}
@@ -26,6 +26,7 @@
 
 #include "internalstate.h"
 #include "libmseed.h"
+#include "unpack.h"
 
 static MS3TraceID *lm_findID_atleast (MS3TraceList *mstl, const char *sid, uint8_t pubversion);
 static MS3TraceID *lm_addID (MS3TraceList *mstl, MS3TraceID *id, MS3TraceID **prev);
@@ -59,7 +60,10 @@ static int lm_segment_short_of_record (const char *sid, const MS3TraceSeg *seg,
                                        uint32_t flags);
 static int lm_pack_scan_range (MS3TraceListPacker *packer, uint32_t flags, size_t extralength,
                                nstime_t *now, MS3TraceID *start, MS3TraceID *end,
-                               MS3TraceSeg *first_resume_seg, char **record, int32_t *reclen);
+                               MS3TraceSeg *first_resume_seg, char *dest, char **record,
+                               int32_t *reclen);
+static int _mstl3_pack_next_impl (MS3TraceListPacker *packer, uint32_t flags, char *dest,
+                                  char **record, int32_t *reclen);
 
 /* Test if two sample rates are similar using either specified tolerance (if non-negative) or
  * default tolerance */
@@ -157,6 +161,12 @@ mstl3_free (MS3TraceList **ppmstl, int8_t freeprvtptr)
     id = nextid;
   }
 
+  if (((LMTraceListNode *)*ppmstl)->recordkeys)
+    libmseed_memory.free (((LMTraceListNode *)*ppmstl)->recordkeys);
+
+  if (((LMTraceListNode *)*ppmstl)->sidentries)
+    libmseed_memory.free (((LMTraceListNode *)*ppmstl)->sidentries);
+
   libmseed_memory.free (*ppmstl);
 
   *ppmstl = NULL;
@@ -636,6 +646,178 @@ lm_scan_recent (LMTraceIDNode *idnode, const MS3Record *msr, nstime_t endtime, n
   return 1;
 } /* End of lm_scan_recent() */
 
+/***************************************************************************
+ * Test whether a record was already added to a trace list.
+ *
+ * Records are identified by a 64-bit hash, the CRC-32C of the source
+ * identifier and of the data payload determined with msr3_data_bounds(),
+ * together with the start time and sample count, so duplicates are
+ * detected without decoding data, at any distance and regardless of
+ * record length or format version.  Keys are kept in an open
+ * addressing table of the trace list, grown to keep it at most half
+ * full.  A record not seen before is added to the table.
+ *
+ * Records without a raw record cannot be identified and are never
+ * duplicates.
+ *
+ * Returns 1 if the record is a duplicate, 0 if not and -1 on error.
+ ***************************************************************************/
+int
+lm_tracelist_seen (MS3TraceList *mstl, const MS3Record *msr)
+{
+  LMTraceListNode *node = (LMTraceListNode *)mstl;
+  LMRecordKey *entry;
+  LMRecordKey *keys;
+  uint64_t newsize;
+  uint64_t hash;
+  uint64_t idx;
+  uint64_t slot;
+  uint32_t dataoffset;
+  uint32_t datasize;
+
+  if (!mstl || !msr)
+    return -1;
+
+  if (!msr->record)
+    return 0;
+
+  if (msr3_data_bounds (msr, &dataoffset, &datasize))
+    return -1;
+
+  hash = (uint64_t)ms_crc32c ((const uint8_t *)msr->sid, (int)strlen (msr->sid), 0) << 32;
+  hash |= ms_crc32c ((const uint8_t *)msr->record + dataoffset, (int)datasize, 0);
+
+  /* Zero marks an unused entry */
+  if (hash == 0)
+    hash = 1;
+
+  /* Grow table to keep it at most half full, rehashing existing keys */
+  if ((node->recordkeycount + 1) * 2 > node->recordkeysize)
+  {
+    newsize = (node->recordkeysize) ? node->recordkeysize * 2 : 1024;
+
+    if ((keys = (LMRecordKey *)libmseed_memory.malloc (sizeof (LMRecordKey) * newsize)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return -1;
+    }
+
+    memset (keys, 0, sizeof (LMRecordKey) * newsize);
+
+    for (idx = 0; idx < node->recordkeysize; idx++)
+    {
+      if (node->recordkeys[idx].hash == 0)
+        continue;
+
+      slot = node->recordkeys[idx].hash & (newsize - 1);
+      while (keys[slot].hash != 0)
+        slot = (slot + 1) & (newsize - 1);
+
+      keys[slot] = node->recordkeys[idx];
+    }
+
+    if (node->recordkeys)
+      libmseed_memory.free (node->recordkeys);
+
+    node->recordkeys = keys;
+    node->recordkeysize = newsize;
+  }
+
+  /* Search for the key, ending at an unused entry where it is added */
+  slot = hash & (node->recordkeysize - 1);
+  while ((entry = &node->recordkeys[slot])->hash != 0)
+  {
+    if (entry->hash == hash && entry->starttime == msr->starttime &&
+        entry->samplecnt == msr->samplecnt)
+      return 1;
+
+    slot = (slot + 1) & (node->recordkeysize - 1);
+  }
+
+  entry->hash = hash;
+  entry->starttime = msr->starttime;
+  entry->samplecnt = msr->samplecnt;
+  node->recordkeycount++;
+
+  return 0;
+} /* End of lm_tracelist_seen() */
+
+/***************************************************************************
+ * Find the entry for a SID in the trace ID table of a trace list, adding
+ * an unset entry if not present and add is set.
+ *
+ * Returns the entry, or NULL if not present or on error.
+ ***************************************************************************/
+static LMSIDEntry *
+lm_sidentry (LMTraceListNode *node, const char *sid, int8_t add)
+{
+  LMSIDEntry *entry;
+  LMSIDEntry *entries;
+  uint32_t hash;
+  uint32_t newsize;
+  uint32_t idx;
+  uint32_t slot;
+
+  if (!add && !node->sidentries)
+    return NULL;
+
+  /* Zero marks an unused entry */
+  if ((hash = ms_crc32c ((const uint8_t *)sid, (int)strlen (sid), 0)) == 0)
+    hash = 1;
+
+  /* Grow table to keep it at most half full, rehashing existing entries */
+  if (add && (node->sidentrycount + 1) * 2 > node->sidentrysize)
+  {
+    newsize = (node->sidentrysize) ? node->sidentrysize * 2 : 256;
+
+    if ((entries = (LMSIDEntry *)libmseed_memory.malloc (sizeof (LMSIDEntry) * newsize)) == NULL)
+    {
+      ms_log (2, "Cannot allocate memory\n");
+      return NULL;
+    }
+
+    memset (entries, 0, sizeof (LMSIDEntry) * newsize);
+
+    for (idx = 0; idx < node->sidentrysize; idx++)
+    {
+      if (node->sidentries[idx].hash == 0)
+        continue;
+
+      slot = node->sidentries[idx].hash & (newsize - 1);
+      while (entries[slot].hash != 0)
+        slot = (slot + 1) & (newsize - 1);
+
+      entries[slot] = node->sidentries[idx];
+    }
+
+    if (node->sidentries)
+      libmseed_memory.free (node->sidentries);
+
+    node->sidentries = entries;
+    node->sidentrysize = newsize;
+  }
+
+  /* Search for the SID, ending at an unused entry where it is added */
+  slot = hash & (node->sidentrysize - 1);
+  while ((entry = &node->sidentries[slot])->hash != 0)
+  {
+    if (entry->hash == hash && !strcmp (entry->sid, sid))
+      return entry;
+
+    slot = (slot + 1) & (node->sidentrysize - 1);
+  }
+
+  if (!add)
+    return NULL;
+
+  entry->hash = hash;
+  memcpy (entry->sid, sid, sizeof (entry->sid));
+  entry->sid[sizeof (entry->sid) - 1] = '\0';
+  node->sidentrycount++;
+
+  return entry;
+} /* End of lm_sidentry() */
+
 /***************************************************************************
  * Implementation of MS3TraceList addition functions
  *
@@ -647,6 +829,8 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
                     int8_t splitversion, int8_t autoheal, uint32_t flags,
                     const MS3Tolerance *tolerance)
 {
+  LMTraceListNode *node = (LMTraceListNode *)mstl;
+  LMSIDEntry *sidentry = NULL;
   MS3TraceID *id = NULL;
   MS3TraceID *previd[MSTRACEID_SKIPLIST_HEIGHT] = {NULL};
 
@@ -668,6 +852,8 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
   double sampratehz;
   double sampratetol = -1.0;
 
+  int duplicate;
+
   if (!mstl || !msr)
   {
     ms_log (2, "%s(): Required input not defined: 'mstl' or 'msr'\n", __func__);
@@ -685,8 +871,39 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
    * as the version, otherwise use msr->pubversion */
   uint8_t pubversion = (flags & MSF_SPLITISVERSION) ? splitversion : msr->pubversion;
 
-  /* Search for matching trace ID */
-  id = mstl3_findID (mstl, msr->sid, (splitversion) ? pubversion : 0, previd);
+  /* Search for matching trace ID, first in the SID table unless IDs not
+   * allocated by this library may be present */
+  if (!node->foreignid && (sidentry = lm_sidentry (node, msr->sid, 1)) && sidentry->id &&
+      (!splitversion || sidentry->id->pubversion == pubversion))
+  {
+    id = sidentry->id;
+  }
+  else
+  {
+    id = mstl3_findID (mstl, msr->sid, (splitversion) ? pubversion : 0, previd);
+
+    /* Remember the only trace ID with the SID */
+    if (id && sidentry && !sidentry->shared)
+      sidentry->id = id;
+  }
+
+  /* Skip a duplicate record, returning the segment already covering it */
+  if (flags & MSF_SKIPDUPLICATES)
+  {
+    if ((duplicate = lm_tracelist_seen (mstl, msr)) < 0)
+      return NULL;
+
+    for (searchseg = (duplicate && id) ? id->first : NULL; searchseg; searchseg = searchseg->next)
+    {
+      if (msr->starttime >= searchseg->starttime && msr->starttime <= searchseg->endtime)
+      {
+        if (pprecptr)
+          *pprecptr = NULL;
+
+        return searchseg;
+      }
+    }
+  }
 
   /* If no matching ID was found create new MS3TraceID and MS3TraceSeg entries */
   if (!id)
@@ -731,6 +948,17 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
       libmseed_memory.free (id);
       return NULL;
     }
+
+    /* Map the SID to the new ID, unless another ID has the SID */
+    if (sidentry && (sidentry->id || sidentry->shared))
+    {
+      sidentry->shared = 1;
+      sidentry->id = NULL;
+    }
+    else if (sidentry)
+    {
+      sidentry->id = id;
+    }
   }
   /* Add data coverage to the matching MS3TraceID */
   else
@@ -1225,6 +1453,15 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
  * mstl3_pack_ppupdate_flushidle(). If this flag is set, ensure to free the
  * memory using mstl3_free() with the @p freeprvtptr parameter set to 1.
  *
+ * If the ::MSF_SKIPDUPLICATES flag is set in @p flags, records already
+ * added to the trace list with this flag are skipped wherever they occur.
+ * Records are identified by a hash of the source identifier and the data
+ * payload of the raw record at ::MS3Record.record, along with the start
+ * time and sample count, without decoding the data.  For a skipped record
+ * the segment already covering it is returned and the data is not added
+ * again, records without a raw record are never skipped.  A duplicate is
+ * only skipped if it is still covered by the trace list.
+ *
  * @param[in] mstl Destination ::MS3TraceList to add data to
  * @param[in] msr ::MS3Record containing the data to add to list
  * @param[in] splitversion Flag to control splitting of version/quality
@@ -1234,6 +1471,7 @@ _mstl3_addmsr_impl (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **ppr
  *  - @c ::MSF_PPUPDATETIME : Store update time (as nstime_t) at ::MS3TraceSeg.prvtptr
  *  - @c ::MSF_SPLITISVERSION : Use @p splitversion as the version, otherwise use msr->pubversion
  *  - @c ::MSF_RECORDLIST_NOEXTRAS : Do not copy extra headers into record list entries
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records already added to the trace list
  * @endparblock
  * @param[in] tolerance Tolerance function pointers as ::MS3Tolerance
  *
@@ -1266,6 +1504,9 @@ mstl3_addmsr (MS3TraceList *mstl, const MS3Record *msr, int8_t splitversion, int
  * ::MS3RecordPtr will be added to the appropriate record list and the values of
  * ::MS3RecordPtr.msr and ::MS3RecordPtr.endtime will be set, all other fields
  * should be set by the caller.
+ *
+ * For a duplicate record skipped with ::MSF_SKIPDUPLICATES no ::MS3RecordPtr
+ * is added and @p *pprecptr is set to NULL.
  ***************************************************************************/
 MS3TraceSeg *
 mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr **pprecptr,
@@ -1298,6 +1539,7 @@ mstl3_addmsr_recordptr (MS3TraceList *mstl, const MS3Record *msr, MS3RecordPtr *
  * @parblock
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
  *  - @c ::MSF_RECORDLIST_NOEXTRAS : Do not copy extra headers into record list entries
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records already added to the trace list, before unpacking
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -1347,6 +1589,7 @@ mstl3_readbuffer (MS3TraceList **ppmstl, const char *buffer, uint64_t bufferleng
  * @parblock
  *  - @c ::MSF_RECORDLIST : Build a ::MS3RecordList for each ::MS3TraceSeg
  *  - @c ::MSF_RECORDLIST_NOEXTRAS : Do not copy extra headers into record list entries
+ *  - @c ::MSF_SKIPDUPLICATES : Skip records already added to the trace list, before unpacking
  *  - Flags supported by msr3_parse()
  *  - Flags supported by mstl3_addmsr()
  * @endparblock
@@ -1369,12 +1612,15 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
   MS3Record *msr = NULL;
   MS3TraceSeg *seg = NULL;
   MS3RecordPtr *recordptr = NULL;
+  char sid[LM_SIDLEN];
   uint32_t dataoffset;
   uint32_t datasize;
   uint64_t offset = 0;
   uint32_t pflags = flags;
+  int64_t preskip;
   int64_t reccount = 0;
   int parsevalue;
+  int duplicate;
 
   if (!ppmstl)
   {
@@ -1391,12 +1637,28 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
       return MS_GENERROR;
   }
 
-  /* Defer data unpacking if selections are used by unsetting MSF_UNPACKDATA */
-  if ((flags & MSF_UNPACKDATA) && selections)
+  /* Defer data unpacking for selections or duplicate skipping by unsetting MSF_UNPACKDATA */
+  if ((flags & MSF_UNPACKDATA) && (selections || (flags & MSF_SKIPDUPLICATES)))
     pflags &= ~(MSF_UNPACKDATA);
 
   while ((bufferlength - offset) >= MINRECLEN)
   {
+    /* Skip records not matching selections using only the fixed header */
+    if (selections &&
+        (preskip = lm_preselect_skip (selections, buffer + offset, bufferlength - offset, sid)) > 0)
+    {
+      if (verbose > 1)
+      {
+        ms_log (0,
+                "Skipping (selection) record for %s (%" PRId64
+                " bytes) starting at offset %" PRIu64 "\n",
+                sid, preskip, offset);
+      }
+
+      offset += preskip;
+      continue;
+    }
+
     parsevalue = msr3_parse (buffer + offset, bufferlength - offset, &msr, pflags, verbose);
 
     if (parsevalue < 0)
@@ -1426,23 +1688,46 @@ mstl3_readbuffer_selection (MS3TraceList **ppmstl, const char *buffer, uint64_t
         offset += msr->reclen;
         continue;
       }
+    }
 
-      /* Unpack data samples if this has been deferred */
-      if ((flags & MSF_UNPACKDATA) && msr->samplecnt > 0)
+    /* Skip records already added to the trace list */
+    if (flags & MSF_SKIPDUPLICATES)
+    {
+      if ((duplicate = lm_tracelist_seen (*ppmstl, msr)) < 0)
       {
-        if (msr3_unpack_data (msr, verbose) != msr->samplecnt)
-        {
-          if (msr)
-            msr3_free (&msr);
+        msr3_free (&msr);
+        return MS_GENERROR;
+      }
 
-          return MS_GENERROR;
+      if (duplicate)
+      {
+        if (verbose > 1)
+        {
+          ms_log (0,
+                  "Skipping (duplicate) record for %s (%d bytes) starting at offset %" PRIu64 "\n",
+                  msr->sid, msr->reclen, offset);
         }
+
+        offset += msr->reclen;
+        continue;
+      }
+    }
+
+    /* Unpack data samples if this has been deferred */
+    if (!(pflags & MSF_UNPACKDATA) && (flags & MSF_UNPACKDATA) && msr->samplecnt > 0)
+    {
+      if (msr3_unpack_data (msr, verbose) != msr->samplecnt)
+      {
+        if (msr)
+          msr3_free (&msr);
+
+        return MS_GENERROR;
       }
     }
 
     /* Add record to trace list */
     seg = mstl3_addmsr_recordptr (*ppmstl, msr, (flags & MSF_RECORDLIST) ? &recordptr : NULL,
-                                  splitversion, 1, flags, tolerance);
+                                  splitversion, 1, flags & ~MSF_SKIPDUPLICATES, tolerance);
 
     if (seg == NULL)
     {
@@ -2101,6 +2386,45 @@ mstl3_convertsamples (MS3TraceSeg *seg, char type, int8_t truncate)
   return 0;
 } /* End of mstl3_convertsamples() */
 
+/** ************************************************************************
+ * @brief Calculate the times of samples in a ::MS3TraceSeg
+ *
+ * Set @p times to the times of the @p count samples of the segment
+ * starting at sample @p start, identical to those calculated by
+ * ms_sampletime() including adjustment for leap seconds.  The sample
+ * times do not depend on the data samples, which need not be present.
+ *
+ * @param[in] seg ::MS3TraceSeg to calculate sample times of
+ * @param[out] times Array of at least @p count values for the sample times
+ * @param[in] start First sample to calculate the time of
+ * @param[in] count Number of sample times to calculate
+ *
+ * @returns 0 on success and ::MS_GENERROR on error, including samples
+ * beyond ::MS3TraceSeg.samplecnt.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see ms_sampletimes()
+ ***************************************************************************/
+int
+mstl3_sampletimes (const MS3TraceSeg *seg, nstime_t *times, int64_t start, int64_t count)
+{
+  if (!seg)
+  {
+    ms_log (2, "%s(): Required input not defined: 'seg'\n", __func__);
+    return MS_GENERROR;
+  }
+
+  if (start < 0 || count < 0 || start > seg->samplecnt - count)
+  {
+    ms_log (2, "%s(): Samples %" PRId64 " to %" PRId64 " beyond %" PRId64 " in the segment\n",
+            __func__, start, start + count, seg->samplecnt);
+    return MS_GENERROR;
+  }
+
+  return ms_sampletimes (seg->starttime, start, count, seg->samprate, times);
+} /* End of mstl3_sampletimes() */
+
 /** ************************************************************************
  * @brief Resize data sample buffers of ::MS3TraceList to what is needed
  *
@@ -2520,11 +2844,11 @@ lm_segment_short_of_record (const char *sid, const MS3TraceSeg *seg, int reclen,
 {
   uint32_t maxreclen = (reclen < 0) ? MS_PACK_DEFAULT_RECLEN : (uint32_t)reclen;
   int8_t formatversion = (flags & MSF_PACKVER2) ? 2 : 3;
-  uint8_t samplesize = ms_samplesize (seg->sampletype);
 
-  return lm_pack_short_of_record (
-      formatversion, maxreclen, strlen (sid), (extra) ? (uint16_t)extralength : 0,
-      lm_segment_encoding (seg->sampletype, encoding), samplesize, seg->numsamples);
+  return lm_pack_short_of_record (formatversion, maxreclen, strlen (sid),
+                                  (extra) ? (uint16_t)extralength : 0,
+                                  lm_segment_encoding (seg->sampletype, encoding), seg->sampletype,
+                                  seg->datasamples, seg->numsamples);
 } /* End of lm_segment_short_of_record() */
 
 /***************************************************************************
@@ -2722,6 +3046,60 @@ mstl3_pack (MS3TraceList *mstl, void (*record_handler) (char *, int, void *), vo
                                flags, verbose, extra, 0);
 }
 
+/** ************************************************************************
+ * @brief Pack ::MS3TraceList data into miniSEED records delivered in batches
+ *
+ * This function is identical to mstl3_pack() except that records are
+ * collected in a buffer of @p batchsize bytes and passed to @p
+ * batch_handler() many at a time instead of one record per callback,
+ * see msr3_pack_batch() for a description of the callback.  Records of
+ * different trace IDs and segments may share a batch.
+ *
+ * @param[in] mstl ::MS3TraceList containing data to pack
+ * @param[in] batch_handler() Callback function called for each batch of records
+ * @param[in] handlerdata A pointer that will be provided to the @p batch_handler()
+ * @param[in] batchsize Size of the batch buffer in bytes, 0 for a default of 65536
+ * @param[in] reclen Maximum record length to create
+ * @param[in] encoding Encoding for data samples, see msr3_pack()
+ * @param[out] packedsamples The number of samples packed, returned to caller
+ * @param[in] flags Bit flags to control packing, see mstl3_pack()
+ * @param[in] verbose Controls logging verbosity, 0 is no diagnostic output
+ * @param[in] extra If not NULL, add this buffer of extra headers to all records
+ *
+ * @returns the number of records created on success and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mstl3_pack()
+ * @see msr3_pack_batch()
+ ***************************************************************************/
+int64_t
+mstl3_pack_batch (MS3TraceList *mstl, void (*batch_handler) (char *, uint64_t, int, void *),
+                  void *handlerdata, uint64_t batchsize, int reclen, int8_t encoding,
+                  int64_t *packedsamples, uint32_t flags, int8_t verbose, char *extra)
+{
+  LMRecordBatch batch;
+  int64_t packedrecords;
+
+  if (!mstl)
+  {
+    ms_log (2, "%s(): Required input not defined: 'mstl'\n", __func__);
+    return -1;
+  }
+
+  if (lm_batch_init (&batch, batch_handler, handlerdata, batchsize))
+    return -1;
+
+  packedrecords = _mstl3_pack_callback (mstl, lm_batch_record_handler, &batch, reclen, encoding,
+                                        packedsamples, flags, verbose, extra, 0);
+
+  /* Records packed before an error are delivered */
+  lm_batch_flush (&batch);
+  lm_batch_free (&batch);
+
+  return packedrecords;
+} /* End of mstl3_pack_batch() */
+
 /***************************************************************************
  * Calculate a new segment start time after packed samples are removed
  * from the front of the segment.
@@ -2873,7 +3251,7 @@ mstl3_pack_init (MS3TraceList *mstl, int reclen, int8_t encoding, uint32_t flags
 static int
 lm_pack_scan_range (MS3TraceListPacker *packer, uint32_t flags, size_t extralength, nstime_t *now,
                     MS3TraceID *start, MS3TraceID *end, MS3TraceSeg *first_resume_seg,
-                    char **record, int32_t *reclen)
+                    char *dest, char **record, int32_t *reclen)
 {
   MS3TraceID *id;
   MS3TraceSeg *seg;
@@ -2989,7 +3367,8 @@ lm_pack_scan_range (MS3TraceListPacker *packer, uint32_t flags, size_t extraleng
       packer->segpackedsamples = 0;
 
       /* Try to get next record from segment packing state */
-      result = msr3_pack_next (packer->seg_packing_state, record, reclen);
+      result = (dest) ? lm_pack_next (packer->seg_packing_state, dest, reclen)
+                      : msr3_pack_next (packer->seg_packing_state, record, reclen);
 
       if (result == 1)
       {
@@ -3071,17 +3450,52 @@ lm_pack_scan_range (MS3TraceListPacker *packer, uint32_t flags, size_t extraleng
  * @ref MessageOnError - this function logs a message on error
  *
  * @see mstl3_pack_init()
+ * @see mstl3_pack_next_into()
  * @see mstl3_pack_free()
  ***************************************************************************/
 int
 mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int32_t *reclen)
 {
-  int result;
-  int samplesize;
-  size_t extralength = 0;
-  MS3TraceID *id = NULL;
-  MS3TraceSeg *resume_seg = NULL;
-  nstime_t now = NSTUNSET;
+  if (!packer || !record || !reclen)
+  {
+    ms_log (2, "%s(): Required input not defined\n", __func__);
+    return -1;
+  }
+
+  return _mstl3_pack_next_impl (packer, flags, NULL, record, reclen);
+} /* End of mstl3_pack_next() */
+
+/** ************************************************************************
+ * @brief Generate next miniSEED record from trace list into a caller-supplied buffer
+ *
+ * This function is identical to mstl3_pack_next() except that the record
+ * is written to @p record, memory owned by the caller, instead of a
+ * buffer owned by the @p packer, see msr3_pack_next_into().
+ *
+ * The buffer must be at least as large as the maximum record length of
+ * the packer, i.e. the record length given to mstl3_pack_init() or 4096
+ * when that is -1.  Bytes beyond the returned record length are not
+ * specified.
+ *
+ * @param[in] packer ::MS3TraceListPacker context
+ * @param[in] flags Bit flags to control packing, see mstl3_pack_next()
+ * @param[out] record Buffer for the record
+ * @param[in] recbuflen Length of @p record buffer in bytes
+ * @param[out] reclen Length of record in bytes
+ *
+ * @returns 1 when a record is available, 0 when finished, and -1 on error.
+ *
+ * @ref MessageOnError - this function logs a message on error
+ *
+ * @see mstl3_pack_next()
+ * @see msr3_pack_next_into()
+ ***************************************************************************/
+int
+mstl3_pack_next_into (MS3TraceListPacker *packer, uint32_t flags, char *record, uint32_t recbuflen,
+                      int32_t *reclen)
+{
+  char *unused = NULL;
+  uint32_t maxreclen;
 
   if (!packer || !record || !reclen)
   {
@@ -3089,6 +3503,34 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
     return -1;
   }
 
+  maxreclen = (packer->reclen < 0) ? MS_PACK_DEFAULT_RECLEN : (uint32_t)packer->reclen;
+
+  if (recbuflen < maxreclen)
+  {
+    ms_log (2, "Record buffer length (%u) is smaller than the record length (%u)\n", recbuflen,
+            maxreclen);
+    return -1;
+  }
+
+  return _mstl3_pack_next_impl (packer, flags, record, &unused, reclen);
+} /* End of mstl3_pack_next_into() */
+
+/***************************************************************************
+ * Implementation of mstl3_pack_next() and mstl3_pack_next_into().  When
+ * dest is not NULL records are packed into it, otherwise into the buffer
+ * of the segment packer returned via record.
+ ***************************************************************************/
+static int
+_mstl3_pack_next_impl (MS3TraceListPacker *packer, uint32_t flags, char *dest, char **record,
+                       int32_t *reclen)
+{
+  int result;
+  int samplesize;
+  size_t extralength = 0;
+  MS3TraceID *id = NULL;
+  MS3TraceSeg *resume_seg = NULL;
+  nstime_t now = NSTUNSET;
+
   /* If we have an active segment packing state, try to get another record from it */
   if (packer->seg_packing_state)
   {
@@ -3146,7 +3588,8 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
     if (flags & MSF_FLUSHDATA)
       packer->seg_packing_state->flags |= MSF_FLUSHDATA;
 
-    result = msr3_pack_next (packer->seg_packing_state, record, reclen);
+    result = (dest) ? lm_pack_next (packer->seg_packing_state, dest, reclen)
+                    : msr3_pack_next (packer->seg_packing_state, record, reclen);
 
     if (result == 1)
     {
@@ -3308,7 +3751,8 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
     }
 
     result =
-        lm_pack_scan_range (packer, flags, extralength, &now, id, NULL, resume_seg, record, reclen);
+        lm_pack_scan_range (packer, flags, extralength, &now, id, NULL, resume_seg, dest, record,
+                            reclen);
     if (result != 0)
       return result;
   }
@@ -3329,7 +3773,8 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
     }
 
     result =
-        lm_pack_scan_range (packer, flags, extralength, &now, start, NULL, NULL, record, reclen);
+        lm_pack_scan_range (packer, flags, extralength, &now, start, NULL, NULL, dest, record,
+                            reclen);
     if (result != 0)
       return result;
 
@@ -3339,7 +3784,8 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
     if (start != head)
     {
       result =
-          lm_pack_scan_range (packer, flags, extralength, &now, head, start, NULL, record, reclen);
+          lm_pack_scan_range (packer, flags, extralength, &now, head, start, NULL, dest, record,
+                              reclen);
       if (result != 0)
         return result;
     }
@@ -3351,7 +3797,7 @@ mstl3_pack_next (MS3TraceListPacker *packer, uint32_t flags, char **record, int3
    * 2. With MSF_FLUSHDATA: all segments are empty
    * The caller can add more data and call pack_next() again. */
   return 0;
-} /* End of mstl3_pack_next() */
+} /* End of _mstl3_pack_next_impl() */
 
 /** ************************************************************************
  * @brief Free trace list packing state and resources
@@ -3628,8 +4074,8 @@ mstl3_printtracelist (const MS3TraceList *mstl, ms_timeformat_t timeformat, int8
 {
   const MS3TraceID *id = NULL;
   const MS3TraceSeg *seg = NULL;
-  char stime[40];
-  char etime[40];
+  nstime_t segtimes[2];
+  char timestrs[2][40];
   char gapstr[40];
   int8_t nogap;
   double gap;
@@ -3678,11 +4124,11 @@ mstl3_printtracelist (const MS3TraceList *mstl, ms_timeformat_t timeformat, int8
     while (seg)
     {
       /* Create formatted time strings */
-      if (ms_nstime2timestr_n (seg->starttime, stime, sizeof (stime), timeformat, NANO_MICRO) ==
-          NULL)
-        return;
+      segtimes[0] = seg->starttime;
+      segtimes[1] = seg->endtime;
 
-      if (ms_nstime2timestr_n (seg->endtime, etime, sizeof (etime), timeformat, NANO_MICRO) == NULL)
+      if (ms_nstime2timestr_batch (segtimes, 2, timestrs[0], sizeof (timestrs[0]), timeformat,
+                                   NANO_MICRO) < 0)
         return;
 
       /* Print segment info at varying levels */
@@ -3718,16 +4164,16 @@ mstl3_printtracelist (const MS3TraceList *mstl, ms_timeformat_t timeformat, int8
           snprintf (gapstr, sizeof (gapstr), "%-4.4g", gap);
 
         if (details <= 0)
-          ms_log (0, "%-27s %-28s %-28s %-4s\n", display_sid, stime, etime, gapstr);
+          ms_log (0, "%-27s %-28s %-28s %-4s\n", display_sid, timestrs[0], timestrs[1], gapstr);
         else
-          ms_log (0, "%-27s %-28s %-28s %-s %-3.3g %-" PRId64 "\n", display_sid, stime, etime,
-                  gapstr, seg->samprate, seg->samplecnt);
+          ms_log (0, "%-27s %-28s %-28s %-s %-3.3g %-" PRId64 "\n", display_sid, timestrs[0],
+                  timestrs[1], gapstr, seg->samprate, seg->samplecnt);
       }
       else if (details > 0 && gaps <= 0)
-        ms_log (0, "%-27s %-28s %-28s %-3.3g %-" PRId64 "\n", display_sid, stime, etime,
-                seg->samprate, seg->samplecnt);
+        ms_log (0, "%-27s %-28s %-28s %-3.3g %-" PRId64 "\n", display_sid, timestrs[0],
+                timestrs[1], seg->samprate, seg->samplecnt);
       else
-        ms_log (0, "%-27s %-28s %-28s\n", display_sid, stime, etime);
+        ms_log (0, "%-27s %-28s %-28s\n", display_sid, timestrs[0], timestrs[1]);
 
       segcnt++;
       seg = seg->next;
@@ -3762,8 +4208,8 @@ mstl3_printsynclist (const MS3TraceList *mstl, const char *dccid, ms_subseconds_
 {
   const MS3TraceID *id = NULL;
   const MS3TraceSeg *seg = NULL;
-  char starttime[40];
-  char endtime[40];
+  nstime_t segtimes[2];
+  char timestrs[2][40];
   char yearday[32];
   char net[11] = {0};
   char sta[11] = {0};
@@ -3807,12 +4253,14 @@ mstl3_printsynclist (const MS3TraceList *mstl, const char *dccid, ms_subseconds_
     seg = id->first;
     while (seg)
     {
-      ms_nstime2timestr_n (seg->starttime, starttime, sizeof (starttime), SEEDORDINAL, subseconds);
-      ms_nstime2timestr_n (seg->endtime, endtime, sizeof (endtime), SEEDORDINAL, subseconds);
+      segtimes[0] = seg->starttime;
+      segtimes[1] = seg->endtime;
+      ms_nstime2timestr_batch (segtimes, 2, timestrs[0], sizeof (timestrs[0]), SEEDORDINAL,
+                               subseconds);
 
       /* Print SYNC line */
-      ms_log (0, "%s|%s|%s|%s|%s|%s||%.10g|%" PRId64 "|||||||%s\n", net, sta, loc, chan, starttime,
-              endtime, seg->samprate, seg->samplecnt, yearday);
+      ms_log (0, "%s|%s|%s|%s|%s|%s||%.10g|%" PRId64 "|||||||%s\n", net, sta, loc, chan,
+              timestrs[0], timestrs[1], seg->samprate, seg->samplecnt, yearday);
 
       seg = seg->next;
     }
@@ -3844,7 +4292,8 @@ mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timeformat, double
   const MS3TraceID *id = NULL;
   const MS3TraceSeg *seg = NULL;
 
-  char time1[40], time2[40];
+  nstime_t gaptimes[2];
+  char timestrs[2][40];
   char gapstr[40];
   double gap;
   double delta;
@@ -3916,15 +4365,15 @@ mstl3_printgaplist (const MS3TraceList *mstl, ms_timeformat_t timeformat, double
           snprintf (gapstr, sizeof (gapstr), "%-4.4g", gap);
 
         /* Create formatted time strings */
-        if (ms_nstime2timestr_n (seg->endtime, time1, sizeof (time1), timeformat, NANO_MICRO) ==
-            NULL)
-          ms_log (2, "Cannot convert trace start time for %s\n", id->sid);
+        gaptimes[0] = seg->endtime;
+        gaptimes[1] = seg->next->starttime;
 
-        if (ms_nstime2timestr_n (seg->next->starttime, time2, sizeof (time2), timeformat,
-                                 NANO_MICRO) == NULL)
-          ms_log (2, "Cannot convert trace end time for %s\n", id->sid);
+        if (ms_nstime2timestr_batch (gaptimes, 2, timestrs[0], sizeof (timestrs[0]), timeformat,
+                                     NANO_MICRO) < 0)
+          ms_log (2, "Cannot convert gap times for %s\n", id->sid);
 
-        ms_log (0, "%-27s %-28s %-28s %-4s %-.8g\n", id->sid, time1, time2, gapstr, nsamples);
+        ms_log (0, "%-27s %-28s %-28s %-4s %-.8g\n", id->sid, timestrs[0], timestrs[1], gapstr,
+                nsamples);
 
         gapcnt++;
       }
@@ -4011,6 +4460,7 @@ lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg, int8_t
 {
   MS3TraceID *searchid = NULL;
   MS3TraceID *previd[MSTRACEID_SKIPLIST_HEIGHT] = {NULL};
+  LMSIDEntry *sidentry;
   int level;
 
   if (!mstl || !id || !seg)
@@ -4084,6 +4534,11 @@ lm_remove_segment (MS3TraceList *mstl, MS3TraceID *id, MS3TraceSeg *seg, int8_t
     if (freeprvtptr && id->prvtptr)
       libmseed_memory.free (id->prvtptr);
 
+    /* Forget the TraceID in the SID table */
+    if (!((LMTraceListNode *)mstl)->foreignid &&
+        (sidentry = lm_sidentry ((LMTraceListNode *)mstl, id->sid, 0)) && sidentry->id == id)
+      sidentry->id = NULL;
+
     /* Free the TraceID */
     libmseed_memory.free (id);
 
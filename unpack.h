@@ -37,6 +37,9 @@ extern char *ms2_recordsid (const char *record, char *sid, int sidlen);
 extern const char *ms2_blktdesc (uint16_t blkttype);
 uint16_t ms2_blktlen (uint16_t blkttype, const char *blkt, int8_t swapflag);
 
+extern int64_t lm_preselect_skip (const MS3Selections *selections, const char *record,
+                                  uint64_t recbuflen, char *sid);
+
 #ifdef __cplusplus
 }
 #endif
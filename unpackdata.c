@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "libmseed.h"
+#include "simdutils.h"
 #include "unpackdata.h"
 
 /* Extract bit range.  Byte order agnostic & defined when used with unsigned values */
@@ -35,6 +36,18 @@
 #define MAX16 0x7FFFul   /* maximum 16 bit positive # */
 #define MAX24 0x7FFFFFul /* maximum 24 bit positive # */
 
+/* Force inlining of the decoding kernels.  Each kernel takes the byte swap
+ * flag as a compile-time constant, the public routines call the kernel once
+ * with a literal 0 or 1 so the compiler generates a native-order and a
+ * swapped-order variant without any byte order tests in the sample loops. */
+#if defined(__GNUC__) || defined(__clang__)
+#define LM_DECODE_KERNEL static inline __attribute__ ((always_inline))
+#elif defined(_MSC_VER)
+#define LM_DECODE_KERNEL static __forceinline
+#else
+#define LM_DECODE_KERNEL static inline
+#endif
+
 /************************************************************************
  * msr_decode_int16:
  *
@@ -47,28 +60,18 @@ int64_t
 msr_decode_int16 (int16_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                   int swapflag)
 {
-  int16_t sample;
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength < sizeof (int32_t))
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
-  {
-    sample = input[idx];
-
-    if (swapflag)
-      ms_gswap2 (&sample);
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
 
-    output[idx] = (int32_t)sample;
+  lm_int16_to_int32 (output, input, samplecount, swapflag);
 
-    outputlength -= sizeof (int32_t);
-  }
-
-  return idx;
+  return samplecount;
 } /* End of msr_decode_int16() */
 
 /************************************************************************
@@ -83,28 +86,21 @@ int64_t
 msr_decode_int32 (int32_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                   int swapflag)
 {
-  int32_t sample;
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength < sizeof (int32_t))
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
-  {
-    sample = input[idx];
-
-    if (swapflag)
-      ms_gswap4 (&sample);
-
-    output[idx] = sample;
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
 
-    outputlength -= sizeof (int32_t);
-  }
+  if (swapflag)
+    lm_bswap4_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (int32_t));
 
-  return idx;
+  return samplecount;
 } /* End of msr_decode_int32() */
 
 /************************************************************************
@@ -119,28 +115,21 @@ int64_t
 msr_decode_float32 (float *input, uint64_t samplecount, float *output, uint64_t outputlength,
                     int swapflag)
 {
-  float sample;
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength < sizeof (float))
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (float); idx++)
-  {
-    memcpy (&sample, &input[idx], sizeof (float));
-
-    if (swapflag)
-      ms_gswap4 (&sample);
-
-    output[idx] = sample;
+  if (samplecount > outputlength / sizeof (float))
+    samplecount = outputlength / sizeof (float);
 
-    outputlength -= sizeof (float);
-  }
+  if (swapflag)
+    lm_bswap4_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (float));
 
-  return idx;
+  return samplecount;
 } /* End of msr_decode_float32() */
 
 /************************************************************************
@@ -155,47 +144,32 @@ int64_t
 msr_decode_float64 (double *input, uint64_t samplecount, double *output, uint64_t outputlength,
                     int swapflag)
 {
-  double sample;
-  uint64_t idx;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength < sizeof (double))
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (double); idx++)
-  {
-    memcpy (&sample, &input[idx], sizeof (double));
+  if (samplecount > outputlength / sizeof (double))
+    samplecount = outputlength / sizeof (double);
 
-    if (swapflag)
-      ms_gswap8 (&sample);
-
-    output[idx] = sample;
+  if (swapflag)
+    lm_bswap8_copy (output, input, samplecount);
+  else
+    memcpy (output, input, samplecount * sizeof (double));
 
-    outputlength -= sizeof (double);
-  }
-
-  return idx;
+  return samplecount;
 } /* End of msr_decode_float64() */
 
-/************************************************************************
- * msr_decode_steim1:
- *
- * Decode Steim1 encoded miniSEED data and place in supplied buffer
- * as 32-bit integers.
- *
- * Return number of samples in output buffer on success, -1 on error.
- ************************************************************************/
-int64_t
-msr_decode_steim1 (int32_t *input, uint64_t inputlength, uint64_t samplecount, int32_t *output,
-                   uint64_t outputlength, const char *srcname, int swapflag)
+/* Steim1 frame decoding kernel, arguments are validated by the caller */
+LM_DECODE_KERNEL int64_t
+msr_decode_steim1_int (const int32_t *input, uint64_t maxframes, uint64_t samplecount,
+                       int32_t *output, const char *srcname, const int swapflag)
 {
   uint32_t frame[16]; /* Frame, 16 x 32-bit quantities = 64 bytes */
   int32_t diff[60];   /* Difference values for a frame, max is 15 x 4 (8-bit samples) */
   int32_t Xn = 0;     /* Reverse integration constant, aka last sample */
   uint64_t outputidx;
-  uint64_t maxframes = inputlength / 64;
   uint64_t frameidx;
   int diffidx;
   int startnibble;
@@ -210,19 +184,6 @@ msr_decode_steim1 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
     int32_t d32;
   } *word;
 
-  if (maxframes == 0 || samplecount == 0)
-    return 0;
-
-  if (!input || !output || outputlength == 0)
-    return -1;
-
-  /* Make sure output buffer is sufficient for all output samples */
-  if (samplecount > outputlength / sizeof (int32_t))
-  {
-    ms_log (2, "%s(%s) Output buffer not large enough for decoded samples\n", __func__, srcname);
-    return -1;
-  }
-
 #if DECODE_DEBUG
   ms_log (0, "Decoding %" PRIu64 " Steim1 frames, swapflag: %d, srcname: %s\n", maxframes, swapflag,
           (srcname) ? srcname : "");
@@ -343,25 +304,50 @@ msr_decode_steim1 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
   }
 
   return outputidx;
-} /* End of msr_decode_steim1() */
+} /* End of msr_decode_steim1_int() */
 
 /************************************************************************
- * msr_decode_steim2:
+ * msr_decode_steim1:
  *
- * Decode Steim2 encoded miniSEED data and place in supplied buffer
+ * Decode Steim1 encoded miniSEED data and place in supplied buffer
  * as 32-bit integers.
  *
  * Return number of samples in output buffer on success, -1 on error.
  ************************************************************************/
 int64_t
-msr_decode_steim2 (int32_t *input, uint64_t inputlength, uint64_t samplecount, int32_t *output,
+msr_decode_steim1 (int32_t *input, uint64_t inputlength, uint64_t samplecount, int32_t *output,
                    uint64_t outputlength, const char *srcname, int swapflag)
+{
+  uint64_t maxframes = inputlength / 64;
+
+  if (maxframes == 0 || samplecount == 0)
+    return 0;
+
+  if (!input || !output || outputlength == 0)
+    return -1;
+
+  /* Make sure output buffer is sufficient for all output samples */
+  if (samplecount > outputlength / sizeof (int32_t))
+  {
+    ms_log (2, "%s(%s) Output buffer not large enough for decoded samples\n", __func__, srcname);
+    return -1;
+  }
+
+  if (swapflag)
+    return msr_decode_steim1_int (input, maxframes, samplecount, output, srcname, 1);
+  else
+    return msr_decode_steim1_int (input, maxframes, samplecount, output, srcname, 0);
+} /* End of msr_decode_steim1() */
+
+/* Steim2 frame decoding kernel, arguments are validated by the caller */
+LM_DECODE_KERNEL int64_t
+msr_decode_steim2_int (const int32_t *input, uint64_t maxframes, uint64_t samplecount,
+                       int32_t *output, const char *srcname, const int swapflag)
 {
   uint32_t frame[16]; /* Frame, 16 x 32-bit quantities = 64 bytes */
   int32_t diff[105];  /* Difference values for a frame, max is 15 x 7 (4-bit samples) */
   int32_t Xn = 0;     /* Reverse integration constant, aka last sample */
   uint64_t outputidx;
-  uint64_t maxframes = inputlength / 64;
   uint64_t frameidx;
   int diffidx;
   int startnibble;
@@ -402,19 +388,6 @@ msr_decode_steim2 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
     signed int x : 30;
   } s30;
 
-  if (maxframes == 0 || samplecount == 0)
-    return 0;
-
-  if (!input || !output || outputlength == 0)
-    return -1;
-
-  /* Make sure output buffer is sufficient for all output samples */
-  if (samplecount > outputlength / sizeof (int32_t))
-  {
-    ms_log (2, "%s(%s) Output buffer not large enough for decoded samples\n", __func__, srcname);
-    return -1;
-  }
-
 #if DECODE_DEBUG
   ms_log (0, "Decoding %" PRIu64 " Steim2 frames, swapflag: %d, srcname: %s\n", maxframes, swapflag,
           (srcname) ? srcname : "");
@@ -606,6 +579,39 @@ msr_decode_steim2 (int32_t *input, uint64_t inputlength, uint64_t samplecount, i
   }
 
   return outputidx;
+} /* End of msr_decode_steim2_int() */
+
+/************************************************************************
+ * msr_decode_steim2:
+ *
+ * Decode Steim2 encoded miniSEED data and place in supplied buffer
+ * as 32-bit integers.
+ *
+ * Return number of samples in output buffer on success, -1 on error.
+ ************************************************************************/
+int64_t
+msr_decode_steim2 (int32_t *input, uint64_t inputlength, uint64_t samplecount, int32_t *output,
+                   uint64_t outputlength, const char *srcname, int swapflag)
+{
+  uint64_t maxframes = inputlength / 64;
+
+  if (maxframes == 0 || samplecount == 0)
+    return 0;
+
+  if (!input || !output || outputlength == 0)
+    return -1;
+
+  /* Make sure output buffer is sufficient for all output samples */
+  if (samplecount > outputlength / sizeof (int32_t))
+  {
+    ms_log (2, "%s(%s) Output buffer not large enough for decoded samples\n", __func__, srcname);
+    return -1;
+  }
+
+  if (swapflag)
+    return msr_decode_steim2_int (input, maxframes, samplecount, output, srcname, 1);
+  else
+    return msr_decode_steim2_int (input, maxframes, samplecount, output, srcname, 0);
 } /* End of msr_decode_steim2() */
 
 /* Defines for GEOSCOPE encoding */
@@ -635,6 +641,7 @@ msr_decode_geoscope (char *input, uint64_t samplecount, float *output, uint64_t
   uint64_t exp2val;
   int16_t sint;
   double dsample = 0.0;
+  int bigendianrecord;
 
   if (samplecount == 0)
     return 0;
@@ -649,6 +656,9 @@ msr_decode_geoscope (char *input, uint64_t samplecount, float *output, uint64_t
     return -1;
   }
 
+  /* Determine the record byte order once, not per sample */
+  bigendianrecord = ms_bigendianhost () ^ (swapflag != 0);
+
   for (idx = 0; idx < samplecount && outputlength >= sizeof (float); idx++)
   {
     switch (encoding)
@@ -656,7 +666,7 @@ msr_decode_geoscope (char *input, uint64_t samplecount, float *output, uint64_t
     case DE_GEOSCOPE24:
       /* Assemble the 24-bit sample explicitly by byte position, independent
        * of host byte order, using the record's actual byte order */
-      if (ms_bigendianhost () ^ (swapflag != 0))
+      if (bigendianrecord)
         mantissa = ((uint32_t)(uint8_t)input[0] << 16) | ((uint32_t)(uint8_t)input[1] << 8) |
                    (uint32_t)(uint8_t)input[2];
       else
@@ -732,6 +742,53 @@ msr_decode_geoscope (char *input, uint64_t samplecount, float *output, uint64_t
 #define CDSN_GAINRANGE_MASK 0xC000ul /* mask for gainrange factor */
 #define CDSN_SHIFT 14                /* # bits in mantissa */
 
+/* CDSN decoding kernel, the sample count is already limited to the output length */
+LM_DECODE_KERNEL int64_t
+msr_decode_cdsn_int (const int16_t *input, uint64_t samplecount, int32_t *output,
+                     const int swapflag)
+{
+  uint64_t idx = 0;
+  int32_t mantissa;  /* mantissa */
+  int32_t gainrange; /* gain range factor */
+  int32_t mult = -1; /* multiplier for gain range */
+  uint16_t sint;
+  int32_t sample;
+
+  for (idx = 0; idx < samplecount; idx++)
+  {
+    memcpy (&sint, &input[idx], sizeof (int16_t));
+    if (swapflag)
+      ms_gswap2 (&sint);
+
+    /* Recover mantissa and gain range factor */
+    mantissa = (sint & CDSN_MANTISSA_MASK);
+    gainrange = (sint & CDSN_GAINRANGE_MASK) >> CDSN_SHIFT;
+
+    /* Determine multiplier from the gain range factor and format definition
+     * because shift operator is used later, these are powers of two */
+    if (gainrange == 0)
+      mult = 0;
+    else if (gainrange == 1)
+      mult = 2;
+    else if (gainrange == 2)
+      mult = 4;
+    else if (gainrange == 3)
+      mult = 7;
+
+    /* Unbias the mantissa */
+    mantissa -= MAX14;
+
+    /* Calculate sample from mantissa and multiplier using left shift
+     * mantissa << mult is equivalent to mantissa * (2 exp (mult)) */
+    sample = ((uint32_t)mantissa << mult);
+
+    /* Save sample in output array */
+    output[idx] = sample;
+  }
+
+  return idx;
+} /* End of msr_decode_cdsn_int() */
+
 /************************************************************************
  * msr_decode_cdsn:
  *
@@ -773,59 +830,79 @@ int64_t
 msr_decode_cdsn (int16_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                  int swapflag)
 {
-  uint64_t idx = 0;
-  int32_t mantissa;  /* mantissa */
-  int32_t gainrange; /* gain range factor */
-  int32_t mult = -1; /* multiplier for gain range */
-  uint16_t sint;
-  int32_t sample;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
+
+  if (swapflag)
+    return msr_decode_cdsn_int (input, samplecount, output, 1);
+  else
+    return msr_decode_cdsn_int (input, samplecount, output, 0);
+} /* End of msr_decode_cdsn() */
+
+/* Defines for SRO encoding */
+#define SRO_MANTISSA_MASK 0x0FFFul  /* mask for mantissa */
+#define SRO_GAINRANGE_MASK 0xF000ul /* mask for gainrange factor */
+#define SRO_SHIFT 12                /* # bits in mantissa */
+
+/* SRO decoding kernel, the sample count is already limited to the output length */
+LM_DECODE_KERNEL int64_t
+msr_decode_sro_int (const int16_t *input, uint64_t samplecount, int32_t *output,
+                    const char *srcname, const int swapflag)
+{
+  uint64_t idx = 0;
+  int32_t mantissa;   /* mantissa */
+  int32_t gainrange;  /* gain range factor */
+  int32_t add2gr;     /* added to gainrage factor */
+  int32_t mult;       /* multiplier for gain range */
+  int32_t add2result; /* added to multiplied gain rage */
+  int32_t exponent;   /* total exponent */
+  uint16_t sint;
+  int32_t sample;
+
+  add2gr = 0;
+  mult = -1;
+  add2result = 10;
+
+  for (idx = 0; idx < samplecount; idx++)
   {
     memcpy (&sint, &input[idx], sizeof (int16_t));
     if (swapflag)
       ms_gswap2 (&sint);
 
     /* Recover mantissa and gain range factor */
-    mantissa = (sint & CDSN_MANTISSA_MASK);
-    gainrange = (sint & CDSN_GAINRANGE_MASK) >> CDSN_SHIFT;
+    mantissa = (sint & SRO_MANTISSA_MASK);
+    gainrange = (sint & SRO_GAINRANGE_MASK) >> SRO_SHIFT;
 
-    /* Determine multiplier from the gain range factor and format definition
-     * because shift operator is used later, these are powers of two */
-    if (gainrange == 0)
-      mult = 0;
-    else if (gainrange == 1)
-      mult = 2;
-    else if (gainrange == 2)
-      mult = 4;
-    else if (gainrange == 3)
-      mult = 7;
+    /* Take 2's complement for mantissa */
+    if ((unsigned long)mantissa > MAX12)
+      mantissa -= 2 * (MAX12 + 1);
 
-    /* Unbias the mantissa */
-    mantissa -= MAX14;
+    /* Calculate exponent, SRO exponent = 0..10 */
+    exponent = (mult * (gainrange + add2gr)) + add2result;
 
-    /* Calculate sample from mantissa and multiplier using left shift
-     * mantissa << mult is equivalent to mantissa * (2 exp (mult)) */
-    sample = ((uint32_t)mantissa << mult);
+    if (exponent < 0 || exponent > 10)
+    {
+      ms_log (2, "%s: SRO gain ranging exponent out of range: %d\n", srcname, exponent);
+      return MS_GENERROR;
+    }
+
+    /* Calculate sample as mantissa * 2^exponent.  Use signed arithmetic so a
+     * negative mantissa is scaled correctly; exponent is bounded to 0..10
+     * above, so (1 << exponent) and the product are well within int64_t. */
+    sample = (int32_t)(mantissa * (int64_t)(1 << exponent));
 
     /* Save sample in output array */
     output[idx] = sample;
-    outputlength -= sizeof (int32_t);
   }
 
   return idx;
-} /* End of msr_decode_cdsn() */
-
-/* Defines for SRO encoding */
-#define SRO_MANTISSA_MASK 0x0FFFul  /* mask for mantissa */
-#define SRO_GAINRANGE_MASK 0xF000ul /* mask for gainrange factor */
-#define SRO_SHIFT 12                /* # bits in mantissa */
+} /* End of msr_decode_sro_int() */
 
 /************************************************************************
  * msr_decode_sro:
@@ -862,61 +939,47 @@ int64_t
 msr_decode_sro (int16_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                 const char *srcname, int swapflag)
 {
-  uint64_t idx = 0;
-  int32_t mantissa;   /* mantissa */
-  int32_t gainrange;  /* gain range factor */
-  int32_t add2gr;     /* added to gainrage factor */
-  int32_t mult;       /* multiplier for gain range */
-  int32_t add2result; /* added to multiplied gain rage */
-  int32_t exponent;   /* total exponent */
-  uint16_t sint;
-  int32_t sample;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  add2gr = 0;
-  mult = -1;
-  add2result = 10;
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
+
+  if (swapflag)
+    return msr_decode_sro_int (input, samplecount, output, srcname, 1);
+  else
+    return msr_decode_sro_int (input, samplecount, output, srcname, 0);
+} /* End of msr_decode_sro() */
+
+/* DWWSSN decoding kernel, the sample count is already limited to the output length */
+LM_DECODE_KERNEL int64_t
+msr_decode_dwwssn_int (const int16_t *input, uint64_t samplecount, int32_t *output,
+                       const int swapflag)
+{
+  uint64_t idx = 0;
+  int32_t sample;
+  uint16_t sint;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
+  for (idx = 0; idx < samplecount; idx++)
   {
-    memcpy (&sint, &input[idx], sizeof (int16_t));
+    memcpy (&sint, &input[idx], sizeof (uint16_t));
     if (swapflag)
       ms_gswap2 (&sint);
+    sample = (int32_t)sint;
 
-    /* Recover mantissa and gain range factor */
-    mantissa = (sint & SRO_MANTISSA_MASK);
-    gainrange = (sint & SRO_GAINRANGE_MASK) >> SRO_SHIFT;
-
-    /* Take 2's complement for mantissa */
-    if ((unsigned long)mantissa > MAX12)
-      mantissa -= 2 * (MAX12 + 1);
-
-    /* Calculate exponent, SRO exponent = 0..10 */
-    exponent = (mult * (gainrange + add2gr)) + add2result;
-
-    if (exponent < 0 || exponent > 10)
-    {
-      ms_log (2, "%s: SRO gain ranging exponent out of range: %d\n", srcname, exponent);
-      return MS_GENERROR;
-    }
-
-    /* Calculate sample as mantissa * 2^exponent.  Use signed arithmetic so a
-     * negative mantissa is scaled correctly; exponent is bounded to 0..10
-     * above, so (1 << exponent) and the product are well within int64_t. */
-    sample = (int32_t)(mantissa * (int64_t)(1 << exponent));
+    /* Take 2's complement for sample */
+    if ((unsigned long)sample > MAX16)
+      sample -= 2 * (MAX16 + 1);
 
     /* Save sample in output array */
     output[idx] = sample;
-    outputlength -= sizeof (int32_t);
   }
 
   return idx;
-} /* End of msr_decode_sro() */
+} /* End of msr_decode_dwwssn_int() */
 
 /************************************************************************
  * msr_decode_dwwssn:
@@ -930,31 +993,17 @@ int64_t
 msr_decode_dwwssn (int16_t *input, uint64_t samplecount, int32_t *output, uint64_t outputlength,
                    int swapflag)
 {
-  uint64_t idx = 0;
-  int32_t sample;
-  uint16_t sint;
-
   if (samplecount == 0)
     return 0;
 
   if (!input || !output || outputlength == 0)
     return -1;
 
-  for (idx = 0; idx < samplecount && outputlength >= sizeof (int32_t); idx++)
-  {
-    memcpy (&sint, &input[idx], sizeof (uint16_t));
-    if (swapflag)
-      ms_gswap2 (&sint);
-    sample = (int32_t)sint;
-
-    /* Take 2's complement for sample */
-    if ((unsigned long)sample > MAX16)
-      sample -= 2 * (MAX16 + 1);
-
-    /* Save sample in output array */
-    output[idx] = sample;
-    outputlength -= sizeof (int32_t);
-  }
+  if (samplecount > outputlength / sizeof (int32_t))
+    samplecount = outputlength / sizeof (int32_t);
 
-  return idx;
+  if (swapflag)
+    return msr_decode_dwwssn_int (input, samplecount, output, 1);
+  else
+    return msr_decode_dwwssn_int (input, samplecount, output, 0);
 } /* End of msr_decode_dwwssn() */